@@ -0,0 +1,177 @@
+//===-- AdaptiveArray.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_ADAPTIVEARRAY_H
+#define KLEE_ADAPTIVEARRAY_H
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+/// A fixed-size array of optional values whose representation follows the
+/// number of values actually present. A value is absent iff it converts to
+/// false (e.g. a null ref<Expr>).
+///
+/// While few entries are present they are kept in a vector of (index, value)
+/// pairs sorted by index. Once the entries make up more than a quarter of the
+/// array, the storage switches to a dense array indexed directly. A dense
+/// array is only turned back into a sparse one when it is copied and has
+/// become sufficiently empty, so that alternating set/erase sequences do not
+/// thrash between the two representations.
+template <class T> class AdaptiveArray {
+  typedef std::pair<unsigned, T> Entry;
+  typedef std::vector<Entry> SparseStore;
+
+  unsigned size;
+  unsigned count;
+  std::unique_ptr<T[]> dense;
+  SparseStore sparse;
+
+  /// Number of present entries above which the sparse store is converted.
+  unsigned denseThreshold() const { return size / 4; }
+  /// Number of present entries below which a copy uses the sparse store.
+  unsigned sparseThreshold() const { return size / 16; }
+
+  typename SparseStore::iterator sparseFind(unsigned idx) {
+    return std::lower_bound(
+        sparse.begin(), sparse.end(), idx,
+        [](const Entry &e, unsigned i) { return e.first < i; });
+  }
+  typename SparseStore::const_iterator sparseFind(unsigned idx) const {
+    return std::lower_bound(
+        sparse.begin(), sparse.end(), idx,
+        [](const Entry &e, unsigned i) { return e.first < i; });
+  }
+
+  void makeDense() {
+    dense.reset(new T[size]);
+    for (auto &e : sparse)
+      dense[e.first] = std::move(e.second);
+    SparseStore().swap(sparse);
+  }
+
+public:
+  explicit AdaptiveArray(unsigned size) : size(size), count(0) {}
+
+  AdaptiveArray(const AdaptiveArray &other)
+      : size(other.size), count(other.count) {
+    if (!other.dense) {
+      sparse = other.sparse;
+    } else if (count < sparseThreshold()) {
+      sparse.reserve(count);
+      for (unsigned i = 0; i < size; ++i)
+        if (other.dense[i])
+          sparse.emplace_back(i, other.dense[i]);
+    } else {
+      dense.reset(new T[size]);
+      std::copy(other.dense.get(), other.dense.get() + size, dense.get());
+    }
+  }
+
+  AdaptiveArray &operator=(const AdaptiveArray &) = delete;
+
+  unsigned getSize() const { return size; }
+  /// Number of present entries.
+  unsigned getCount() const { return count; }
+  bool empty() const { return count == 0; }
+  bool isDense() const { return dense != nullptr; }
+
+  /// Returns a pointer to the value at idx, or null if it is absent.
+  const T *lookup(unsigned idx) const {
+    assert(idx < size && "index out of bounds");
+    if (dense)
+      return dense[idx] ? &dense[idx] : nullptr;
+    auto it = sparseFind(idx);
+    if (it == sparse.end() || it->first != idx)
+      return nullptr;
+    return &it->second;
+  }
+
+  bool contains(unsigned idx) const { return lookup(idx) != nullptr; }
+
+  /// Sets the value at idx; setting an absent value erases the entry.
+  void set(unsigned idx, T value) {
+    assert(idx < size && "index out of bounds");
+    if (!value) {
+      erase(idx);
+      return;
+    }
+    if (dense) {
+      if (!dense[idx])
+        ++count;
+      dense[idx] = std::move(value);
+      return;
+    }
+    auto it = sparseFind(idx);
+    if (it != sparse.end() && it->first == idx) {
+      it->second = std::move(value);
+      return;
+    }
+    sparse.emplace(it, idx, std::move(value));
+    if (++count > denseThreshold())
+      makeDense();
+  }
+
+  void erase(unsigned idx) {
+    assert(idx < size && "index out of bounds");
+    if (dense) {
+      if (dense[idx]) {
+        dense[idx] = T();
+        --count;
+      }
+      return;
+    }
+    auto it = sparseFind(idx);
+    if (it != sparse.end() && it->first == idx) {
+      sparse.erase(it);
+      --count;
+    }
+  }
+
+  /// Erases all entries with an index in [begin, end).
+  void eraseRange(unsigned begin, unsigned end) {
+    assert(begin <= end && end <= size && "invalid range");
+    if (dense) {
+      for (unsigned i = begin; i < end && count; ++i) {
+        if (dense[i]) {
+          dense[i] = T();
+          --count;
+        }
+      }
+      return;
+    }
+    auto first = sparseFind(begin);
+    auto last = sparseFind(end);
+    count -= std::distance(first, last);
+    sparse.erase(first, last);
+  }
+
+  /// Calls f(index, value) for each present entry with an index in
+  /// [begin, end), in ascending index order.
+  template <class F> void forEach(unsigned begin, unsigned end, F f) const {
+    assert(begin <= end && end <= size && "invalid range");
+    if (dense) {
+      for (unsigned i = begin; i < end; ++i)
+        if (dense[i])
+          f(i, dense[i]);
+      return;
+    }
+    for (auto it = sparseFind(begin), ie = sparse.end();
+         it != ie && it->first < end; ++it)
+      f(it->first, it->second);
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_ADAPTIVEARRAY_H */
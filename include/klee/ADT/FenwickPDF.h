@@ -0,0 +1,138 @@
+//===-- FenwickPDF.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_FENWICKPDF_H
+#define KLEE_FENWICKPDF_H
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+
+/// A discrete probability distribution over a set of items, with the same
+/// interface as DiscretePDF.
+///
+/// Items occupy a dense range of slots, and the weights are summed in a
+/// Fenwick (binary indexed) tree over those slots, stored in a flat array.
+/// update() and choose() take O(log n) time and never allocate. Removal
+/// moves the last item into the freed slot, so the slots stay dense.
+template <class T, class Hash = std::hash<T>> class FenwickPDF {
+  typedef double weight_type;
+
+  std::vector<T> items;
+  std::vector<weight_type> weights;
+  /// 1-based Fenwick tree over the first `capacity` slots; capacity is a
+  /// power of two so that tree[capacity] is the total weight.
+  std::vector<weight_type> tree;
+  std::size_t capacity = 0;
+  std::unordered_map<T, std::size_t, Hash> slots;
+  /// Incremental updates since the sums were last rebuilt from `weights`.
+  std::size_t updatesSinceRebuild = 0;
+
+  void add(std::size_t slot, weight_type delta) {
+    for (std::size_t i = slot + 1; i <= capacity; i += i & -i)
+      tree[i] += delta;
+  }
+
+  /// Recomputes all partial sums in O(capacity), discarding the rounding
+  /// error accumulated by incremental updates.
+  void rebuild() {
+    tree.assign(capacity + 1, 0);
+    for (std::size_t i = 1; i <= weights.size(); ++i)
+      tree[i] = weights[i - 1];
+    for (std::size_t i = 1; i <= capacity; ++i) {
+      std::size_t parent = i + (i & -i);
+      if (parent <= capacity)
+        tree[parent] += tree[i];
+    }
+    updatesSinceRebuild = 0;
+  }
+
+  void setSlotWeight(std::size_t slot, weight_type weight) {
+    add(slot, weight - weights[slot]);
+    weights[slot] = weight;
+    if (++updatesSinceRebuild >= 16 * capacity)
+      rebuild();
+  }
+
+public:
+  bool empty() const { return items.empty(); }
+  std::size_t size() const { return items.size(); }
+
+  void insert(T item, weight_type weight) {
+    assert(weight >= 0 && "negative weight");
+    assert(!slots.count(item) && "item already in distribution");
+    std::size_t slot = items.size();
+    slots.emplace(item, slot);
+    items.push_back(item);
+    weights.push_back(0);
+    if (slot == capacity) {
+      capacity = capacity ? 2 * capacity : 16;
+      rebuild();
+    }
+    setSlotWeight(slot, weight);
+  }
+
+  void update(T item, weight_type newWeight) {
+    assert(newWeight >= 0 && "negative weight");
+    auto it = slots.find(item);
+    assert(it != slots.end() && "item not in distribution");
+    if (weights[it->second] != newWeight)
+      setSlotWeight(it->second, newWeight);
+  }
+
+  void remove(T item) {
+    auto it = slots.find(item);
+    assert(it != slots.end() && "item not in distribution");
+    std::size_t slot = it->second, last = items.size() - 1;
+    slots.erase(it);
+    if (slot != last) {
+      setSlotWeight(slot, weights[last]);
+      items[slot] = items[last];
+      slots[items[slot]] = slot;
+    }
+    setSlotWeight(last, 0);
+    items.pop_back();
+    weights.pop_back();
+    if (items.empty())
+      rebuild();
+  }
+
+  bool inTree(T item) const { return slots.count(item) != 0; }
+
+  weight_type getWeight(T item) const {
+    auto it = slots.find(item);
+    assert(it != slots.end() && "item not in distribution");
+    return weights[it->second];
+  }
+
+  /// Picks an item according to its weight. p should be in [0,1).
+  T choose(double p) const {
+    assert(!empty() && "choose() called on empty distribution");
+    weight_type target = p * tree[capacity];
+    // Descend to the first slot whose prefix sum exceeds the target.
+    std::size_t pos = 0;
+    for (std::size_t step = capacity; step; step >>= 1) {
+      if (pos + step <= capacity && tree[pos + step] <= target) {
+        pos += step;
+        target -= tree[pos];
+      }
+    }
+    // Rounding (or an all-zero distribution) can push the descent past the
+    // last occupied slot.
+    return items[pos < items.size() ? pos : items.size() - 1];
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_FENWICKPDF_H */
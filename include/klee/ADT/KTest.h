@@ -49,11 +49,54 @@ extern "C" {
   /* returns 1 on success, 0 on (unspecified) error */
   int   kTest_toFile(KTest *, const char *path);
   
+  /* parses the contents of a .ktest file; returns NULL on error */
+  KTest* kTest_fromBuffer(const unsigned char *data, unsigned size);
+
   /* returns total number of object bytes */
   unsigned kTest_numBytes(KTest *);
 
   void  kTest_free(KTest *);
 
+
+  /* A KTest archive stores many tests in one file. Each entry holds the
+     contents of a .ktest file under its file name, optionally compressed
+     with zlib; an index at the end of the file locates the entries. Entries
+     are only ever appended, and an archive whose index was never written
+     (e.g. after a crash) is still readable. */
+  typedef struct KTestArchive KTestArchive;
+
+  /* return true iff file at path is a KTest archive */
+  int   kTestArchive_isArchive(const char *path);
+
+  /* creates an archive for writing, replacing any existing file; returns
+     NULL on error. compress is ignored if zlib is not available. */
+  KTestArchive* kTestArchive_create(const char *path, int compress);
+
+  /* appends a test; returns 1 on success, 0 on error. After a failed
+     write no more tests are added and the index is not written. */
+  int   kTestArchive_addTest(KTestArchive *, const char *name, KTest *);
+
+  /* maps an archive for reading; returns NULL on error */
+  KTestArchive* kTestArchive_open(const char *path);
+
+  unsigned kTestArchive_numTests(KTestArchive *);
+
+  /* the file name the test was added under */
+  const char* kTestArchive_getName(KTestArchive *, unsigned index);
+
+  /* the .ktest file contents of a test. For uncompressed entries this
+     points into the mapped archive; otherwise it stays valid until the
+     next call. Returns NULL on error. */
+  const unsigned char* kTestArchive_getData(KTestArchive *, unsigned index,
+                                            unsigned *size);
+
+  /* returns NULL on error; the result is freed with kTest_free */
+  KTest* kTestArchive_getTest(KTestArchive *, unsigned index);
+
+  /* writes the index if the archive was created and no write has failed,
+     and frees it; returns 1 on success, 0 on error */
+  int   kTestArchive_close(KTestArchive *);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,712 @@
+//===-- PersistentBTree.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PERSISTENTBTREE_H
+#define KLEE_PERSISTENTBTREE_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+
+namespace klee {
+
+  /// A persistent (immutable) B+-tree with the same interface as
+  /// ImmutableTree. Values live in wide leaf nodes of up to Order entries,
+  /// inner nodes hold up to Order children together with the minimum key of
+  /// each child. Updates copy the nodes along the path from the root to the
+  /// modified leaf and share everything else, so a copy of the tree is O(1)
+  /// and an update allocates O(log_Order n) nodes.
+  ///
+  /// Compared to a binary tree, lookups touch far fewer (and denser) nodes,
+  /// and in-order iteration walks arrays instead of chasing pointers.
+  ///
+  /// Inner nodes also count the values below each child, so the tree can
+  /// be accessed by position (select() and rank()) in O(log_Order n).
+  template<class K, class V, class KOV, class CMP, unsigned Order = 32>
+  class PersistentBTree {
+    static_assert(Order >= 4, "B-tree order too small");
+
+  public:
+    static size_t allocated;
+    class iterator;
+
+    typedef K key_type;
+    typedef V value_type;
+    typedef KOV key_of_value;
+    typedef CMP key_compare;
+
+  public:
+    PersistentBTree() : root(nullptr), elements(0) {}
+    PersistentBTree(const PersistentBTree &s)
+        : root(incref(s.root)), elements(s.elements) {}
+    PersistentBTree(PersistentBTree &&s) noexcept
+        : root(s.root), elements(s.elements) {
+      s.root = nullptr;
+      s.elements = 0;
+    }
+    ~PersistentBTree() { decref(root); }
+
+    PersistentBTree &operator=(const PersistentBTree &s) {
+      Node *n = incref(s.root);
+      decref(root);
+      root = n;
+      elements = s.elements;
+      return *this;
+    }
+    PersistentBTree &operator=(PersistentBTree &&s) noexcept {
+      std::swap(root, s.root);
+      std::swap(elements, s.elements);
+      return *this;
+    }
+
+    bool empty() const { return elements == 0; }
+
+    size_t count(const key_type &key) const { return lookup(key) ? 1 : 0; }
+    const value_type *lookup(const key_type &key) const;
+
+    // find the last value less than or equal to key, or null if
+    // no such value exists
+    const value_type *lookup_previous(const key_type &key) const;
+
+    const value_type &min() const;
+    const value_type &max() const;
+    size_t size() const { return elements; }
+
+    /// The value at position i (0-based) in key order; i < size().
+    const value_type &select(size_t i) const;
+    /// Number of values whose key is less than key.
+    size_t rank(const key_type &key) const;
+
+    PersistentBTree insert(const value_type &value) const {
+      return insertOrReplace(value, false);
+    }
+    PersistentBTree replace(const value_type &value) const {
+      return insertOrReplace(value, true);
+    }
+    PersistentBTree remove(const key_type &key) const;
+    PersistentBTree popMin(value_type &valueOut) const {
+      valueOut = min();
+      return remove(key_of_value()(valueOut));
+    }
+    PersistentBTree popMax(value_type &valueOut) const {
+      valueOut = max();
+      return remove(key_of_value()(valueOut));
+    }
+
+    iterator begin() const;
+    iterator end() const { return iterator(root); }
+    iterator find(const key_type &key) const;
+    iterator lower_bound(const key_type &key) const;
+    iterator upper_bound(const key_type &key) const;
+
+    static size_t getAllocated() { return allocated; }
+
+  private:
+    struct Node {
+      unsigned references;
+      unsigned count;
+      const bool leaf;
+
+      explicit Node(bool leaf) : references(1), count(0), leaf(leaf) {
+        ++allocated;
+      }
+      ~Node() { --allocated; }
+    };
+
+    struct Leaf : Node {
+      value_type values[Order];
+      Leaf() : Node(true) {}
+    };
+
+    struct Inner : Node {
+      /// keys[i] is the minimum key stored below children[i]
+      key_type keys[Order];
+      Node *children[Order];
+      /// sizes[i] is the number of values stored below children[i]
+      size_t sizes[Order];
+      Inner() : Node(false) {}
+    };
+
+    Node *root;
+    size_t elements;
+
+    PersistentBTree(Node *root, size_t elements)
+        : root(root), elements(elements) {}
+
+    static bool less(const key_type &a, const key_type &b) {
+      return key_compare()(a, b);
+    }
+    static const key_type &keyOf(const value_type &v) {
+      return key_of_value()(v);
+    }
+    static Leaf *asLeaf(Node *n) { return static_cast<Leaf *>(n); }
+    static Inner *asInner(Node *n) { return static_cast<Inner *>(n); }
+
+    static Node *incref(Node *n) {
+      if (n)
+        ++n->references;
+      return n;
+    }
+    static void decref(Node *n) {
+      if (n && !--n->references)
+        destroy(n);
+    }
+    /// Frees n, which is no longer referenced, and releases its children.
+    /// Everything needed from n is read before it is deleted.
+    static void destroy(Node *n) {
+      if (n->leaf) {
+        delete asLeaf(n);
+        return;
+      }
+      Inner *in = asInner(n);
+      Node *children[Order];
+      unsigned count = in->count;
+      std::copy(in->children, in->children + count, children);
+      delete in;
+      for (unsigned i = 0; i < count; ++i)
+        decref(children[i]);
+    }
+
+    /// Number of values stored below n.
+    static size_t subtreeSize(const Node *n) {
+      if (n->leaf)
+        return n->count;
+      const Inner *in = static_cast<const Inner *>(n);
+      size_t size = 0;
+      for (unsigned i = 0; i < in->count; ++i)
+        size += in->sizes[i];
+      return size;
+    }
+
+    /// Makes child the i-th child of in.
+    static void setChild(Inner *in, unsigned i, Node *child) {
+      in->keys[i] = firstKey(child);
+      in->children[i] = child;
+      in->sizes[i] = subtreeSize(child);
+    }
+
+    static const key_type &firstKey(Node *n) {
+      return n->leaf ? keyOf(asLeaf(n)->values[0]) : asInner(n)->keys[0];
+    }
+
+    /// Index of the child of in that may contain k: the last child whose
+    /// minimum key is not greater than k, or the first child.
+    static unsigned childIndex(const Inner *in, const key_type &k) {
+      unsigned i = std::upper_bound(in->keys, in->keys + in->count, k,
+                                    [](const key_type &a, const key_type &b) {
+                                      return less(a, b);
+                                    }) -
+                   in->keys;
+      return i ? i - 1 : 0;
+    }
+
+    /// Index of the first value in l whose key is not less than k.
+    static unsigned leafLowerBound(const Leaf *l, const key_type &k) {
+      return std::lower_bound(l->values, l->values + l->count, k,
+                              [](const value_type &v, const key_type &b) {
+                                return less(keyOf(v), b);
+                              }) -
+             l->values;
+    }
+
+    /// Shallow copies share (and reference) the children of n.
+    static Leaf *copyLeaf(const Leaf *l) {
+      Leaf *res = new Leaf();
+      std::copy(l->values, l->values + l->count, res->values);
+      res->count = l->count;
+      return res;
+    }
+    static Inner *copyInner(const Inner *in) {
+      Inner *res = new Inner();
+      for (unsigned i = 0; i < in->count; ++i) {
+        res->keys[i] = in->keys[i];
+        res->children[i] = incref(in->children[i]);
+        res->sizes[i] = in->sizes[i];
+      }
+      res->count = in->count;
+      return res;
+    }
+
+    /// Puts child at position i of in (which must have room), shifting the
+    /// children after it.
+    static void insertChild(Inner *in, unsigned i, Node *child) {
+      assert(in->count < Order);
+      for (unsigned j = in->count; j > i; --j) {
+        in->keys[j] = in->keys[j - 1];
+        in->children[j] = in->children[j - 1];
+        in->sizes[j] = in->sizes[j - 1];
+      }
+      setChild(in, i, child);
+      ++in->count;
+    }
+
+    static void eraseChild(Inner *in, unsigned i) {
+      for (unsigned j = i + 1; j < in->count; ++j) {
+        in->keys[j - 1] = in->keys[j];
+        in->children[j - 1] = in->children[j];
+        in->sizes[j - 1] = in->sizes[j];
+      }
+      --in->count;
+    }
+
+    static Node *insertRec(Node *n, const value_type &v, bool replace,
+                           Node *&split, bool &inserted);
+    static Node *removeRec(Node *n, const key_type &k);
+    static Node *merge(Node *a, Node *b);
+
+    PersistentBTree insertOrReplace(const value_type &value,
+                                    bool replace) const;
+  };
+
+  /***/
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  class PersistentBTree<K,V,KOV,CMP,Order>::iterator {
+    friend class PersistentBTree<K,V,KOV,CMP,Order>;
+
+    struct Level {
+      Node *node;
+      unsigned index;
+    };
+
+    // Growing the tree by another level takes at least (Order / 2)^depth
+    // insertions, so this depth is never reached in practice.
+    static constexpr unsigned MaxDepth = 16;
+
+    Node *root; // so can back up from end
+    unsigned depth; // 0 iff at end
+    Level path[MaxDepth];
+
+    explicit iterator(Node *_root) : root(incref(_root)), depth(0) {}
+
+    void descend(Node *n, bool leftmost) {
+      for (;;) {
+        assert(depth < MaxDepth);
+        unsigned index = leftmost ? 0 : n->count - 1;
+        path[depth++] = {n, index};
+        if (n->leaf)
+          return;
+        n = asInner(n)->children[index];
+      }
+    }
+
+  public:
+    iterator(const iterator &i) : root(incref(i.root)), depth(i.depth) {
+      std::copy(i.path, i.path + depth, path);
+    }
+    ~iterator() { decref(root); }
+
+    iterator &operator=(const iterator &b) {
+      incref(b.root);
+      decref(root);
+      root = b.root;
+      depth = b.depth;
+      std::copy(b.path, b.path + depth, path);
+      return *this;
+    }
+
+    const value_type &operator*() const {
+      assert(depth && "dereferencing end iterator");
+      const Level &l = path[depth - 1];
+      return asLeaf(l.node)->values[l.index];
+    }
+
+    const value_type *operator->() const { return &**this; }
+
+    bool operator==(const iterator &b) const {
+      if (depth != b.depth)
+        return false;
+      if (!depth)
+        return true;
+      const Level &l = path[depth - 1], &r = b.path[depth - 1];
+      return l.node == r.node && l.index == r.index;
+    }
+    bool operator!=(const iterator &b) const { return !(*this == b); }
+
+    iterator &operator++() {
+      assert(depth && "incrementing end iterator");
+      Level &l = path[depth - 1];
+      if (++l.index < l.node->count)
+        return *this;
+      for (--depth; depth; --depth) {
+        Level &up = path[depth - 1];
+        if (++up.index < up.node->count) {
+          descend(asInner(up.node)->children[up.index], true);
+          return *this;
+        }
+      }
+      return *this;
+    }
+
+    iterator &operator--() {
+      if (!depth) {
+        if (root)
+          descend(root, false);
+        return *this;
+      }
+      Level &l = path[depth - 1];
+      if (l.index > 0) {
+        --l.index;
+        return *this;
+      }
+      for (--depth; depth; --depth) {
+        Level &up = path[depth - 1];
+        if (up.index > 0) {
+          --up.index;
+          descend(asInner(up.node)->children[up.index], false);
+          return *this;
+        }
+      }
+      return *this;
+    }
+  };
+
+  /***/
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  size_t PersistentBTree<K,V,KOV,CMP,Order>::allocated = 0;
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  typename PersistentBTree<K,V,KOV,CMP,Order>::Node *
+  PersistentBTree<K,V,KOV,CMP,Order>::insertRec(Node *n, const value_type &v,
+                                                bool replace, Node *&split,
+                                                bool &inserted) {
+    const key_type &k = keyOf(v);
+    split = nullptr;
+
+    if (n->leaf) {
+      Leaf *l = asLeaf(n);
+      unsigned pos = leafLowerBound(l, k);
+      if (pos < l->count && !less(k, keyOf(l->values[pos]))) {
+        if (!replace)
+          return nullptr;
+        Leaf *res = copyLeaf(l);
+        res->values[pos] = v;
+        return res;
+      }
+
+      inserted = true;
+      if (l->count < Order) {
+        Leaf *res = new Leaf();
+        std::copy(l->values, l->values + pos, res->values);
+        res->values[pos] = v;
+        std::copy(l->values + pos, l->values + l->count, res->values + pos + 1);
+        res->count = l->count + 1;
+        return res;
+      }
+
+      // split a full leaf into two halves and insert into one of them
+      Leaf *left = new Leaf(), *right = new Leaf();
+      unsigned half = Order / 2;
+      std::copy(l->values, l->values + half, left->values);
+      left->count = half;
+      std::copy(l->values + half, l->values + Order, right->values);
+      right->count = Order - half;
+      Leaf *target = pos <= half ? left : right;
+      unsigned tpos = pos <= half ? pos : pos - half;
+      std::copy_backward(target->values + tpos, target->values + target->count,
+                         target->values + target->count + 1);
+      target->values[tpos] = v;
+      ++target->count;
+      split = right;
+      return left;
+    }
+
+    Inner *in = asInner(n);
+    unsigned i = childIndex(in, k);
+    Node *childSplit;
+    Node *child = insertRec(in->children[i], v, replace, childSplit, inserted);
+    if (!child)
+      return nullptr;
+
+    Inner *res = copyInner(in);
+    decref(res->children[i]);
+    setChild(res, i, child);
+    if (!childSplit)
+      return res;
+
+    if (res->count < Order) {
+      insertChild(res, i + 1, childSplit);
+      return res;
+    }
+
+    // split a full inner node
+    Inner *right = new Inner();
+    unsigned half = Order / 2;
+    for (unsigned j = half; j < Order; ++j) {
+      right->keys[j - half] = res->keys[j];
+      right->children[j - half] = res->children[j];
+      right->sizes[j - half] = res->sizes[j];
+    }
+    right->count = Order - half;
+    res->count = half;
+    if (i + 1 <= half)
+      insertChild(res, i + 1, childSplit);
+    else
+      insertChild(right, i + 1 - half, childSplit);
+    split = right;
+    return res;
+  }
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  typename PersistentBTree<K,V,KOV,CMP,Order>::Node *
+  PersistentBTree<K,V,KOV,CMP,Order>::merge(Node *a, Node *b) {
+    assert(a->leaf == b->leaf && a->count + b->count <= Order);
+    if (a->leaf) {
+      Leaf *res = copyLeaf(asLeaf(a));
+      std::copy(asLeaf(b)->values, asLeaf(b)->values + b->count,
+                res->values + res->count);
+      res->count += b->count;
+      return res;
+    }
+    Inner *res = copyInner(asInner(a));
+    for (unsigned j = 0; j < b->count; ++j) {
+      res->keys[res->count] = asInner(b)->keys[j];
+      res->sizes[res->count] = asInner(b)->sizes[j];
+      res->children[res->count++] = incref(asInner(b)->children[j]);
+    }
+    return res;
+  }
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  typename PersistentBTree<K,V,KOV,CMP,Order>::Node *
+  PersistentBTree<K,V,KOV,CMP,Order>::removeRec(Node *n, const key_type &k) {
+    if (n->leaf) {
+      Leaf *l = asLeaf(n);
+      unsigned pos = leafLowerBound(l, k);
+      if (pos == l->count || less(k, keyOf(l->values[pos])))
+        return nullptr;
+      Leaf *res = new Leaf();
+      std::copy(l->values, l->values + pos, res->values);
+      std::copy(l->values + pos + 1, l->values + l->count, res->values + pos);
+      res->count = l->count - 1;
+      return res;
+    }
+
+    Inner *in = asInner(n);
+    unsigned i = childIndex(in, k);
+    Node *child = removeRec(in->children[i], k);
+    if (!child)
+      return nullptr;
+
+    Inner *res = copyInner(in);
+    decref(res->children[i]);
+    if (!child->count) {
+      decref(child);
+      eraseChild(res, i);
+      return res;
+    }
+    setChild(res, i, child);
+
+    // Merge sparse nodes with a neighbour. Full rebalancing is not needed:
+    // removals never make the tree deeper.
+    if (child->count < Order / 4 && res->count > 1) {
+      unsigned j = i + 1 < res->count ? i + 1 : i - 1;
+      unsigned lo = std::min(i, j);
+      Node *a = res->children[lo], *b = res->children[lo + 1];
+      if (a->count + b->count <= Order) {
+        Node *merged = merge(a, b);
+        decref(a);
+        decref(b);
+        setChild(res, lo, merged);
+        eraseChild(res, lo + 1);
+      }
+    }
+    return res;
+  }
+
+  /***/
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  const typename PersistentBTree<K,V,KOV,CMP,Order>::value_type *
+  PersistentBTree<K,V,KOV,CMP,Order>::lookup(const key_type &k) const {
+    Node *n = root;
+    if (!n)
+      return nullptr;
+    while (!n->leaf)
+      n = asInner(n)->children[childIndex(asInner(n), k)];
+    Leaf *l = asLeaf(n);
+    unsigned pos = leafLowerBound(l, k);
+    if (pos < l->count && !less(k, keyOf(l->values[pos])))
+      return &l->values[pos];
+    return nullptr;
+  }
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  const typename PersistentBTree<K,V,KOV,CMP,Order>::value_type *
+  PersistentBTree<K,V,KOV,CMP,Order>::lookup_previous(const key_type &k) const {
+    Node *n = root;
+    if (!n)
+      return nullptr;
+    while (!n->leaf)
+      n = asInner(n)->children[childIndex(asInner(n), k)];
+    // Unless k is below the minimum of the whole tree, the leaf's minimum
+    // is not greater than k, so the answer is in this leaf.
+    Leaf *l = asLeaf(n);
+    unsigned pos = std::upper_bound(l->values, l->values + l->count, k,
+                                    [](const key_type &a, const value_type &v) {
+                                      return less(a, keyOf(v));
+                                    }) -
+                   l->values;
+    return pos ? &l->values[pos - 1] : nullptr;
+  }
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  const typename PersistentBTree<K,V,KOV,CMP,Order>::value_type &
+  PersistentBTree<K,V,KOV,CMP,Order>::min() const {
+    Node *n = root;
+    assert(n);
+    while (!n->leaf)
+      n = asInner(n)->children[0];
+    return asLeaf(n)->values[0];
+  }
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  const typename PersistentBTree<K,V,KOV,CMP,Order>::value_type &
+  PersistentBTree<K,V,KOV,CMP,Order>::max() const {
+    Node *n = root;
+    assert(n);
+    while (!n->leaf)
+      n = asInner(n)->children[n->count - 1];
+    return asLeaf(n)->values[n->count - 1];
+  }
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  const typename PersistentBTree<K,V,KOV,CMP,Order>::value_type &
+  PersistentBTree<K,V,KOV,CMP,Order>::select(size_t i) const {
+    assert(i < elements && "position out of range");
+    Node *n = root;
+    while (!n->leaf) {
+      Inner *in = asInner(n);
+      unsigned c = 0;
+      while (i >= in->sizes[c])
+        i -= in->sizes[c++];
+      n = in->children[c];
+    }
+    return asLeaf(n)->values[i];
+  }
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  size_t PersistentBTree<K,V,KOV,CMP,Order>::rank(const key_type &k) const {
+    Node *n = root;
+    if (!n)
+      return 0;
+    size_t res = 0;
+    while (!n->leaf) {
+      Inner *in = asInner(n);
+      unsigned c = childIndex(in, k);
+      for (unsigned j = 0; j < c; ++j)
+        res += in->sizes[j];
+      n = in->children[c];
+    }
+    return res + leafLowerBound(asLeaf(n), k);
+  }
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  PersistentBTree<K,V,KOV,CMP,Order>
+  PersistentBTree<K,V,KOV,CMP,Order>::insertOrReplace(const value_type &value,
+                                                      bool replace) const {
+    if (!root) {
+      Leaf *l = new Leaf();
+      l->values[0] = value;
+      l->count = 1;
+      return PersistentBTree(l, 1);
+    }
+
+    Node *split;
+    bool inserted = false;
+    Node *n = insertRec(root, value, replace, split, inserted);
+    if (!n)
+      return *this;
+    if (split) {
+      Inner *in = new Inner();
+      insertChild(in, 0, n);
+      insertChild(in, 1, split);
+      n = in;
+    }
+    return PersistentBTree(n, elements + (inserted ? 1 : 0));
+  }
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  PersistentBTree<K,V,KOV,CMP,Order>
+  PersistentBTree<K,V,KOV,CMP,Order>::remove(const key_type &key) const {
+    if (!root)
+      return *this;
+    Node *n = removeRec(root, key);
+    if (!n)
+      return *this;
+    // shrink the tree while the root has a single child
+    while (n->count == 1 && !n->leaf) {
+      Node *child = incref(asInner(n)->children[0]);
+      decref(n);
+      n = child;
+    }
+    if (!n->count) {
+      decref(n);
+      n = nullptr;
+    }
+    return PersistentBTree(n, elements - 1);
+  }
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  typename PersistentBTree<K,V,KOV,CMP,Order>::iterator
+  PersistentBTree<K,V,KOV,CMP,Order>::begin() const {
+    iterator it(root);
+    if (root)
+      it.descend(root, true);
+    return it;
+  }
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  typename PersistentBTree<K,V,KOV,CMP,Order>::iterator
+  PersistentBTree<K,V,KOV,CMP,Order>::find(const key_type &key) const {
+    iterator it = lower_bound(key);
+    if (it == end() || less(key, keyOf(*it)))
+      return end();
+    return it;
+  }
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  typename PersistentBTree<K,V,KOV,CMP,Order>::iterator
+  PersistentBTree<K,V,KOV,CMP,Order>::lower_bound(const key_type &k) const {
+    iterator it(root);
+    if (!root)
+      return it;
+    Node *n = root;
+    while (!n->leaf) {
+      unsigned i = childIndex(asInner(n), k);
+      assert(it.depth < iterator::MaxDepth);
+      it.path[it.depth++] = {n, i};
+      n = asInner(n)->children[i];
+    }
+    unsigned pos = leafLowerBound(asLeaf(n), k);
+    if (pos < n->count) {
+      it.path[it.depth++] = {n, pos};
+    } else {
+      // all values in this leaf are below k, move on to the next one
+      it.path[it.depth++] = {n, n->count - 1};
+      ++it;
+    }
+    return it;
+  }
+
+  template<class K, class V, class KOV, class CMP, unsigned Order>
+  typename PersistentBTree<K,V,KOV,CMP,Order>::iterator
+  PersistentBTree<K,V,KOV,CMP,Order>::upper_bound(const key_type &key) const {
+    iterator it = lower_bound(key);
+    if (it != end() &&
+        !less(key, keyOf(*it))) // no need to loop, no duplicates
+      ++it;
+    return it;
+  }
+
+}
+
+#endif /* KLEE_PERSISTENTBTREE_H */
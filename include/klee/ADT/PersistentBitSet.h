@@ -0,0 +1,98 @@
+//===-- PersistentBitSet.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PERSISTENTBITSET_H
+#define KLEE_PERSISTENTBITSET_H
+
+#include "klee/ADT/Ref.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+/// A set of unsigned integers stored as a bitset split into fixed-size
+/// chunks. Only populated chunks are stored, and chunks are reference
+/// counted and shared between copies of the set: copying costs one
+/// reference per populated chunk, and an insertion into a shared chunk
+/// clones just that chunk.
+class PersistentBitSet {
+  static constexpr unsigned WordBits = 64;
+  static constexpr unsigned ChunkWords = 8;
+  static constexpr unsigned ChunkBits = WordBits * ChunkWords;
+
+  struct Chunk {
+    /// @brief Required by klee::ref-managed objects
+    class ReferenceCounter _refCount;
+    std::uint64_t words[ChunkWords] = {};
+  };
+
+  typedef std::pair<unsigned, ref<Chunk>> Entry;
+  /// Populated chunks, sorted by chunk index.
+  std::vector<Entry> chunks;
+  std::size_t count = 0;
+
+  std::vector<Entry>::const_iterator findChunk(unsigned index) const {
+    return std::lower_bound(
+        chunks.begin(), chunks.end(), index,
+        [](const Entry &e, unsigned i) { return e.first < i; });
+  }
+
+public:
+  bool empty() const { return count == 0; }
+  /// Number of elements in the set.
+  std::size_t size() const { return count; }
+
+  bool contains(unsigned i) const {
+    auto it = findChunk(i / ChunkBits);
+    if (it == chunks.end() || it->first != i / ChunkBits)
+      return false;
+    unsigned bit = i % ChunkBits;
+    return (it->second->words[bit / WordBits] >> (bit % WordBits)) & 1;
+  }
+
+  /// Adds i to the set. Returns true if it was not already present.
+  bool insert(unsigned i) {
+    unsigned index = i / ChunkBits, bit = i % ChunkBits;
+    std::uint64_t mask = std::uint64_t(1) << (bit % WordBits);
+    auto it = chunks.begin() + (findChunk(index) - chunks.cbegin());
+    if (it == chunks.end() || it->first != index) {
+      it = chunks.emplace(it, index, new Chunk());
+    } else if (it->second->words[bit / WordBits] & mask) {
+      return false;
+    } else if (it->second->_refCount.getCount() > 1) {
+      it->second = new Chunk(*it->second);
+    }
+    it->second->words[bit / WordBits] |= mask;
+    ++count;
+    return true;
+  }
+
+  void clear() {
+    chunks.clear();
+    count = 0;
+  }
+
+  /// Calls f(i) for each element i of the set, in ascending order.
+  template <class F> void forEach(F f) const {
+    for (const Entry &e : chunks) {
+      for (unsigned w = 0; w < ChunkWords; ++w) {
+        for (std::uint64_t bits = e.second->words[w]; bits; bits &= bits - 1)
+          f(e.first * ChunkBits + w * WordBits + __builtin_ctzll(bits));
+      }
+    }
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_PERSISTENTBITSET_H */
@@ -0,0 +1,114 @@
+//===-- PersistentMap.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PERSISTENTMAP_H
+#define KLEE_PERSISTENTMAP_H
+
+#include <functional>
+#include <utility>
+
+#include "PersistentBTree.h"
+
+namespace klee {
+  /// An immutable map with the interface of ImmutableMap, backed by a
+  /// PersistentBTree instead of a binary ImmutableTree.
+  template<class K, class D, class CMP=std::less<K> >
+  class PersistentMap {
+  public:
+    typedef K key_type;
+    typedef std::pair<K,D> value_type;
+
+  private:
+    struct KeyOfValue {
+      const key_type &operator()(const value_type &a) const { return a.first; }
+    };
+
+  public:
+    typedef PersistentBTree<K, value_type, KeyOfValue, CMP> Tree;
+    typedef typename Tree::iterator iterator;
+
+  private:
+    Tree elts;
+
+    PersistentMap(const Tree &b): elts(b) {}
+    PersistentMap(Tree &&b): elts(std::move(b)) {}
+
+  public:
+    PersistentMap() {}
+    PersistentMap(const PersistentMap &b) : elts(b.elts) {}
+    ~PersistentMap() {}
+
+    PersistentMap &operator=(const PersistentMap &b) { elts = b.elts; return *this; }
+
+    bool empty() const {
+      return elts.empty();
+    }
+    size_t count(const key_type &key) const {
+      return elts.count(key);
+    }
+    const value_type *lookup(const key_type &key) const {
+      return elts.lookup(key);
+    }
+    const value_type *lookup_previous(const key_type &key) const {
+      return elts.lookup_previous(key);
+    }
+    const value_type &min() const {
+      return elts.min();
+    }
+    const value_type &max() const {
+      return elts.max();
+    }
+    size_t size() const {
+      return elts.size();
+    }
+    const value_type &select(size_t i) const {
+      return elts.select(i);
+    }
+    size_t rank(const key_type &key) const {
+      return elts.rank(key);
+    }
+
+    PersistentMap insert(const value_type &value) const {
+      return elts.insert(value);
+    }
+    PersistentMap replace(const value_type &value) const {
+      return elts.replace(value);
+    }
+    PersistentMap remove(const key_type &key) const {
+      return elts.remove(key);
+    }
+    PersistentMap popMin(value_type &valueOut) const {
+      return elts.popMin(valueOut);
+    }
+    PersistentMap popMax(value_type &valueOut) const {
+      return elts.popMax(valueOut);
+    }
+
+    iterator begin() const {
+      return elts.begin();
+    }
+    iterator end() const {
+      return elts.end();
+    }
+    iterator find(const key_type &key) const {
+      return elts.find(key);
+    }
+    iterator lower_bound(const key_type &key) const {
+      return elts.lower_bound(key);
+    }
+    iterator upper_bound(const key_type &key) const {
+      return elts.upper_bound(key);
+    }
+
+    static size_t getAllocated() { return Tree::allocated; }
+  };
+
+}
+
+#endif /* KLEE_PERSISTENTMAP_H */
@@ -10,6 +10,9 @@
 #ifndef KLEE_TREESTREAM_H
 #define KLEE_TREESTREAM_H
 
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
 #include <string>
 #include <vector>
 
@@ -18,6 +21,88 @@ namespace klee {
   typedef unsigned TreeStreamID;
   class TreeOStream;
 
+  /// Where the contents of each stream in a tree stream file live.
+  ///
+  /// A stream continues its parent's contents as they were when it was
+  /// opened, followed by its own records. Keeping the parent, the fork
+  /// point and the record locations of every stream in memory lets a
+  /// stream be extracted in time proportional to its length, without
+  /// scanning the file.
+  class TreeStreamIndex {
+  public:
+    /// A record: `count` items stored at `offset`, either as bytes or as
+    /// packed bits.
+    struct Chunk {
+      std::uint64_t offset;
+      unsigned start; ///< position of the first item in its stream
+      unsigned count;
+      bool bits;
+    };
+
+  private:
+    struct Stream {
+      TreeStreamID parent = 0;
+      /// Number of items the parent had written itself when this stream
+      /// was opened
+      unsigned forkPoint = 0;
+      /// Number of items written to this stream itself
+      unsigned length = 0;
+      std::vector<Chunk> chunks;
+    };
+
+    /// Indexed by stream ID; stream 0 is the (empty) root.
+    std::vector<Stream> streams;
+
+  public:
+    TreeStreamIndex() : streams(1) {}
+
+    /// Number of IDs in use, including the root.
+    std::size_t size() const { return streams.size(); }
+
+    void addStream(TreeStreamID id, TreeStreamID parent);
+    void addChunk(TreeStreamID id, std::uint64_t offset, unsigned count,
+                  bool bits);
+
+    /// Appends the contents of stream `id` to `out`, reading records
+    /// from `data`, the first `size` bytes of the file. Branch bits are
+    /// read back as '0' and '1'.
+    bool read(TreeStreamID id, const unsigned char *data, std::size_t size,
+              std::vector<unsigned char> &out) const;
+  };
+
+  /// A read-only memory mapping of a (possibly growing) file.
+  class MappedFile {
+    std::string path;
+    int fd = -1;
+    void *base = nullptr;
+    /// Length of the mapping, which may extend past the end of the file
+    std::size_t mapped = 0;
+    /// Size of the file when it was last checked
+    std::size_t available = 0;
+
+  public:
+    explicit MappedFile(const std::string &_path) : path(_path) {}
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /// Makes at least the first `size` bytes accessible (the whole file if
+    /// `size` is 0). The mapping is made larger than the file, so that a
+    /// growing file only has to be remapped when its size has doubled.
+    const unsigned char *map(std::size_t size);
+    /// Number of bytes that can be read from the mapping.
+    std::size_t size() const { return available; }
+  };
+
+  /// Writes a tree of streams to a file.
+  ///
+  /// The file starts with the 8-byte magic "KLEETS2\0", followed by
+  /// records that each begin with a one byte kind:
+  ///   fork:   parent (u32), child (u32)
+  ///   bytes:  stream (u32), count (u32), `count` bytes
+  ///   bits:   stream (u32), count (u32), `count` bits packed LSB first
+  /// Integers are stored in host byte order.
   class TreeStreamWriter {
     static const unsigned bufferSize = 4*4096;
 
@@ -25,13 +110,22 @@ namespace klee {
 
   private:
     char buffer[bufferSize];
+    /// Stream of the buffered record and the number of items in it
     unsigned lastID, bufferCount;
+    bool bufferBits;
 
     std::string path;
     std::ofstream *output;
+    std::uint64_t fileSize;
     unsigned ids;
 
+    TreeStreamIndex index;
+    MappedFile mapping;
+
     void write(TreeOStream &os, const char *s, unsigned size);
+    void writeBranch(TreeOStream &os, bool taken);
+    void writeRecord(unsigned char kind, unsigned id, unsigned count,
+                     const char *payload, std::size_t payloadSize);
     void flushBuffer();
 
   public:
@@ -50,13 +144,40 @@ namespace klee {
                     std::vector<unsigned char> &out);
   };
 
+  /// Reads the streams of a file written by TreeStreamWriter.
+  class TreeStreamReader {
+    TreeStreamIndex index;
+    MappedFile mapping;
+    const unsigned char *data;
+    std::size_t size;
+    bool valid;
+
+  public:
+    explicit TreeStreamReader(const std::string &path);
+
+    bool good() const { return valid; }
+    /// Number of stream IDs in the file, including the root 0.
+    std::size_t getNumStreams() const { return index.size(); }
+
+    bool readStream(TreeStreamID id, std::vector<unsigned char> &out) const;
+  };
+
+  /// Rewrites a tree stream file in the format used before
+  /// TreeStreamWriter kept an index (a flat sequence of records, without
+  /// a header) into the current format, preserving stream IDs. Bytes '0'
+  /// and '1' become branch bits. Returns false and sets `error` on
+  /// failure.
+  bool convertLegacyTreeStream(const std::string &oldPath,
+                               const std::string &newPath,
+                               std::string &error);
+
   class TreeOStream {
     friend class TreeStreamWriter;
 
   private:
     TreeStreamWriter *writer;
     unsigned id;
-    
+
     TreeOStream(TreeStreamWriter &_writer, unsigned _id);
 
   public:
@@ -66,6 +187,9 @@ namespace klee {
     unsigned getID() const;
 
     void write(const char *buffer, unsigned size);
+    /// Appends a branch outcome. It is stored as a single bit and read
+    /// back as '1' or '0'.
+    void writeBranch(bool taken);
 
     TreeOStream &operator<<(const std::string &s);
 
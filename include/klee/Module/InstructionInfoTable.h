@@ -10,7 +10,13 @@
 #ifndef KLEE_INSTRUCTIONINFOTABLE_H
 #define KLEE_INSTRUCTIONINFOTABLE_H
 
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -19,10 +25,37 @@ namespace llvm {
   class Function;
   class Instruction;
   class Module; 
+  class Value;
 }
 
 namespace klee {
 
+  /// @brief AssemblyLineTable maps functions and instructions to their line
+  /// in the generated assembly.ll. The module is printed to build the map
+  /// the first time a line is asked for, which only happens for statistics
+  /// and error reports. Lines may be asked for from several threads (the
+  /// statistics writer and the interpreter).
+  class AssemblyLineTable {
+    const llvm::Module &module;
+    mutable std::once_flag built;
+    mutable std::map<std::uintptr_t, std::uint64_t> lines;
+
+  public:
+    explicit AssemblyLineTable(const llvm::Module &m) : module(m) {}
+
+    std::uint64_t getLine(const llvm::Value &v) const;
+  };
+
+  /// @brief A location in the source, as given by the debug information.
+  struct SourceLocation {
+    /// @brief Source file name, empty if unknown.
+    llvm::StringRef file;
+    /// @brief Line number in source file, 0 if unknown.
+    unsigned line;
+    /// @brief Column number in source file, 0 if unknown.
+    unsigned column;
+  };
+
   /// @brief InstructionInfo stores debug information for a KInstruction.
   struct InstructionInfo {
     /// @brief The instruction id.
@@ -31,15 +64,22 @@ namespace klee {
     unsigned line;
     /// @brief Column number in source file.
     unsigned column;
-    /// @brief Line number in generated assembly.ll.
-    unsigned assemblyLine;
     /// @brief Source file name.
     const std::string &file;
 
+  private:
+    const llvm::Instruction &inst;
+    const AssemblyLineTable &assemblyLines;
+
   public:
     InstructionInfo(unsigned id, const std::string &file, unsigned line,
-                    unsigned column, unsigned assemblyLine)
-        : id{id}, line{line}, column{column}, assemblyLine{assemblyLine}, file{file} {}
+                    unsigned column, const llvm::Instruction &inst,
+                    const AssemblyLineTable &assemblyLines)
+        : id{id}, line{line}, column{column}, file{file}, inst{inst},
+          assemblyLines{assemblyLines} {}
+
+    /// @brief Line number in generated assembly.ll.
+    unsigned getAssemblyLine() const;
   };
 
   /// @brief FunctionInfo stores debug information for a KFunction.
@@ -48,35 +88,80 @@ namespace klee {
     unsigned id;
     /// @brief Line number in source file.
     unsigned line;
-    /// @brief Line number in generated assembly.ll.
-    uint64_t assemblyLine;
     /// @brief Source file name.
     const std::string &file;
 
+  private:
+    const llvm::Function &function;
+    const AssemblyLineTable &assemblyLines;
+
   public:
-    FunctionInfo(unsigned id, const std::string &file, unsigned line, uint64_t assemblyLine)
-        : id{id}, line{line}, assemblyLine{assemblyLine}, file{file} {}
+    FunctionInfo(unsigned id, const std::string &file, unsigned line,
+                 const llvm::Function &function,
+                 const AssemblyLineTable &assemblyLines)
+        : id{id}, line{line}, file{file}, function{function},
+          assemblyLines{assemblyLines} {}
 
     FunctionInfo(const FunctionInfo &) = delete;
     FunctionInfo &operator=(FunctionInfo const &) = delete;
 
     FunctionInfo(FunctionInfo &&) = default;
+
+    /// @brief Line number in generated assembly.ll.
+    uint64_t getAssemblyLine() const;
   };
 
+  /// Debug information for the instructions and functions of a module.
+  ///
+  /// The table is populated one function at a time, the first time one of
+  /// its instructions (or the function itself) is looked up, so that
+  /// functions which are never executed cost nothing. getMaxID() populates
+  /// the whole module.
   class InstructionInfoTable {
-    std::unordered_map<const llvm::Instruction *,
-                       std::unique_ptr<InstructionInfo>>
+  public:
+    /// Called right after a function has been populated; the ids of its
+    /// instructions are the ones right before the id of its FunctionInfo.
+    using PopulateListener =
+        std::function<void(const llvm::Function &, const FunctionInfo &)>;
+
+  private:
+    const llvm::Module &module;
+    mutable std::unordered_map<const llvm::Instruction *,
+                               std::unique_ptr<InstructionInfo>>
         infos;
-    std::unordered_map<const llvm::Function *, std::unique_ptr<FunctionInfo>>
+    mutable std::unordered_map<const llvm::Function *,
+                               std::unique_ptr<FunctionInfo>>
         functionInfos;
-    std::vector<std::unique_ptr<std::string>> internedStrings;
+    mutable std::vector<std::unique_ptr<std::string>> internedStrings;
+    /// Instruction infos indexed by their id.
+    mutable std::vector<const InstructionInfo *> infosByID;
+    AssemblyLineTable assemblyLines;
+    PopulateListener populateListener;
+
+    const FunctionInfo &populate(const llvm::Function &f) const;
 
   public:
     explicit InstructionInfoTable(const llvm::Module &m);
 
     unsigned getMaxID() const;
+    /// Returns getMaxID() of the functions populated so far, without
+    /// populating any other.
+    unsigned getPopulatedMaxID() const;
     const InstructionInfo &getInfo(const llvm::Instruction &) const;
+    const InstructionInfo &getInfo(unsigned id) const;
     const FunctionInfo &getFunctionInfo(const llvm::Function &) const;
+    /// Returns the info of a function if it has been populated, or null.
+    const FunctionInfo *findFunctionInfo(const llvm::Function &) const;
+    const AssemblyLineTable &getAssemblyLines() const { return assemblyLines; }
+
+    /// Sets the listener called for every function populated from now on,
+    /// and calls it for the functions populated so far.
+    void setPopulateListener(PopulateListener listener);
+
+    /// Source location of a function or instruction, looked up without
+    /// populating the table, so that it can be used from any thread.
+    static SourceLocation getSourceLocation(const llvm::Function &);
+    static SourceLocation getSourceLocation(const llvm::Instruction &);
   };
 
 }
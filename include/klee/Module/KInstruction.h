@@ -42,6 +42,18 @@ namespace klee {
     /// Destination register index.
     unsigned dest;
 
+    /// The following fields are decoded from inst once, when the
+    /// KFunction is built, so the interpreter does not have to walk the
+    /// LLVM IR again on every execution.
+
+    /// Opcode of inst (llvm::Instruction::getOpcode()).
+    unsigned opcode;
+    /// Width in bits of the result type of inst, resolved against the
+    /// module's data layout, or 0 if the result type is not sized.
+    unsigned width;
+    /// Predicate of a compare instruction (llvm::CmpInst::Predicate), or 0.
+    unsigned predicate;
+
   public:
     virtual ~KInstruction();
     std::string getSourceLocation() const;
@@ -59,6 +71,16 @@ namespace klee {
     /// instruction.
     uint64_t offset;
   };
+
+  struct KBranchInstruction : KInstruction {
+    /// successors - The successors of a Br or Switch instruction, in the
+    /// order of llvm::Instruction::getSuccessor(). The first element is the
+    /// index of the first instruction of the successor in
+    /// KFunction::instructions, and the second element is the index of the
+    /// incoming block of its PHI nodes that corresponds to this instruction
+    /// (or 0 if it has none).
+    std::vector< std::pair<unsigned, unsigned> > successors;
+  };
 }
 
 #endif /* KLEE_KINSTRUCTION_H */
@@ -12,6 +12,7 @@
 
 #include "klee/Config/Version.h"
 #include "klee/Core/Interpreter.h"
+#include "klee/Module/Cell.h"
 #include "klee/Module/KCallable.h"
 
 #include "llvm/ADT/ArrayRef.h"
@@ -31,7 +32,6 @@ namespace llvm {
 }
 
 namespace klee {
-  struct Cell;
   class Executor;
   class Expr;
   class InterpreterHandler;
@@ -54,6 +54,18 @@ namespace klee {
     /// "coverable" for statistics and search heuristics.
     bool trackCoverage;
 
+    /// For each conditional branch and switch whose immediate post-dominator
+    /// lies in the same loop, the first non-PHI instruction of that
+    /// post-dominator: the point where states forked by the branch can be
+    /// merged again. Only filled in by computeMergePoints().
+    std::map<const KInstruction *, KInstruction *> mergePoints;
+
+    /// For each register, an estimate of the number of branch conditions and
+    /// memory addresses in this function computed from its value, i.e. of
+    /// the solver queries a symbolic value in the register leads to. Only
+    /// filled in by computeMergePoints().
+    std::vector<unsigned> registerQueryUses;
+
     explicit KFunction(llvm::Function*, KModule*);
     KFunction(const KFunction &) = delete;
     KFunction &operator=(const KFunction &) = delete;
@@ -62,6 +74,10 @@ namespace klee {
 
     unsigned getArgRegister(unsigned index) { return index; }
 
+    /// Compute mergePoints and registerQueryUses from the post-dominator
+    /// tree and loop structure of the function.
+    void computeMergePoints();
+
     llvm::StringRef getName() const override { return function->getName(); }
 
     llvm::FunctionType *getFunctionType() const override {
@@ -97,7 +113,8 @@ namespace klee {
     std::unique_ptr<llvm::Module> module;
     std::unique_ptr<llvm::DataLayout> targetData;
 
-    // Our shadow versions of LLVM structures.
+    // Our shadow versions of LLVM structures, for the functions that have
+    // been reached so far (see getKFunction()).
     std::vector<std::unique_ptr<KFunction>> functions;
     std::map<llvm::Function*, KFunction*> functionMap;
 
@@ -111,12 +128,18 @@ namespace klee {
     std::map<const llvm::Constant *, std::unique_ptr<KConstant>> constantMap;
     KConstant* getKConstant(const llvm::Constant *c);
 
-    std::unique_ptr<Cell[]> constantTable;
+    /// Values of the constants, in the order of their ids. Grows as
+    /// KFunctions are built.
+    std::vector<Cell> constantTable;
 
     // Functions which are part of KLEE runtime
     std::set<const llvm::Function*> internalFunctions;
 
   private:
+    // Where the prepared module is stored by storeInCache(); empty unless
+    // loadFromCache() missed.
+    std::string cachePath;
+
     // Mark function with functionName as part of the KLEE runtime
     void addInternalFunction(const char* functionName);
 
@@ -153,9 +176,25 @@ namespace klee {
 
     void instrument(const Interpreter::ModuleOptions &opts);
 
+    /// Look up the prepared form of the given modules in the module cache
+    /// (--module-cache-dir). On a hit the cached module is installed, which
+    /// replaces linking, instrumentation and optimisation.
+    ///
+    /// @return true if the module was loaded from the cache
+    bool loadFromCache(std::vector<std::unique_ptr<llvm::Module>> &modules,
+                       const Interpreter::ModuleOptions &opts);
+
+    /// Store the prepared module in the module cache if loadFromCache()
+    /// missed.
+    void storeInCache();
+
     /// Return an id for the given constant, creating a new one if necessary.
     unsigned getConstantID(llvm::Constant *c, KInstruction* ki);
 
+    /// Return the KFunction for the given function, building it (and the
+    /// instruction infos of the function) on first use.
+    KFunction *getKFunction(llvm::Function *f);
+
     /// Run passes that check if module is valid LLVM IR and if invariants
     /// expected by KLEE's Executor hold.
     void checkModule();
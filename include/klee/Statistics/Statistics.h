@@ -43,6 +43,8 @@ namespace klee {
     std::vector<Statistic*> stats;
     uint64_t *globalStats;
     uint64_t *indexedStats;
+    /// Number of indices indexedStats has room for.
+    unsigned indexedCapacity;
     StatisticRecord *contextStats;
     unsigned index;
 
@@ -51,6 +53,9 @@ namespace klee {
     ~StatisticManager();
 
     void useIndexedStats(unsigned totalIndices);
+    /// Makes room for at least totalIndices indices, if indexed statistics
+    /// are used. The statistics of new indices are zero.
+    void growIndexedStats(unsigned totalIndices);
 
     StatisticRecord *getContext();
     void setContext(StatisticRecord *sr); /* null to reset */
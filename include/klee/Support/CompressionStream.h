@@ -13,6 +13,8 @@
 #include "llvm/Support/raw_ostream.h"
 #include "zlib.h"
 
+#include <string>
+
 namespace klee {
 const size_t BUFSIZE = 128 * 1024;
 
@@ -41,6 +43,25 @@ public:
 
   ~compressed_fd_ostream();
 };
+
+/// compressed_fd_istream - Reads a gzip-compressed file (as written by
+/// compressed_fd_ostream) line by line. Uncompressed files are read as is.
+class compressed_fd_istream {
+  gzFile file;
+  char buffer[BUFSIZE];
+
+public:
+  /// Open the specified file for reading. If an error occurs, information
+  /// about the error is put into ErrorInfo.
+  compressed_fd_istream(const std::string &Filename, std::string &ErrorInfo);
+  ~compressed_fd_istream();
+  compressed_fd_istream(const compressed_fd_istream &) = delete;
+  compressed_fd_istream &operator=(const compressed_fd_istream &) = delete;
+
+  /// Reads the next line, without its trailing newline, into Line. Returns
+  /// false at the end of the file.
+  bool getline(std::string &Line);
+};
 }
 
 #endif /* KLEE_COMPRESSIONSTREAM_H */
@@ -0,0 +1,61 @@
+//===-- MetricsServer.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_METRICSSERVER_H
+#define KLEE_METRICSSERVER_H
+
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace klee {
+
+  /**
+   * A MetricsServer serves the most recently published text (usually
+   * metrics in the Prometheus text format) on a Unix domain socket.
+   *
+   * Connections are handled on a dedicated thread, which only ever reads
+   * the published snapshot: publishing swaps in a new immutable string and
+   * never waits for clients. A client that sends an HTTP request (e.g.
+   * `curl --unix-socket PATH http://localhost/metrics`) gets an HTTP
+   * response, any other client just the text.
+   */
+  class MetricsServer {
+    std::string path;
+    int listenFd = -1;
+    /// Whether the socket file at `path` was created by this server
+    bool bound = false;
+    /// Written to by the destructor to wake up and stop the server thread
+    int wakeFds[2] = {-1, -1};
+    std::shared_ptr<const std::string> snapshot;
+    std::thread thread;
+
+    void loop();
+    void serve(int fd);
+
+    MetricsServer() = default;
+
+  public:
+    /// Listens on a socket at `path`, replacing a stale socket file. Returns
+    /// null and sets `error` on failure.
+    static std::unique_ptr<MetricsServer> create(const std::string &path,
+                                                 std::string &error);
+    /// Stops the server and removes the socket file.
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer &) = delete;
+    MetricsServer &operator=(const MetricsServer &) = delete;
+
+    /// Makes `text` the response for all following connections.
+    void publish(std::string text);
+  };
+
+} // namespace klee
+
+#endif /* KLEE_METRICSSERVER_H */
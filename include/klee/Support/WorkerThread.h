@@ -0,0 +1,69 @@
+//===-- WorkerThread.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_WORKERTHREAD_H
+#define KLEE_WORKERTHREAD_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace klee {
+
+  /**
+   * A WorkerThread runs jobs on a dedicated thread, one at a time and in
+   * submission order. It is used to move output (statistics, test cases,
+   * ...) off the interpreter loop: submitting a job never waits for
+   * previously submitted jobs to finish.
+   *
+   * Jobs must not touch state that the submitting thread keeps modifying;
+   * they typically own a snapshot of the data they write out.
+   */
+  class WorkerThread {
+  public:
+    using Job = std::function<void()>;
+
+  private:
+    mutable std::mutex mutex;
+    /// Signalled when a job is submitted or the thread is asked to stop.
+    std::condition_variable jobAvailable;
+    /// Signalled whenever a job finishes.
+    std::condition_variable jobDone;
+    std::deque<Job> jobs;
+    bool running = false;
+    bool stopping = false;
+    std::thread thread;
+
+    void loop();
+
+  public:
+    WorkerThread();
+    /// Runs all outstanding jobs and joins the thread.
+    ~WorkerThread();
+
+    WorkerThread(const WorkerThread &) = delete;
+    WorkerThread &operator=(const WorkerThread &) = delete;
+
+    /// Queues `job` to run on the worker thread.
+    void submit(Job job);
+    /// Blocks until all submitted jobs have run.
+    void drain();
+    /// Blocks until at most `maxPending` jobs are outstanding. Submitters
+    /// use this to keep the queue bounded when the worker falls behind.
+    void waitForPending(std::size_t maxPending);
+    /// Number of jobs submitted but not finished yet.
+    std::size_t pending() const;
+  };
+
+} // namespace klee
+
+#endif /* KLEE_WORKERTHREAD_H */
@@ -9,10 +9,24 @@
 
 #include "klee/ADT/KTest.h"
 
+#include "klee/Config/config.h"
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
+
 #define KTEST_VERSION 3
 #define KTEST_MAGIC_SIZE 5
 #define KTEST_MAGIC "KTEST"
@@ -22,43 +36,54 @@
 
 /***/
 
-static int read_uint32(FILE *f, unsigned *value_out) {
-  unsigned char data[4];
-  if (fread(data, 4, 1, f)!=1)
+/* a position in a buffer being parsed */
+struct Cursor {
+  const unsigned char *pos, *end;
+};
+
+static int read_uint32(Cursor *c, unsigned *value_out) {
+  if (c->end - c->pos < 4)
     return 0;
+  const unsigned char *data = c->pos;
   *value_out = (((((data[0]<<8) + data[1])<<8) + data[2])<<8) + data[3];
+  c->pos += 4;
   return 1;
 }
 
-static int write_uint32(FILE *f, unsigned value) {
-  unsigned char data[4];
-  data[0] = value>>24;
-  data[1] = value>>16;
-  data[2] = value>> 8;
-  data[3] = value>> 0;
-  return fwrite(data, 1, 4, f)==4;
+static void write_uint32(std::vector<unsigned char> &out, unsigned value) {
+  out.push_back(value>>24);
+  out.push_back(value>>16);
+  out.push_back(value>> 8);
+  out.push_back(value>> 0);
+}
+
+static int read_bytes(Cursor *c, unsigned len, const unsigned char **data_out) {
+  if ((size_t) (c->end - c->pos) < len)
+    return 0;
+  *data_out = c->pos;
+  c->pos += len;
+  return 1;
 }
 
-static int read_string(FILE *f, char **value_out) {
+static int read_string(Cursor *c, char **value_out) {
   unsigned len;
-  if (!read_uint32(f, &len))
+  const unsigned char *data;
+  if (!read_uint32(c, &len))
+    return 0;
+  if (!read_bytes(c, len, &data))
     return 0;
   *value_out = (char*) malloc(len+1);
   if (!*value_out)
     return 0;
-  if (fread(*value_out, len, 1, f)!=1)
-    return 0;
+  memcpy(*value_out, data, len);
   (*value_out)[len] = 0;
   return 1;
 }
 
-static int write_string(FILE *f, const char *value) {
+static void write_string(std::vector<unsigned char> &out, const char *value) {
   unsigned len = strlen(value);
-  if (!write_uint32(f, len))
-    return 0;
-  if (fwrite(value, len, 1, f)!=1)
-    return 0;
-  return 1;
+  write_uint32(out, len);
+  out.insert(out.end(), value, value + len);
 }
 
 /***/
@@ -91,21 +116,44 @@ int kTest_isKTestFile(const char *path) {
   return res;
 }
 
-KTest *kTest_fromFile(const char *path) {
+static int read_file(const char *path, std::vector<unsigned char> &out) {
   FILE *f = fopen(path, "rb");
+  unsigned char buffer[4096];
+  size_t n;
+
+  if (!f)
+    return 0;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+    out.insert(out.end(), buffer, buffer + n);
+  int res = !ferror(f);
+  fclose(f);
+  return res;
+}
+
+KTest *kTest_fromFile(const char *path) {
+  std::vector<unsigned char> data;
+  if (!read_file(path, data))
+    return 0;
+  return kTest_fromBuffer(data.data(), data.size());
+}
+
+KTest *kTest_fromBuffer(const unsigned char *data, unsigned size) {
+  Cursor c = {data, data + size};
   KTest *res = 0;
   unsigned i, version;
+  const unsigned char *bytes;
 
-  if (!f) 
+  if (!read_bytes(&c, KTEST_MAGIC_SIZE, &bytes))
     goto error;
-  if (!kTest_checkHeader(f)) 
+  if (memcmp(bytes, KTEST_MAGIC, KTEST_MAGIC_SIZE) &&
+      memcmp(bytes, BOUT_MAGIC, KTEST_MAGIC_SIZE))
     goto error;
 
   res = (KTest*) calloc(1, sizeof(*res));
   if (!res) 
     goto error;
 
-  if (!read_uint32(f, &version)) 
+  if (!read_uint32(&c, &version)) 
     goto error;
   
   if (version > kTest_getCurrentVersion())
@@ -113,41 +161,42 @@ KTest *kTest_fromFile(const char *path) {
 
   res->version = version;
 
-  if (!read_uint32(f, &res->numArgs)) 
+  if (!read_uint32(&c, &res->numArgs)) 
     goto error;
   res->args = (char**) calloc(res->numArgs, sizeof(*res->args));
   if (!res->args) 
     goto error;
   
   for (i=0; i<res->numArgs; i++)
-    if (!read_string(f, &res->args[i]))
+    if (!read_string(&c, &res->args[i]))
       goto error;
 
   if (version >= 2) {
-    if (!read_uint32(f, &res->symArgvs)) 
+    if (!read_uint32(&c, &res->symArgvs)) 
       goto error;
-    if (!read_uint32(f, &res->symArgvLen)) 
+    if (!read_uint32(&c, &res->symArgvLen)) 
       goto error;
   }
 
-  if (!read_uint32(f, &res->numObjects))
+  if (!read_uint32(&c, &res->numObjects))
     goto error;
   res->objects = (KTestObject*) calloc(res->numObjects, sizeof(*res->objects));
   if (!res->objects)
     goto error;
   for (i=0; i<res->numObjects; i++) {
     KTestObject *o = &res->objects[i];
-    if (!read_string(f, &o->name))
+    if (!read_string(&c, &o->name))
+      goto error;
+    if (!read_uint32(&c, &o->numBytes))
       goto error;
-    if (!read_uint32(f, &o->numBytes))
+    if (!read_bytes(&c, o->numBytes, &bytes))
       goto error;
     o->bytes = (unsigned char*) malloc(o->numBytes);
-    if (fread(o->bytes, o->numBytes, 1, f)!=1)
+    if (o->numBytes && !o->bytes)
       goto error;
+    memcpy(o->bytes, bytes, o->numBytes);
   }
 
-  fclose(f);
-
   return res;
  error:
   if (res) {
@@ -170,53 +219,43 @@ KTest *kTest_fromFile(const char *path) {
     free(res);
   }
 
-  if (f) fclose(f);
-
   return 0;
 }
 
-int kTest_toFile(KTest *bo, const char *path) {
-  FILE *f = fopen(path, "wb");
+/* appends the contents of a .ktest file for bo to out */
+static void kTest_serialize(KTest *bo, std::vector<unsigned char> &out) {
   unsigned i;
 
-  if (!f) 
-    goto error;
-  if (fwrite(KTEST_MAGIC, strlen(KTEST_MAGIC), 1, f)!=1)
-    goto error;
-  if (!write_uint32(f, KTEST_VERSION))
-    goto error;
+  out.insert(out.end(), KTEST_MAGIC, KTEST_MAGIC + KTEST_MAGIC_SIZE);
+  write_uint32(out, KTEST_VERSION);
       
-  if (!write_uint32(f, bo->numArgs))
-    goto error;
-  for (i=0; i<bo->numArgs; i++) {
-    if (!write_string(f, bo->args[i]))
-      goto error;
-  }
+  write_uint32(out, bo->numArgs);
+  for (i=0; i<bo->numArgs; i++)
+    write_string(out, bo->args[i]);
 
-  if (!write_uint32(f, bo->symArgvs))
-    goto error;
-  if (!write_uint32(f, bo->symArgvLen))
-    goto error;
+  write_uint32(out, bo->symArgvs);
+  write_uint32(out, bo->symArgvLen);
   
-  if (!write_uint32(f, bo->numObjects))
-    goto error;
+  write_uint32(out, bo->numObjects);
   for (i=0; i<bo->numObjects; i++) {
     KTestObject *o = &bo->objects[i];
-    if (!write_string(f, o->name))
-      goto error;
-    if (!write_uint32(f, o->numBytes))
-      goto error;
-    if (fwrite(o->bytes, o->numBytes, 1, f)!=1)
-      goto error;
+    write_string(out, o->name);
+    write_uint32(out, o->numBytes);
+    out.insert(out.end(), o->bytes, o->bytes + o->numBytes);
   }
+}
 
-  fclose(f);
+int kTest_toFile(KTest *bo, const char *path) {
+  std::vector<unsigned char> data;
+  kTest_serialize(bo, data);
 
-  return 1;
- error:
-  if (f) fclose(f);
-  
-  return 0;
+  FILE *f = fopen(path, "wb");
+  if (!f) 
+    return 0;
+  int res = fwrite(data.data(), 1, data.size(), f) == data.size();
+  if (fclose(f))
+    res = 0;
+  return res;
 }
 
 unsigned kTest_numBytes(KTest *bo) {
@@ -238,3 +277,287 @@ void kTest_free(KTest *bo) {
   free(bo->objects);
   free(bo);
 }
+
+/***/
+
+/* Archive layout (integers are big-endian):
+     header:  ARCHIVE_MAGIC, version (u32)
+     entry:   name (u32 length + bytes), flags (u32), size (u32),
+              stored size (u32), stored bytes
+     index:   offset of each entry (u64)
+     trailer: index offset (u64), number of entries (u32), INDEX_MAGIC
+   The index and trailer are written when the archive is closed. */
+#define ARCHIVE_MAGIC "KTESTARC"
+#define ARCHIVE_MAGIC_SIZE 8
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_HEADER_SIZE (ARCHIVE_MAGIC_SIZE + 4)
+#define INDEX_MAGIC "KTARIDX1"
+#define INDEX_MAGIC_SIZE 8
+#define TRAILER_SIZE (8 + 4 + INDEX_MAGIC_SIZE)
+#define ENTRY_ZLIB 1u
+
+struct KTestArchive {
+  /* writing */
+  FILE *file;
+  int compress;
+  std::vector<unsigned long long> offsets;
+  unsigned long long size;
+  /* set once a write has failed: the file may end in a partial entry, so
+     neither further entries nor the index can be placed correctly */
+  int failed;
+
+  /* reading */
+  const unsigned char *data;
+  size_t mappedSize;
+  struct Entry {
+    std::string name;
+    unsigned flags, rawSize, storedSize;
+    const unsigned char *stored;
+  };
+  std::vector<Entry> entries;
+  std::vector<unsigned char> scratch;
+};
+
+static void write_uint64(std::vector<unsigned char> &out,
+                         unsigned long long value) {
+  write_uint32(out, value >> 32);
+  write_uint32(out, value);
+}
+
+static int read_uint64(Cursor *c, unsigned long long *value_out) {
+  unsigned hi, lo;
+  if (!read_uint32(c, &hi) || !read_uint32(c, &lo))
+    return 0;
+  *value_out = ((unsigned long long) hi << 32) | lo;
+  return 1;
+}
+
+int kTestArchive_isArchive(const char *path) {
+  FILE *f = fopen(path, "rb");
+  char header[ARCHIVE_MAGIC_SIZE];
+  int res;
+
+  if (!f)
+    return 0;
+  res = fread(header, ARCHIVE_MAGIC_SIZE, 1, f) == 1 &&
+        !memcmp(header, ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE);
+  fclose(f);
+  return res;
+}
+
+KTestArchive *kTestArchive_create(const char *path, int compress) {
+  FILE *f = fopen(path, "wb");
+  if (!f)
+    return 0;
+
+  std::vector<unsigned char> header(ARCHIVE_MAGIC, ARCHIVE_MAGIC + ARCHIVE_MAGIC_SIZE);
+  write_uint32(header, ARCHIVE_VERSION);
+  if (fwrite(header.data(), 1, header.size(), f) != header.size()) {
+    fclose(f);
+    return 0;
+  }
+
+  KTestArchive *ar = new KTestArchive();
+  ar->file = f;
+#ifdef HAVE_ZLIB_H
+  ar->compress = compress;
+#else
+  ar->compress = 0;
+#endif
+  ar->size = header.size();
+  ar->failed = 0;
+  ar->data = 0;
+  ar->mappedSize = 0;
+  return ar;
+}
+
+int kTestArchive_addTest(KTestArchive *ar, const char *name, KTest *bo) {
+  if (!ar->file || ar->failed)
+    return 0;
+
+  std::vector<unsigned char> test;
+  kTest_serialize(bo, test);
+
+  unsigned flags = 0;
+  const unsigned char *stored = test.data();
+  size_t storedSize = test.size();
+#ifdef HAVE_ZLIB_H
+  std::vector<unsigned char> compressed;
+  if (ar->compress) {
+    uLongf compressedSize = compressBound(test.size());
+    compressed.resize(compressedSize);
+    if (compress2(compressed.data(), &compressedSize, test.data(), test.size(),
+                  Z_DEFAULT_COMPRESSION) == Z_OK &&
+        compressedSize < test.size()) {
+      flags |= ENTRY_ZLIB;
+      stored = compressed.data();
+      storedSize = compressedSize;
+    }
+  }
+#endif
+
+  std::vector<unsigned char> header;
+  write_string(header, name);
+  write_uint32(header, flags);
+  write_uint32(header, test.size());
+  write_uint32(header, storedSize);
+
+  if (fwrite(header.data(), 1, header.size(), ar->file) != header.size() ||
+      fwrite(stored, 1, storedSize, ar->file) != storedSize) {
+    ar->failed = 1;
+    return 0;
+  }
+  ar->offsets.push_back(ar->size);
+  ar->size += header.size() + storedSize;
+  return 1;
+}
+
+/* parses the entry at offset; returns its end, or 0 if it is malformed */
+static size_t read_entry(KTestArchive *ar, size_t offset) {
+  if (offset < ARCHIVE_HEADER_SIZE || offset >= ar->mappedSize)
+    return 0;
+  Cursor c = {ar->data + offset, ar->data + ar->mappedSize};
+  KTestArchive::Entry e;
+  unsigned len;
+  const unsigned char *name;
+  if (!read_uint32(&c, &len) || !read_bytes(&c, len, &name) ||
+      !read_uint32(&c, &e.flags) || !read_uint32(&c, &e.rawSize) ||
+      !read_uint32(&c, &e.storedSize) ||
+      !read_bytes(&c, e.storedSize, &e.stored))
+    return 0;
+  e.name.assign(reinterpret_cast<const char *>(name), len);
+  ar->entries.push_back(std::move(e));
+  return c.pos - ar->data;
+}
+
+static int read_index(KTestArchive *ar) {
+  if (ar->mappedSize < ARCHIVE_HEADER_SIZE + TRAILER_SIZE)
+    return 0;
+  Cursor c = {ar->data + ar->mappedSize - TRAILER_SIZE,
+              ar->data + ar->mappedSize};
+  unsigned long long indexOffset;
+  unsigned count;
+  if (!read_uint64(&c, &indexOffset) || !read_uint32(&c, &count) ||
+      memcmp(c.pos, INDEX_MAGIC, INDEX_MAGIC_SIZE) ||
+      indexOffset > ar->mappedSize - TRAILER_SIZE ||
+      (ar->mappedSize - TRAILER_SIZE - indexOffset) / 8 != count)
+    return 0;
+
+  c.pos = ar->data + indexOffset;
+  for (unsigned i = 0; i < count; ++i) {
+    unsigned long long offset;
+    if (!read_uint64(&c, &offset) || offset >= indexOffset ||
+        !read_entry(ar, offset))
+      return 0;
+  }
+  return 1;
+}
+
+KTestArchive *kTestArchive_open(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return 0;
+  struct stat st;
+  void *base = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= ARCHIVE_HEADER_SIZE)
+    base = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return 0;
+
+  KTestArchive *ar = new KTestArchive();
+  ar->file = 0;
+  ar->compress = 0;
+  ar->size = 0;
+  ar->failed = 0;
+  ar->data = static_cast<const unsigned char *>(base);
+  ar->mappedSize = st.st_size;
+
+  Cursor c = {ar->data, ar->data + ar->mappedSize};
+  const unsigned char *magic;
+  unsigned version;
+  if (!read_bytes(&c, ARCHIVE_MAGIC_SIZE, &magic) ||
+      memcmp(magic, ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE) ||
+      !read_uint32(&c, &version) || version > ARCHIVE_VERSION) {
+    kTestArchive_close(ar);
+    return 0;
+  }
+
+  if (!read_index(ar)) {
+    /* No (valid) index: the archive was not closed. Recover every complete
+       entry by walking them from the start. */
+    ar->entries.clear();
+    for (size_t offset = ARCHIVE_HEADER_SIZE; offset < ar->mappedSize;) {
+      size_t next = read_entry(ar, offset);
+      if (!next)
+        break;
+      offset = next;
+    }
+  }
+  return ar;
+}
+
+unsigned kTestArchive_numTests(KTestArchive *ar) {
+  return ar->entries.size();
+}
+
+const char *kTestArchive_getName(KTestArchive *ar, unsigned index) {
+  if (index >= ar->entries.size())
+    return 0;
+  return ar->entries[index].name.c_str();
+}
+
+const unsigned char *kTestArchive_getData(KTestArchive *ar, unsigned index,
+                                          unsigned *size) {
+  if (index >= ar->entries.size())
+    return 0;
+  const KTestArchive::Entry &e = ar->entries[index];
+  if (!(e.flags & ENTRY_ZLIB)) {
+    *size = e.storedSize;
+    return e.stored;
+  }
+
+#ifdef HAVE_ZLIB_H
+  ar->scratch.resize(e.rawSize);
+  uLongf rawSize = e.rawSize;
+  if (uncompress(ar->scratch.data(), &rawSize, e.stored, e.storedSize) != Z_OK ||
+      rawSize != e.rawSize)
+    return 0;
+  *size = e.rawSize;
+  return ar->scratch.data();
+#else
+  return 0;
+#endif
+}
+
+KTest *kTestArchive_getTest(KTestArchive *ar, unsigned index) {
+  unsigned size;
+  const unsigned char *data = kTestArchive_getData(ar, index, &size);
+  if (!data)
+    return 0;
+  return kTest_fromBuffer(data, size);
+}
+
+int kTestArchive_close(KTestArchive *ar) {
+  int res = 1;
+  if (ar->file && ar->failed) {
+    /* without an index, readers recover the entries before the failed one */
+    fclose(ar->file);
+    res = 0;
+  } else if (ar->file) {
+    std::vector<unsigned char> index;
+    for (unsigned long long offset : ar->offsets)
+      write_uint64(index, offset);
+    write_uint64(index, ar->size);
+    write_uint32(index, ar->offsets.size());
+    index.insert(index.end(), INDEX_MAGIC, INDEX_MAGIC + INDEX_MAGIC_SIZE);
+    if (fwrite(index.data(), 1, index.size(), ar->file) != index.size())
+      res = 0;
+    if (fclose(ar->file))
+      res = 0;
+  }
+  if (ar->data)
+    munmap(const_cast<unsigned char *>(ar->data), ar->mappedSize);
+  delete ar;
+  return res;
+}
@@ -9,6 +9,7 @@
 
 #include "klee/Statistics/Statistics.h"
 
+#include <algorithm>
 #include <vector>
 
 using namespace klee;
@@ -17,6 +18,7 @@ StatisticManager::StatisticManager()
   : enabled(true),
     globalStats(0),
     indexedStats(0),
+    indexedCapacity(0),
     contextStats(0),
     index(0) {
 }
@@ -30,6 +32,23 @@ void StatisticManager::useIndexedStats(unsigned totalIndices) {
   delete[] indexedStats;
   indexedStats = new uint64_t[totalIndices * stats.size()];
   memset(indexedStats, 0, sizeof(*indexedStats) * totalIndices * stats.size());
+  indexedCapacity = totalIndices;
+}
+
+void StatisticManager::growIndexedStats(unsigned totalIndices) {
+  if (!indexedStats || totalIndices <= indexedCapacity)
+    return;
+
+  // grow geometrically, as indices are added a few at a time
+  unsigned capacity = std::max(totalIndices, 2 * indexedCapacity);
+  uint64_t *grown = new uint64_t[capacity * stats.size()];
+  memcpy(grown, indexedStats,
+         sizeof(*indexedStats) * indexedCapacity * stats.size());
+  memset(grown + indexedCapacity * stats.size(), 0,
+         sizeof(*grown) * (capacity - indexedCapacity) * stats.size());
+  delete[] indexedStats;
+  indexedStats = grown;
+  indexedCapacity = capacity;
 }
 
 void StatisticManager::registerStatistic(Statistic &s) {
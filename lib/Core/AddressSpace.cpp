@@ -18,18 +18,28 @@
 
 #include "CoreStats.h"
 
+#include <algorithm>
+
 using namespace klee;
 
+namespace {
+/// Upper bound on the number of symbolic pointer resolutions cached per
+/// address space; stale entries are only dropped when looked up again.
+constexpr std::size_t MaxCachedResolutions = 64;
+} // namespace
+
 ///
 
 void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
   assert(os->copyOnWriteOwner==0 && "object already has owner");
   os->copyOnWriteOwner = cowKey;
   objects = objects.replace(std::make_pair(mo, os));
+  invalidateResolutionsOnBind(mo);
 }
 
 void AddressSpace::unbindObject(const MemoryObject *mo) {
   objects = objects.remove(mo);
+  invalidateResolutionsOnUnbind(mo);
 }
 
 const ObjectState *AddressSpace::findObject(const MemoryObject *mo) const {
@@ -56,7 +66,10 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
 
 bool AddressSpace::resolveOne(const ref<ConstantExpr> &addr, 
                               ObjectPair &result) const {
-  uint64_t address = addr->getZExtValue();
+  return resolveOne(addr->getZExtValue(), result);
+}
+
+bool AddressSpace::resolveOne(uint64_t address, ObjectPair &result) const {
   MemoryObject hack(address);
 
   if (const auto res = objects.lookup_previous(&hack)) {
@@ -204,6 +217,109 @@ int AddressSpace::checkPointerInObject(ExecutionState &state,
   return 2;
 }
 
+void AddressSpace::invalidateResolutionsOnBind(const MemoryObject *mo) {
+  // a resolution only changes if the new object lies where the pointer may
+  // point
+  const std::uint64_t end = mo->address + std::max<std::uint64_t>(mo->size, 1);
+  for (auto it = resolutionCache.begin(); it != resolutionCache.end();) {
+    const CachedResolution &cr = it->second;
+    if (mo->address < cr.highAddress && cr.lowAddress < end)
+      it = resolutionCache.erase(it);
+    else
+      ++it;
+  }
+}
+
+void AddressSpace::invalidateResolutionsOnUnbind(const MemoryObject *mo) {
+  for (auto it = resolutionCache.begin(); it != resolutionCache.end();) {
+    const auto &candidates = it->second.objects;
+    if (std::find(candidates.begin(), candidates.end(), mo) != candidates.end())
+      it = resolutionCache.erase(it);
+    else
+      ++it;
+  }
+}
+
+bool AddressSpace::boundCandidates(ExecutionState &state, TimingSolver *solver,
+                                   ref<Expr> p, std::size_t start,
+                                   std::size_t &first, std::size_t &last,
+                                   std::uint64_t &lowAddress,
+                                   std::uint64_t &highAddress) const {
+  auto base = [this](std::size_t i) { return objects.select(i).first; };
+
+  // Objects do not overlap, so once p must be at or above the base of an
+  // object, no object below it can contain p. Find the highest such object
+  // below start: gallop downwards, then binary search in the last step.
+  first = 0;
+  lowAddress = 0;
+  std::size_t hi = start, step = 1;
+  while (hi > 0) {
+    std::size_t probe = hi >= step ? hi - step : 0;
+    bool mustBeTrue;
+    if (!solver->mustBeTrue(state.constraints,
+                            UgeExpr::create(p, base(probe)->getBaseExpr()),
+                            mustBeTrue, state.queryMetaData))
+      return false;
+    if (mustBeTrue) {
+      // the object at probe is a candidate, the answer lies in [probe, hi)
+      std::size_t lo = probe;
+      while (hi - lo > 1) {
+        std::size_t mid = lo + (hi - lo) / 2;
+        if (!solver->mustBeTrue(state.constraints,
+                                UgeExpr::create(p, base(mid)->getBaseExpr()),
+                                mustBeTrue, state.queryMetaData))
+          return false;
+        if (mustBeTrue)
+          lo = mid;
+        else
+          hi = mid;
+      }
+      first = lo;
+      lowAddress = base(lo)->address;
+      break;
+    }
+    hi = probe;
+    step *= 2;
+  }
+
+  // Symmetrically, find the lowest object at or above start whose base p
+  // must be below; it and everything above it are no candidates.
+  last = objects.size();
+  highAddress = UINT64_MAX;
+  std::size_t lo = start;
+  step = 1;
+  while (lo < objects.size()) {
+    std::size_t probe = std::min(lo + step - 1, objects.size() - 1);
+    bool mustBeTrue;
+    if (!solver->mustBeTrue(state.constraints,
+                            UltExpr::create(p, base(probe)->getBaseExpr()),
+                            mustBeTrue, state.queryMetaData))
+      return false;
+    if (mustBeTrue) {
+      // the answer lies in [lo, probe]
+      std::size_t hi = probe;
+      while (lo < hi) {
+        std::size_t mid = lo + (hi - lo) / 2;
+        if (!solver->mustBeTrue(state.constraints,
+                                UltExpr::create(p, base(mid)->getBaseExpr()),
+                                mustBeTrue, state.queryMetaData))
+          return false;
+        if (mustBeTrue)
+          hi = mid;
+        else
+          lo = mid + 1;
+      }
+      last = lo;
+      highAddress = base(lo)->address;
+      break;
+    }
+    lo = probe + 1;
+    step *= 2;
+  }
+
+  return true;
+}
+
 bool AddressSpace::resolve(ExecutionState &state, TimingSolver *solver,
                            ref<Expr> p, ResolutionList &rl,
                            unsigned maxResolutions, time::Span timeout) const {
@@ -215,16 +331,30 @@ bool AddressSpace::resolve(ExecutionState &state, TimingSolver *solver,
   } else {
     TimerStatIncrementer timer(stats::resolveTime);
 
+    // Reuse a previous resolution of p if neither the objects nor the
+    // constraints have changed since.
+    const std::size_t numConstraints = state.constraints.size();
+    const ref<Expr> lastConstraint =
+        numConstraints ? *std::prev(state.constraints.end()) : ref<Expr>();
+    const auto cached = resolutionCache.find(p);
+    if (cached != resolutionCache.end()) {
+      const CachedResolution &cr = cached->second;
+      if (cr.numConstraints == numConstraints &&
+          cr.lastConstraint.get() == lastConstraint.get() &&
+          (!maxResolutions || cr.objects.size() < maxResolutions)) {
+        for (const MemoryObject *mo : cr.objects)
+          rl.emplace_back(mo, findObject(mo));
+        return false;
+      }
+      resolutionCache.erase(cached);
+    }
+
     // XXX in general this isn't exactly what we want... for
     // a multiple resolution case (or for example, a \in {b,c,0})
     // we want to find the first object, find a cex assuming
     // not the first, find a cex assuming not the second...
     // etc.
 
-    // XXX how do we smartly amortize the cost of checking to
-    // see if we need to keep searching up/down, in bad cases?
-    // maybe we don't care?
-
     // XXX we really just need a smart place to start (although
     // if its a known solution then the code below is guaranteed
     // to hit the fast path with exactly 2 queries). we could also
@@ -234,58 +364,66 @@ bool AddressSpace::resolve(ExecutionState &state, TimingSolver *solver,
     if (!solver->getValue(state.constraints, p, cex, state.queryMetaData))
       return true;
     uint64_t example = cex->getZExtValue();
-    MemoryObject hack(example);
 
-    MemoryMap::iterator oi = objects.upper_bound(&hack);
-    MemoryMap::iterator begin = objects.begin();
-    MemoryMap::iterator end = objects.end();
-
-    MemoryMap::iterator start = oi;
-    // search backwards, start with one minus because this
-    // is the object that p *should* be within, which means we
-    // get write off the end with 4 queries
-    while (oi != begin) {
-      --oi;
-      const MemoryObject *mo = oi->first;
-      if (timeout && timeout < timer.delta())
+    const std::size_t firstResolution = rl.size();
+    // position of the first object above the example
+    MemoryObject hack(example);
+    std::size_t start = objects.rank(&hack) + objects.count(&hack);
+
+    auto checkCandidate = [&](std::size_t i) {
+      const auto &object = objects.select(i);
+      auto op = std::make_pair<>(object.first, object.second.get());
+      return checkPointerInObject(state, solver, p, op, rl, maxResolutions);
+    };
+
+    // the object just below the example is the one p *should* be within,
+    // which resolves in-bounds pointers with exactly 2 queries
+    int incomplete = start > 0 ? checkCandidate(start - 1) : 2;
+    std::uint64_t lowAddress = 0, highAddress = UINT64_MAX;
+
+    if (incomplete == 2) {
+      // otherwise bound the candidates with O(log n) queries instead of
+      // walking the objects one by one in both directions
+      std::size_t first, last;
+      if (!boundCandidates(state, solver, p, start, first, last, lowAddress,
+                           highAddress))
         return true;
 
-      auto op = std::make_pair<>(mo, oi->second.get());
-
-      int incomplete =
-          checkPointerInObject(state, solver, p, op, rl, maxResolutions);
-      if (incomplete != 2)
-        return incomplete ? true : false;
-
-      bool mustBeTrue;
-      if (!solver->mustBeTrue(state.constraints,
-                              UgeExpr::create(p, mo->getBaseExpr()), mustBeTrue,
-                              state.queryMetaData))
-        return true;
-      if (mustBeTrue)
-        break;
+      // search backwards, then forwards, as candidates closer to the
+      // example are more likely to be hit
+      for (std::size_t i = start > 0 ? start - 1 : 0;
+           incomplete == 2 && i > first;) {
+        if (timeout && timeout < timer.delta())
+          return true;
+        incomplete = checkCandidate(--i);
+      }
+      for (std::size_t i = start; incomplete == 2 && i < last; ++i) {
+        if (timeout && timeout < timer.delta())
+          return true;
+        incomplete = checkCandidate(i);
+      }
     }
 
-    // search forwards
-    for (oi = start; oi != end; ++oi) {
-      const MemoryObject *mo = oi->first;
-      if (timeout && timeout < timer.delta())
-        return true;
-
-      bool mustBeTrue;
-      if (!solver->mustBeTrue(state.constraints,
-                              UltExpr::create(p, mo->getBaseExpr()), mustBeTrue,
-                              state.queryMetaData))
-        return true;
-      if (mustBeTrue)
-        break;
-      auto op = std::make_pair<>(mo, oi->second.get());
+    if (incomplete == 1)
+      return true;
 
-      int incomplete =
-          checkPointerInObject(state, solver, p, op, rl, maxResolutions);
-      if (incomplete != 2)
-        return incomplete ? true : false;
+    if (incomplete == 0) {
+      // p must point into the single object found
+      const MemoryObject *mo = rl.back().first;
+      lowAddress = mo->address;
+      highAddress = mo->address + std::max<std::uint64_t>(mo->size, 1);
     }
+
+    // the resolution is complete, remember it
+    if (resolutionCache.size() >= MaxCachedResolutions)
+      resolutionCache.clear();
+    CachedResolution &cr = resolutionCache[p];
+    cr.numConstraints = numConstraints;
+    cr.lastConstraint = lastConstraint;
+    cr.lowAddress = lowAddress;
+    cr.highAddress = highAddress;
+    for (auto it = rl.begin() + firstResolution; it != rl.end(); ++it)
+      cr.objects.push_back(it->first);
   }
 
   return false;
@@ -302,6 +440,13 @@ std::size_t AddressSpace::copyOutConcretes() {
   for (const auto &object : objects) {
     auto &mo = object.first;
     auto &os = object.second;
+    // Objects which are not initialized yet and whose address external code
+    // cannot know are left alone, so that they stay uninitialized.
+    if (os->isHiddenFromExternalCalls())
+      continue;
+    // Read-only objects are copied out when they are initialized.
+    if (os->readOnly)
+      os->materialize();
     if (!mo->isUserSpecified && !os->readOnly && os->size != 0) {
       auto size = std::max(os->size, mo->alignment);
       numPages +=
@@ -315,6 +460,7 @@ std::size_t AddressSpace::copyOutConcretes() {
 void AddressSpace::copyOutConcrete(const MemoryObject *mo,
                                    const ObjectState *os) const {
   auto address = reinterpret_cast<std::uint8_t *>(mo->address);
+  os->materialize();
   std::memcpy(address, os->concreteStore, mo->size);
 }
 
@@ -324,6 +470,9 @@ bool AddressSpace::copyInConcretes(bool concretize) {
 
     if (!mo->isUserSpecified) {
       const auto &os = obj.second;
+      // not copied out, see copyOutConcretes()
+      if (os->isHiddenFromExternalCalls())
+        continue;
 
       if (!copyInConcrete(mo, os.get(), mo->address, concretize))
         return false;
@@ -336,6 +485,7 @@ bool AddressSpace::copyInConcretes(bool concretize) {
 bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
                                   uint64_t src_address, bool concretize) {
   auto address = reinterpret_cast<std::uint8_t*>(src_address);
+  os->materialize();
 
   // Don't do anything if the underlying representation has not been changed
   // externally.
@@ -13,9 +13,13 @@
 #include "Memory.h"
 
 #include "klee/Expr/Expr.h"
-#include "klee/ADT/ImmutableMap.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/ADT/PersistentMap.h"
 #include "klee/System/Time.h"
 
+#include <cstdint>
+#include <vector>
+
 namespace klee {
   class ExecutionState;
   class MemoryObject;
@@ -32,7 +36,7 @@ namespace klee {
     bool operator()(const MemoryObject *a, const MemoryObject *b) const;
   };
 
-  typedef ImmutableMap<const MemoryObject *, ref<ObjectState>, MemoryObjectLT>
+  typedef PersistentMap<const MemoryObject *, ref<ObjectState>, MemoryObjectLT>
       MemoryMap;
 
   class AddressSpace {
@@ -43,6 +47,39 @@ namespace klee {
     /// Unsupported, use copy constructor
     AddressSpace &operator=(const AddressSpace &);
 
+    /// A resolution of a symbolic pointer, valid as long as the path
+    /// constraints do not change, no object is bound within
+    /// [lowAddress, highAddress) and none of `objects` is unbound.
+    struct CachedResolution {
+      std::size_t numConstraints;
+      ref<Expr> lastConstraint;
+      /// The pointer is known to lie within [lowAddress, highAddress).
+      std::uint64_t lowAddress;
+      std::uint64_t highAddress;
+      std::vector<const MemoryObject *> objects;
+    };
+
+    /// Complete resolutions of symbolic pointers under the current
+    /// constraints. Not shared between copies of the address space.
+    mutable ExprHashMap<CachedResolution> resolutionCache;
+
+    /// Drop the cached resolutions that binding `mo` may change.
+    void invalidateResolutionsOnBind(const MemoryObject *mo);
+    /// Drop the cached resolutions that unbinding `mo` may change.
+    void invalidateResolutionsOnUnbind(const MemoryObject *mo);
+
+    /// Bound the objects pointer `p` may point to, starting from position
+    /// `start` in `objects` (the first object above an example value of
+    /// `p`) and galloping outwards. On success, [first, last) is the range
+    /// of positions of candidate objects, and `p` is known to lie within
+    /// [lowAddress, highAddress).
+    ///
+    /// \return false iff a solver query failed.
+    bool boundCandidates(ExecutionState &state, TimingSolver *solver,
+                         ref<Expr> p, std::size_t start, std::size_t &first,
+                         std::size_t &last, std::uint64_t &lowAddress,
+                         std::uint64_t &highAddress) const;
+
     /// Check if pointer `p` can point to the memory object in the
     /// given object pair.  If so, add it to the given resolution list.
     ///
@@ -65,7 +102,8 @@ namespace klee {
     MemoryMap objects;
 
     AddressSpace() : cowKey(1) {}
-    AddressSpace(const AddressSpace &b) : cowKey(++b.cowKey), objects(b.objects) { }
+    AddressSpace(const AddressSpace &b)
+        : cowKey(++b.cowKey), objects(b.objects) {}
     ~AddressSpace() {}
 
     /// Resolve address to an ObjectPair in result.
@@ -73,6 +111,10 @@ namespace klee {
     bool resolveOne(const ref<ConstantExpr> &address, 
                     ObjectPair &result) const;
 
+    /// Resolve address to an ObjectPair in result.
+    /// \return true iff an object was found.
+    bool resolveOne(std::uint64_t address, ObjectPair &result) const;
+
     /// Resolve address to an ObjectPair in result.
     ///
     /// \param state The state this address space is part of.
@@ -0,0 +1,727 @@
+//===-- ConcreteJIT.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ConcreteJIT.h"
+
+#include "AddressSpace.h"
+#include "CoreStats.h"
+#include "ExecutionState.h"
+#include "Executor.h"
+#include "Memory.h"
+#include "StatsTracker.h"
+
+#include "klee/Module/InstructionInfoTable.h"
+#include "klee/Module/KInstruction.h"
+#include "klee/Module/KModule.h"
+#include "klee/Statistics/Statistics.h"
+#include "klee/Support/CompilerWarning.h"
+#include "klee/Support/ErrorHandling.h"
+#include "klee/Support/OptionCategories.h"
+
+DISABLE_WARNING_PUSH
+DISABLE_WARNING_DEPRECATED_DECLARATIONS
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
+DISABLE_WARNING_POP
+
+#include <algorithm>
+#include <csetjmp>
+#include <deque>
+#include <map>
+#include <set>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+cl::opt<unsigned> ConcreteJITThreshold(
+    "concrete-jit-threshold", cl::init(16),
+    cl::desc("Number of calls with concrete arguments after which "
+             "--concrete-jit compiles a function (default=16)"),
+    cl::cat(MiscCat));
+
+/// The most instructions a single native call may execute before it gives
+/// up, so that the interpreter gets to check its limits regularly.
+constexpr std::uint64_t maxCallInstructions = UINT64_C(1) << 20;
+
+/// The most functions compiled together; calls to further functions give
+/// up.
+constexpr std::size_t maxCompiledFunctions = 64;
+
+/// How often a compiled function may give up before it is only
+/// interpreted, unless it completes more often than that.
+constexpr unsigned maxAborts = 8;
+
+/// A block that was not covered yet when its function was compiled. Native
+/// code gives up on entering it until the interpreter has covered it, so
+/// that coverage is only ever gained by interpretation.
+struct UncoveredBlock {
+  const KFunction *kf;
+  /// The instructions of the block in kf, [first, last)
+  unsigned first, last;
+  bool covered;
+};
+
+/// The native call in progress. Compiled code refers to its instruction
+/// counters by address.
+struct NativeCall {
+  ExecutionState *state;
+  std::uint64_t instructions;
+  std::uint64_t maxInstructions;
+
+  /// The object accessed last and its state, which is writeable if
+  /// `writeable` is set.
+  const MemoryObject *object;
+  ObjectState *objectState;
+  bool writeable;
+
+  /// The previous contents of the bytes written so far, in order.
+  struct Write {
+    const MemoryObject *object;
+    unsigned offset;
+    unsigned bytes;
+    std::uint64_t value;
+  };
+  std::vector<Write> undo;
+
+  std::jmp_buf abort;
+} nativeCall;
+
+// The callbacks below are called from compiled code. Giving up jumps back
+// to ConcreteJIT::executeCall() across the native frames, so they must not
+// hold objects with non-trivial destructors when they do.
+
+[[noreturn]] void abortCall() { std::longjmp(nativeCall.abort, 1); }
+
+bool contains(const MemoryObject *mo, std::uint64_t address, unsigned bytes) {
+  return bytes <= mo->size && address - mo->address <= mo->size - bytes;
+}
+
+/// Return the state of the object holding [address, address + bytes), or
+/// give up if there is none.
+ObjectState *access(std::uint64_t address, unsigned bytes, bool write) {
+  NativeCall &nc = nativeCall;
+  if (!nc.object || !contains(nc.object, address, bytes)) {
+    ObjectPair op;
+    if (!nc.state->addressSpace.resolveOne(address, op) ||
+        !contains(op.first, address, bytes))
+      abortCall();
+    nc.object = op.first;
+    nc.objectState = const_cast<ObjectState *>(op.second);
+    nc.writeable = false;
+  }
+  if (write && !nc.writeable) {
+    if (nc.objectState->readOnly)
+      abortCall();
+    nc.objectState =
+        nc.state->addressSpace.getWriteable(nc.object, nc.objectState);
+    nc.writeable = true;
+  }
+  return nc.objectState;
+}
+
+std::uint64_t load(std::uint64_t address, std::uint32_t bytes) {
+  const ObjectState *os = access(address, bytes, false);
+  std::uint64_t value = 0;
+  if (!os->readConcrete(address - nativeCall.object->address, bytes,
+                        reinterpret_cast<std::uint8_t *>(&value)))
+    abortCall();
+  return value;
+}
+
+void store(std::uint64_t address, std::uint64_t value, std::uint32_t bytes) {
+  ObjectState *os = access(address, bytes, true);
+  unsigned offset = address - nativeCall.object->address;
+  // Symbolic bytes could not be restored if the call gives up
+  std::uint64_t old = 0;
+  if (!os->readConcrete(offset, bytes, reinterpret_cast<std::uint8_t *>(&old)))
+    abortCall();
+  nativeCall.undo.push_back({nativeCall.object, offset, bytes, old});
+  for (unsigned i = 0; i < bytes; ++i)
+    os->write8(offset + i, static_cast<std::uint8_t>(value >> (8 * i)));
+}
+
+bool isCovered(const UncoveredBlock &block) {
+  for (unsigned i = block.first; i != block.last; ++i) {
+    const KInstruction *ki = block.kf->instructions[i];
+    // Reaching an unreachable instruction gives up anyway
+    if (!isa<UnreachableInst>(ki->inst) &&
+        !theStatisticManager->getIndexedValue(stats::coveredInstructions,
+                                              ki->info->id))
+      return false;
+  }
+  return true;
+}
+
+void enterUncoveredBlock(UncoveredBlock *block) {
+  if (!block->covered) {
+    if (!isCovered(*block))
+      abortCall();
+    block->covered = true;
+  }
+}
+
+/// Whether values of type t are passed to and from compiled code as
+/// integers of at most 64 bits.
+bool isScalar(const Type *t) {
+  return (t->isIntegerTy() && t->getIntegerBitWidth() <= 64) ||
+         (t->isPointerTy() && t->getPointerAddressSpace() == 0);
+}
+
+bool isCompilable(const Function *f) {
+  if (f->isDeclaration() || f->isVarArg())
+    return false;
+  if (!f->getReturnType()->isVoidTy() && !isScalar(f->getReturnType()))
+    return false;
+  for (const Argument &arg : f->args())
+    if (!isScalar(arg.getType()) || arg.hasPassPointeeByValueCopyAttr())
+      return false;
+  return true;
+}
+
+/// Whether a is a stack object that is only loaded from and stored to as a
+/// whole, which compiled code keeps on the native stack. Any other use
+/// might access it out of bounds or let its address escape.
+bool isPrivateAlloca(const AllocaInst *a) {
+  if (a->getParent() != &a->getFunction()->getEntryBlock() ||
+      a->isArrayAllocation() || !isScalar(a->getAllocatedType()))
+    return false;
+  for (const User *user : a->users()) {
+    if (const auto *li = dyn_cast<LoadInst>(user)) {
+      if (!li->isSimple())
+        return false;
+    } else if (const auto *si = dyn_cast<StoreInst>(user)) {
+      if (!si->isSimple() || si->getValueOperand() == a)
+        return false;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool isPrivateAccess(const Value *pointer) {
+  const auto *a = dyn_cast<AllocaInst>(pointer);
+  return a && isPrivateAlloca(a);
+}
+
+/// The functions compiled together with a function, and the calls between
+/// them that stay native. Recursive calls give up, so that the native
+/// stack depth is bounded.
+struct CompiledClosure {
+  std::vector<Function *> functions;
+  std::set<const CallInst *> calls;
+  std::set<const Function *> active, done;
+
+  void add(Function *f) {
+    active.insert(f);
+    functions.push_back(f);
+    for (Instruction &i : instructions(*f)) {
+      const auto *ci = dyn_cast<CallInst>(&i);
+      if (!ci || isa<IntrinsicInst>(ci))
+        continue;
+      Function *callee = ci->getCalledFunction();
+      if (!callee || !isCompilable(callee) || active.count(callee))
+        continue;
+      if (!done.count(callee)) {
+        if (functions.size() >= maxCompiledFunctions)
+          continue;
+        add(callee);
+      }
+      calls.insert(ci);
+    }
+    active.erase(f);
+    done.insert(f);
+  }
+};
+
+/// How compiled code implements an instruction.
+enum class Lowering {
+  Keep,
+  Load,
+  Store,
+  CheckDivisor,
+  CheckShift,
+  Call,
+  Abort,
+};
+
+Lowering getLowering(const Instruction &i, const CompiledClosure &closure) {
+  switch (i.getOpcode()) {
+  case Instruction::Ret:
+  case Instruction::Br:
+  case Instruction::Switch:
+  case Instruction::PHI:
+  case Instruction::Select:
+  case Instruction::ICmp:
+  case Instruction::GetElementPtr:
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+  case Instruction::PtrToInt:
+  case Instruction::IntToPtr:
+  case Instruction::BitCast:
+  case Instruction::Freeze:
+  case Instruction::ExtractValue:
+  case Instruction::InsertValue:
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+    return Lowering::Keep;
+
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+    return isScalar(i.getType()) ? Lowering::CheckDivisor : Lowering::Abort;
+
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+    return isScalar(i.getType()) ? Lowering::CheckShift : Lowering::Abort;
+
+  case Instruction::Alloca:
+    return isPrivateAlloca(cast<AllocaInst>(&i)) ? Lowering::Keep
+                                                 : Lowering::Abort;
+
+  case Instruction::Load: {
+    const auto &li = cast<LoadInst>(i);
+    if (isPrivateAccess(li.getPointerOperand()))
+      return Lowering::Keep;
+    return li.isSimple() && isScalar(li.getType()) ? Lowering::Load
+                                                   : Lowering::Abort;
+  }
+
+  case Instruction::Store: {
+    const auto &si = cast<StoreInst>(i);
+    if (isPrivateAccess(si.getPointerOperand()))
+      return Lowering::Keep;
+    return si.isSimple() && isScalar(si.getValueOperand()->getType())
+               ? Lowering::Store
+               : Lowering::Abort;
+  }
+
+  case Instruction::Call:
+    if (isa<DbgInfoIntrinsic>(i))
+      return Lowering::Keep;
+    return closure.calls.count(cast<CallInst>(&i)) ? Lowering::Call
+                                                   : Lowering::Abort;
+
+  default:
+    return Lowering::Abort;
+  }
+}
+
+template <typename T> Constant *getAddress(T *p, Type *type) {
+  return llvm::ConstantExpr::getIntToPtr(
+      ConstantInt::get(Type::getInt64Ty(type->getContext()),
+                       reinterpret_cast<std::uint64_t>(p)),
+      type);
+}
+
+template <typename F> FunctionCallee getCallback(F *f, FunctionType *type) {
+  return FunctionCallee(type, getAddress(f, type->getPointerTo()));
+}
+} // namespace
+
+struct ConcreteJIT::CompiledFunction {
+  std::uint64_t (*entry)(const std::uint64_t *) = nullptr;
+  /// Set if f is only interpreted
+  bool disabled = false;
+  /// Calls with concrete arguments before f was compiled
+  unsigned calls = 0;
+  unsigned aborts = 0;
+  unsigned completions = 0;
+  std::deque<UncoveredBlock> uncoveredBlocks;
+};
+
+ConcreteJIT::ConcreteJIT(Executor &executor) : executor(executor) {
+  Module *m = executor.kmodule->module.get();
+  const DataLayout &dl = m->getDataLayout();
+  // Compiled code exchanges memory contents with the interpreter as
+  // integers in host byte order
+  if (!sys::IsLittleEndianHost || !dl.isLittleEndian() ||
+      dl.getPointerSizeInBits() != 64 || sizeof(void *) != 8) {
+    klee_warning("--concrete-jit is only supported on little-endian 64-bit "
+                 "targets, disabling it");
+    return;
+  }
+
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmParser();
+  InitializeNativeTargetAsmPrinter();
+
+  std::string error;
+  engine.reset(EngineBuilder(std::make_unique<Module>("klee_jit",
+                                                      m->getContext()))
+                   .setErrorStr(&error)
+                   .setEngineKind(EngineKind::JIT)
+                   .create());
+  if (!engine)
+    klee_warning("unable to make concrete jit: %s, disabling it",
+                 error.c_str());
+}
+
+ConcreteJIT::~ConcreteJIT() = default;
+
+bool ConcreteJIT::executeCall(ExecutionState &state, KInstruction *ki,
+                              Function *f,
+                              const std::vector<ref<Expr>> &arguments,
+                              std::uint64_t maxInstructions) {
+  const auto *ci = dyn_cast<CallInst>(ki->inst);
+  if (!engine || !ci || ci->getCalledFunction() != f)
+    return false;
+
+  std::unique_ptr<CompiledFunction> &slot = functions[f];
+  if (!slot)
+    slot = std::make_unique<CompiledFunction>();
+  CompiledFunction &cf = *slot;
+  if (cf.disabled)
+    return false;
+
+  argumentValues.clear();
+  for (const ref<Expr> &argument : arguments) {
+    const auto *ce = dyn_cast<klee::ConstantExpr>(argument);
+    if (!ce || ce->getWidth() > Expr::Int64)
+      return false;
+    argumentValues.push_back(ce->getZExtValue());
+  }
+
+  if (!cf.entry) {
+    if (++cf.calls < ConcreteJITThreshold)
+      return false;
+    compile(f, cf);
+    if (!cf.entry)
+      return false;
+  }
+
+  NativeCall &nc = nativeCall;
+  nc.state = &state;
+  nc.instructions = 0;
+  nc.maxInstructions = std::min(maxInstructions, maxCallInstructions);
+  nc.object = nullptr;
+  nc.undo.clear();
+
+  if (setjmp(nc.abort)) {
+    for (auto it = nc.undo.rbegin(), ie = nc.undo.rend(); it != ie; ++it) {
+      ObjectState *os = state.addressSpace.getWriteable(
+          it->object, state.addressSpace.findObject(it->object));
+      for (unsigned i = 0; i < it->bytes; ++i)
+        os->write8(it->offset + i,
+                   static_cast<std::uint8_t>(it->value >> (8 * i)));
+    }
+    if (++cf.aborts > maxAborts && cf.aborts > cf.completions)
+      cf.disabled = true;
+    return false;
+  }
+  std::uint64_t result = cf.entry(argumentValues.data());
+  ++cf.completions;
+
+  Type *returnType = f->getReturnType();
+  if (!returnType->isVoidTy())
+    executor.bindLocal(
+        ki, state,
+        klee::ConstantExpr::create(
+            result, executor.getWidthForLLVMType(returnType)));
+
+  stats::instructions += nc.instructions;
+  stats::concreteFastPathInstructions += nc.instructions;
+  state.steppedInstructions += nc.instructions;
+  if (state.instsSinceCovNew)
+    state.instsSinceCovNew += nc.instructions;
+  return true;
+}
+
+void ConcreteJIT::compile(Function *root, CompiledFunction &cf) {
+  cf.disabled = true;
+  if (!isCompilable(root))
+    return;
+
+  CompiledClosure closure;
+  closure.add(root);
+
+  const Module &source = *root->getParent();
+  LLVMContext &ctx = source.getContext();
+  const std::string id = utostr(moduleCount++);
+  auto module = std::make_unique<Module>("klee_jit_" + id, ctx);
+  module->setDataLayout(source.getDataLayout());
+  module->setTargetTriple(source.getTargetTriple());
+  const DataLayout &dl = module->getDataLayout();
+
+  Type *voidTy = Type::getVoidTy(ctx);
+  Type *i32 = Type::getInt32Ty(ctx);
+  Type *i64 = Type::getInt64Ty(ctx);
+  PointerType *i64Ptr = PointerType::getUnqual(i64);
+  FunctionCallee abortCallback =
+      getCallback(&abortCall, FunctionType::get(voidTy, false));
+  FunctionCallee loadCallback =
+      getCallback(&load, FunctionType::get(i64, {i64, i32}, false));
+  FunctionCallee storeCallback =
+      getCallback(&store, FunctionType::get(voidTy, {i64, i64, i32}, false));
+  FunctionCallee enterBlockCallback = getCallback(
+      &enterUncoveredBlock,
+      FunctionType::get(voidTy, {Type::getInt8PtrTy(ctx)}, false));
+
+  // Globals and functions are referred to by their addresses in KLEE's
+  // memory; only the debug intrinsics survive as calls.
+  ValueToValueMapTy vmap;
+  for (const GlobalValue &gv : source.global_values()) {
+    const auto *fn = dyn_cast<Function>(&gv);
+    if (fn && fn->isIntrinsic()) {
+      vmap[fn] = Function::Create(fn->getFunctionType(),
+                                  GlobalValue::ExternalLinkage, fn->getName(),
+                                  module.get());
+      continue;
+    }
+    auto it = executor.globalAddresses.find(&gv);
+    if (it != executor.globalAddresses.end())
+      vmap[&gv] = llvm::ConstantExpr::getIntToPtr(
+          ConstantInt::get(i64, it->second->getZExtValue()), gv.getType());
+  }
+
+  std::map<const Function *, Function *> clones;
+  for (Function *f : closure.functions)
+    clones[f] = Function::Create(f->getFunctionType(),
+                                 GlobalValue::InternalLinkage, f->getName(),
+                                 module.get());
+
+  struct Prologue {
+    BasicBlock *block;
+    std::uint64_t instructions;
+    UncoveredBlock *uncovered;
+  };
+  std::vector<Prologue> prologues;
+  std::vector<std::pair<const Instruction *, Lowering>> lowerings;
+  const bool trackCoverage =
+      executor.statsTracker && StatsTracker::useIStats();
+
+  for (Function *f : closure.functions) {
+    Function *clone = clones[f];
+    auto cloneArg = clone->arg_begin();
+    for (const Argument &arg : f->args())
+      vmap[&arg] = &*cloneArg++;
+    SmallVector<ReturnInst *, 8> returns;
+    CloneFunctionInto(clone, f, vmap, CloneFunctionChangeType::DifferentModule,
+                      returns);
+    clone->setLinkage(GlobalValue::InternalLinkage);
+
+    KFunction *kf = trackCoverage ? executor.getKFunction(f) : nullptr;
+    for (BasicBlock &bb : *f) {
+      UncoveredBlock *uncovered = nullptr;
+      if (kf && kf->trackCoverage) {
+        unsigned first = kf->basicBlockEntry[&bb];
+        UncoveredBlock block{kf, first, first + unsigned(bb.size()), false};
+        if (!isCovered(block)) {
+          cf.uncoveredBlocks.push_back(block);
+          uncovered = &cf.uncoveredBlocks.back();
+        }
+      }
+      prologues.push_back({cast<BasicBlock>(vmap[&bb]), bb.size(), uncovered});
+
+      for (const Instruction &i : bb) {
+        Lowering lowering = getLowering(i, closure);
+        if (lowering == Lowering::Abort && f == root &&
+            &bb == &f->getEntryBlock())
+          return;
+        if (lowering != Lowering::Keep)
+          lowerings.emplace_back(&i, lowering);
+      }
+    }
+  }
+
+  auto abortIf = [&](Value *condition, Instruction *before) {
+    Instruction *then =
+        SplitBlockAndInsertIfThen(condition, before, /*Unreachable=*/true);
+    CallInst::Create(abortCallback, "", then);
+  };
+
+  // Count the instructions of each block on entry, as the interpreter
+  // would, and give up on exceeding the limit or entering uncovered code
+  Constant *instructionsPtr = getAddress(&nativeCall.instructions, i64Ptr);
+  Constant *maxInstructionsPtr =
+      getAddress(&nativeCall.maxInstructions, i64Ptr);
+  for (const Prologue &p : prologues) {
+    Instruction *at = &*p.block->getFirstInsertionPt();
+    if (p.block->isEntryBlock())
+      while (isa<AllocaInst>(at))
+        at = at->getNextNode();
+    IRBuilder<> builder(at);
+    Value *count =
+        builder.CreateAdd(builder.CreateLoad(i64, instructionsPtr),
+                          ConstantInt::get(i64, p.instructions));
+    builder.CreateStore(count, instructionsPtr);
+    abortIf(builder.CreateICmpUGT(count,
+                                  builder.CreateLoad(i64, maxInstructionsPtr)),
+            at);
+    if (p.uncovered) {
+      builder.SetInsertPoint(at);
+      builder.CreateCall(enterBlockCallback,
+                         {getAddress(p.uncovered, Type::getInt8PtrTy(ctx))});
+    }
+  }
+
+  // Instructions that give up are handled last, as they remove the rest of
+  // their block
+  std::vector<const Instruction *> aborts;
+  for (const auto &[original, lowering] : lowerings) {
+    auto *i = cast<Instruction>(vmap[original]);
+    IRBuilder<> builder(i);
+    switch (lowering) {
+    case Lowering::Load: {
+      Type *type = i->getType();
+      Value *value = builder.CreateCall(
+          loadCallback,
+          {builder.CreatePtrToInt(cast<LoadInst>(i)->getPointerOperand(), i64),
+           ConstantInt::get(i32, dl.getTypeStoreSize(type).getFixedSize())});
+      value = type->isPointerTy() ? builder.CreateIntToPtr(value, type)
+                                  : builder.CreateTrunc(value, type);
+      i->replaceAllUsesWith(value);
+      i->eraseFromParent();
+      break;
+    }
+    case Lowering::Store: {
+      auto *si = cast<StoreInst>(i);
+      Value *value = si->getValueOperand();
+      Type *type = value->getType();
+      value = type->isPointerTy() ? builder.CreatePtrToInt(value, i64)
+                                  : builder.CreateZExt(value, i64);
+      builder.CreateCall(
+          storeCallback,
+          {builder.CreatePtrToInt(si->getPointerOperand(), i64), value,
+           ConstantInt::get(i32, dl.getTypeStoreSize(type).getFixedSize())});
+      si->eraseFromParent();
+      break;
+    }
+    case Lowering::CheckDivisor: {
+      // Dividing by zero or INT_MIN / -1 traps natively; the interpreter
+      // reports the former and defines the latter
+      Type *type = i->getType();
+      Value *divisor = i->getOperand(1);
+      Value *invalid =
+          builder.CreateICmpEQ(divisor, Constant::getNullValue(type));
+      if (i->getOpcode() == Instruction::SDiv ||
+          i->getOpcode() == Instruction::SRem)
+        invalid = builder.CreateOr(
+            invalid,
+            builder.CreateAnd(
+                builder.CreateICmpEQ(divisor, Constant::getAllOnesValue(type)),
+                builder.CreateICmpEQ(
+                    i->getOperand(0),
+                    ConstantInt::get(type, APInt::getSignedMinValue(
+                                               type->getIntegerBitWidth())))));
+      abortIf(invalid, i);
+      break;
+    }
+    case Lowering::CheckShift: {
+      Type *type = i->getType();
+      abortIf(builder.CreateICmpUGE(
+                  i->getOperand(1),
+                  ConstantInt::get(type, type->getIntegerBitWidth())),
+              i);
+      break;
+    }
+    case Lowering::Call: {
+      auto *call = cast<CallInst>(i);
+      call->setCalledFunction(
+          clones[cast<CallInst>(original)->getCalledFunction()]);
+      break;
+    }
+    case Lowering::Abort:
+      aborts.push_back(original);
+      break;
+    case Lowering::Keep:
+      break;
+    }
+  }
+  for (const Instruction *original : aborts) {
+    // Null if removed by an earlier abort in the same block
+    auto *i = cast_or_null<Instruction>(vmap.lookup(original));
+    if (!i)
+      continue;
+    CallInst::Create(abortCallback, "", i);
+    changeToUnreachable(i);
+  }
+
+  for (const auto &clone : clones) {
+    Function &f = *clone.second;
+    removeUnreachableBlocks(f);
+    if (f.hasPersonalityFn())
+      f.setPersonalityFn(nullptr);
+    // The interpreter wraps around on overflow, which the optimizer must
+    // not assume away
+    for (Instruction &i : instructions(f))
+      i.dropPoisonGeneratingFlags();
+  }
+  StripDebugInfo(*module);
+
+  // The entry point takes the arguments as an array of integers
+  const std::string entryName = "klee_jit_entry_" + id;
+  Function *entry =
+      Function::Create(FunctionType::get(i64, {i64Ptr}, false),
+                       GlobalValue::ExternalLinkage, entryName, module.get());
+  IRBuilder<> builder(BasicBlock::Create(ctx, "", entry));
+  std::vector<Value *> args;
+  for (const Argument &arg : root->args()) {
+    Type *type = arg.getType();
+    Value *value = builder.CreateLoad(
+        i64, builder.CreateConstGEP1_64(i64, entry->getArg(0), arg.getArgNo()));
+    args.push_back(type->isPointerTy() ? builder.CreateIntToPtr(value, type)
+                                       : builder.CreateTrunc(value, type));
+  }
+  Value *result = builder.CreateCall(clones[root], args);
+  Type *returnType = root->getReturnType();
+  if (returnType->isVoidTy())
+    builder.CreateRet(ConstantInt::get(i64, 0));
+  else if (returnType->isPointerTy())
+    builder.CreateRet(builder.CreatePtrToInt(result, i64));
+  else
+    builder.CreateRet(builder.CreateZExt(result, i64));
+
+  if (verifyModule(*module)) {
+    klee_warning("unable to compile %s for --concrete-jit",
+                 root->getName().data());
+    return;
+  }
+
+  legacy::FunctionPassManager passes(module.get());
+  passes.add(createPromoteMemoryToRegisterPass());
+  passes.add(createInstructionCombiningPass());
+  passes.add(createCFGSimplificationPass());
+  passes.doInitialization();
+  for (Function &f : *module)
+    if (!f.isDeclaration())
+      passes.run(f);
+  passes.doFinalization();
+
+  engine->addModule(std::move(module));
+  cf.entry = reinterpret_cast<std::uint64_t (*)(const std::uint64_t *)>(
+      engine->getFunctionAddress(entryName));
+  cf.disabled = !cf.entry;
+}
@@ -0,0 +1,71 @@
+//===-- ConcreteJIT.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CONCRETEJIT_H
+#define KLEE_CONCRETEJIT_H
+
+#include "klee/Expr/Expr.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace llvm {
+class ExecutionEngine;
+class Function;
+} // namespace llvm
+
+namespace klee {
+class ExecutionState;
+class Executor;
+struct KInstruction;
+
+/// Runs calls whose arguments are all concrete as native code.
+///
+/// Once a function has been called often enough with concrete arguments,
+/// it is compiled by the MCJIT together with the functions it calls. The
+/// compiled code reads and writes the memory of the calling state through
+/// callbacks, which give up on symbolic bytes and on accesses the
+/// interpreter would report as errors. Instructions the compiled code does
+/// not handle (floating point, external and recursive calls, escaping
+/// stack objects, ...) and blocks that have not been covered yet give up
+/// as well. Giving up undoes the writes of the call, which is then
+/// interpreted as usual.
+class ConcreteJIT {
+public:
+  struct CompiledFunction;
+
+  explicit ConcreteJIT(Executor &executor);
+  ~ConcreteJIT();
+
+  /// Run the call of f by ki with the given arguments natively if
+  /// possible, executing at most maxInstructions instructions.
+  ///
+  /// \return true if the call completed, in which case its result is bound
+  /// to ki; false if it has to be interpreted, in which case state is
+  /// unchanged.
+  bool executeCall(ExecutionState &state, KInstruction *ki, llvm::Function *f,
+                   const std::vector<ref<Expr>> &arguments,
+                   std::uint64_t maxInstructions);
+
+private:
+  Executor &executor;
+  std::unique_ptr<llvm::ExecutionEngine> engine;
+  std::unordered_map<const llvm::Function *, std::unique_ptr<CompiledFunction>>
+      functions;
+  std::vector<std::uint64_t> argumentValues;
+  unsigned moduleCount = 0;
+
+  /// Compile f, with the functions it calls, into cf.
+  void compile(llvm::Function *f, CompiledFunction &cf);
+};
+} // namespace klee
+
+#endif /* KLEE_CONCRETEJIT_H */
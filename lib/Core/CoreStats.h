@@ -32,6 +32,21 @@ namespace stats {
   /// The number of external calls.
   extern Statistic externalCalls;
 
+  /// The number of instructions evaluated natively on concrete operands,
+  /// one at a time or by --concrete-jit.
+  extern Statistic concreteFastPathInstructions;
+
+  /// The number of states selected by the locality searcher rather than the
+  /// underlying search heuristic.
+  extern Statistic localitySelections;
+
+  /// The number of states merged into another state.
+  extern Statistic mergedStates;
+
+  /// The estimated number of paths that were not explored separately
+  /// because of state merging.
+  extern Statistic mergedPathsSaved;
+
   /// The number of process forks.
   extern Statistic forks;
 
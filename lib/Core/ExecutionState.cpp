@@ -24,8 +24,10 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <cassert>
+#include <cstddef>
 #include <iomanip>
 #include <map>
+#include <memory>
 #include <set>
 #include <sstream>
 #include <stdarg.h>
@@ -50,28 +52,79 @@ std::uint32_t ExecutionState::nextID = 1;
 
 /***/
 
-StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
-  : caller(_caller), kf(_kf), callPathNode(0), 
-    minDistToUncoveredOnReturn(0), varargs(0) {
-  locals = new Cell[kf->numRegisters];
+namespace {
+/// Free lists of register file storage. Size class c holds blocks with room
+/// for 2^c cells; every block is prefixed by a header recording its class.
+class RegisterFilePool {
+  static constexpr unsigned NumSizeClasses = 32;
+  std::vector<void *> freeLists[NumSizeClasses];
+
+  struct Header {
+    alignas(std::max_align_t) unsigned sizeClass;
+  };
+
+public:
+  /// Returns storage for a RegisterFile with numCells cells.
+  void *allocate(unsigned numCells) {
+    unsigned sizeClass = numCells <= 1 ? 0 : 32 - __builtin_clz(numCells - 1);
+    assert(sizeClass < NumSizeClasses);
+    void *block;
+    if (freeLists[sizeClass].empty()) {
+      block = ::operator new(sizeof(Header) + sizeof(RegisterFile) +
+                             (std::size_t(1) << sizeClass) * sizeof(Cell));
+      static_cast<Header *>(block)->sizeClass = sizeClass;
+    } else {
+      block = freeLists[sizeClass].back();
+      freeLists[sizeClass].pop_back();
+    }
+    return static_cast<Header *>(block) + 1;
+  }
+
+  /// Returns storage obtained from allocate() to the pool.
+  void release(void *p) {
+    Header *block = static_cast<Header *>(p) - 1;
+    freeLists[block->sizeClass].push_back(block);
+  }
+};
+
+/// The pool is never destroyed, so that register files outliving static
+/// destruction can still be released.
+RegisterFilePool &getRegisterFilePool() {
+  static RegisterFilePool *pool = new RegisterFilePool();
+  return *pool;
 }
+} // namespace
+
+static_assert(sizeof(RegisterFile) % alignof(Cell) == 0,
+              "cells must be suitably aligned after the register file");
 
-StackFrame::StackFrame(const StackFrame &s) 
-  : caller(s.caller),
-    kf(s.kf),
-    callPathNode(s.callPathNode),
-    allocas(s.allocas),
-    minDistToUncoveredOnReturn(s.minDistToUncoveredOnReturn),
-    varargs(s.varargs) {
-  locals = new Cell[s.kf->numRegisters];
-  for (unsigned i=0; i<s.kf->numRegisters; i++)
-    locals[i] = s.locals[i];
+RegisterFile::RegisterFile(unsigned numCells) : numCells(numCells) {}
+
+RegisterFile *RegisterFile::create(unsigned numCells) {
+  RegisterFile *rf =
+      new (getRegisterFilePool().allocate(numCells)) RegisterFile(numCells);
+  std::uninitialized_value_construct_n(rf->cells(), numCells);
+  return rf;
+}
+
+RegisterFile *RegisterFile::clone() const {
+  RegisterFile *rf =
+      new (getRegisterFilePool().allocate(numCells)) RegisterFile(numCells);
+  std::uninitialized_copy_n(cells(), numCells, rf->cells());
+  return rf;
 }
 
-StackFrame::~StackFrame() { 
-  delete[] locals; 
+RegisterFile::~RegisterFile() { std::destroy_n(cells(), numCells); }
+
+void RegisterFile::operator delete(void *p) {
+  getRegisterFilePool().release(p);
 }
 
+StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
+  : caller(_caller), kf(_kf), callPathNode(0),
+    locals(RegisterFile::create(kf->numRegisters)),
+    minDistToUncoveredOnReturn(0), varargs(0) {}
+
 /***/
 
 ExecutionState::ExecutionState(KFunction *kf, MemoryManager *mm)
@@ -104,11 +157,12 @@ ExecutionState::ExecutionState(const ExecutionState& state):
     constraints(state.constraints),
     pathOS(state.pathOS),
     symPathOS(state.symPathOS),
-    coveredLines(state.coveredLines),
+    coveredInstructions(state.coveredInstructions),
     symbolics(state.symbolics),
     cexPreferences(state.cexPreferences),
     arrayNames(state.arrayNames),
     openMergeStack(state.openMergeStack),
+    mergedPaths(state.mergedPaths),
     steppedInstructions(state.steppedInstructions),
     instsSinceCovNew(state.instsSinceCovNew),
     unwindingInformation(state.unwindingInformation
@@ -128,7 +182,7 @@ ExecutionState *ExecutionState::branch() {
   auto *falseState = new ExecutionState(*this);
   falseState->setID();
   falseState->coveredNew = false;
-  falseState->coveredLines.clear();
+  falseState->coveredInstructions.clear();
 
   return falseState;
 }
@@ -312,13 +366,16 @@ bool ExecutionState::merge(const ExecutionState &b) {
     StackFrame &af = *itA;
     const StackFrame &bf = *itB;
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
-      const ref<Expr> &bv = bf.locals[i].value;
+      const ref<Expr> &av = af.getLocal(i).value;
+      const ref<Expr> &bv = bf.getLocal(i).value;
       if (!av || !bv) {
         // if one is null then by implication (we are at same pc)
         // we cannot reuse this local, so just ignore
-      } else {
-        av = SelectExpr::create(inA, av, bv);
+      } else if (av != bv) {
+        // only registers that differ need an ite, so shared register
+        // files are not copied needlessly
+        ref<Expr> merged = SelectExpr::create(inA, av, bv);
+        af.getWritableLocal(i).value = merged;
       }
     }
   }
@@ -361,7 +418,7 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
     const InstructionInfo &ii = *target->info;
     out << "\t#" << idx++;
     std::stringstream AssStream;
-    AssStream << std::setw(8) << std::setfill('0') << ii.assemblyLine;
+    AssStream << std::setw(8) << std::setfill('0') << ii.getAssemblyLine();
     out << AssStream.str();
     out << " in " << f->getName().str() << "(";
     // Yawn, we could go up and print varargs if we wanted to.
@@ -373,7 +430,7 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
       if (ai->hasName())
         out << ai->getName().str() << "=";
 
-      ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].value;
+      ref<Expr> value = sf.getLocal(sf.kf->getArgRegister(index++)).value;
       if (isa_and_nonnull<ConstantExpr>(value)) {
         out << value;
       } else {
@@ -15,10 +15,12 @@
 #include "MergeHandler.h"
 
 #include "klee/ADT/ImmutableSet.h"
+#include "klee/ADT/PersistentBitSet.h"
 #include "klee/ADT/TreeStream.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/KDAlloc/kdalloc.h"
+#include "klee/Module/Cell.h"
 #include "klee/Module/KInstIterator.h"
 #include "klee/Solver/Solver.h"
 #include "klee/System/Time.h"
@@ -31,7 +33,6 @@
 namespace klee {
 class Array;
 class CallPathNode;
-struct Cell;
 class ExecutionTreeNode;
 struct KFunction;
 struct KInstruction;
@@ -40,13 +41,55 @@ struct InstructionInfo;
 
 llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const MemoryMap &mm);
 
+/// The registers of a stack frame. Register files are reference counted
+/// and shared copy-on-write between the corresponding frames of states
+/// forked from each other, so that a fork does not copy every frame of the
+/// stack; a frame clones its register file on the first write after a fork.
+/// Storage is recycled through free lists bucketed by size class.
+class RegisterFile {
+  unsigned numCells;
+
+  explicit RegisterFile(unsigned numCells);
+  RegisterFile(const RegisterFile &) = delete;
+  RegisterFile &operator=(const RegisterFile &) = delete;
+
+  Cell *cells() { return reinterpret_cast<Cell *>(this + 1); }
+  const Cell *cells() const { return reinterpret_cast<const Cell *>(this + 1); }
+
+public:
+  /// @brief Required by klee::ref-managed objects
+  class ReferenceCounter _refCount;
+
+  /// Creates a register file of numCells empty cells.
+  static RegisterFile *create(unsigned numCells);
+  /// Creates an unshared copy of this register file.
+  RegisterFile *clone() const;
+
+  ~RegisterFile();
+  static void operator delete(void *p);
+
+  bool isShared() { return _refCount.getCount() > 1; }
+  unsigned size() const { return numCells; }
+
+  Cell &operator[](unsigned index) {
+    assert(index < numCells && "register index out of bounds");
+    return cells()[index];
+  }
+  const Cell &operator[](unsigned index) const {
+    assert(index < numCells && "register index out of bounds");
+    return cells()[index];
+  }
+};
+
 struct StackFrame {
   KInstIterator caller;
   KFunction *kf;
   CallPathNode *callPathNode;
 
   std::vector<const MemoryObject *> allocas;
-  Cell *locals;
+  /// Register file; may be shared with frames of other states, so writes
+  /// have to go through getWritableLocal().
+  ref<RegisterFile> locals;
 
   /// Minimum distance to an uncovered instruction once the function
   /// returns. This is not a good place for this but is used to
@@ -63,8 +106,16 @@ struct StackFrame {
   MemoryObject *varargs;
 
   StackFrame(KInstIterator caller, KFunction *kf);
-  StackFrame(const StackFrame &s);
-  ~StackFrame();
+
+  const Cell &getLocal(unsigned index) const { return (*locals)[index]; }
+
+  /// Returns the register at index for writing, first cloning the register
+  /// file if it is shared with another frame.
+  Cell &getWritableLocal(unsigned index) {
+    if (locals->isShared())
+      locals = locals->clone();
+    return (*locals)[index];
+  }
 };
 
 /// Contains information related to unwinding (Itanium ABI/2-Phase unwinding)
@@ -204,8 +255,8 @@ public:
   /// taken to reach/create this state
   TreeOStream symPathOS;
 
-  /// @brief Set containing which lines in which files are covered by this state
-  std::map<const std::string *, std::set<std::uint32_t>> coveredLines;
+  /// @brief Instructions (by InstructionInfo id) first covered by this state
+  PersistentBitSet coveredInstructions;
 
   /// @brief Pointer to the execution tree of the current state
   /// Copies of ExecutionState should not copy executionTreeNode
@@ -226,6 +277,10 @@ public:
   /// @brief The objects handling the klee_open_merge calls this state ran through
   std::vector<ref<MergeHandler>> openMergeStack;
 
+  /// @brief Estimated number of paths this state stands for, as a result of
+  /// merging other states into it
+  std::uint64_t mergedPaths = 1;
+
   /// @brief The numbers of times this state has run through Executor::stepInstruction
   std::uint64_t steppedInstructions = 0;
 
@@ -292,9 +347,18 @@ public:
 };
 
 struct ExecutionStateIDCompare {
+  /// Allows looking up states by ID in containers ordered by ID.
+  using is_transparent = void;
+
   bool operator()(const ExecutionState *a, const ExecutionState *b) const {
     return a->getID() < b->getID();
   }
+  bool operator()(const ExecutionState *a, std::uint32_t id) const {
+    return a->getID() < id;
+  }
+  bool operator()(std::uint32_t id, const ExecutionState *b) const {
+    return id < b->getID();
+  }
 };
 }
 
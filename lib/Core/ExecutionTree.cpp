@@ -16,7 +16,9 @@
 #include "klee/Module/KInstruction.h"
 #include "klee/Support/OptionCategories.h"
 
-#include <bitset>
+#include <algorithm>
+#include <cstddef>
+#include <string>
 #include <vector>
 
 using namespace klee;
@@ -42,6 +44,62 @@ llvm::cl::opt<bool> WriteExecutionTree(
 
 // ExecutionTreeNode
 
+namespace {
+/// Allocates nodes from slabs, keeping one free list per node size.
+class ExecutionTreeNodePool {
+  static constexpr std::size_t Granularity = alignof(ExecutionTreeNode);
+  static constexpr std::size_t NumSizeClasses = 32;
+  static constexpr std::size_t SlabSize = 64 * 1024;
+
+  std::vector<void *> freeLists[NumSizeClasses];
+  char *slabCur = nullptr;
+  char *slabEnd = nullptr;
+
+  static std::size_t sizeClass(std::size_t size) {
+    std::size_t sc = (size + Granularity - 1) / Granularity;
+    assert(sc < NumSizeClasses && "node too large for the pool");
+    return sc;
+  }
+
+public:
+  void *allocate(std::size_t size) {
+    std::size_t sc = sizeClass(size);
+    if (!freeLists[sc].empty()) {
+      void *p = freeLists[sc].back();
+      freeLists[sc].pop_back();
+      return p;
+    }
+    std::size_t bytes = sc * Granularity;
+    if (slabEnd - slabCur < static_cast<std::ptrdiff_t>(bytes)) {
+      slabCur = static_cast<char *>(::operator new(SlabSize));
+      slabEnd = slabCur + SlabSize;
+    }
+    void *p = slabCur;
+    slabCur += bytes;
+    return p;
+  }
+
+  void release(void *p, std::size_t size) {
+    freeLists[sizeClass(size)].push_back(p);
+  }
+};
+
+/// The pool is never destroyed, so that nodes outliving static destruction
+/// can still be released.
+ExecutionTreeNodePool &getNodePool() {
+  static ExecutionTreeNodePool *pool = new ExecutionTreeNodePool();
+  return *pool;
+}
+} // namespace
+
+void *ExecutionTreeNode::operator new(std::size_t size) {
+  return getNodePool().allocate(size);
+}
+
+void ExecutionTreeNode::operator delete(void *p, std::size_t size) {
+  getNodePool().release(p, size);
+}
+
 ExecutionTreeNode::ExecutionTreeNode(ExecutionTreeNode *parent,
                                      ExecutionState *state) noexcept
     : parent{parent}, left{nullptr}, right{nullptr}, state{state} {
@@ -66,8 +124,8 @@ void NoopExecutionTree::dump(llvm::raw_ostream &os) noexcept {
 
 InMemoryExecutionTree::InMemoryExecutionTree(
     ExecutionState &initialState) noexcept {
-  root = ExecutionTreeNodePtr(createNode(nullptr, &initialState));
-  initialState.executionTreeNode = root.getPointer();
+  root = createNode(nullptr, &initialState);
+  initialState.executionTreeNode = root;
 }
 
 ExecutionTreeNode *InMemoryExecutionTree::createNode(ExecutionTreeNode *parent,
@@ -79,56 +137,61 @@ void InMemoryExecutionTree::attach(ExecutionTreeNode *node,
                                    ExecutionState *leftState,
                                    ExecutionState *rightState,
                                    BranchType reason) noexcept {
-  assert(node && !node->left.getPointer() && !node->right.getPointer());
+  assert(node && !node->left && !node->right);
   assert(node == rightState->executionTreeNode &&
          "Attach assumes the right state is the current state");
-  node->left = ExecutionTreeNodePtr(createNode(node, leftState));
-  // The current node inherits the tag
-  uint8_t currentNodeTag = root.getInt();
-  if (node->parent)
-    currentNodeTag = node->parent->left.getPointer() == node
-                         ? node->parent->left.getInt()
-                         : node->parent->right.getInt();
-  node->right =
-      ExecutionTreeNodePtr(createNode(node, rightState), currentNodeTag);
+  node->left = createNode(node, leftState);
+  node->right = createNode(node, rightState);
+  // The current node inherits the owners
+  node->leftOwners = 0;
+  node->rightOwners = owners(node);
   updateBranchingNode(*node, reason);
   node->state = nullptr;
 }
 
 void InMemoryExecutionTree::remove(ExecutionTreeNode *n) noexcept {
-  assert(!n->left.getPointer() && !n->right.getPointer());
+  assert(!n->left && !n->right);
   updateTerminatingNode(*n);
   do {
     ExecutionTreeNode *p = n->parent;
     if (p) {
-      if (n == p->left.getPointer()) {
-        p->left = ExecutionTreeNodePtr(nullptr);
+      if (n == p->left) {
+        p->left = nullptr;
+        p->leftOwners = 0;
       } else {
-        assert(n == p->right.getPointer());
-        p->right = ExecutionTreeNodePtr(nullptr);
+        assert(n == p->right);
+        p->right = nullptr;
+        p->rightOwners = 0;
       }
+    } else {
+      root = nullptr;
+      rootOwners = 0;
     }
     delete n;
     n = p;
-  } while (n && !n->left.getPointer() && !n->right.getPointer());
+  } while (n && !n->left && !n->right);
 
   if (n && CompressExecutionTree) {
     // We are now at a node that has exactly one child; we've just deleted the
     // other one. Eliminate the node and connect its child to the parent
     // directly (if it's not the root).
-    ExecutionTreeNodePtr child = n->left.getPointer() ? n->left : n->right;
+    ExecutionTreeNode *child = n->left ? n->left : n->right;
+    ExecutionTreeOwnerMask childMask = n->left ? n->leftOwners : n->rightOwners;
     ExecutionTreeNode *parent = n->parent;
 
-    child.getPointer()->parent = parent;
+    child->parent = parent;
     if (!parent) {
       // We are at the root
       root = child;
+      rootOwners = childMask;
     } else {
-      if (n == parent->left.getPointer()) {
+      if (n == parent->left) {
         parent->left = child;
+        parent->leftOwners = childMask;
       } else {
-        assert(n == parent->right.getPointer());
+        assert(n == parent->right);
         parent->right = child;
+        parent->rightOwners = childMask;
       }
     }
 
@@ -147,7 +210,14 @@ void InMemoryExecutionTree::dump(llvm::raw_ostream &os) noexcept {
      << "\tnode [style=\"filled\",width=.1,height=.1,fontname=\"Terminus\"]\n"
      << "\tedge [arrowsize=.3]\n";
   std::vector<const ExecutionTreeNode *> stack;
-  stack.push_back(root.getPointer());
+  if (root)
+    stack.push_back(root);
+  auto label = [this](ExecutionTreeOwnerMask mask) {
+    std::string bits;
+    for (unsigned i = std::max(registeredIds, 1u); i-- > 0;)
+      bits += (mask >> i) & 1 ? '1' : '0';
+    return bits;
+  };
   while (!stack.empty()) {
     const ExecutionTreeNode *n = stack.back();
     stack.pop_back();
@@ -155,28 +225,26 @@ void InMemoryExecutionTree::dump(llvm::raw_ostream &os) noexcept {
     if (n->state)
       os << ",fillcolor=green";
     os << "];\n";
-    if (n->left.getPointer()) {
-      os << "\tn" << n << " -> n" << n->left.getPointer() << " [label=0b"
-         << std::bitset<PtrBitCount>(n->left.getInt()).to_string() << "];\n";
-      stack.push_back(n->left.getPointer());
+    if (n->left) {
+      os << "\tn" << n << " -> n" << n->left << " [label=0b"
+         << label(n->leftOwners) << "];\n";
+      stack.push_back(n->left);
     }
-    if (n->right.getPointer()) {
-      os << "\tn" << n << " -> n" << n->right.getPointer() << " [label=0b"
-         << std::bitset<PtrBitCount>(n->right.getInt()).to_string() << "];\n";
-      stack.push_back(n->right.getPointer());
+    if (n->right) {
+      os << "\tn" << n << " -> n" << n->right << " [label=0b"
+         << label(n->rightOwners) << "];\n";
+      stack.push_back(n->right);
     }
   }
   os << "}\n";
 }
 
-std::uint8_t InMemoryExecutionTree::getNextId() noexcept {
-  static_assert(PtrBitCount <= 8);
-  std::uint8_t id = 1 << registeredIds++;
-  if (registeredIds > PtrBitCount) {
-    klee_error("ExecutionTree cannot support more than %d RandomPathSearchers",
-               PtrBitCount);
+ExecutionTreeOwnerMask InMemoryExecutionTree::getNextId() noexcept {
+  if (registeredIds >= MaxExecutionTreeOwners) {
+    klee_error("ExecutionTree cannot support more than %u RandomPathSearchers",
+               MaxExecutionTreeOwners);
   }
-  return id;
+  return ExecutionTreeOwnerMask(1) << registeredIds++;
 }
 
 // PersistentExecutionTree
@@ -184,15 +252,17 @@ std::uint8_t InMemoryExecutionTree::getNextId() noexcept {
 PersistentExecutionTree::PersistentExecutionTree(
     ExecutionState &initialState, InterpreterHandler &ih) noexcept
     : writer(ih.getOutputFilename("exec_tree.db")) {
-  root = ExecutionTreeNodePtr(createNode(nullptr, &initialState));
-  initialState.executionTreeNode = root.getPointer();
+  root = createNode(nullptr, &initialState);
+  initialState.executionTreeNode = root;
 }
 
 void PersistentExecutionTree::dump(llvm::raw_ostream &os) noexcept {
-  writer.batchCommit(true);
+  writer.flush();
   InMemoryExecutionTree::dump(os);
 }
 
+void PersistentExecutionTree::flush() { writer.flush(); }
+
 ExecutionTreeNode *
 PersistentExecutionTree::createNode(ExecutionTreeNode *parent,
                                     ExecutionState *state) {
@@ -212,7 +282,7 @@ void PersistentExecutionTree::updateBranchingNode(ExecutionTreeNode &node,
   const auto &state = *node.state;
   const auto prevPC = state.prevPC;
   annotatedNode->asmLine =
-      prevPC && prevPC->info ? prevPC->info->assemblyLine : 0;
+      prevPC && prevPC->info ? prevPC->info->getAssemblyLine() : 0;
   annotatedNode->kind = reason;
   writer.write(*annotatedNode);
 }
@@ -223,7 +293,7 @@ void PersistentExecutionTree::updateTerminatingNode(ExecutionTreeNode &node) {
   const auto &state = *node.state;
   const auto prevPC = state.prevPC;
   annotatedNode->asmLine =
-      prevPC && prevPC->info ? prevPC->info->assemblyLine : 0;
+      prevPC && prevPC->info ? prevPC->info->getAssemblyLine() : 0;
   annotatedNode->stateID = state.getID();
   writer.write(*annotatedNode);
 }
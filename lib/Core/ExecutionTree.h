@@ -17,9 +17,9 @@
 #include "klee/Expr/Expr.h"
 #include "klee/Support/ErrorHandling.h"
 
-#include "llvm/ADT/PointerIntPair.h"
 #include "llvm/Support/Casting.h"
 
+#include <cstddef>
 #include <cstdint>
 #include <variant>
 
@@ -31,23 +31,25 @@ class InterpreterHandler;
 class ExecutionTreeNode;
 class Searcher;
 
-/* ExecutionTreeNodePtr is used by the Random Path Searcher object to
-efficiently record which ExecutionTreeNode belongs to it. ExecutionTree is a
-global structure that captures all  states, whereas a Random Path Searcher might
-only care about a subset. The integer part of ExecutionTreeNodePtr is a bitmask
-(a "tag") of which Random Path Searchers ExecutionTreeNode belongs to. */
-constexpr std::uint8_t PtrBitCount = 3;
-using ExecutionTreeNodePtr =
-    llvm::PointerIntPair<ExecutionTreeNode *, PtrBitCount, uint8_t>;
+/* A Random Path Searcher only walks the subset of the ExecutionTree that
+belongs to it, since ExecutionTree is a global structure that captures all
+states. Every node records which searchers own its left and its right child in
+two ExecutionTreeOwnerMasks, with one bit per searcher. */
+using ExecutionTreeOwnerMask = std::uint64_t;
+constexpr unsigned MaxExecutionTreeOwners = 64;
 
 class ExecutionTreeNode {
 public:
   enum class NodeType : std::uint8_t { Basic, Annotated };
 
   ExecutionTreeNode *parent{nullptr};
-  ExecutionTreeNodePtr left;
-  ExecutionTreeNodePtr right;
+  ExecutionTreeNode *left{nullptr};
+  ExecutionTreeNode *right{nullptr};
   ExecutionState *state{nullptr};
+  /// Searchers owning the left child
+  ExecutionTreeOwnerMask leftOwners{0};
+  /// Searchers owning the right child
+  ExecutionTreeOwnerMask rightOwners{0};
 
   ExecutionTreeNode(ExecutionTreeNode *parent, ExecutionState *state) noexcept;
   virtual ~ExecutionTreeNode() = default;
@@ -58,6 +60,11 @@ public:
 
   [[nodiscard]] virtual NodeType getType() const { return NodeType::Basic; }
   static bool classof(const ExecutionTreeNode *N) { return true; }
+
+  /// Nodes are carved out of slabs, without per-allocation overhead, so that
+  /// the nodes visited by a random walk are packed densely in memory
+  static void *operator new(std::size_t size);
+  static void operator delete(void *p, std::size_t size);
 };
 
 class AnnotatedExecutionTreeNode : public ExecutionTreeNode {
@@ -100,6 +107,8 @@ public:
   /// Set termination type (on state removal)
   virtual void setTerminationType(ExecutionState &state,
                                   StateTerminationType type){}
+  /// Write out buffered data (e.g. before an early exit)
+  virtual void flush() {}
 
   virtual ~ExecutionTree() = default;
   ExecutionTree(ExecutionTree const &) = delete;
@@ -136,11 +145,13 @@ public:
 /// @brief An in-memory execution tree required by RandomPathSearcher
 class InMemoryExecutionTree : public ExecutionTree {
 public:
-  ExecutionTreeNodePtr root;
+  ExecutionTreeNode *root{nullptr};
 
 private:
   /// Number of registered IDs ("users", e.g. RandomPathSearcher)
-  std::uint8_t registeredIds = 0;
+  unsigned registeredIds = 0;
+  /// Searchers owning the root
+  ExecutionTreeOwnerMask rootOwners = 0;
 
   virtual ExecutionTreeNode *createNode(ExecutionTreeNode *parent,
                                         ExecutionState *state);
@@ -155,9 +166,20 @@ public:
   void attach(ExecutionTreeNode *node, ExecutionState *leftState,
               ExecutionState *rightState, BranchType reason) noexcept override;
   void dump(llvm::raw_ostream &os) noexcept override;
-  std::uint8_t getNextId() noexcept;
+  /// Returns the ownership bit of a new user (e.g. RandomPathSearcher)
+  ExecutionTreeOwnerMask getNextId() noexcept;
   void remove(ExecutionTreeNode *node) noexcept override;
 
+  /// Owners of the root node
+  ExecutionTreeOwnerMask getRootOwners() const { return rootOwners; }
+  /// Owners of node itself, stored in its parent
+  ExecutionTreeOwnerMask &owners(ExecutionTreeNode *node) {
+    ExecutionTreeNode *parent = node->parent;
+    if (!parent)
+      return rootOwners;
+    return parent->left == node ? parent->leftOwners : parent->rightOwners;
+  }
+
   [[nodiscard]] ExecutionTreeType getType() const override {
     return ExecutionTreeType::InMemory;
   };
@@ -185,6 +207,7 @@ public:
   void dump(llvm::raw_ostream &os) noexcept override;
   void setTerminationType(ExecutionState &state,
                           StateTerminationType type) override;
+  void flush() override;
 
   [[nodiscard]] ExecutionTreeType getType() const override {
     return ExecutionTreeType::Persistent;
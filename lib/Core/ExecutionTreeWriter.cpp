@@ -15,12 +15,37 @@
 
 #include "llvm/Support/CommandLine.h"
 
+#include <algorithm>
+
 namespace {
+/// Rows per multi-row INSERT, kept below SQLite's historical limit of 999
+/// parameters per statement
+constexpr unsigned rowsPerInsert = 50;
+constexpr unsigned columns = 6;
+
+constexpr unsigned defaultBatchSize = 100;
+// a full batch of the default size must go through the multi-row statement
+// only, as single-row inserts are only meant for the remainder of a batch
+static_assert(defaultBatchSize % rowsPerInsert == 0,
+              "default batch size must be a multiple of rowsPerInsert");
+
 llvm::cl::opt<unsigned> BatchSize(
-    "exec-tree-batch-size", llvm::cl::init(100U),
+    "exec-tree-batch-size", llvm::cl::init(defaultBatchSize),
     llvm::cl::desc("Number of execution tree nodes to batch for writing, "
                    "see --write-exec-tree (default=100)"),
     llvm::cl::cat(klee::ExecTreeCat));
+
+llvm::cl::opt<bool> WriterThread(
+    "exec-tree-writer-thread", llvm::cl::init(true),
+    llvm::cl::desc("Write execution tree nodes from a background thread, "
+                   "see --write-exec-tree (default=true)"),
+    llvm::cl::cat(klee::ExecTreeCat));
+
+llvm::cl::opt<unsigned> MaxPendingBatches(
+    "exec-tree-max-pending-batches", llvm::cl::init(64U),
+    llvm::cl::desc("Maximum number of execution tree batches waiting to be "
+                   "written before the interpreter blocks (default=64)"),
+    llvm::cl::cat(klee::ExecTreeCat));
 } // namespace
 
 using namespace klee;
@@ -77,6 +102,12 @@ ExecutionTreeWriter::ExecutionTreeWriter(const std::string &dbPath) {
   // - insertStmt
   query = "INSERT INTO nodes VALUES (?, ?, ?, ?, ?, ?);";
   prepare_statement(db, query, &insertStmt);
+  // - multiInsertStmt
+  query = "INSERT INTO nodes VALUES (?, ?, ?, ?, ?, ?)";
+  for (unsigned i = 1; i < rowsPerInsert; ++i)
+    query += ", (?, ?, ?, ?, ?, ?)";
+  query += ";";
+  prepare_statement(db, query, &multiInsertStmt);
   // - transactionBeginStmt
   query = "BEGIN TRANSACTION";
   prepare_statement(db, query, &transactionBeginStmt);
@@ -84,115 +115,168 @@ ExecutionTreeWriter::ExecutionTreeWriter(const std::string &dbPath) {
   query = "COMMIT TRANSACTION";
   prepare_statement(db, query, &transactionCommitStmt);
 
-  // begin transaction
-  if (sqlite3_step(transactionBeginStmt) != SQLITE_DONE) {
-    klee_warning("Execution tree database: cannot begin transaction: %s",
-                 sqlite3_errmsg(db));
-  }
-  if (sqlite3_reset(transactionBeginStmt) != SQLITE_OK) {
-    klee_warning("Execution tree database: cannot reset transaction: %s",
-                 sqlite3_errmsg(db));
-  }
+  batch.reserve(std::min(BatchSize.getValue(), 4096U));
+  // Once the writer thread is started, the connection is only used by it
+  // (and by the destructor after it has finished), which is safe in
+  // SQLite's default serialized mode and in multi-thread mode, but not in a
+  // library built without thread support.
+  if (WriterThread && sqlite3_threadsafe())
+    worker = std::make_unique<WorkerThread>();
 }
 
 ExecutionTreeWriter::~ExecutionTreeWriter() {
-  batchCommit(!flushed);
+  flush();
+  worker.reset();
 
   // finalize prepared statements
   sqlite3_finalize(insertStmt);
+  sqlite3_finalize(multiInsertStmt);
   sqlite3_finalize(transactionBeginStmt);
   sqlite3_finalize(transactionCommitStmt);
 
-  // commit
-  if (sqlite3_exec(db, "END TRANSACTION", nullptr, nullptr, nullptr) !=
-      SQLITE_OK) {
-    klee_warning("Execution tree database: cannot end transaction: %s",
-                 sqlite3_errmsg(db));
-  }
-
   if (sqlite3_close(db) != SQLITE_OK) {
     klee_warning("Execution tree database: cannot close database: %s",
                  sqlite3_errmsg(db));
   }
 }
 
-void ExecutionTreeWriter::batchCommit(bool force) {
-  ++batch;
-  if (batch < BatchSize && !force)
-    return;
+void ExecutionTreeWriter::warn(std::string message) {
+  std::lock_guard<std::mutex> lock(errorMutex);
+  warnings.push_back("Execution tree database: " + std::move(message));
+}
 
-  // commit and begin transaction
-  if (sqlite3_step(transactionCommitStmt) != SQLITE_DONE) {
-    klee_warning("Execution tree database: transaction commit error: %s",
-                 sqlite3_errmsg(db));
+void ExecutionTreeWriter::reportErrors() {
+  std::vector<std::string> pendingWarnings;
+  std::string error;
+  {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    pendingWarnings.swap(warnings);
+    error = fatalError;
   }
+  for (const auto &warning : pendingWarnings)
+    klee_warning("%s", warning.c_str());
+  if (!error.empty()) {
+    // let the writer finish its outstanding batches before exiting
+    worker.reset();
+    klee_error("%s", error.c_str());
+  }
+}
 
-  if (sqlite3_reset(transactionCommitStmt) != SQLITE_OK) {
-    klee_warning("Execution tree database: transaction reset error: %s",
-                 sqlite3_errmsg(db));
+void ExecutionTreeWriter::insert(const std::vector<Record> &records) {
+  {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    if (!fatalError.empty())
+      return;
   }
 
-  if (sqlite3_step(transactionBeginStmt) != SQLITE_DONE) {
-    klee_warning("Execution tree database: transaction begin error: %s",
-                 sqlite3_errmsg(db));
+  if (sqlite3_step(transactionBeginStmt) != SQLITE_DONE)
+    warn(std::string("transaction begin error: ") + sqlite3_errmsg(db));
+
+  if (sqlite3_reset(transactionBeginStmt) != SQLITE_OK)
+    warn(std::string("transaction reset error: ") + sqlite3_errmsg(db));
+
+  std::size_t i = 0;
+  while (i < records.size()) {
+    // full groups of rows go through the multi-row statement, the remainder
+    // row by row
+    sqlite3_stmt *stmt =
+        records.size() - i >= rowsPerInsert ? multiInsertStmt : insertStmt;
+    unsigned rows = stmt == multiInsertStmt ? rowsPerInsert : 1;
+
+    // bind values (SQLITE_OK is defined as 0 - just check success once at
+    // the end)
+    unsigned rc = 0;
+    for (unsigned row = 0; row < rows; ++row) {
+      const Record &r = records[i + row];
+      int param = row * columns;
+      rc |= sqlite3_bind_int64(stmt, param + 1, r.id);
+      rc |= sqlite3_bind_int(stmt, param + 2, r.stateID);
+      rc |= sqlite3_bind_int64(stmt, param + 3, r.leftID);
+      rc |= sqlite3_bind_int64(stmt, param + 4, r.rightID);
+      rc |= sqlite3_bind_int(stmt, param + 5, r.asmLine);
+      rc |= sqlite3_bind_int(stmt, param + 6, r.kind);
+    }
+    if (rc != SQLITE_OK) {
+      // This is either a programming error (e.g. SQLITE_MISUSE) or we ran out
+      // of resources (e.g. SQLITE_NOMEM). Calling sqlite3_errmsg() after a
+      // possible successful call above is undefined, hence no error message
+      // here.
+      // This runs on the writer thread, so the error is reported by
+      // reportErrors() on the interpreter thread.
+      std::lock_guard<std::mutex> lock(errorMutex);
+      fatalError = "Execution tree database: cannot persist data for node: " +
+                   std::to_string(records[i].id);
+      break;
+    }
+
+    // insert
+    if (sqlite3_step(stmt) != SQLITE_DONE)
+      warn("cannot persist data for node: " + std::to_string(records[i].id) +
+           ": " + sqlite3_errmsg(db));
+
+    if (sqlite3_reset(stmt) != SQLITE_OK)
+      warn("error reset node: " + std::to_string(records[i].id) + ": " +
+           sqlite3_errmsg(db));
+
+    i += rows;
   }
 
-  if (sqlite3_reset(transactionBeginStmt) != SQLITE_OK) {
-    klee_warning("Execution tree database: transaction reset error: %s",
-                 sqlite3_errmsg(db));
+  if (sqlite3_step(transactionCommitStmt) != SQLITE_DONE)
+    warn(std::string("transaction commit error: ") + sqlite3_errmsg(db));
+
+  if (sqlite3_reset(transactionCommitStmt) != SQLITE_OK)
+    warn(std::string("transaction reset error: ") + sqlite3_errmsg(db));
+}
+
+void ExecutionTreeWriter::submitBatch() {
+  if (batch.empty())
+    return;
+
+  std::vector<Record> records;
+  records.reserve(std::min(BatchSize.getValue(), 4096U));
+  records.swap(batch);
+
+  if (!worker) {
+    insert(records);
+    reportErrors();
+    return;
   }
 
-  batch = 0;
-  flushed = true;
+  worker->waitForPending(MaxPendingBatches);
+  reportErrors();
+  worker->submit(
+      [this, records = std::move(records)] { insert(records); });
+}
+
+void ExecutionTreeWriter::flush() {
+  submitBatch();
+  if (worker)
+    worker->drain();
+  reportErrors();
 }
 
 void ExecutionTreeWriter::write(const AnnotatedExecutionTreeNode &node) {
-  unsigned rc = 0;
-
-  // bind values (SQLITE_OK is defined as 0 - just check success once at the
-  // end)
-  rc |= sqlite3_bind_int64(insertStmt, 1, node.id);
-  rc |= sqlite3_bind_int(insertStmt, 2, node.stateID);
-  rc |= sqlite3_bind_int64(
-      insertStmt, 3,
-      node.left.getPointer()
-          ? (static_cast<AnnotatedExecutionTreeNode *>(node.left.getPointer()))->id
-          : 0);
-  rc |= sqlite3_bind_int64(
-      insertStmt, 4,
-      node.right.getPointer()
-          ? (static_cast<AnnotatedExecutionTreeNode *>(node.right.getPointer()))->id
-          : 0);
-  rc |= sqlite3_bind_int(insertStmt, 5, node.asmLine);
-  std::uint8_t value{0};
+  Record record;
+  record.id = node.id;
+  record.stateID = node.stateID;
+  record.leftID =
+      node.left ? (static_cast<AnnotatedExecutionTreeNode *>(node.left))->id
+                : 0;
+  record.rightID =
+      node.right ? (static_cast<AnnotatedExecutionTreeNode *>(node.right))->id
+                 : 0;
+  record.asmLine = node.asmLine;
+  record.kind = 0;
   if (std::holds_alternative<BranchType>(node.kind)) {
-    value = static_cast<std::uint8_t>(std::get<BranchType>(node.kind));
+    record.kind = static_cast<std::uint8_t>(std::get<BranchType>(node.kind));
   } else if (std::holds_alternative<StateTerminationType>(node.kind)) {
-    value =
+    record.kind =
         static_cast<std::uint8_t>(std::get<StateTerminationType>(node.kind));
   } else {
     assert(false && "ExecutionTreeWriter: Illegal node kind!");
   }
-  rc |= sqlite3_bind_int(insertStmt, 6, value);
-  if (rc != SQLITE_OK) {
-    // This is either a programming error (e.g. SQLITE_MISUSE) or we ran out of
-    // resources (e.g. SQLITE_NOMEM). Calling sqlite3_errmsg() after a possible
-    // successful call above is undefined, hence no error message here.
-    klee_error("Execution tree database: cannot persist data for node: %u",
-               node.id);
-  }
-
-  // insert
-  if (sqlite3_step(insertStmt) != SQLITE_DONE) {
-    klee_warning(
-        "Execution tree database: cannot persist data for node: %u: %s",
-        node.id, sqlite3_errmsg(db));
-  }
-
-  if (sqlite3_reset(insertStmt) != SQLITE_OK) {
-    klee_warning("Execution tree database: error reset node: %u: %s", node.id,
-                 sqlite3_errmsg(db));
-  }
 
-  batchCommit();
+  batch.push_back(record);
+  if (batch.size() >= BatchSize)
+    submitBatch();
 }
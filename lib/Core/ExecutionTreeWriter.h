@@ -9,27 +9,66 @@
 
 #pragma once
 
+#include "klee/Support/WorkerThread.h"
+
 #include <sqlite3.h>
 
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace klee {
 class AnnotatedExecutionTreeNode;
 
 /// @brief Writes execution tree nodes into an SQLite database
+///
+/// Nodes are copied into a batch on the interpreter thread. Full batches are
+/// inserted by a background thread, each in its own transaction and with
+/// multi-row INSERT statements. The number of batches waiting to be inserted
+/// is bounded; when the writer falls behind, write() blocks.
 class ExecutionTreeWriter {
   friend class PersistentExecutionTree;
 
+  /// A node as stored in the database
+  struct Record {
+    std::uint32_t id;
+    std::uint32_t stateID;
+    std::uint32_t leftID;
+    std::uint32_t rightID;
+    std::uint32_t asmLine;
+    std::uint8_t kind;
+  };
+
   ::sqlite3 *db{nullptr};
   ::sqlite3_stmt *insertStmt{nullptr};
+  /// Inserts rowsPerInsert rows at once
+  ::sqlite3_stmt *multiInsertStmt{nullptr};
   ::sqlite3_stmt *transactionBeginStmt{nullptr};
   ::sqlite3_stmt *transactionCommitStmt{nullptr};
-  std::uint32_t batch{0};
-  bool flushed{true};
+  /// Nodes not yet handed to the writer thread
+  std::vector<Record> batch;
+  /// Inserts batches, null if --exec-tree-writer-thread=false or SQLite
+  /// was built without thread support
+  std::unique_ptr<WorkerThread> worker;
+
+  /// Problems hit by insert(), which must not call klee_warning() or
+  /// klee_error() from the writer thread
+  std::mutex errorMutex;
+  std::vector<std::string> warnings;
+  /// Set when a batch could not be stored; later batches are dropped
+  std::string fatalError;
 
-  /// Writes nodes in batches
-  void batchCommit(bool force = false);
+  /// Inserts records in one transaction (on the writer thread)
+  void insert(const std::vector<Record> &records);
+  /// Records a warning for reportErrors() (on the writer thread)
+  void warn(std::string message);
+  /// Prints the warnings recorded by insert() and exits if it failed (on
+  /// the interpreter thread)
+  void reportErrors();
+  /// Hands the current batch to the writer thread
+  void submitBatch();
 
 public:
   explicit ExecutionTreeWriter(const std::string &dbPath);
@@ -41,6 +80,8 @@ public:
 
   /// Write new node into database
   void write(const AnnotatedExecutionTreeNode &node);
+  /// Write all nodes passed to write() so far and wait until they are stored
+  void flush();
 };
 
 } // namespace klee
@@ -10,6 +10,7 @@
 #include "Executor.h"
 
 #include "AddressSpace.h"
+#include "ConcreteJIT.h"
 #include "Context.h"
 #include "CoreStats.h"
 #include "ExecutionState.h"
@@ -21,6 +22,7 @@
 #include "ImpliedValue.h"
 #include "Memory.h"
 #include "MemoryManager.h"
+#include "SearchLog.h"
 #include "Searcher.h"
 #include "SeedInfo.h"
 #include "SpecialFunctionHandler.h"
@@ -77,6 +79,7 @@
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Process.h"
+#include "llvm/Support/SwapByteOrder.h"
 #include "llvm/Support/TypeSize.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -136,6 +139,29 @@ cl::opt<bool> SingleObjectResolution(
 
 namespace {
 
+/*** Misc options ***/
+
+cl::opt<bool> ConcreteFastPath(
+    "concrete-fast-path", cl::init(true),
+    cl::desc("Evaluate integer arithmetic, comparisons and casts on concrete "
+             "operands of at most 64 bits natively instead of through the "
+             "expression builder (default=true)"),
+    cl::cat(MiscCat));
+
+cl::opt<bool> UseConcreteJIT(
+    "concrete-jit", cl::init(false),
+    cl::desc("Run frequently called functions natively, compiled by the JIT, "
+             "when their arguments are concrete. Calls fall back to the "
+             "interpreter on touching symbolic memory (default=false)"),
+    cl::cat(MiscCat));
+
+cl::opt<bool> LazyGlobalInit(
+    "lazy-global-init", cl::init(true),
+    cl::desc("Fill in the contents of global variables from their "
+             "initializers on first access instead of at startup "
+             "(default=true)"),
+    cl::cat(MiscCat));
+
 /*** Test generation options ***/
 
 cl::opt<bool> DumpStatesOnHalt(
@@ -467,6 +493,19 @@ cl::opt<bool> DebugCompressInstructions(
     cl::cat(DebugCat));
 #endif
 
+cl::opt<std::string> RecordSearchLog(
+    "record-search-log",
+    cl::desc("Record the states selected by the searcher and the outcome of "
+             "every fork to the given file (off by default)"),
+    cl::value_desc("file"), cl::cat(DebugCat));
+
+cl::opt<std::string> ReplaySearchLog(
+    "replay-search-log",
+    cl::desc("Replay the state selections of a log written by "
+             "--record-search-log, and stop with an error at the first "
+             "divergence (off by default)"),
+    cl::value_desc("file"), cl::cat(DebugCat));
+
 cl::opt<bool> DebugCheckForImpliedValues(
     "debug-check-for-implied-values", cl::init(false),
     cl::desc("Debug the implied value optimization"),
@@ -538,6 +577,14 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
                  error.c_str());
     }
   }
+
+  if (!RecordSearchLog.empty() && !ReplaySearchLog.empty())
+    klee_error("--record-search-log and --replay-search-log are mutually "
+               "exclusive");
+  if (!RecordSearchLog.empty())
+    searchLog = SearchLog::record(RecordSearchLog);
+  else if (!ReplaySearchLog.empty())
+    searchLog = SearchLog::replay(ReplaySearchLog);
 }
 
 llvm::Module *
@@ -560,42 +607,52 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
     klee_error("Could not load KLEE intrinsic file %s", LibPath.c_str());
   }
 
-  // 1.) Link the modules together
-  while (kmodule->link(modules, opts.EntryPoint)) {
-    // 2.) Apply different instrumentation
-    kmodule->instrument(opts);
-  }
+  specialFunctionHandler = new SpecialFunctionHandler(*this);
 
-  // 3.) Optimise and prepare for KLEE
+  // A cached module has already been through steps 1.) to 3.)
+  if (!kmodule->loadFromCache(modules, opts)) {
+    // 1.) Link the modules together
+    while (kmodule->link(modules, opts.EntryPoint)) {
+      // 2.) Apply different instrumentation
+      kmodule->instrument(opts);
+    }
 
-  // Create a list of functions that should be preserved if used
-  std::vector<const char *> preservedFunctions;
-  specialFunctionHandler = new SpecialFunctionHandler(*this);
-  specialFunctionHandler->prepare(preservedFunctions);
+    // 3.) Optimise and prepare for KLEE
 
-  preservedFunctions.push_back(opts.EntryPoint.c_str());
+    // Create a list of functions that should be preserved if used
+    std::vector<const char *> preservedFunctions;
+    specialFunctionHandler->prepare(preservedFunctions);
 
-  // Preserve the free-standing library calls
-  preservedFunctions.push_back("memset");
-  preservedFunctions.push_back("memcpy");
-  preservedFunctions.push_back("memcmp");
-  preservedFunctions.push_back("memmove");
+    preservedFunctions.push_back(opts.EntryPoint.c_str());
 
-  kmodule->optimiseAndPrepare(opts, preservedFunctions);
-  kmodule->checkModule();
+    // Preserve the free-standing library calls
+    preservedFunctions.push_back("memset");
+    preservedFunctions.push_back("memcpy");
+    preservedFunctions.push_back("memcmp");
+    preservedFunctions.push_back("memmove");
+
+    kmodule->optimiseAndPrepare(opts, preservedFunctions);
+    kmodule->checkModule();
+    kmodule->storeInCache();
+  }
 
   // 4.) Manifest the module
   kmodule->manifest(interpreterHandler, StatsTracker::useStatistics());
 
   specialFunctionHandler->bind();
 
-  if (StatsTracker::useStatistics() || userSearcherRequiresMD2U()) {
+  if (StatsTracker::useStatistics() || StatsTracker::useMetrics() ||
+      userSearcherRequiresMD2U()) {
     statsTracker = 
       new StatsTracker(*this,
                        interpreterHandler->getOutputFilename("assembly.ll"),
                        userSearcherRequiresMD2U());
   }
 
+  // Instruction traces need every instruction to be interpreted
+  if (UseConcreteJIT && DebugPrintInstructions.getBits() == 0)
+    concreteJIT = std::make_unique<ConcreteJIT>(*this);
+
   // Initialize the context.
   DataLayout *TD = kmodule->targetData.get();
   Context::initialize(TD->isLittleEndian(),
@@ -612,16 +669,14 @@ Executor::~Executor() {
 
 /***/
 
-void Executor::initializeGlobalObject(ExecutionState &state, ObjectState *os,
-                                      const Constant *c, 
+void Executor::initializeGlobalObject(ObjectState *os, const Constant *c,
                                       unsigned offset) {
   const auto targetData = kmodule->targetData.get();
   if (const ConstantVector *cp = dyn_cast<ConstantVector>(c)) {
     unsigned elementSize =
       targetData->getTypeStoreSize(cp->getType()->getElementType());
     for (unsigned i=0, e=cp->getNumOperands(); i != e; ++i)
-      initializeGlobalObject(state, os, cp->getOperand(i), 
-			     offset + i*elementSize);
+      initializeGlobalObject(os, cp->getOperand(i), offset + i*elementSize);
   } else if (isa<ConstantAggregateZero>(c)) {
     unsigned i, size = targetData->getTypeStoreSize(c->getType());
     for (i=0; i<size; i++)
@@ -630,20 +685,26 @@ void Executor::initializeGlobalObject(ExecutionState &state, ObjectState *os,
     unsigned elementSize =
       targetData->getTypeStoreSize(ca->getType()->getElementType());
     for (unsigned i=0, e=ca->getNumOperands(); i != e; ++i)
-      initializeGlobalObject(state, os, ca->getOperand(i), 
-			     offset + i*elementSize);
+      initializeGlobalObject(os, ca->getOperand(i), offset + i*elementSize);
   } else if (const ConstantStruct *cs = dyn_cast<ConstantStruct>(c)) {
     const StructLayout *sl =
       targetData->getStructLayout(cast<StructType>(cs->getType()));
     for (unsigned i=0, e=cs->getNumOperands(); i != e; ++i)
-      initializeGlobalObject(state, os, cs->getOperand(i), 
-			     offset + sl->getElementOffset(i));
+      initializeGlobalObject(os, cs->getOperand(i),
+                             offset + sl->getElementOffset(i));
   } else if (const ConstantDataSequential *cds =
                dyn_cast<ConstantDataSequential>(c)) {
+    if (targetData->isLittleEndian() == sys::IsLittleEndianHost) {
+      // The raw data is the elements' in-memory representation.
+      StringRef data = cds->getRawDataValues();
+      for (unsigned i=0, e=data.size(); i != e; ++i)
+        os->write8(offset + i, static_cast<uint8_t>(data[i]));
+      return;
+    }
     unsigned elementSize =
       targetData->getTypeStoreSize(cds->getElementType());
     for (unsigned i=0, e=cds->getNumElements(); i != e; ++i)
-      initializeGlobalObject(state, os, cds->getElementAsConstant(i),
+      initializeGlobalObject(os, cds->getElementAsConstant(i),
                              offset + i*elementSize);
   } else if (!isa<UndefValue>(c) && !isa<MetadataAsValue>(c)) {
     unsigned StoreBits = targetData->getTypeStoreSizeInBits(c->getType());
@@ -658,6 +719,81 @@ void Executor::initializeGlobalObject(ExecutionState &state, ObjectState *os,
   }
 }
 
+/// Returns whether v, the address of a global or derived from it, may be
+/// used other than to load from or store to it, so that code outside of
+/// KLEE may learn it.
+static bool isAddressTaken(const Value *v) {
+  for (const User *u : v->users()) {
+    if (isa<LoadInst>(u))
+      continue;
+    if (const auto *si = dyn_cast<StoreInst>(u)) {
+      if (si->getValueOperand() == v)
+        return true;
+      continue;
+    }
+    if (isa<GEPOperator>(u) || isa<BitCastOperator>(u)) {
+      if (isAddressTaken(u))
+        return true;
+      continue;
+    }
+    return true;
+  }
+  return false;
+}
+
+Executor::GlobalInitializer::~GlobalInitializer() {
+  if (image)
+    munmap(image, imageSize);
+}
+
+void Executor::GlobalInitializer::prepare() {
+  if (prepared)
+    return;
+  prepared = true;
+
+  for (const GlobalVariable &v : executor.kmodule->module->globals()) {
+    if (v.isDeclaration() || !v.hasInitializer())
+      continue;
+    const MemoryObject *mo = executor.globalObjects.find(&v)->second;
+    if (!isAddressTaken(&v))
+      unreachable.insert(mo);
+    if (v.isConstant() && mo->size) {
+      imageOffsets.emplace(mo, imageSize);
+      imageSize += (mo->size + 7) & ~std::size_t(7);
+    }
+  }
+
+  if (!imageSize)
+    return;
+  void *base = mmap(nullptr, imageSize, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (base == MAP_FAILED) {
+    klee_warning("Cannot map the image of read-only globals, allocating "
+                 "them one by one (%s)",
+                 strerror(errno));
+    imageOffsets.clear();
+    imageSize = 0;
+    return;
+  }
+  image = static_cast<std::uint8_t *>(base);
+}
+
+void Executor::GlobalInitializer::initialize(ObjectState &os) const {
+  const auto *v = cast<GlobalVariable>(os.getObject()->allocSite);
+  executor.initializeGlobalObject(&os, v->getInitializer(), 0);
+}
+
+std::uint8_t *
+Executor::GlobalInitializer::getReadOnlyStore(const ObjectState &os) const {
+  auto it = imageOffsets.find(os.getObject());
+  return it != imageOffsets.end() ? image + it->second : nullptr;
+}
+
+bool Executor::GlobalInitializer::isReachableExternally(
+    const MemoryObject *mo) const {
+  return !unreachable.count(mo);
+}
+
 MemoryObject * Executor::addExternalObject(ExecutionState &state, 
                                            void *addr, unsigned size, 
                                            bool isReadOnly) {
@@ -842,6 +978,17 @@ void Executor::initializeGlobalObjects(ExecutionState &state) {
 
   for (const GlobalVariable &v : m->globals()) {
     MemoryObject *mo = globalObjects.find(&v)->second;
+
+    if (LazyGlobalInit && !v.isDeclaration() && v.hasInitializer()) {
+      // Constants are copied out to their own memory, where external calls
+      // can see them, once they are initialized.
+      globalInitializer.prepare();
+      auto os = new ObjectState(mo, &globalInitializer);
+      state.addressSpace.bindObject(mo, os);
+      os->setReadOnly(v.isConstant());
+      continue;
+    }
+
     ObjectState *os = bindObjectInState(state, mo, false);
 
     if (v.isDeclaration() && mo->size) {
@@ -861,7 +1008,7 @@ void Executor::initializeGlobalObjects(ExecutionState &state) {
         os->write8(offset, static_cast<unsigned char *>(addr)[offset]);
       }
     } else if (v.hasInitializer()) {
-      initializeGlobalObject(state, os, v.getInitializer(), 0);
+      initializeGlobalObject(os, v.getInitializer(), 0);
       if (v.isConstant()) {
         os->setReadOnly(true);
         // initialise constant memory that may be used with external calls
@@ -895,6 +1042,15 @@ bool Executor::branchingPermitted(const ExecutionState &state) const {
   return true;
 }
 
+unsigned Executor::getForkChoice(unsigned bound) {
+  unsigned value = theRNG.getInt32() % bound;
+  // searchers draw from theRNG as well, so a replay under another searcher
+  // must take the choice from the log
+  if (!searchLog || bound == 1)
+    return value;
+  return searchLog->choose(value, bound);
+}
+
 void Executor::branch(ExecutionState &state,
                       const std::vector<ref<Expr>> &conditions,
                       std::vector<ExecutionState *> &result,
@@ -904,7 +1060,7 @@ void Executor::branch(ExecutionState &state,
   assert(N);
 
   if (!branchingPermitted(state)) {
-    unsigned next = theRNG.getInt32() % N;
+    unsigned next = getForkChoice(N);
     for (unsigned i=0; i<N; ++i) {
       if (i == next) {
         result.push_back(&state);
@@ -920,11 +1076,14 @@ void Executor::branch(ExecutionState &state,
     // XXX do proper balance or keep random?
     result.push_back(&state);
     for (unsigned i=1; i<N; ++i) {
-      ExecutionState *es = result[theRNG.getInt32() % i];
+      ExecutionState *es = result[getForkChoice(i)];
       ExecutionState *ns = es->branch();
       addedStates.push_back(ns);
       result.push_back(ns);
       executionTree->attach(es->executionTreeNode, ns, es, reason);
+      if (searchLog)
+        searchLog->fork(es->getID(), SearchLog::ForkOutcome::Both,
+                        ns->getID());
     }
   }
 
@@ -932,37 +1091,42 @@ void Executor::branch(ExecutionState &state,
   // states if necessary due to OnlyReplaySeeds (inefficient but
   // simple).
   
-  std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
-    seedMap.find(&state);
+  auto it = seedMap.find(&state);
   if (it != seedMap.end()) {
-    std::vector<SeedInfo> seeds = it->second;
-    seedMap.erase(it);
+    std::vector<SeedInfo> seeds = seedMap.take(it);
 
     // Assume each seed only satisfies one condition (necessarily true
     // when conditions are mutually exclusive and their conjunction is
     // a tautology).
-    for (std::vector<SeedInfo>::iterator siit = seeds.begin(), 
-           siie = seeds.end(); siit != siie; ++siit) {
-      unsigned i;
-      for (i=0; i<N; ++i) {
-        ref<ConstantExpr> res;
-        bool success = solver->getValue(
-            state.constraints, siit->assignment.evaluate(conditions[i]), res,
-            state.queryMetaData);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
+    std::vector<unsigned> satisfied(seeds.size(), N);
+    for (unsigned i = 0; i < N; ++i) {
+      std::vector<ref<Expr>> values = evaluateSeeds(seeds, conditions[i]);
+      for (std::size_t j = 0; j < seeds.size(); ++j) {
+        if (satisfied[j] != N)
+          continue;
+        ref<ConstantExpr> res = dyn_cast<ConstantExpr>(values[j]);
+        if (!res) {
+          bool success = solver->getValue(state.constraints, values[j], res,
+                                          state.queryMetaData);
+          assert(success && "FIXME: Unhandled solver failure");
+          (void) success;
+        }
         if (res->isTrue())
-          break;
+          satisfied[j] = i;
       }
-      
+    }
+
+    for (std::size_t j = 0; j < seeds.size(); ++j) {
+      unsigned i = satisfied[j];
+
       // If we didn't find a satisfying condition randomly pick one
       // (the seed will be patched).
       if (i==N)
-        i = theRNG.getInt32() % N;
+        i = getForkChoice(N);
 
       // Extra check in case we're replaying seeds with a max-fork
       if (result[i])
-        seedMap[result[i]].push_back(*siit);
+        seedMap.add(result[i], std::move(seeds[j]));
     }
 
     if (OnlyReplaySeeds) {
@@ -1039,13 +1203,17 @@ ref<Expr> Executor::maxStaticPctChecks(ExecutionState &current,
 Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
                                    bool isInternal, BranchType reason) {
   Solver::Validity res;
-  std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
-    seedMap.find(&current);
+  auto it = seedMap.find(&current);
   bool isSeeding = it != seedMap.end();
 
   if (!isSeeding)
     condition = maxStaticPctChecks(current, condition);
 
+  // branches on concrete conditions are deterministic and not logged, so
+  // that concrete loops do not flood the search log
+  SearchLog *forkLog =
+      isa<ConstantExpr>(condition) ? nullptr : searchLog.get();
+
   time::Span timeout = coreSolverTimeout;
   if (isSeeding)
     timeout *= static_cast<unsigned>(it->second.size());
@@ -1054,6 +1222,8 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
                                   current.queryMetaData);
   solver->setTimeout(time::Span());
   if (!success) {
+    if (forkLog)
+      forkLog->fork(current.getID(), SearchLog::ForkOutcome::Failed);
     current.pc = current.prevPC;
     terminateStateOnSolverError(current, "Query timed out (fork).");
     return StatePair(nullptr, nullptr);
@@ -1084,7 +1254,10 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
       
       if (!branchingPermitted(current)) {
         TimerStatIncrementer timer(stats::forkTime);
-        if (theRNG.getBool()) {
+        bool takeTrue = theRNG.getBool();
+        if (searchLog)
+          takeTrue = searchLog->choose(takeTrue, 2);
+        if (takeTrue) {
           addConstraint(current, condition);
           res = Solver::True;        
         } else {
@@ -1103,14 +1276,7 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
       res == Solver::Unknown) {
     bool trueSeed=false, falseSeed=false;
     // Is seed extension still ok here?
-    for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
-           siie = it->second.end(); siit != siie; ++siit) {
-      ref<ConstantExpr> res;
-      bool success = solver->getValue(current.constraints,
-                                      siit->assignment.evaluate(condition), res,
-                                      current.queryMetaData);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
+    for (const auto &res : getSeedValues(current, it->second, condition)) {
       if (res->isTrue()) {
         trueSeed = true;
       } else {
@@ -1138,17 +1304,21 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
   if (res==Solver::True) {
     if (!isInternal) {
       if (pathWriter) {
-        current.pathOS << "1";
+        current.pathOS.writeBranch(true);
       }
     }
+    if (forkLog)
+      forkLog->fork(current.getID(), SearchLog::ForkOutcome::True);
 
     return StatePair(&current, nullptr);
   } else if (res==Solver::False) {
     if (!isInternal) {
       if (pathWriter) {
-        current.pathOS << "0";
+        current.pathOS.writeBranch(false);
       }
     }
+    if (forkLog)
+      forkLog->fork(current.getID(), SearchLog::ForkOutcome::False);
 
     return StatePair(nullptr, &current);
   } else {
@@ -1161,57 +1331,45 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
     addedStates.push_back(falseState);
 
     if (it != seedMap.end()) {
-      std::vector<SeedInfo> seeds = it->second;
-      it->second.clear();
-      std::vector<SeedInfo> &trueSeeds = seedMap[trueState];
-      std::vector<SeedInfo> &falseSeeds = seedMap[falseState];
-      for (std::vector<SeedInfo>::iterator siit = seeds.begin(), 
-             siie = seeds.end(); siit != siie; ++siit) {
-        ref<ConstantExpr> res;
-        bool success = solver->getValue(current.constraints,
-                                        siit->assignment.evaluate(condition),
-                                        res, current.queryMetaData);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
-        if (res->isTrue()) {
-          trueSeeds.push_back(*siit);
-        } else {
-          falseSeeds.push_back(*siit);
-        }
-      }
-      
+      std::vector<SeedInfo> seeds = seedMap.take(it);
+      std::vector<ref<ConstantExpr>> values =
+          getSeedValues(current, seeds, condition);
+      for (std::size_t i = 0; i < seeds.size(); ++i)
+        seedMap.add(values[i]->isTrue() ? trueState : falseState,
+                    std::move(seeds[i]));
+
       bool swapInfo = false;
-      if (trueSeeds.empty()) {
-        if (&current == trueState) swapInfo = true;
-        seedMap.erase(trueState);
-      }
-      if (falseSeeds.empty()) {
-        if (&current == falseState) swapInfo = true;
-        seedMap.erase(falseState);
-      }
+      if (!seedMap.count(trueState) && &current == trueState)
+        swapInfo = true;
+      if (!seedMap.count(falseState) && &current == falseState)
+        swapInfo = true;
       if (swapInfo) {
         std::swap(trueState->coveredNew, falseState->coveredNew);
-        std::swap(trueState->coveredLines, falseState->coveredLines);
+        std::swap(trueState->coveredInstructions,
+                  falseState->coveredInstructions);
       }
     }
 
     executionTree->attach(current.executionTreeNode, falseState, trueState, reason);
     stats::incBranchStat(reason, 1);
+    if (forkLog)
+      forkLog->fork(current.getID(), SearchLog::ForkOutcome::Both,
+                    falseState->getID());
 
     if (pathWriter) {
       // Need to update the pathOS.id field of falseState, otherwise the same id
       // is used for both falseState and trueState.
       falseState->pathOS = pathWriter->open(current.pathOS);
       if (!isInternal) {
-        trueState->pathOS << "1";
-        falseState->pathOS << "0";
+        trueState->pathOS.writeBranch(true);
+        falseState->pathOS.writeBranch(false);
       }
     }
     if (symPathWriter) {
       falseState->symPathOS = symPathWriter->open(current.symPathOS);
       if (!isInternal) {
-        trueState->symPathOS << "1";
-        falseState->symPathOS << "0";
+        trueState->symPathOS.writeBranch(true);
+        falseState->symPathOS.writeBranch(false);
       }
     }
 
@@ -1229,6 +1387,73 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
   }
 }
 
+void Executor::openAutoMerge(KInstruction *ki,
+                             const std::vector<ExecutionState *> &branches) {
+  // Merged states cannot follow a seed, a replayed test or path.
+  if (!mergingSearcher || !seedMap.empty() || replayKTest || replayPath)
+    return;
+
+  std::vector<ExecutionState *> forked;
+  for (ExecutionState *es : branches)
+    if (es)
+      forked.push_back(es);
+  if (forked.size() < 2)
+    return;
+
+  KFunction *kf = forked.front()->stack.back().kf;
+  auto it = kf->mergePoints.find(ki);
+  if (it == kf->mergePoints.end())
+    return;
+
+  // The states already share a merge with the same close point, e.g. the
+  // one opened by the first condition of a short-circuit '&&'.
+  const auto &stack = forked.front()->openMergeStack;
+  if (!stack.empty() &&
+      stack.back()->closesAt(it->second, forked.front()->stack.size()))
+    return;
+
+  ref<MergeHandler> handler(new MergeHandler(this, *forked.front(), it->second));
+  for (ExecutionState *es : forked) {
+    es->openMergeStack.push_back(handler);
+    handler->addOpenState(es);
+  }
+}
+
+bool Executor::closeAutoMerge(ExecutionState &state) {
+  if (state.openMergeStack.empty() ||
+      !state.openMergeStack.back()->reachedClosePoint(state))
+    return false;
+
+  assert(mergingSearcher->inCloseMerge.find(&state) ==
+             mergingSearcher->inCloseMerge.end() &&
+         "State cannot run into close_merge while being closed");
+  mergingSearcher->inCloseMerge.insert(&state);
+  state.openMergeStack.back()->addClosedState(&state, state.pc->inst);
+  state.openMergeStack.pop_back();
+  return true;
+}
+
+std::vector<ref<klee::ConstantExpr>>
+Executor::getSeedValues(ExecutionState &state,
+                        const std::vector<SeedInfo> &seeds, ref<Expr> e) {
+  std::vector<ref<klee::ConstantExpr>> result;
+  result.reserve(seeds.size());
+  for (const ref<Expr> &value : evaluateSeeds(seeds, e)) {
+    if (auto CE = dyn_cast<ConstantExpr>(value)) {
+      result.push_back(CE);
+      continue;
+    }
+    ref<ConstantExpr> res;
+    bool success = solver->getValue(state.constraints,
+                                    optimizer.optimizeExpr(value, true), res,
+                                    state.queryMetaData);
+    assert(success && "FIXME: Unhandled solver failure");
+    (void) success;
+    result.push_back(res);
+  }
+  return result;
+}
+
 void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(condition)) {
     if (!CE->isTrue())
@@ -1237,20 +1462,22 @@ void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
   }
 
   // Check to see if this constraint violates seeds.
-  std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
-    seedMap.find(&state);
+  auto it = seedMap.find(&state);
   if (it != seedMap.end()) {
     bool warn = false;
-    for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
-           siie = it->second.end(); siit != siie; ++siit) {
+    std::vector<ref<Expr>> values = evaluateSeeds(it->second, condition);
+    for (std::size_t i = 0; i < values.size(); ++i) {
       bool res;
-      bool success = solver->mustBeFalse(state.constraints,
-                                         siit->assignment.evaluate(condition),
-                                         res, state.queryMetaData);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
+      if (const auto *CE = dyn_cast<ConstantExpr>(values[i])) {
+        res = CE->isFalse();
+      } else {
+        bool success = solver->mustBeFalse(state.constraints, values[i], res,
+                                           state.queryMetaData);
+        assert(success && "FIXME: Unhandled solver failure");
+        (void) success;
+      }
       if (res) {
-        siit->patchSeed(state, condition, solver.get());
+        it->second[i].patchSeed(state, condition, solver.get());
         warn = true;
       }
     }
@@ -1279,7 +1506,7 @@ const Cell& Executor::eval(KInstruction *ki, unsigned index,
   } else {
     unsigned index = vnumber;
     StackFrame &sf = state.stack.back();
-    return sf.locals[index];
+    return sf.getLocal(index);
   }
 }
 
@@ -1354,8 +1581,7 @@ ref<klee::ConstantExpr> Executor::getValueFromSeeds(ExecutionState &state,
   if (found == seedMap.end())
     return nullptr;
 
-  auto seeds = found->second;
-  for (auto const &seed : seeds) {
+  for (auto const &seed : found->second) {
     auto value = seed.assignment.evaluate(e);
     if (isa<ConstantExpr>(value))
       return value;
@@ -1367,8 +1593,7 @@ void Executor::executeGetValue(ExecutionState &state,
                                ref<Expr> e,
                                KInstruction *target) {
   e = ConstraintManager::simplifyExpr(state.constraints, e);
-  std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
-    seedMap.find(&state);
+  auto it = seedMap.find(&state);
   if (it==seedMap.end() || isa<ConstantExpr>(e)) {
     ref<ConstantExpr> value;
     e = optimizer.optimizeExpr(e, true);
@@ -1378,18 +1603,9 @@ void Executor::executeGetValue(ExecutionState &state,
     (void) success;
     bindLocal(target, state, value);
   } else {
-    std::set< ref<Expr> > values;
-    for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
-           siie = it->second.end(); siit != siie; ++siit) {
-      ref<Expr> cond = siit->assignment.evaluate(e);
-      cond = optimizer.optimizeExpr(cond, true);
-      ref<ConstantExpr> value;
-      bool success =
-          solver->getValue(state.constraints, cond, value, state.queryMetaData);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
-      values.insert(value);
-    }
+    std::vector<ref<ConstantExpr>> seedValues =
+        getSeedValues(state, it->second, e);
+    std::set< ref<Expr> > values(seedValues.begin(), seedValues.end());
     
     std::vector< ref<Expr> > conditions;
     for (std::set< ref<Expr> >::iterator vit = values.begin(), 
@@ -1433,7 +1649,7 @@ void Executor::printDebugInstructions(ExecutionState &state) {
     (*stream) << "     " << state.pc->getSourceLocation() << ':';
   }
 
-  (*stream) << state.pc->info->assemblyLine << ':' << state.getID();
+  (*stream) << state.pc->info->getAssemblyLine() << ':' << state.getID();
 
   if (DebugPrintInstructions.isSet(STDERR_ALL) ||
       DebugPrintInstructions.isSet(FILE_ALL))
@@ -1646,7 +1862,7 @@ void Executor::unwindToNextLandingpad(ExecutionState &state) {
 
         llvm::Function *personality_fn =
             kmodule->module->getFunction("_klee_eh_cxx_personality");
-        KFunction *kf = kmodule->functionMap[personality_fn];
+        KFunction *kf = getKFunction(personality_fn);
 
         state.pushFrame(state.prevPC, kf);
         state.pc = kf->instructions;
@@ -1715,7 +1931,7 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
     switch (f->getIntrinsicID()) {
     case Intrinsic::not_intrinsic: {
       // state may be destroyed by this call, cannot touch
-      callExternalFunction(state, ki, kmodule->functionMap[f], arguments);
+      callExternalFunction(state, ki, getKFunction(f), arguments);
       break;
     }
     case Intrinsic::fabs: {
@@ -1930,6 +2146,17 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
       transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
     }
   } else {
+    if (concreteJIT) {
+      // Leave the interpreter to reach --max-instructions
+      std::uint64_t maxInstructions = std::numeric_limits<std::uint64_t>::max();
+      if (MaxInstructions)
+        maxInstructions = MaxInstructions > stats::instructions.getValue()
+                              ? MaxInstructions - stats::instructions - 1
+                              : 0;
+      if (concreteJIT->executeCall(state, ki, f, arguments, maxInstructions))
+        return;
+    }
+
     // Check if maximum stack size was reached.
     // We currently only count the number of stack frames
     if (RuntimeMaxStackFrames && state.stack.size() > RuntimeMaxStackFrames) {
@@ -1942,7 +2169,7 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
     // guess. This just done to avoid having to pass KInstIterator everywhere
     // instead of the actual instruction, since we can't make a KInstIterator
     // from just an instruction (unlike LLVM).
-    KFunction *kf = kmodule->functionMap[f];
+    KFunction *kf = getKFunction(f);
 
     state.pushFrame(state.prevPC, kf);
     state.pc = kf->instructions;
@@ -2086,6 +2313,13 @@ void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src,
   }
 }
 
+void Executor::transferToSuccessor(const KBranchInstruction *kbi,
+                                   unsigned index, ExecutionState &state) {
+  const std::pair<unsigned, unsigned> &successor = kbi->successors[index];
+  state.pc = &state.stack.back().kf->instructions[successor.first];
+  state.incomingBBIndex = successor.second;
+}
+
 /// Compute the true target of a function call, resolving LLVM aliases
 /// and bitcasts.
 Function *Executor::getTargetFunction(Value *calledVal) {
@@ -2116,1285 +2350,1311 @@ Function *Executor::getTargetFunction(Value *calledVal) {
   }
 }
 
-void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
-  Instruction *i = ki->inst;
-  switch (i->getOpcode()) {
-    // Control flow
-  case Instruction::Ret: {
-    ReturnInst *ri = cast<ReturnInst>(i);
-    KInstIterator kcaller = state.stack.back().caller;
-    Instruction *caller = kcaller ? kcaller->inst : nullptr;
-    bool isVoidReturn = (ri->getNumOperands() == 0);
-    ref<Expr> result = ConstantExpr::alloc(0, Expr::Bool);
-    
-    if (!isVoidReturn) {
-      result = eval(ki, 0, state).value;
-    }
-    
-    if (state.stack.size() <= 1) {
-      assert(!caller && "caller set on initial stack frame");
-      terminateStateOnExit(state);
-    } else {
-      state.popFrame();
+/// Returns the low width bits of value.
+static inline uint64_t truncateToWidth(uint64_t value, unsigned width) {
+  return width >= 64 ? value : value & ((UINT64_C(1) << width) - 1);
+}
 
-      if (statsTracker)
-        statsTracker->framePopped(state);
+/// Interprets the low width bits of value as a signed integer.
+static inline int64_t signExtendFromWidth(uint64_t value, unsigned width) {
+  if (width >= 64)
+    return static_cast<int64_t>(value);
+  unsigned shift = 64 - width;
+  return static_cast<int64_t>(value << shift) >> shift;
+}
+
+void Executor::executeRetInst(ExecutionState &state, KInstruction *ki) {
+  ReturnInst *ri = cast<ReturnInst>(ki->inst);
+  KInstIterator kcaller = state.stack.back().caller;
+  Instruction *caller = kcaller ? kcaller->inst : nullptr;
+  bool isVoidReturn = (ri->getNumOperands() == 0);
+  ref<Expr> result = ConstantExpr::alloc(0, Expr::Bool);
+  
+  if (!isVoidReturn) {
+    result = eval(ki, 0, state).value;
+  }
+  
+  if (state.stack.size() <= 1) {
+    assert(!caller && "caller set on initial stack frame");
+    terminateStateOnExit(state);
+  } else {
+    state.popFrame();
+
+    if (statsTracker)
+      statsTracker->framePopped(state);
+
+    if (InvokeInst *ii = dyn_cast<InvokeInst>(caller)) {
+      transferToBasicBlock(ii->getNormalDest(), caller->getParent(), state);
+    } else {
+      state.pc = kcaller;
+      ++state.pc;
+    }
 
-      if (InvokeInst *ii = dyn_cast<InvokeInst>(caller)) {
-        transferToBasicBlock(ii->getNormalDest(), caller->getParent(), state);
+#ifdef SUPPORT_KLEE_EH_CXX
+    if (ri->getFunction()->getName() == "_klee_eh_cxx_personality") {
+      assert(dyn_cast<ConstantExpr>(result) &&
+             "result from personality fn must be a concrete value");
+
+      auto *sui = dyn_cast_or_null<SearchPhaseUnwindingInformation>(
+          state.unwindingInformation.get());
+      assert(sui && "return from personality function outside of "
+                    "search phase unwinding");
+
+      // unbind the MO we used to pass the serialized landingpad
+      state.addressSpace.unbindObject(sui->serializedLandingpad);
+      sui->serializedLandingpad = nullptr;
+
+      if (result->isZero()) {
+        // this lpi doesn't handle the exception, continue the search
+        unwindToNextLandingpad(state);
       } else {
-        state.pc = kcaller;
-        ++state.pc;
+        // a clause (or a catch-all clause or filter clause) matches:
+        // remember the stack index and switch to clean-up phase
+        state.unwindingInformation =
+            std::make_unique<CleanupPhaseUnwindingInformation>(
+                sui->exceptionObject, cast<ConstantExpr>(result),
+                sui->unwindingProgress);
+        // this pointer is now invalidated
+        sui = nullptr;
+        // continue the unwinding process (which will now start with the
+        // cleanup phase)
+        unwindToNextLandingpad(state);
       }
 
-#ifdef SUPPORT_KLEE_EH_CXX
-      if (ri->getFunction()->getName() == "_klee_eh_cxx_personality") {
-        assert(dyn_cast<ConstantExpr>(result) &&
-               "result from personality fn must be a concrete value");
-
-        auto *sui = dyn_cast_or_null<SearchPhaseUnwindingInformation>(
-            state.unwindingInformation.get());
-        assert(sui && "return from personality function outside of "
-                      "search phase unwinding");
-
-        // unbind the MO we used to pass the serialized landingpad
-        state.addressSpace.unbindObject(sui->serializedLandingpad);
-        sui->serializedLandingpad = nullptr;
-
-        if (result->isZero()) {
-          // this lpi doesn't handle the exception, continue the search
-          unwindToNextLandingpad(state);
-        } else {
-          // a clause (or a catch-all clause or filter clause) matches:
-          // remember the stack index and switch to clean-up phase
-          state.unwindingInformation =
-              std::make_unique<CleanupPhaseUnwindingInformation>(
-                  sui->exceptionObject, cast<ConstantExpr>(result),
-                  sui->unwindingProgress);
-          // this pointer is now invalidated
-          sui = nullptr;
-          // continue the unwinding process (which will now start with the
-          // cleanup phase)
-          unwindToNextLandingpad(state);
+      // never return normally from the personality fn
+      return;
+    }
+#endif // SUPPORT_KLEE_EH_CXX
+
+    if (!isVoidReturn) {
+      Type *t = caller->getType();
+      if (t != Type::getVoidTy(ki->inst->getContext())) {
+        // may need to do coercion due to bitcasts
+        Expr::Width from = result->getWidth();
+        Expr::Width to = kcaller->width;
+          
+        if (from != to) {
+          const CallBase &cb = cast<CallBase>(*caller);
+
+          // XXX need to check other param attrs ?
+          bool isSExt = cb.hasRetAttr(llvm::Attribute::SExt);
+          if (isSExt) {
+            result = SExtExpr::create(result, to);
+          } else {
+            result = ZExtExpr::create(result, to);
+          }
         }
 
-        // never return normally from the personality fn
-        break;
+        bindLocal(kcaller, state, result);
       }
-#endif // SUPPORT_KLEE_EH_CXX
+    } else {
+      // We check that the return value has no users instead of
+      // checking the type, since C defaults to returning int for
+      // undeclared functions.
+      if (!caller->use_empty()) {
+        terminateStateOnExecError(state, "return void when caller expected a result");
+      }
+    }
+  }      
+}
 
-      if (!isVoidReturn) {
-        Type *t = caller->getType();
-        if (t != Type::getVoidTy(i->getContext())) {
-          // may need to do coercion due to bitcasts
-          Expr::Width from = result->getWidth();
-          Expr::Width to = getWidthForLLVMType(t);
-            
-          if (from != to) {
-            const CallBase &cb = cast<CallBase>(*caller);
+void Executor::executeBrInst(ExecutionState &state, KInstruction *ki) {
+  KBranchInstruction *kbi = static_cast<KBranchInstruction *>(ki);
+  if (kbi->successors.size() == 1) {
+    transferToSuccessor(kbi, 0, state);
+  } else {
+    // FIXME: Find a way that we don't have this hidden dependency.
+    assert(cast<BranchInst>(ki->inst)->getCondition() ==
+               ki->inst->getOperand(0) &&
+           "Wrong operand index!");
+    ref<Expr> cond = eval(ki, 0, state).value;
 
-            // XXX need to check other param attrs ?
-            bool isSExt = cb.hasRetAttr(llvm::Attribute::SExt);
-            if (isSExt) {
-              result = SExtExpr::create(result, to);
-            } else {
-              result = ZExtExpr::create(result, to);
-            }
-          }
+    cond = optimizer.optimizeExpr(cond, false);
+    Executor::StatePair branches = fork(state, cond, false, BranchType::Conditional);
 
-          bindLocal(kcaller, state, result);
-        }
-      } else {
-        // We check that the return value has no users instead of
-        // checking the type, since C defaults to returning int for
-        // undeclared functions.
-        if (!caller->use_empty()) {
-          terminateStateOnExecError(state, "return void when caller expected a result");
-        }
-      }
-    }      
-    break;
+    // NOTE: There is a hidden dependency here, markBranchVisited
+    // requires that we still be in the context of the branch
+    // instruction (it reuses its statistic id). Should be cleaned
+    // up with convenient instruction specific data.
+    if (statsTracker && state.stack.back().kf->trackCoverage)
+      statsTracker->markBranchVisited(branches.first, branches.second);
+
+    if (branches.first)
+      transferToSuccessor(kbi, 0, *branches.first);
+    if (branches.second)
+      transferToSuccessor(kbi, 1, *branches.second);
+
+    if (AutoMerge && branches.first && branches.second)
+      openAutoMerge(ki, {branches.first, branches.second});
   }
-  case Instruction::Br: {
-    BranchInst *bi = cast<BranchInst>(i);
-    if (bi->isUnconditional()) {
-      transferToBasicBlock(bi->getSuccessor(0), bi->getParent(), state);
-    } else {
-      // FIXME: Find a way that we don't have this hidden dependency.
-      assert(bi->getCondition() == bi->getOperand(0) &&
-             "Wrong operand index!");
-      ref<Expr> cond = eval(ki, 0, state).value;
+}
 
-      cond = optimizer.optimizeExpr(cond, false);
-      Executor::StatePair branches = fork(state, cond, false, BranchType::Conditional);
-
-      // NOTE: There is a hidden dependency here, markBranchVisited
-      // requires that we still be in the context of the branch
-      // instruction (it reuses its statistic id). Should be cleaned
-      // up with convenient instruction specific data.
-      if (statsTracker && state.stack.back().kf->trackCoverage)
-        statsTracker->markBranchVisited(branches.first, branches.second);
-
-      if (branches.first)
-        transferToBasicBlock(bi->getSuccessor(0), bi->getParent(), *branches.first);
-      if (branches.second)
-        transferToBasicBlock(bi->getSuccessor(1), bi->getParent(), *branches.second);
-    }
-    break;
+void Executor::executeIndirectBrInst(ExecutionState &state, KInstruction *ki) {
+  // implements indirect branch to a label within the current function
+  const auto bi = cast<IndirectBrInst>(ki->inst);
+  auto address = eval(ki, 0, state).value;
+  address = toUnique(state, address);
+
+  // concrete address
+  if (const auto CE = dyn_cast<ConstantExpr>(address.get())) {
+    const auto bb_address = (BasicBlock *) CE->getZExtValue(Context::get().getPointerWidth());
+    transferToBasicBlock(bb_address, bi->getParent(), state);
+    return;
   }
-  case Instruction::IndirectBr: {
-    // implements indirect branch to a label within the current function
-    const auto bi = cast<IndirectBrInst>(i);
-    auto address = eval(ki, 0, state).value;
-    address = toUnique(state, address);
 
-    // concrete address
-    if (const auto CE = dyn_cast<ConstantExpr>(address.get())) {
-      const auto bb_address = (BasicBlock *) CE->getZExtValue(Context::get().getPointerWidth());
-      transferToBasicBlock(bb_address, bi->getParent(), state);
-      break;
-    }
+  // symbolic address
+  const auto numDestinations = bi->getNumDestinations();
+  std::vector<BasicBlock *> targets;
+  targets.reserve(numDestinations);
+  std::vector<ref<Expr>> expressions;
+  expressions.reserve(numDestinations);
 
-    // symbolic address
-    const auto numDestinations = bi->getNumDestinations();
-    std::vector<BasicBlock *> targets;
-    targets.reserve(numDestinations);
-    std::vector<ref<Expr>> expressions;
-    expressions.reserve(numDestinations);
-
-    ref<Expr> errorCase = ConstantExpr::alloc(1, Expr::Bool);
-    SmallPtrSet<BasicBlock *, 5> destinations;
-    // collect and check destinations from label list
-    for (unsigned k = 0; k < numDestinations; ++k) {
-      // filter duplicates
-      const auto d = bi->getDestination(k);
-      if (destinations.count(d)) continue;
-      destinations.insert(d);
-
-      // create address expression
-      const auto PE = Expr::createPointer(reinterpret_cast<std::uint64_t>(d));
-      ref<Expr> e = EqExpr::create(address, PE);
-
-      // exclude address from errorCase
-      errorCase = AndExpr::create(errorCase, Expr::createIsZero(e));
-
-      // check feasibility
-      bool result;
-      bool success __attribute__((unused)) =
-          solver->mayBeTrue(state.constraints, e, result, state.queryMetaData);
-      assert(success && "FIXME: Unhandled solver failure");
-      if (result) {
-        targets.push_back(d);
-        expressions.push_back(e);
-      }
-    }
-    // check errorCase feasibility
+  ref<Expr> errorCase = ConstantExpr::alloc(1, Expr::Bool);
+  SmallPtrSet<BasicBlock *, 5> destinations;
+  // collect and check destinations from label list
+  for (unsigned k = 0; k < numDestinations; ++k) {
+    // filter duplicates
+    const auto d = bi->getDestination(k);
+    if (destinations.count(d)) continue;
+    destinations.insert(d);
+
+    // create address expression
+    const auto PE = Expr::createPointer(reinterpret_cast<std::uint64_t>(d));
+    ref<Expr> e = EqExpr::create(address, PE);
+
+    // exclude address from errorCase
+    errorCase = AndExpr::create(errorCase, Expr::createIsZero(e));
+
+    // check feasibility
     bool result;
-    bool success __attribute__((unused)) = solver->mayBeTrue(
-        state.constraints, errorCase, result, state.queryMetaData);
+    bool success __attribute__((unused)) =
+        solver->mayBeTrue(state.constraints, e, result, state.queryMetaData);
     assert(success && "FIXME: Unhandled solver failure");
     if (result) {
-      expressions.push_back(errorCase);
+      targets.push_back(d);
+      expressions.push_back(e);
     }
+  }
+  // check errorCase feasibility
+  bool result;
+  bool success __attribute__((unused)) = solver->mayBeTrue(
+      state.constraints, errorCase, result, state.queryMetaData);
+  assert(success && "FIXME: Unhandled solver failure");
+  if (result) {
+    expressions.push_back(errorCase);
+  }
 
-    // fork states
-    std::vector<ExecutionState *> branches;
-    branch(state, expressions, branches, BranchType::Indirect);
+  // fork states
+  std::vector<ExecutionState *> branches;
+  branch(state, expressions, branches, BranchType::Indirect);
 
-    // terminate error state
-    if (result) {
-      terminateStateOnExecError(*branches.back(), "indirectbr: illegal label address");
-      branches.pop_back();
-    }
+  // terminate error state
+  if (result) {
+    terminateStateOnExecError(*branches.back(), "indirectbr: illegal label address");
+    branches.pop_back();
+  }
 
-    // branch states to resp. target blocks
-    assert(targets.size() == branches.size());
-    for (std::vector<ExecutionState *>::size_type k = 0; k < branches.size(); ++k) {
-      if (branches[k]) {
-        transferToBasicBlock(targets[k], bi->getParent(), *branches[k]);
-      }
+  // branch states to resp. target blocks
+  assert(targets.size() == branches.size());
+  for (std::vector<ExecutionState *>::size_type k = 0; k < branches.size(); ++k) {
+    if (branches[k]) {
+      transferToBasicBlock(targets[k], bi->getParent(), *branches[k]);
     }
-
-    break;
   }
-  case Instruction::Switch: {
-    SwitchInst *si = cast<SwitchInst>(i);
-    ref<Expr> cond = eval(ki, 0, state).value;
-    BasicBlock *bb = si->getParent();
-
-    cond = toUnique(state, cond);
-    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(cond)) {
-      // Somewhat gross to create these all the time, but fine till we
-      // switch to an internal rep.
-      llvm::IntegerType *Ty = cast<IntegerType>(si->getCondition()->getType());
-      ConstantInt *ci = ConstantInt::get(Ty, CE->getZExtValue());
-      unsigned index = si->findCaseValue(ci)->getSuccessorIndex();
-      transferToBasicBlock(si->getSuccessor(index), si->getParent(), state);
-    } else {
-      // Handle possible different branch targets
+}
 
-      // We have the following assumptions:
-      // - each case value is mutual exclusive to all other values
-      // - order of case branches is based on the order of the expressions of
-      //   the case values, still default is handled last
-      std::vector<BasicBlock *> bbOrder;
-      std::map<BasicBlock *, ref<Expr> > branchTargets;
+void Executor::executeSwitchInst(ExecutionState &state, KInstruction *ki) {
+  SwitchInst *si = cast<SwitchInst>(ki->inst);
+  ref<Expr> cond = eval(ki, 0, state).value;
+  BasicBlock *bb = si->getParent();
+
+  cond = toUnique(state, cond);
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(cond)) {
+    // Somewhat gross to create these all the time, but fine till we
+    // switch to an internal rep.
+    llvm::IntegerType *Ty = cast<IntegerType>(si->getCondition()->getType());
+    ConstantInt *ci = ConstantInt::get(Ty, CE->getZExtValue());
+    unsigned index = si->findCaseValue(ci)->getSuccessorIndex();
+    transferToSuccessor(static_cast<KBranchInstruction *>(ki), index, state);
+  } else {
+    // Handle possible different branch targets
 
-      std::map<ref<Expr>, BasicBlock *> expressionOrder;
+    // We have the following assumptions:
+    // - each case value is mutual exclusive to all other values
+    // - order of case branches is based on the order of the expressions of
+    //   the case values, still default is handled last
+    std::vector<BasicBlock *> bbOrder;
+    std::map<BasicBlock *, ref<Expr> > branchTargets;
 
-      // Iterate through all non-default cases and order them by expressions
-      for (auto i : si->cases()) {
-        ref<Expr> value = evalConstant(i.getCaseValue());
+    std::map<ref<Expr>, BasicBlock *> expressionOrder;
 
-        BasicBlock *caseSuccessor = i.getCaseSuccessor();
-        expressionOrder.insert(std::make_pair(value, caseSuccessor));
-      }
+    // Iterate through all non-default cases and order them by expressions
+    for (auto i : si->cases()) {
+      ref<Expr> value = evalConstant(i.getCaseValue());
 
-      // Track default branch values
-      ref<Expr> defaultValue = ConstantExpr::alloc(1, Expr::Bool);
+      BasicBlock *caseSuccessor = i.getCaseSuccessor();
+      expressionOrder.insert(std::make_pair(value, caseSuccessor));
+    }
 
-      // iterate through all non-default cases but in order of the expressions
-      for (std::map<ref<Expr>, BasicBlock *>::iterator
-               it = expressionOrder.begin(),
-               itE = expressionOrder.end();
-           it != itE; ++it) {
-        ref<Expr> match = EqExpr::create(cond, it->first);
+    // Track default branch values
+    ref<Expr> defaultValue = ConstantExpr::alloc(1, Expr::Bool);
 
-        // skip if case has same successor basic block as default case
-        // (should work even with phi nodes as a switch is a single terminating instruction)
-        if (it->second == si->getDefaultDest()) continue;
+    // iterate through all non-default cases but in order of the expressions
+    for (std::map<ref<Expr>, BasicBlock *>::iterator
+             it = expressionOrder.begin(),
+             itE = expressionOrder.end();
+         it != itE; ++it) {
+      ref<Expr> match = EqExpr::create(cond, it->first);
 
-        // Make sure that the default value does not contain this target's value
-        defaultValue = AndExpr::create(defaultValue, Expr::createIsZero(match));
+      // skip if case has same successor basic block as default case
+      // (should work even with phi nodes as a switch is a single terminating instruction)
+      if (it->second == si->getDefaultDest()) continue;
 
-        // Check if control flow could take this case
-        bool result;
-        match = optimizer.optimizeExpr(match, false);
-        bool success = solver->mayBeTrue(state.constraints, match, result,
-                                         state.queryMetaData);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
-        if (result) {
-          BasicBlock *caseSuccessor = it->second;
-
-          // Handle the case that a basic block might be the target of multiple
-          // switch cases.
-          // Currently we generate an expression containing all switch-case
-          // values for the same target basic block. We spare us forking too
-          // many times but we generate more complex condition expressions
-          // TODO Add option to allow to choose between those behaviors
-          std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> res =
-              branchTargets.insert(std::make_pair(
-                  caseSuccessor, ConstantExpr::alloc(0, Expr::Bool)));
-
-          res.first->second = OrExpr::create(match, res.first->second);
-
-          // Only add basic blocks which have not been target of a branch yet
-          if (res.second) {
-            bbOrder.push_back(caseSuccessor);
-          }
-        }
-      }
+      // Make sure that the default value does not contain this target's value
+      defaultValue = AndExpr::create(defaultValue, Expr::createIsZero(match));
 
-      // Check if control could take the default case
-      defaultValue = optimizer.optimizeExpr(defaultValue, false);
-      bool res;
-      bool success = solver->mayBeTrue(state.constraints, defaultValue, res,
+      // Check if control flow could take this case
+      bool result;
+      match = optimizer.optimizeExpr(match, false);
+      bool success = solver->mayBeTrue(state.constraints, match, result,
                                        state.queryMetaData);
       assert(success && "FIXME: Unhandled solver failure");
       (void) success;
-      if (res) {
-        std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> ret =
-            branchTargets.insert(
-                std::make_pair(si->getDefaultDest(), defaultValue));
-        if (ret.second) {
-          bbOrder.push_back(si->getDefaultDest());
+      if (result) {
+        BasicBlock *caseSuccessor = it->second;
+
+        // Handle the case that a basic block might be the target of multiple
+        // switch cases.
+        // Currently we generate an expression containing all switch-case
+        // values for the same target basic block. We spare us forking too
+        // many times but we generate more complex condition expressions
+        // TODO Add option to allow to choose between those behaviors
+        std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> res =
+            branchTargets.insert(std::make_pair(
+                caseSuccessor, ConstantExpr::alloc(0, Expr::Bool)));
+
+        res.first->second = OrExpr::create(match, res.first->second);
+
+        // Only add basic blocks which have not been target of a branch yet
+        if (res.second) {
+          bbOrder.push_back(caseSuccessor);
         }
       }
+    }
 
-      // Fork the current state with each state having one of the possible
-      // successors of this switch
-      std::vector< ref<Expr> > conditions;
-      for (std::vector<BasicBlock *>::iterator it = bbOrder.begin(),
-                                               ie = bbOrder.end();
-           it != ie; ++it) {
-        conditions.push_back(branchTargets[*it]);
-      }
-      std::vector<ExecutionState*> branches;
-      branch(state, conditions, branches, BranchType::Switch);
-
-      std::vector<ExecutionState*>::iterator bit = branches.begin();
-      for (std::vector<BasicBlock *>::iterator it = bbOrder.begin(),
-                                               ie = bbOrder.end();
-           it != ie; ++it) {
-        ExecutionState *es = *bit;
-        if (es)
-          transferToBasicBlock(*it, bb, *es);
-        ++bit;
+    // Check if control could take the default case
+    defaultValue = optimizer.optimizeExpr(defaultValue, false);
+    bool res;
+    bool success = solver->mayBeTrue(state.constraints, defaultValue, res,
+                                     state.queryMetaData);
+    assert(success && "FIXME: Unhandled solver failure");
+    (void) success;
+    if (res) {
+      std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> ret =
+          branchTargets.insert(
+              std::make_pair(si->getDefaultDest(), defaultValue));
+      if (ret.second) {
+        bbOrder.push_back(si->getDefaultDest());
       }
     }
-    break;
+
+    // Fork the current state with each state having one of the possible
+    // successors of this switch
+    std::vector< ref<Expr> > conditions;
+    for (std::vector<BasicBlock *>::iterator it = bbOrder.begin(),
+                                             ie = bbOrder.end();
+         it != ie; ++it) {
+      conditions.push_back(branchTargets[*it]);
+    }
+    std::vector<ExecutionState*> branches;
+    branch(state, conditions, branches, BranchType::Switch);
+
+    std::vector<ExecutionState*>::iterator bit = branches.begin();
+    for (std::vector<BasicBlock *>::iterator it = bbOrder.begin(),
+                                             ie = bbOrder.end();
+         it != ie; ++it) {
+      ExecutionState *es = *bit;
+      if (es)
+        transferToBasicBlock(*it, bb, *es);
+      ++bit;
+    }
+
+    if (AutoMerge)
+      openAutoMerge(ki, branches);
   }
-  case Instruction::Unreachable:
-    // Note that this is not necessarily an internal bug, llvm will
-    // generate unreachable instructions in cases where it knows the
-    // program will crash. So it is effectively a SEGV or internal
-    // error.
-    terminateStateOnExecError(state, "reached \"unreachable\" instruction");
-    break;
+}
 
-  case Instruction::Invoke:
-  case Instruction::Call: {
-    // Ignore debug intrinsic calls
-    if (isa<DbgInfoIntrinsic>(i))
-      break;
+void Executor::executeUnreachableInst(ExecutionState &state, KInstruction *ki) {
+  // Note that this is not necessarily an internal bug, llvm will
+  // generate unreachable instructions in cases where it knows the
+  // program will crash. So it is effectively a SEGV or internal
+  // error.
+  terminateStateOnExecError(state, "reached \"unreachable\" instruction");
+}
 
-    const CallBase &cb = cast<CallBase>(*i);
-    Value *fp = cb.getCalledOperand();
-    unsigned numArgs = cb.arg_size();
-    Function *f = getTargetFunction(fp);
+void Executor::executeCallInst(ExecutionState &state, KInstruction *ki) {
+  // Ignore debug intrinsic calls
+  if (isa<DbgInfoIntrinsic>(ki->inst))
+    return;
 
-    // evaluate arguments
-    std::vector< ref<Expr> > arguments;
-    arguments.reserve(numArgs);
+  const CallBase &cb = cast<CallBase>(*ki->inst);
+  Value *fp = cb.getCalledOperand();
+  unsigned numArgs = cb.arg_size();
+  Function *f = getTargetFunction(fp);
 
-    for (unsigned j=0; j<numArgs; ++j)
-      arguments.push_back(eval(ki, j+1, state).value);
+  // evaluate arguments
+  std::vector< ref<Expr> > arguments;
+  arguments.reserve(numArgs);
 
-    if (auto* asmValue = dyn_cast<InlineAsm>(fp)) { //TODO: move to `executeCall`
-      if (ExternalCalls != ExternalCallPolicy::None) {
-        KInlineAsm callable(asmValue);
-        callExternalFunction(state, ki, &callable, arguments);
-      } else {
-        terminateStateOnExecError(state, "external calls disallowed (in particular inline asm)");
-      }
-      break;
+  for (unsigned j=0; j<numArgs; ++j)
+    arguments.push_back(eval(ki, j+1, state).value);
+
+  if (auto* asmValue = dyn_cast<InlineAsm>(fp)) { //TODO: move to `executeCall`
+    if (ExternalCalls != ExternalCallPolicy::None) {
+      KInlineAsm callable(asmValue);
+      callExternalFunction(state, ki, &callable, arguments);
+    } else {
+      terminateStateOnExecError(state, "external calls disallowed (in particular inline asm)");
     }
+    return;
+  }
 
-    if (f) {
-      const FunctionType *fType = f->getFunctionType();
+  if (f) {
+    const FunctionType *fType = f->getFunctionType();
 #if LLVM_VERSION_MAJOR >= 15
-      const FunctionType *fpType = cb.getFunctionType();
+    const FunctionType *fpType = cb.getFunctionType();
 #else
-      const FunctionType *fpType =
-          dyn_cast<FunctionType>(fp->getType()->getPointerElementType());
+    const FunctionType *fpType =
+        dyn_cast<FunctionType>(fp->getType()->getPointerElementType());
 #endif
 
-      // special case the call with a bitcast case
-      if (fType != fpType) {
-        assert(fType && fpType && "unable to get function type");
-
-        // XXX check result coercion
-
-        // XXX this really needs thought and validation
-        unsigned i=0;
-        for (std::vector< ref<Expr> >::iterator
-               ai = arguments.begin(), ie = arguments.end();
-             ai != ie; ++ai) {
-          Expr::Width to, from = (*ai)->getWidth();
-            
-          if (i<fType->getNumParams()) {
-            to = getWidthForLLVMType(fType->getParamType(i));
-
-            if (from != to) {
-              // XXX need to check other param attrs ?
-              bool isSExt = cb.paramHasAttr(i, llvm::Attribute::SExt);
-              if (isSExt) {
-                arguments[i] = SExtExpr::create(arguments[i], to);
-              } else {
-                arguments[i] = ZExtExpr::create(arguments[i], to);
-              }
-            }
-          }
-            
-          i++;
-        }
-      }
+    // special case the call with a bitcast case
+    if (fType != fpType) {
+      assert(fType && fpType && "unable to get function type");
 
-      executeCall(state, ki, f, arguments);
-    } else {
-      ref<Expr> v = eval(ki, 0, state).value;
-
-      ExecutionState *free = &state;
-      bool hasInvalid = false, first = true;
-
-      /* XXX This is wasteful, no need to do a full evaluate since we
-         have already got a value. But in the end the caches should
-         handle it for us, albeit with some overhead. */
-      do {
-        v = optimizer.optimizeExpr(v, true);
-        ref<ConstantExpr> value;
-        bool success =
-            solver->getValue(free->constraints, v, value, free->queryMetaData);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
-        StatePair res = fork(*free, EqExpr::create(v, value), true, BranchType::Call);
-        if (res.first) {
-          uint64_t addr = value->getZExtValue();
-          auto it = legalFunctions.find(addr);
-          if (it != legalFunctions.end()) {
-            f = it->second;
-
-            // Don't give warning on unique resolution
-            if (res.second || !first)
-              klee_warning_once(reinterpret_cast<void*>(addr),
-                                "resolved symbolic function pointer to: %s",
-                                f->getName().data());
-
-            executeCall(*res.first, ki, f, arguments);
-          } else {
-            if (!hasInvalid) {
-              terminateStateOnExecError(state, "invalid function pointer");
-              hasInvalid = true;
+      // XXX check result coercion
+
+      // XXX this really needs thought and validation
+      unsigned i=0;
+      for (std::vector< ref<Expr> >::iterator
+             ai = arguments.begin(), ie = arguments.end();
+           ai != ie; ++ai) {
+        Expr::Width to, from = (*ai)->getWidth();
+          
+        if (i<fType->getNumParams()) {
+          to = getWidthForLLVMType(fType->getParamType(i));
+
+          if (from != to) {
+            // XXX need to check other param attrs ?
+            bool isSExt = cb.paramHasAttr(i, llvm::Attribute::SExt);
+            if (isSExt) {
+              arguments[i] = SExtExpr::create(arguments[i], to);
+            } else {
+              arguments[i] = ZExtExpr::create(arguments[i], to);
             }
           }
         }
-
-        first = false;
-        free = res.second;
-      } while (free);
+          
+        i++;
+      }
     }
-    break;
-  }
-  case Instruction::PHI: {
-    ref<Expr> result = eval(ki, state.incomingBBIndex, state).value;
-    bindLocal(ki, state, result);
-    break;
-  }
 
-    // Special instructions
-  case Instruction::Select: {
-    // NOTE: It is not required that operands 1 and 2 be of scalar type.
-    ref<Expr> cond = eval(ki, 0, state).value;
-    ref<Expr> tExpr = eval(ki, 1, state).value;
-    ref<Expr> fExpr = eval(ki, 2, state).value;
-    ref<Expr> result = SelectExpr::create(cond, tExpr, fExpr);
-    bindLocal(ki, state, result);
-    break;
-  }
+    executeCall(state, ki, f, arguments);
+  } else {
+    ref<Expr> v = eval(ki, 0, state).value;
 
-  case Instruction::VAArg:
-    terminateStateOnExecError(state, "unexpected VAArg instruction");
-    break;
+    ExecutionState *free = &state;
+    bool hasInvalid = false, first = true;
 
-    // Arithmetic / logical
+    /* XXX This is wasteful, no need to do a full evaluate since we
+       have already got a value. But in the end the caches should
+       handle it for us, albeit with some overhead. */
+    do {
+      v = optimizer.optimizeExpr(v, true);
+      ref<ConstantExpr> value;
+      bool success =
+          solver->getValue(free->constraints, v, value, free->queryMetaData);
+      assert(success && "FIXME: Unhandled solver failure");
+      (void) success;
+      StatePair res = fork(*free, EqExpr::create(v, value), true, BranchType::Call);
+      if (res.first) {
+        uint64_t addr = value->getZExtValue();
+        auto it = legalFunctions.find(addr);
+        if (it != legalFunctions.end()) {
+          f = it->second;
+
+          // Don't give warning on unique resolution
+          if (res.second || !first)
+            klee_warning_once(reinterpret_cast<void*>(addr),
+                              "resolved symbolic function pointer to: %s",
+                              f->getName().data());
+
+          executeCall(*res.first, ki, f, arguments);
+        } else {
+          if (!hasInvalid) {
+            terminateStateOnExecError(state, "invalid function pointer");
+            hasInvalid = true;
+          }
+        }
+      }
 
-  case Instruction::Add: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, AddExpr::create(left, right));
-    break;
+      first = false;
+      free = res.second;
+    } while (free);
   }
+}
 
-  case Instruction::Sub: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, SubExpr::create(left, right));
-    break;
-  }
- 
-  case Instruction::Mul: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, MulExpr::create(left, right));
-    break;
-  }
+void Executor::executePHIInst(ExecutionState &state, KInstruction *ki) {
+  ref<Expr> result = eval(ki, state.incomingBBIndex, state).value;
+  bindLocal(ki, state, result);
+}
 
-  case Instruction::UDiv: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = UDivExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
-  }
+void Executor::executeSelectInst(ExecutionState &state, KInstruction *ki) {
+  // NOTE: It is not required that operands 1 and 2 be of scalar type.
+  ref<Expr> cond = eval(ki, 0, state).value;
+  ref<Expr> tExpr = eval(ki, 1, state).value;
+  ref<Expr> fExpr = eval(ki, 2, state).value;
+  ref<Expr> result = SelectExpr::create(cond, tExpr, fExpr);
+  bindLocal(ki, state, result);
+}
 
-  case Instruction::SDiv: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = SDivExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
-  }
+void Executor::executeVAArgInst(ExecutionState &state, KInstruction *ki) {
+  terminateStateOnExecError(state, "unexpected VAArg instruction");
+}
 
-  case Instruction::URem: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = URemExpr::create(left, right);
-    bindLocal(ki, state, result);
+/// Computes the integer binary operator or comparison opcode (with the
+/// given predicate) of the concrete operands left and right as a width bit
+/// result. Returns false if an operand is symbolic or wider than 64 bits.
+/// Division by zero, signed overflow and oversized shifts are left to the
+/// general path as well, which implements their exact semantics.
+static inline bool evaluateConcrete(unsigned opcode, unsigned predicate,
+                                    unsigned width, const ref<Expr> &left,
+                                    const ref<Expr> &right, uint64_t &result) {
+  const klee::ConstantExpr *cl = dyn_cast<klee::ConstantExpr>(left);
+  if (!cl)
+    return false;
+  const klee::ConstantExpr *cr = dyn_cast<klee::ConstantExpr>(right);
+  if (!cr)
+    return false;
+  unsigned w = cl->getWidth();
+  if (w > 64)
+    return false;
+  uint64_t l = cl->getZExtValue(), r = cr->getZExtValue();
+  int64_t sl = signExtendFromWidth(l, w), sr = signExtendFromWidth(r, w);
+
+  switch (opcode) {
+  case Instruction::Add: result = l + r; break;
+  case Instruction::Sub: result = l - r; break;
+  case Instruction::Mul: result = l * r; break;
+  case Instruction::UDiv:
+    if (r == 0)
+      return false;
+    result = l / r;
     break;
-  }
-
-  case Instruction::SRem: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = SRemExpr::create(left, right);
-    bindLocal(ki, state, result);
+  case Instruction::URem:
+    if (r == 0)
+      return false;
+    result = l % r;
     break;
-  }
-
-  case Instruction::And: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = AndExpr::create(left, right);
-    bindLocal(ki, state, result);
+  case Instruction::SDiv:
+  case Instruction::SRem:
+    if (sr == 0 ||
+        (sr == -1 && sl == signExtendFromWidth(UINT64_C(1) << (w - 1), w)))
+      return false;
+    result = opcode == Instruction::SDiv ? sl / sr : sl % sr;
     break;
-  }
-
-  case Instruction::Or: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = OrExpr::create(left, right);
-    bindLocal(ki, state, result);
+  case Instruction::And: result = l & r; break;
+  case Instruction::Or: result = l | r; break;
+  case Instruction::Xor: result = l ^ r; break;
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+    if (r >= w)
+      return false;
+    if (opcode == Instruction::Shl)
+      result = l << r;
+    else if (opcode == Instruction::LShr)
+      result = l >> r;
+    else
+      result = static_cast<uint64_t>(sl >> r);
     break;
+  case Instruction::ICmp:
+    switch (predicate) {
+    case ICmpInst::ICMP_EQ: result = l == r; break;
+    case ICmpInst::ICMP_NE: result = l != r; break;
+    case ICmpInst::ICMP_UGT: result = l > r; break;
+    case ICmpInst::ICMP_UGE: result = l >= r; break;
+    case ICmpInst::ICMP_ULT: result = l < r; break;
+    case ICmpInst::ICMP_ULE: result = l <= r; break;
+    case ICmpInst::ICMP_SGT: result = sl > sr; break;
+    case ICmpInst::ICMP_SGE: result = sl >= sr; break;
+    case ICmpInst::ICMP_SLT: result = sl < sr; break;
+    case ICmpInst::ICMP_SLE: result = sl <= sr; break;
+    default:
+      return false;
+    }
+    break;
+  default:
+    llvm_unreachable("unexpected opcode");
   }
+  result = truncateToWidth(result, width);
+  return true;
+}
 
-  case Instruction::Xor: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = XorExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
+template <unsigned Opcode>
+void Executor::executeBinaryInst(ExecutionState &state, KInstruction *ki) {
+  ref<Expr> left = eval(ki, 0, state).value;
+  ref<Expr> right = eval(ki, 1, state).value;
+
+  uint64_t value;
+  if (ConcreteFastPath &&
+      evaluateConcrete(Opcode, 0, ki->width, left, right, value)) {
+    bindLocal(ki, state, ConstantExpr::create(value, ki->width));
+    ++stats::concreteFastPathInstructions;
+    return;
   }
 
-  case Instruction::Shl: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = ShlExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
+  // Opcode is a constant, so this switch is folded away.
+  ref<Expr> result;
+  switch (Opcode) {
+  case Instruction::Add: result = AddExpr::create(left, right); break;
+  case Instruction::Sub: result = SubExpr::create(left, right); break;
+  case Instruction::Mul: result = MulExpr::create(left, right); break;
+  case Instruction::UDiv: result = UDivExpr::create(left, right); break;
+  case Instruction::SDiv: result = SDivExpr::create(left, right); break;
+  case Instruction::URem: result = URemExpr::create(left, right); break;
+  case Instruction::SRem: result = SRemExpr::create(left, right); break;
+  case Instruction::And: result = AndExpr::create(left, right); break;
+  case Instruction::Or: result = OrExpr::create(left, right); break;
+  case Instruction::Xor: result = XorExpr::create(left, right); break;
+  case Instruction::Shl: result = ShlExpr::create(left, right); break;
+  case Instruction::LShr: result = LShrExpr::create(left, right); break;
+  case Instruction::AShr: result = AShrExpr::create(left, right); break;
+  default:
+    llvm_unreachable("unexpected opcode");
   }
+  bindLocal(ki, state, result);
+}
 
-  case Instruction::LShr: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = LShrExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
+void Executor::executeICmpInst(ExecutionState &state, KInstruction *ki) {
+  ref<Expr> left = eval(ki, 0, state).value;
+  ref<Expr> right = eval(ki, 1, state).value;
+
+  uint64_t value;
+  if (ConcreteFastPath && evaluateConcrete(Instruction::ICmp, ki->predicate,
+                                           ki->width, left, right, value)) {
+    bindLocal(ki, state, ConstantExpr::create(value, ki->width));
+    ++stats::concreteFastPathInstructions;
+    return;
   }
 
-  case Instruction::AShr: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = AShrExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
+  ref<Expr> result;
+  switch (ki->predicate) {
+  case ICmpInst::ICMP_EQ: result = EqExpr::create(left, right); break;
+  case ICmpInst::ICMP_NE: result = NeExpr::create(left, right); break;
+  case ICmpInst::ICMP_UGT: result = UgtExpr::create(left, right); break;
+  case ICmpInst::ICMP_UGE: result = UgeExpr::create(left, right); break;
+  case ICmpInst::ICMP_ULT: result = UltExpr::create(left, right); break;
+  case ICmpInst::ICMP_ULE: result = UleExpr::create(left, right); break;
+  case ICmpInst::ICMP_SGT: result = SgtExpr::create(left, right); break;
+  case ICmpInst::ICMP_SGE: result = SgeExpr::create(left, right); break;
+  case ICmpInst::ICMP_SLT: result = SltExpr::create(left, right); break;
+  case ICmpInst::ICMP_SLE: result = SleExpr::create(left, right); break;
+  default:
+    terminateStateOnExecError(state, "invalid ICmp predicate");
+    return;
   }
+  bindLocal(ki, state, result);
+}
 
-    // Compare
+void Executor::executeAllocaInst(ExecutionState &state, KInstruction *ki) {
+  AllocaInst *ai = cast<AllocaInst>(ki->inst);
+  unsigned elementSize = 
+    kmodule->targetData->getTypeStoreSize(ai->getAllocatedType());
+  ref<Expr> size = Expr::createPointer(elementSize);
+  if (ai->isArrayAllocation()) {
+    ref<Expr> count = eval(ki, 0, state).value;
+    count = Expr::createZExtToPointerWidth(count);
+    size = MulExpr::create(size, count);
+  }
+  executeAlloc(state, size, true, ki);
+}
 
-  case Instruction::ICmp: {
-    CmpInst *ci = cast<CmpInst>(i);
-    ICmpInst *ii = cast<ICmpInst>(ci);
+void Executor::executeLoadInst(ExecutionState &state, KInstruction *ki) {
+  ref<Expr> base = eval(ki, 0, state).value;
+  executeMemoryOperation(state, false, base, 0, ki);
+}
 
-    switch(ii->getPredicate()) {
-    case ICmpInst::ICMP_EQ: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = EqExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+void Executor::executeStoreInst(ExecutionState &state, KInstruction *ki) {
+  ref<Expr> base = eval(ki, 1, state).value;
+  ref<Expr> value = eval(ki, 0, state).value;
+  executeMemoryOperation(state, true, base, value, 0);
+}
 
-    case ICmpInst::ICMP_NE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = NeExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+void Executor::executeGetElementPtrInst(ExecutionState &state,
+                                        KInstruction *ki) {
+  KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
+  ref<Expr> base = eval(ki, 0, state).value;
+  ref<Expr> original_base = base;
 
-    case ICmpInst::ICMP_UGT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UgtExpr::create(left, right);
-      bindLocal(ki, state,result);
-      break;
-    }
+  for (std::vector< std::pair<unsigned, uint64_t> >::iterator 
+         it = kgepi->indices.begin(), ie = kgepi->indices.end(); 
+       it != ie; ++it) {
+    uint64_t elementSize = it->second;
+    ref<Expr> index = eval(ki, it->first, state).value;
+    base = AddExpr::create(base,
+                           MulExpr::create(Expr::createSExtToPointerWidth(index),
+                                           Expr::createPointer(elementSize)));
+  }
+  if (kgepi->offset)
+    base = AddExpr::create(base,
+                           Expr::createPointer(kgepi->offset));
+
+  if (SingleObjectResolution) {
+    if (isa<ConstantExpr>(original_base) && !isa<ConstantExpr>(base)) {
+      // the initial base address was a constant expression, the final is not:
+      // store the mapping between constant address and the non-const
+      // reference in the state
+      ref<ConstantExpr> c_orig_base = dyn_cast<ConstantExpr>(original_base);
+
+      ObjectPair op;
+      if (state.addressSpace.resolveOne(c_orig_base, op)) {
+        // store the address of the MemoryObject associated with this GEP
+        // instruction
+        state.base_mos[op.first->address].insert(base);
+        ref<ConstantExpr> r =
+            ConstantExpr::alloc(op.first->address, Expr::Int64);
+        state.base_addrs[base] = r;
+      } else {
+        // this case should not happen - we have a GEP instruction with const
+        // base address, so we should be able to find an exact memory object
+        // match
+        klee_warning("Failed to find a memory object for address %" PRIx64,
+                     c_orig_base->getZExtValue());
+      }
 
-    case ICmpInst::ICMP_UGE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UgeExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
+    } else if (!isa<ConstantExpr>(original_base)) {
+      auto base_it = state.base_addrs.find(original_base);
+      if (base_it != state.base_addrs.end()) {
+        // we need to update the current entry with a new value
+        uint64_t address = base_it->second->getZExtValue();
+        auto refs_it = state.base_mos[address].find(base_it->first);
+        if (refs_it != state.base_mos[address].end()) {
+          state.base_mos[address].erase(refs_it);
+        }
+        state.base_mos[address].insert(base);
+        state.base_addrs[base] = base_it->second;
+        state.base_addrs.erase(base_it->first);
+      }
     }
+  }
 
-    case ICmpInst::ICMP_ULT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UltExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+  bindLocal(ki, state, base);
+}
 
-    case ICmpInst::ICMP_ULE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UleExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
+template <unsigned Opcode>
+void Executor::executeIntCastInst(ExecutionState &state, KInstruction *ki) {
+  ref<Expr> arg = eval(ki, 0, state).value;
+  unsigned width = ki->width;
+
+  if (ConcreteFastPath && width <= 64) {
+    const ConstantExpr *CE = dyn_cast<ConstantExpr>(arg);
+    if (CE && CE->getWidth() <= 64) {
+      uint64_t value = CE->getZExtValue();
+      if (Opcode == Instruction::SExt)
+        value = signExtendFromWidth(value, CE->getWidth());
+      bindLocal(ki, state,
+                ConstantExpr::create(truncateToWidth(value, width), width));
+      ++stats::concreteFastPathInstructions;
+      return;
     }
+  }
 
-    case ICmpInst::ICMP_SGT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SgtExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+  ref<Expr> result;
+  switch (Opcode) {
+  case Instruction::Trunc: result = ExtractExpr::create(arg, 0, width); break;
+  case Instruction::ZExt: result = ZExtExpr::create(arg, width); break;
+  case Instruction::SExt: result = SExtExpr::create(arg, width); break;
+  default:
+    llvm_unreachable("unexpected opcode");
+  }
+  bindLocal(ki, state, result);
+}
 
-    case ICmpInst::ICMP_SGE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SgeExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+void Executor::executePtrIntCastInst(ExecutionState &state, KInstruction *ki) {
+  ref<Expr> arg = eval(ki, 0, state).value;
+  bindLocal(ki, state, ZExtExpr::create(arg, ki->width));
+}
 
-    case ICmpInst::ICMP_SLT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SltExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+void Executor::executeBitCastInst(ExecutionState &state, KInstruction *ki) {
+  ref<Expr> result = eval(ki, 0, state).value;
+  bindLocal(ki, state, result);
+}
 
-    case ICmpInst::ICMP_SLE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SleExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+void Executor::executeFNegInst(ExecutionState &state, KInstruction *ki) {
+  ref<ConstantExpr> arg =
+      toConstant(state, eval(ki, 0, state).value, "floating point");
+  if (!fpWidthToSemantics(arg->getWidth()))
+    return terminateStateOnExecError(state, "Unsupported FNeg operation");
 
-    default:
-      terminateStateOnExecError(state, "invalid ICmp predicate");
-    }
-    break;
-  }
- 
-    // Memory instructions...
-  case Instruction::Alloca: {
-    AllocaInst *ai = cast<AllocaInst>(i);
-    unsigned elementSize = 
-      kmodule->targetData->getTypeStoreSize(ai->getAllocatedType());
-    ref<Expr> size = Expr::createPointer(elementSize);
-    if (ai->isArrayAllocation()) {
-      ref<Expr> count = eval(ki, 0, state).value;
-      count = Expr::createZExtToPointerWidth(count);
-      size = MulExpr::create(size, count);
-    }
-    executeAlloc(state, size, true, ki);
-    break;
-  }
+  llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
+  Res = llvm::neg(Res);
+  bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+}
 
-  case Instruction::Load: {
-    ref<Expr> base = eval(ki, 0, state).value;
-    executeMemoryOperation(state, false, base, 0, ki);
-    break;
-  }
-  case Instruction::Store: {
-    ref<Expr> base = eval(ki, 1, state).value;
-    ref<Expr> value = eval(ki, 0, state).value;
-    executeMemoryOperation(state, true, base, value, 0);
-    break;
-  }
+void Executor::executeFAddInst(ExecutionState &state, KInstruction *ki) {
+  ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+                                      "floating point");
+  ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+                                       "floating point");
+  if (!fpWidthToSemantics(left->getWidth()) ||
+      !fpWidthToSemantics(right->getWidth()))
+    return terminateStateOnExecError(state, "Unsupported FAdd operation");
 
-  case Instruction::GetElementPtr: {
-    KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
-    ref<Expr> base = eval(ki, 0, state).value;
-    ref<Expr> original_base = base;
+  llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
+  Res.add(APFloat(*fpWidthToSemantics(right->getWidth()),right->getAPValue()), APFloat::rmNearestTiesToEven);
+  bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+}
 
-    for (std::vector< std::pair<unsigned, uint64_t> >::iterator 
-           it = kgepi->indices.begin(), ie = kgepi->indices.end(); 
-         it != ie; ++it) {
-      uint64_t elementSize = it->second;
-      ref<Expr> index = eval(ki, it->first, state).value;
-      base = AddExpr::create(base,
-                             MulExpr::create(Expr::createSExtToPointerWidth(index),
-                                             Expr::createPointer(elementSize)));
-    }
-    if (kgepi->offset)
-      base = AddExpr::create(base,
-                             Expr::createPointer(kgepi->offset));
-
-    if (SingleObjectResolution) {
-      if (isa<ConstantExpr>(original_base) && !isa<ConstantExpr>(base)) {
-        // the initial base address was a constant expression, the final is not:
-        // store the mapping between constant address and the non-const
-        // reference in the state
-        ref<ConstantExpr> c_orig_base = dyn_cast<ConstantExpr>(original_base);
-
-        ObjectPair op;
-        if (state.addressSpace.resolveOne(c_orig_base, op)) {
-          // store the address of the MemoryObject associated with this GEP
-          // instruction
-          state.base_mos[op.first->address].insert(base);
-          ref<ConstantExpr> r =
-              ConstantExpr::alloc(op.first->address, Expr::Int64);
-          state.base_addrs[base] = r;
-        } else {
-          // this case should not happen - we have a GEP instruction with const
-          // base address, so we should be able to find an exact memory object
-          // match
-          klee_warning("Failed to find a memory object for address %" PRIx64,
-                       c_orig_base->getZExtValue());
-        }
+void Executor::executeFSubInst(ExecutionState &state, KInstruction *ki) {
+  ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+                                      "floating point");
+  ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+                                       "floating point");
+  if (!fpWidthToSemantics(left->getWidth()) ||
+      !fpWidthToSemantics(right->getWidth()))
+    return terminateStateOnExecError(state, "Unsupported FSub operation");
+  llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
+  Res.subtract(APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()), APFloat::rmNearestTiesToEven);
+  bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+}
 
-      } else if (!isa<ConstantExpr>(original_base)) {
-        auto base_it = state.base_addrs.find(original_base);
-        if (base_it != state.base_addrs.end()) {
-          // we need to update the current entry with a new value
-          uint64_t address = base_it->second->getZExtValue();
-          auto refs_it = state.base_mos[address].find(base_it->first);
-          if (refs_it != state.base_mos[address].end()) {
-            state.base_mos[address].erase(refs_it);
-          }
-          state.base_mos[address].insert(base);
-          state.base_addrs[base] = base_it->second;
-          state.base_addrs.erase(base_it->first);
-        }
-      }
-    }
+void Executor::executeFMulInst(ExecutionState &state, KInstruction *ki) {
+  ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+                                      "floating point");
+  ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+                                       "floating point");
+  if (!fpWidthToSemantics(left->getWidth()) ||
+      !fpWidthToSemantics(right->getWidth()))
+    return terminateStateOnExecError(state, "Unsupported FMul operation");
 
-    bindLocal(ki, state, base);
-    break;
-  }
+  llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
+  Res.multiply(APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()), APFloat::rmNearestTiesToEven);
+  bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+}
 
-    // Conversion
-  case Instruction::Trunc: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).value,
-                                           0,
-                                           getWidthForLLVMType(ci->getType()));
-    bindLocal(ki, state, result);
-    break;
-  }
-  case Instruction::ZExt: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
-    bindLocal(ki, state, result);
-    break;
-  }
-  case Instruction::SExt: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = SExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
-    bindLocal(ki, state, result);
-    break;
-  }
+void Executor::executeFDivInst(ExecutionState &state, KInstruction *ki) {
+  ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+                                      "floating point");
+  ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+                                       "floating point");
+  if (!fpWidthToSemantics(left->getWidth()) ||
+      !fpWidthToSemantics(right->getWidth()))
+    return terminateStateOnExecError(state, "Unsupported FDiv operation");
 
-  case Instruction::IntToPtr: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width pType = getWidthForLLVMType(ci->getType());
-    ref<Expr> arg = eval(ki, 0, state).value;
-    bindLocal(ki, state, ZExtExpr::create(arg, pType));
-    break;
-  }
-  case Instruction::PtrToInt: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width iType = getWidthForLLVMType(ci->getType());
-    ref<Expr> arg = eval(ki, 0, state).value;
-    bindLocal(ki, state, ZExtExpr::create(arg, iType));
-    break;
-  }
+  llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
+  Res.divide(APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()), APFloat::rmNearestTiesToEven);
+  bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+}
 
-  case Instruction::BitCast: {
-    ref<Expr> result = eval(ki, 0, state).value;
-    bindLocal(ki, state, result);
-    break;
-  }
+void Executor::executeFRemInst(ExecutionState &state, KInstruction *ki) {
+  ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+                                      "floating point");
+  ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+                                       "floating point");
+  if (!fpWidthToSemantics(left->getWidth()) ||
+      !fpWidthToSemantics(right->getWidth()))
+    return terminateStateOnExecError(state, "Unsupported FRem operation");
+  llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
+  Res.mod(
+      APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()));
+  bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+}
 
-    // Floating point instructions
-  case Instruction::FNeg: {
-    ref<ConstantExpr> arg =
-        toConstant(state, eval(ki, 0, state).value, "floating point");
-    if (!fpWidthToSemantics(arg->getWidth()))
-      return terminateStateOnExecError(state, "Unsupported FNeg operation");
+void Executor::executeFPTruncInst(ExecutionState &state, KInstruction *ki) {
+  Expr::Width resultType = ki->width;
+  ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+                                     "floating point");
+  if (!fpWidthToSemantics(arg->getWidth()) || resultType > arg->getWidth())
+    return terminateStateOnExecError(state, "Unsupported FPTrunc operation");
+
+  llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
+  bool losesInfo = false;
+  Res.convert(*fpWidthToSemantics(resultType),
+              llvm::APFloat::rmNearestTiesToEven,
+              &losesInfo);
+  bindLocal(ki, state, ConstantExpr::alloc(Res));
+}
 
-    llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
-    Res = llvm::neg(Res);
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
-    break;
-  }
+void Executor::executeFPExtInst(ExecutionState &state, KInstruction *ki) {
+  Expr::Width resultType = ki->width;
+  ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+                                      "floating point");
+  if (!fpWidthToSemantics(arg->getWidth()) || arg->getWidth() > resultType)
+    return terminateStateOnExecError(state, "Unsupported FPExt operation");
+  llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
+  bool losesInfo = false;
+  Res.convert(*fpWidthToSemantics(resultType),
+              llvm::APFloat::rmNearestTiesToEven,
+              &losesInfo);
+  bindLocal(ki, state, ConstantExpr::alloc(Res));
+}
 
-  case Instruction::FAdd: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
-    if (!fpWidthToSemantics(left->getWidth()) ||
-        !fpWidthToSemantics(right->getWidth()))
-      return terminateStateOnExecError(state, "Unsupported FAdd operation");
+void Executor::executeFPToUIInst(ExecutionState &state, KInstruction *ki) {
+  Expr::Width resultType = ki->width;
+  ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+                                     "floating point");
+  if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
+    return terminateStateOnExecError(state, "Unsupported FPToUI operation");
 
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
-    Res.add(APFloat(*fpWidthToSemantics(right->getWidth()),right->getAPValue()), APFloat::rmNearestTiesToEven);
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
-    break;
-  }
+  llvm::APFloat Arg(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
+  uint64_t value = 0;
+  bool isExact = true;
+#if LLVM_VERSION_CODE >= LLVM_VERSION(16, 0)
+  auto valueRef = llvm::MutableArrayRef(value);
+#else
+  auto valueRef = makeMutableArrayRef(value);
+#endif
+  Arg.convertToInteger(valueRef, resultType, false,
+                       llvm::APFloat::rmTowardZero, &isExact);
+  bindLocal(ki, state, ConstantExpr::alloc(value, resultType));
+}
 
-  case Instruction::FSub: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
-    if (!fpWidthToSemantics(left->getWidth()) ||
-        !fpWidthToSemantics(right->getWidth()))
-      return terminateStateOnExecError(state, "Unsupported FSub operation");
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
-    Res.subtract(APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()), APFloat::rmNearestTiesToEven);
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
-    break;
-  }
+void Executor::executeFPToSIInst(ExecutionState &state, KInstruction *ki) {
+  Expr::Width resultType = ki->width;
+  ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+                                     "floating point");
+  if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
+    return terminateStateOnExecError(state, "Unsupported FPToSI operation");
+  llvm::APFloat Arg(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
 
-  case Instruction::FMul: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
-    if (!fpWidthToSemantics(left->getWidth()) ||
-        !fpWidthToSemantics(right->getWidth()))
-      return terminateStateOnExecError(state, "Unsupported FMul operation");
+  uint64_t value = 0;
+  bool isExact = true;
+#if LLVM_VERSION_CODE >= LLVM_VERSION(16, 0)
+  auto valueRef = llvm::MutableArrayRef(value);
+#else
+  auto valueRef = makeMutableArrayRef(value);
+#endif
+  Arg.convertToInteger(valueRef, resultType, true,
+                       llvm::APFloat::rmTowardZero, &isExact);
+  bindLocal(ki, state, ConstantExpr::alloc(value, resultType));
+}
 
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
-    Res.multiply(APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()), APFloat::rmNearestTiesToEven);
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
-    break;
-  }
+void Executor::executeUIToFPInst(ExecutionState &state, KInstruction *ki) {
+  Expr::Width resultType = ki->width;
+  ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+                                     "floating point");
+  const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
+  if (!semantics)
+    return terminateStateOnExecError(state, "Unsupported UIToFP operation");
+  llvm::APFloat f(*semantics, 0);
+  f.convertFromAPInt(arg->getAPValue(), false,
+                     llvm::APFloat::rmNearestTiesToEven);
+
+  bindLocal(ki, state, ConstantExpr::alloc(f));
+}
 
-  case Instruction::FDiv: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
-    if (!fpWidthToSemantics(left->getWidth()) ||
-        !fpWidthToSemantics(right->getWidth()))
-      return terminateStateOnExecError(state, "Unsupported FDiv operation");
+void Executor::executeSIToFPInst(ExecutionState &state, KInstruction *ki) {
+  Expr::Width resultType = ki->width;
+  ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+                                     "floating point");
+  const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
+  if (!semantics)
+    return terminateStateOnExecError(state, "Unsupported SIToFP operation");
+  llvm::APFloat f(*semantics, 0);
+  f.convertFromAPInt(arg->getAPValue(), true,
+                     llvm::APFloat::rmNearestTiesToEven);
+
+  bindLocal(ki, state, ConstantExpr::alloc(f));
+}
 
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
-    Res.divide(APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()), APFloat::rmNearestTiesToEven);
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+void Executor::executeFCmpInst(ExecutionState &state, KInstruction *ki) {
+  ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+                                      "floating point");
+  ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+                                       "floating point");
+  if (!fpWidthToSemantics(left->getWidth()) ||
+      !fpWidthToSemantics(right->getWidth()))
+    return terminateStateOnExecError(state, "Unsupported FCmp operation");
+
+  APFloat LHS(*fpWidthToSemantics(left->getWidth()),left->getAPValue());
+  APFloat RHS(*fpWidthToSemantics(right->getWidth()),right->getAPValue());
+  APFloat::cmpResult CmpRes = LHS.compare(RHS);
+
+  bool Result = false;
+  switch (ki->predicate) {
+    // Predicates which only care about whether or not the operands are NaNs.
+  case FCmpInst::FCMP_ORD:
+    Result = (CmpRes != APFloat::cmpUnordered);
     break;
-  }
 
-  case Instruction::FRem: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
-    if (!fpWidthToSemantics(left->getWidth()) ||
-        !fpWidthToSemantics(right->getWidth()))
-      return terminateStateOnExecError(state, "Unsupported FRem operation");
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
-    Res.mod(
-        APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()));
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+  case FCmpInst::FCMP_UNO:
+    Result = (CmpRes == APFloat::cmpUnordered);
     break;
-  }
 
-  case Instruction::FPTrunc: {
-    FPTruncInst *fi = cast<FPTruncInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                       "floating point");
-    if (!fpWidthToSemantics(arg->getWidth()) || resultType > arg->getWidth())
-      return terminateStateOnExecError(state, "Unsupported FPTrunc operation");
-
-    llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
-    bool losesInfo = false;
-    Res.convert(*fpWidthToSemantics(resultType),
-                llvm::APFloat::rmNearestTiesToEven,
-                &losesInfo);
-    bindLocal(ki, state, ConstantExpr::alloc(Res));
+    // Ordered comparisons return false if either operand is NaN.  Unordered
+    // comparisons return true if either operand is NaN.
+  case FCmpInst::FCMP_UEQ:
+    Result = (CmpRes == APFloat::cmpUnordered || CmpRes == APFloat::cmpEqual);
     break;
-  }
-
-  case Instruction::FPExt: {
-    FPExtInst *fi = cast<FPExtInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    if (!fpWidthToSemantics(arg->getWidth()) || arg->getWidth() > resultType)
-      return terminateStateOnExecError(state, "Unsupported FPExt operation");
-    llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
-    bool losesInfo = false;
-    Res.convert(*fpWidthToSemantics(resultType),
-                llvm::APFloat::rmNearestTiesToEven,
-                &losesInfo);
-    bindLocal(ki, state, ConstantExpr::alloc(Res));
+  case FCmpInst::FCMP_OEQ:
+    Result = (CmpRes != APFloat::cmpUnordered && CmpRes == APFloat::cmpEqual);
     break;
-  }
 
-  case Instruction::FPToUI: {
-    FPToUIInst *fi = cast<FPToUIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                       "floating point");
-    if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
-      return terminateStateOnExecError(state, "Unsupported FPToUI operation");
+  case FCmpInst::FCMP_UGT:
+    Result = (CmpRes == APFloat::cmpUnordered || CmpRes == APFloat::cmpGreaterThan);
+    break;
+  case FCmpInst::FCMP_OGT:
+    Result = (CmpRes != APFloat::cmpUnordered && CmpRes == APFloat::cmpGreaterThan);
+    break;
 
-    llvm::APFloat Arg(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
-    uint64_t value = 0;
-    bool isExact = true;
-#if LLVM_VERSION_CODE >= LLVM_VERSION(16, 0)
-    auto valueRef = llvm::MutableArrayRef(value);
-#else
-    auto valueRef = makeMutableArrayRef(value);
-#endif
-    Arg.convertToInteger(valueRef, resultType, false,
-                         llvm::APFloat::rmTowardZero, &isExact);
-    bindLocal(ki, state, ConstantExpr::alloc(value, resultType));
+  case FCmpInst::FCMP_UGE:
+    Result = (CmpRes == APFloat::cmpUnordered || (CmpRes == APFloat::cmpGreaterThan || CmpRes == APFloat::cmpEqual));
+    break;
+  case FCmpInst::FCMP_OGE:
+    Result = (CmpRes != APFloat::cmpUnordered && (CmpRes == APFloat::cmpGreaterThan || CmpRes == APFloat::cmpEqual));
     break;
-  }
 
-  case Instruction::FPToSI: {
-    FPToSIInst *fi = cast<FPToSIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                       "floating point");
-    if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
-      return terminateStateOnExecError(state, "Unsupported FPToSI operation");
-    llvm::APFloat Arg(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
+  case FCmpInst::FCMP_ULT:
+    Result = (CmpRes == APFloat::cmpUnordered || CmpRes == APFloat::cmpLessThan);
+    break;
+  case FCmpInst::FCMP_OLT:
+    Result = (CmpRes != APFloat::cmpUnordered && CmpRes == APFloat::cmpLessThan);
+    break;
 
-    uint64_t value = 0;
-    bool isExact = true;
-#if LLVM_VERSION_CODE >= LLVM_VERSION(16, 0)
-    auto valueRef = llvm::MutableArrayRef(value);
-#else
-    auto valueRef = makeMutableArrayRef(value);
-#endif
-    Arg.convertToInteger(valueRef, resultType, true,
-                         llvm::APFloat::rmTowardZero, &isExact);
-    bindLocal(ki, state, ConstantExpr::alloc(value, resultType));
+  case FCmpInst::FCMP_ULE:
+    Result = (CmpRes == APFloat::cmpUnordered || (CmpRes == APFloat::cmpLessThan || CmpRes == APFloat::cmpEqual));
+    break;
+  case FCmpInst::FCMP_OLE:
+    Result = (CmpRes != APFloat::cmpUnordered && (CmpRes == APFloat::cmpLessThan || CmpRes == APFloat::cmpEqual));
     break;
-  }
 
-  case Instruction::UIToFP: {
-    UIToFPInst *fi = cast<UIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                       "floating point");
-    const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
-    if (!semantics)
-      return terminateStateOnExecError(state, "Unsupported UIToFP operation");
-    llvm::APFloat f(*semantics, 0);
-    f.convertFromAPInt(arg->getAPValue(), false,
-                       llvm::APFloat::rmNearestTiesToEven);
-
-    bindLocal(ki, state, ConstantExpr::alloc(f));
+  case FCmpInst::FCMP_UNE:
+    Result = (CmpRes == APFloat::cmpUnordered || CmpRes != APFloat::cmpEqual);
+    break;
+  case FCmpInst::FCMP_ONE:
+    Result = (CmpRes != APFloat::cmpUnordered && CmpRes != APFloat::cmpEqual);
     break;
-  }
 
-  case Instruction::SIToFP: {
-    SIToFPInst *fi = cast<SIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                       "floating point");
-    const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
-    if (!semantics)
-      return terminateStateOnExecError(state, "Unsupported SIToFP operation");
-    llvm::APFloat f(*semantics, 0);
-    f.convertFromAPInt(arg->getAPValue(), true,
-                       llvm::APFloat::rmNearestTiesToEven);
-
-    bindLocal(ki, state, ConstantExpr::alloc(f));
+  default:
+    assert(0 && "Invalid FCMP predicate!");
+    break;
+  case FCmpInst::FCMP_FALSE:
+    Result = false;
+    break;
+  case FCmpInst::FCMP_TRUE:
+    Result = true;
     break;
   }
 
-  case Instruction::FCmp: {
-    FCmpInst *fi = cast<FCmpInst>(i);
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
-    if (!fpWidthToSemantics(left->getWidth()) ||
-        !fpWidthToSemantics(right->getWidth()))
-      return terminateStateOnExecError(state, "Unsupported FCmp operation");
-
-    APFloat LHS(*fpWidthToSemantics(left->getWidth()),left->getAPValue());
-    APFloat RHS(*fpWidthToSemantics(right->getWidth()),right->getAPValue());
-    APFloat::cmpResult CmpRes = LHS.compare(RHS);
-
-    bool Result = false;
-    switch( fi->getPredicate() ) {
-      // Predicates which only care about whether or not the operands are NaNs.
-    case FCmpInst::FCMP_ORD:
-      Result = (CmpRes != APFloat::cmpUnordered);
-      break;
-
-    case FCmpInst::FCMP_UNO:
-      Result = (CmpRes == APFloat::cmpUnordered);
-      break;
+  bindLocal(ki, state, ConstantExpr::alloc(Result, Expr::Bool));
+}
 
-      // Ordered comparisons return false if either operand is NaN.  Unordered
-      // comparisons return true if either operand is NaN.
-    case FCmpInst::FCMP_UEQ:
-      Result = (CmpRes == APFloat::cmpUnordered || CmpRes == APFloat::cmpEqual);
-      break;
-    case FCmpInst::FCMP_OEQ:
-      Result = (CmpRes != APFloat::cmpUnordered && CmpRes == APFloat::cmpEqual);
-      break;
+void Executor::executeInsertValueInst(ExecutionState &state, KInstruction *ki) {
+  KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 
-    case FCmpInst::FCMP_UGT:
-      Result = (CmpRes == APFloat::cmpUnordered || CmpRes == APFloat::cmpGreaterThan);
-      break;
-    case FCmpInst::FCMP_OGT:
-      Result = (CmpRes != APFloat::cmpUnordered && CmpRes == APFloat::cmpGreaterThan);
-      break;
+  ref<Expr> agg = eval(ki, 0, state).value;
+  ref<Expr> val = eval(ki, 1, state).value;
 
-    case FCmpInst::FCMP_UGE:
-      Result = (CmpRes == APFloat::cmpUnordered || (CmpRes == APFloat::cmpGreaterThan || CmpRes == APFloat::cmpEqual));
-      break;
-    case FCmpInst::FCMP_OGE:
-      Result = (CmpRes != APFloat::cmpUnordered && (CmpRes == APFloat::cmpGreaterThan || CmpRes == APFloat::cmpEqual));
-      break;
+  ref<Expr> l = NULL, r = NULL;
+  unsigned lOffset = kgepi->offset*8, rOffset = kgepi->offset*8 + val->getWidth();
 
-    case FCmpInst::FCMP_ULT:
-      Result = (CmpRes == APFloat::cmpUnordered || CmpRes == APFloat::cmpLessThan);
-      break;
-    case FCmpInst::FCMP_OLT:
-      Result = (CmpRes != APFloat::cmpUnordered && CmpRes == APFloat::cmpLessThan);
-      break;
+  if (lOffset > 0)
+    l = ExtractExpr::create(agg, 0, lOffset);
+  if (rOffset < agg->getWidth())
+    r = ExtractExpr::create(agg, rOffset, agg->getWidth() - rOffset);
 
-    case FCmpInst::FCMP_ULE:
-      Result = (CmpRes == APFloat::cmpUnordered || (CmpRes == APFloat::cmpLessThan || CmpRes == APFloat::cmpEqual));
-      break;
-    case FCmpInst::FCMP_OLE:
-      Result = (CmpRes != APFloat::cmpUnordered && (CmpRes == APFloat::cmpLessThan || CmpRes == APFloat::cmpEqual));
-      break;
+  ref<Expr> result;
+  if (l && r)
+    result = ConcatExpr::create(r, ConcatExpr::create(val, l));
+  else if (l)
+    result = ConcatExpr::create(val, l);
+  else if (r)
+    result = ConcatExpr::create(r, val);
+  else
+    result = val;
 
-    case FCmpInst::FCMP_UNE:
-      Result = (CmpRes == APFloat::cmpUnordered || CmpRes != APFloat::cmpEqual);
-      break;
-    case FCmpInst::FCMP_ONE:
-      Result = (CmpRes != APFloat::cmpUnordered && CmpRes != APFloat::cmpEqual);
-      break;
+  bindLocal(ki, state, result);
+}
 
-    default:
-      assert(0 && "Invalid FCMP predicate!");
-      break;
-    case FCmpInst::FCMP_FALSE:
-      Result = false;
-      break;
-    case FCmpInst::FCMP_TRUE:
-      Result = true;
-      break;
-    }
+void Executor::executeExtractValueInst(ExecutionState &state,
+                                       KInstruction *ki) {
+  KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 
-    bindLocal(ki, state, ConstantExpr::alloc(Result, Expr::Bool));
-    break;
-  }
-  case Instruction::InsertValue: {
-    KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
+  ref<Expr> agg = eval(ki, 0, state).value;
 
-    ref<Expr> agg = eval(ki, 0, state).value;
-    ref<Expr> val = eval(ki, 1, state).value;
+  ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, ki->width);
 
-    ref<Expr> l = NULL, r = NULL;
-    unsigned lOffset = kgepi->offset*8, rOffset = kgepi->offset*8 + val->getWidth();
+  bindLocal(ki, state, result);
+}
 
-    if (lOffset > 0)
-      l = ExtractExpr::create(agg, 0, lOffset);
-    if (rOffset < agg->getWidth())
-      r = ExtractExpr::create(agg, rOffset, agg->getWidth() - rOffset);
+void Executor::executeInsertElementInst(ExecutionState &state,
+                                        KInstruction *ki) {
+  InsertElementInst *iei = cast<InsertElementInst>(ki->inst);
+  ref<Expr> vec = eval(ki, 0, state).value;
+  ref<Expr> newElt = eval(ki, 1, state).value;
+  ref<Expr> idx = eval(ki, 2, state).value;
+
+  ConstantExpr *cIdx = dyn_cast<ConstantExpr>(idx);
+  if (cIdx == NULL) {
+    terminateStateOnExecError(
+        state, "InsertElement, support for symbolic index not implemented");
+    return;
+  }
+  uint64_t iIdx = cIdx->getZExtValue();
+  const auto *vt = cast<llvm::FixedVectorType>(iei->getType());
+  unsigned EltBits = getWidthForLLVMType(vt->getElementType());
 
-    ref<Expr> result;
-    if (l && r)
-      result = ConcatExpr::create(r, ConcatExpr::create(val, l));
-    else if (l)
-      result = ConcatExpr::create(val, l);
-    else if (r)
-      result = ConcatExpr::create(r, val);
-    else
-      result = val;
+  if (iIdx >= vt->getNumElements()) {
+    // Out of bounds write
+    terminateStateOnProgramError(state,
+                                 "Out of bounds write when inserting element",
+                                 StateTerminationType::BadVectorAccess);
+    return;
+  }
 
-    bindLocal(ki, state, result);
-    break;
+  const unsigned elementCount = vt->getNumElements();
+  llvm::SmallVector<ref<Expr>, 8> elems;
+  elems.reserve(elementCount);
+  for (unsigned i = elementCount; i != 0; --i) {
+    auto of = i - 1;
+    unsigned bitOffset = EltBits * of;
+    elems.push_back(
+        of == iIdx ? newElt : ExtractExpr::create(vec, bitOffset, EltBits));
   }
-  case Instruction::ExtractValue: {
-    KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 
-    ref<Expr> agg = eval(ki, 0, state).value;
+  assert(Context::get().isLittleEndian() && "FIXME:Broken for big endian");
+  ref<Expr> Result = ConcatExpr::createN(elementCount, elems.data());
+  bindLocal(ki, state, Result);
+}
 
-    ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, getWidthForLLVMType(i->getType()));
+void Executor::executeExtractElementInst(ExecutionState &state,
+                                         KInstruction *ki) {
+  ExtractElementInst *eei = cast<ExtractElementInst>(ki->inst);
+  ref<Expr> vec = eval(ki, 0, state).value;
+  ref<Expr> idx = eval(ki, 1, state).value;
 
-    bindLocal(ki, state, result);
-    break;
+  ConstantExpr *cIdx = dyn_cast<ConstantExpr>(idx);
+  if (cIdx == NULL) {
+    terminateStateOnExecError(
+        state, "ExtractElement, support for symbolic index not implemented");
+    return;
   }
-  case Instruction::Fence: {
-    // Ignore for now
-    break;
+  uint64_t iIdx = cIdx->getZExtValue();
+  const auto *vt = cast<llvm::FixedVectorType>(eei->getVectorOperandType());
+  unsigned EltBits = getWidthForLLVMType(vt->getElementType());
+
+  if (iIdx >= vt->getNumElements()) {
+    // Out of bounds read
+    terminateStateOnProgramError(state,
+                                 "Out of bounds read when extracting element",
+                                 StateTerminationType::BadVectorAccess);
+    return;
   }
-  case Instruction::InsertElement: {
-    InsertElementInst *iei = cast<InsertElementInst>(i);
-    ref<Expr> vec = eval(ki, 0, state).value;
-    ref<Expr> newElt = eval(ki, 1, state).value;
-    ref<Expr> idx = eval(ki, 2, state).value;
 
-    ConstantExpr *cIdx = dyn_cast<ConstantExpr>(idx);
-    if (cIdx == NULL) {
-      terminateStateOnExecError(
-          state, "InsertElement, support for symbolic index not implemented");
-      return;
-    }
-    uint64_t iIdx = cIdx->getZExtValue();
-    const auto *vt = cast<llvm::FixedVectorType>(iei->getType());
-    unsigned EltBits = getWidthForLLVMType(vt->getElementType());
-
-    if (iIdx >= vt->getNumElements()) {
-      // Out of bounds write
-      terminateStateOnProgramError(state,
-                                   "Out of bounds write when inserting element",
-                                   StateTerminationType::BadVectorAccess);
-      return;
-    }
+  unsigned bitOffset = EltBits * iIdx;
+  ref<Expr> Result = ExtractExpr::create(vec, bitOffset, EltBits);
+  bindLocal(ki, state, Result);
+}
 
-    const unsigned elementCount = vt->getNumElements();
-    llvm::SmallVector<ref<Expr>, 8> elems;
-    elems.reserve(elementCount);
-    for (unsigned i = elementCount; i != 0; --i) {
-      auto of = i - 1;
-      unsigned bitOffset = EltBits * of;
-      elems.push_back(
-          of == iIdx ? newElt : ExtractExpr::create(vec, bitOffset, EltBits));
-    }
+void Executor::executeShuffleVectorInst(ExecutionState &state,
+                                        KInstruction *ki) {
+  // Should never happen due to Scalarizer pass removing ShuffleVector
+  // instructions.
+  terminateStateOnExecError(state, "Unexpected ShuffleVector instruction");
+}
 
-    assert(Context::get().isLittleEndian() && "FIXME:Broken for big endian");
-    ref<Expr> Result = ConcatExpr::createN(elementCount, elems.data());
-    bindLocal(ki, state, Result);
-    break;
+void Executor::executeFenceInst(ExecutionState &state, KInstruction *ki) {
+  // Ignore for now
+}
+
+#ifdef SUPPORT_KLEE_EH_CXX
+void Executor::executeResumeInst(ExecutionState &state, KInstruction *ki) {
+  auto *cui = dyn_cast_or_null<CleanupPhaseUnwindingInformation>(
+      state.unwindingInformation.get());
+
+  if (!cui) {
+    terminateStateOnExecError(
+        state,
+        "resume-instruction executed outside of cleanup phase unwinding");
+    return;
   }
-  case Instruction::ExtractElement: {
-    ExtractElementInst *eei = cast<ExtractElementInst>(i);
-    ref<Expr> vec = eval(ki, 0, state).value;
-    ref<Expr> idx = eval(ki, 1, state).value;
 
-    ConstantExpr *cIdx = dyn_cast<ConstantExpr>(idx);
-    if (cIdx == NULL) {
-      terminateStateOnExecError(
-          state, "ExtractElement, support for symbolic index not implemented");
-      return;
-    }
-    uint64_t iIdx = cIdx->getZExtValue();
-    const auto *vt = cast<llvm::FixedVectorType>(eei->getVectorOperandType());
-    unsigned EltBits = getWidthForLLVMType(vt->getElementType());
-
-    if (iIdx >= vt->getNumElements()) {
-      // Out of bounds read
-      terminateStateOnProgramError(state,
-                                   "Out of bounds read when extracting element",
-                                   StateTerminationType::BadVectorAccess);
-      return;
-    }
+  ref<Expr> arg = eval(ki, 0, state).value;
+  ref<Expr> exceptionPointer = ExtractExpr::create(arg, 0, Expr::Int64);
+  ref<Expr> selectorValue =
+      ExtractExpr::create(arg, Expr::Int64, Expr::Int32);
 
-    unsigned bitOffset = EltBits * iIdx;
-    ref<Expr> Result = ExtractExpr::create(vec, bitOffset, EltBits);
-    bindLocal(ki, state, Result);
-    break;
+  if (!dyn_cast<ConstantExpr>(exceptionPointer) ||
+      !dyn_cast<ConstantExpr>(selectorValue)) {
+    terminateStateOnExecError(
+        state, "resume-instruction called with non constant expression");
+    return;
   }
-  case Instruction::ShuffleVector:
-    // Should never happen due to Scalarizer pass removing ShuffleVector
-    // instructions.
-    terminateStateOnExecError(state, "Unexpected ShuffleVector instruction");
-    break;
 
-#ifdef SUPPORT_KLEE_EH_CXX
-  case Instruction::Resume: {
-    auto *cui = dyn_cast_or_null<CleanupPhaseUnwindingInformation>(
-        state.unwindingInformation.get());
-
-    if (!cui) {
-      terminateStateOnExecError(
-          state,
-          "resume-instruction executed outside of cleanup phase unwinding");
-      break;
-    }
-
-    ref<Expr> arg = eval(ki, 0, state).value;
-    ref<Expr> exceptionPointer = ExtractExpr::create(arg, 0, Expr::Int64);
-    ref<Expr> selectorValue =
-        ExtractExpr::create(arg, Expr::Int64, Expr::Int32);
+  if (!Expr::createIsZero(selectorValue)->isTrue()) {
+    klee_warning("resume-instruction called with non-0 selector value");
+  }
 
-    if (!dyn_cast<ConstantExpr>(exceptionPointer) ||
-        !dyn_cast<ConstantExpr>(selectorValue)) {
-      terminateStateOnExecError(
-          state, "resume-instruction called with non constant expression");
-      break;
-    }
+  if (!EqExpr::create(exceptionPointer, cui->exceptionObject)->isTrue()) {
+    terminateStateOnExecError(
+        state, "resume-instruction called with unexpected exception pointer");
+    return;
+  }
 
-    if (!Expr::createIsZero(selectorValue)->isTrue()) {
-      klee_warning("resume-instruction called with non-0 selector value");
-    }
+  unwindToNextLandingpad(state);
+}
 
-    if (!EqExpr::create(exceptionPointer, cui->exceptionObject)->isTrue()) {
-      terminateStateOnExecError(
-          state, "resume-instruction called with unexpected exception pointer");
-      break;
-    }
+void Executor::executeLandingPadInst(ExecutionState &state, KInstruction *ki) {
+  auto *cui = dyn_cast_or_null<CleanupPhaseUnwindingInformation>(
+      state.unwindingInformation.get());
 
-    unwindToNextLandingpad(state);
-    break;
+  if (!cui) {
+    terminateStateOnExecError(
+        state, "Executing landing pad but not in unwinding phase 2");
+    return;
   }
 
-  case Instruction::LandingPad: {
-    auto *cui = dyn_cast_or_null<CleanupPhaseUnwindingInformation>(
-        state.unwindingInformation.get());
+  ref<ConstantExpr> exceptionPointer = cui->exceptionObject;
+  ref<ConstantExpr> selectorValue;
 
-    if (!cui) {
-      terminateStateOnExecError(
-          state, "Executing landing pad but not in unwinding phase 2");
-      break;
-    }
+  // check on which frame we are currently
+  if (state.stack.size() - 1 == cui->catchingStackIndex) {
+    // we are in the target stack frame, return the selector value
+    // that was returned by the personality fn in phase 1 and stop unwinding.
+    selectorValue = cui->selectorValue;
 
-    ref<ConstantExpr> exceptionPointer = cui->exceptionObject;
-    ref<ConstantExpr> selectorValue;
+    // stop unwinding by cleaning up our unwinding information.
+    state.unwindingInformation.reset();
 
-    // check on which frame we are currently
-    if (state.stack.size() - 1 == cui->catchingStackIndex) {
-      // we are in the target stack frame, return the selector value
-      // that was returned by the personality fn in phase 1 and stop unwinding.
-      selectorValue = cui->selectorValue;
+    // this would otherwise now be a dangling pointer
+    cui = nullptr;
+  } else {
+    // we are not yet at the target stack frame. the landingpad might have
+    // a cleanup clause or not, anyway, we give it the selector value "0",
+    // which represents a cleanup, and expect it to handle it.
+    // This is explicitly allowed by LLVM, see
+    // https://llvm.org/docs/ExceptionHandling.html#id18
+    selectorValue = ConstantExpr::create(0, Expr::Int32);
+  }
 
-      // stop unwinding by cleaning up our unwinding information.
-      state.unwindingInformation.reset();
+  // we have to return a {i8*, i32}
+  ref<Expr> result = ConcatExpr::create(
+      ZExtExpr::create(selectorValue, Expr::Int32), exceptionPointer);
 
-      // this would otherwise now be a dangling pointer
-      cui = nullptr;
-    } else {
-      // we are not yet at the target stack frame. the landingpad might have
-      // a cleanup clause or not, anyway, we give it the selector value "0",
-      // which represents a cleanup, and expect it to handle it.
-      // This is explicitly allowed by LLVM, see
-      // https://llvm.org/docs/ExceptionHandling.html#id18
-      selectorValue = ConstantExpr::create(0, Expr::Int32);
-    }
+  bindLocal(ki, state, result);
+}
+#endif // SUPPORT_KLEE_EH_CXX
 
-    // we have to return a {i8*, i32}
-    ref<Expr> result = ConcatExpr::create(
-        ZExtExpr::create(selectorValue, Expr::Int32), exceptionPointer);
+void Executor::executeAtomicRMWInst(ExecutionState &state, KInstruction *ki) {
+  terminateStateOnExecError(state, "Unexpected Atomic instruction, should be "
+                                   "lowered by LowerAtomicInstructionPass");
+}
 
-    bindLocal(ki, state, result);
+void Executor::executeAtomicCmpXchgInst(ExecutionState &state,
+                                        KInstruction *ki) {
+  terminateStateOnExecError(state,
+                            "Unexpected AtomicCmpXchg instruction, should be "
+                            "lowered by LowerAtomicInstructionPass");
+}
 
-    break;
-  }
-#endif // SUPPORT_KLEE_EH_CXX
+void Executor::executeIllegalInst(ExecutionState &state, KInstruction *ki) {
+  terminateStateOnExecError(state, "illegal instruction");
+}
 
-  case Instruction::AtomicRMW:
-    terminateStateOnExecError(state, "Unexpected Atomic instruction, should be "
-                                     "lowered by LowerAtomicInstructionPass");
-    break;
-  case Instruction::AtomicCmpXchg:
-    terminateStateOnExecError(state,
-                              "Unexpected AtomicCmpXchg instruction, should be "
-                              "lowered by LowerAtomicInstructionPass");
-    break;
-  // Other instructions...
-  // Unhandled
-  default:
-    terminateStateOnExecError(state, "illegal instruction");
-    break;
-  }
+std::vector<Executor::InstructionHandler> Executor::makeInstructionHandlers() {
+  std::vector<InstructionHandler> handlers(Instruction::OtherOpsEnd,
+                                           &Executor::executeIllegalInst);
+
+  // Control flow
+  handlers[Instruction::Ret] = &Executor::executeRetInst;
+  handlers[Instruction::Br] = &Executor::executeBrInst;
+  handlers[Instruction::IndirectBr] = &Executor::executeIndirectBrInst;
+  handlers[Instruction::Switch] = &Executor::executeSwitchInst;
+  handlers[Instruction::Unreachable] = &Executor::executeUnreachableInst;
+  handlers[Instruction::Invoke] = &Executor::executeCallInst;
+  handlers[Instruction::Call] = &Executor::executeCallInst;
+  handlers[Instruction::PHI] = &Executor::executePHIInst;
+
+  // Special instructions
+  handlers[Instruction::Select] = &Executor::executeSelectInst;
+  handlers[Instruction::VAArg] = &Executor::executeVAArgInst;
+
+  // Arithmetic / logical
+  handlers[Instruction::Add] = &Executor::executeBinaryInst<Instruction::Add>;
+  handlers[Instruction::Sub] = &Executor::executeBinaryInst<Instruction::Sub>;
+  handlers[Instruction::Mul] = &Executor::executeBinaryInst<Instruction::Mul>;
+  handlers[Instruction::UDiv] = &Executor::executeBinaryInst<Instruction::UDiv>;
+  handlers[Instruction::SDiv] = &Executor::executeBinaryInst<Instruction::SDiv>;
+  handlers[Instruction::URem] = &Executor::executeBinaryInst<Instruction::URem>;
+  handlers[Instruction::SRem] = &Executor::executeBinaryInst<Instruction::SRem>;
+  handlers[Instruction::And] = &Executor::executeBinaryInst<Instruction::And>;
+  handlers[Instruction::Or] = &Executor::executeBinaryInst<Instruction::Or>;
+  handlers[Instruction::Xor] = &Executor::executeBinaryInst<Instruction::Xor>;
+  handlers[Instruction::Shl] = &Executor::executeBinaryInst<Instruction::Shl>;
+  handlers[Instruction::LShr] = &Executor::executeBinaryInst<Instruction::LShr>;
+  handlers[Instruction::AShr] = &Executor::executeBinaryInst<Instruction::AShr>;
+
+  // Compare
+  handlers[Instruction::ICmp] = &Executor::executeICmpInst;
+
+  // Memory instructions
+  handlers[Instruction::Alloca] = &Executor::executeAllocaInst;
+  handlers[Instruction::Load] = &Executor::executeLoadInst;
+  handlers[Instruction::Store] = &Executor::executeStoreInst;
+  handlers[Instruction::GetElementPtr] = &Executor::executeGetElementPtrInst;
+
+  // Conversion
+  handlers[Instruction::Trunc] =
+      &Executor::executeIntCastInst<Instruction::Trunc>;
+  handlers[Instruction::ZExt] =
+      &Executor::executeIntCastInst<Instruction::ZExt>;
+  handlers[Instruction::SExt] =
+      &Executor::executeIntCastInst<Instruction::SExt>;
+  handlers[Instruction::IntToPtr] = &Executor::executePtrIntCastInst;
+  handlers[Instruction::PtrToInt] = &Executor::executePtrIntCastInst;
+  handlers[Instruction::BitCast] = &Executor::executeBitCastInst;
+
+  // Floating point instructions
+  handlers[Instruction::FNeg] = &Executor::executeFNegInst;
+  handlers[Instruction::FAdd] = &Executor::executeFAddInst;
+  handlers[Instruction::FSub] = &Executor::executeFSubInst;
+  handlers[Instruction::FMul] = &Executor::executeFMulInst;
+  handlers[Instruction::FDiv] = &Executor::executeFDivInst;
+  handlers[Instruction::FRem] = &Executor::executeFRemInst;
+  handlers[Instruction::FPTrunc] = &Executor::executeFPTruncInst;
+  handlers[Instruction::FPExt] = &Executor::executeFPExtInst;
+  handlers[Instruction::FPToUI] = &Executor::executeFPToUIInst;
+  handlers[Instruction::FPToSI] = &Executor::executeFPToSIInst;
+  handlers[Instruction::UIToFP] = &Executor::executeUIToFPInst;
+  handlers[Instruction::SIToFP] = &Executor::executeSIToFPInst;
+  handlers[Instruction::FCmp] = &Executor::executeFCmpInst;
+
+  // Aggregate and vector instructions
+  handlers[Instruction::InsertValue] = &Executor::executeInsertValueInst;
+  handlers[Instruction::ExtractValue] = &Executor::executeExtractValueInst;
+  handlers[Instruction::InsertElement] = &Executor::executeInsertElementInst;
+  handlers[Instruction::ExtractElement] = &Executor::executeExtractElementInst;
+  handlers[Instruction::ShuffleVector] = &Executor::executeShuffleVectorInst;
+
+  // Other instructions
+  handlers[Instruction::Fence] = &Executor::executeFenceInst;
+#ifdef SUPPORT_KLEE_EH_CXX
+  handlers[Instruction::Resume] = &Executor::executeResumeInst;
+  handlers[Instruction::LandingPad] = &Executor::executeLandingPadInst;
+#endif
+  handlers[Instruction::AtomicRMW] = &Executor::executeAtomicRMWInst;
+  handlers[Instruction::AtomicCmpXchg] = &Executor::executeAtomicCmpXchgInst;
+
+  return handlers;
+}
+
+const std::vector<Executor::InstructionHandler> Executor::instructionHandlers =
+    Executor::makeInstructionHandlers();
+
+void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
+  assert(ki->opcode < instructionHandlers.size() && "invalid opcode");
+  (this->*instructionHandlers[ki->opcode])(state, ki);
 }
 
 void Executor::updateStates(ExecutionState *current) {
@@ -3412,10 +3672,7 @@ void Executor::updateStates(ExecutionState *current) {
     std::set<ExecutionState*>::iterator it2 = states.find(es);
     assert(it2!=states.end());
     states.erase(it2);
-    std::map<ExecutionState*, std::vector<SeedInfo> >::iterator it3 = 
-      seedMap.find(es);
-    if (it3 != seedMap.end())
-      seedMap.erase(it3);
+    seedMap.erase(es);
     executionTree->remove(es->executionTreeNode);
     delete es;
   }
@@ -3534,18 +3791,28 @@ void Executor::bindInstructionConstants(KInstruction *KI) {
 }
 
 void Executor::bindModuleConstants() {
-  for (auto &kfp : kmodule->functions) {
-    KFunction *kf = kfp.get();
-    for (unsigned i=0; i<kf->numInstructions; ++i)
-      bindInstructionConstants(kf->instructions[i]);
-  }
+  constantsBound = true;
+  for (unsigned i = kmodule->constantTable.size();
+       i < kmodule->constants.size(); ++i)
+    kmodule->constantTable.push_back({evalConstant(kmodule->constants[i])});
+}
 
-  kmodule->constantTable =
-      std::unique_ptr<Cell[]>(new Cell[kmodule->constants.size()]);
-  for (unsigned i=0; i<kmodule->constants.size(); ++i) {
-    Cell &c = kmodule->constantTable[i];
-    c.value = evalConstant(kmodule->constants[i]);
-  }
+KFunction *Executor::getKFunction(Function *f) {
+  auto it = kmodule->functionMap.find(f);
+  if (it != kmodule->functionMap.end())
+    return it->second;
+
+  KFunction *kf = kmodule->getKFunction(f);
+  for (unsigned i=0; i<kf->numInstructions; ++i)
+    bindInstructionConstants(kf->instructions[i]);
+  if (AutoMerge && !f->isDeclaration())
+    kf->computeMergePoints();
+
+  // Constants first used by this function have to be evaluated before it
+  // runs; until then, run() evaluates them together with all others.
+  if (constantsBound)
+    bindModuleConstants();
+  return kf;
 }
 
 bool Executor::checkMemoryUsage() {
@@ -3611,27 +3878,24 @@ void Executor::run(ExecutionState &initialState) {
   states.insert(&initialState);
 
   if (usingSeeds) {
-    std::vector<SeedInfo> &v = seedMap[&initialState];
-    
     for (std::vector<KTest*>::const_iterator it = usingSeeds->begin(), 
            ie = usingSeeds->end(); it != ie; ++it)
-      v.push_back(SeedInfo(*it));
+      seedMap.add(&initialState, SeedInfo(*it));
 
     int lastNumSeeds = usingSeeds->size()+10;
     time::Point lastTime, startTime = lastTime = time::getWallTime();
-    ExecutionState *lastState = 0;
+    std::uint32_t lastID = 0;
     while (!seedMap.empty()) {
       if (haltExecution) {
         doDumpStates();
         return;
       }
 
-      std::map<ExecutionState*, std::vector<SeedInfo> >::iterator it = 
-        seedMap.upper_bound(lastState);
+      auto it = seedMap.upper_bound(lastID);
       if (it == seedMap.end())
         it = seedMap.begin();
-      lastState = it->first;
-      ExecutionState &state = *lastState;
+      ExecutionState &state = *it->first;
+      lastID = state.getID();
       KInstruction *ki = state.pc;
       stepInstruction(state);
 
@@ -3643,13 +3907,8 @@ void Executor::run(ExecutionState &initialState) {
       updateStates(&state);
 
       if ((stats::instructions % 1000) == 0) {
-        int numSeeds = 0, numStates = 0;
-        for (std::map<ExecutionState*, std::vector<SeedInfo> >::iterator
-               it = seedMap.begin(), ie = seedMap.end();
-             it != ie; ++it) {
-          numSeeds += it->second.size();
-          numStates++;
-        }
+        int numSeeds = seedMap.totalSeeds();
+        int numStates = seedMap.numStates();
         const auto time = time::getWallTime();
         const time::Span seedTime(SeedTime);
         if (seedTime && time > startTime + seedTime) {
@@ -3681,7 +3940,23 @@ void Executor::run(ExecutionState &initialState) {
 
   // main interpreter loop
   while (!states.empty() && !haltExecution) {
-    ExecutionState &state = searcher->selectState();
+    ExecutionState *selected = &searcher->selectState();
+    if (searchLog) {
+      // The searcher still selects a state when replaying, so that it
+      // consumes the random number generator exactly as when recording.
+      std::uint32_t id = searchLog->select(selected->getID());
+      if (id != selected->getID()) {
+        auto it = states.find(id);
+        if (it == states.end())
+          searchLog->missingState(id);
+        selected = *it;
+      }
+    }
+    ExecutionState &state = *selected;
+    if (AutoMerge && closeAutoMerge(state)) {
+      updateStates(&state);
+      continue;
+    }
     KInstruction *ki = state.pc;
     stepInstruction(state);
 
@@ -3702,6 +3977,9 @@ void Executor::run(ExecutionState &initialState) {
   delete searcher;
   searcher = nullptr;
 
+  if (searchLog && !haltExecution)
+    searchLog->finish();
+
   doDumpStates();
 }
 
@@ -3766,6 +4044,7 @@ void Executor::terminateState(ExecutionState &state,
 
   interpreterHandler->incPathsExplored();
   executionTree->setTerminationType(state, reason);
+  stats::mergedPathsSaved += state.mergedPaths - 1;
 
   std::vector<ExecutionState *>::iterator it =
       std::find(addedStates.begin(), addedStates.end(), &state);
@@ -3775,10 +4054,7 @@ void Executor::terminateState(ExecutionState &state,
     removedStates.push_back(&state);
   } else {
     // never reached searcher, just delete immediately
-    std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it3 = 
-      seedMap.find(&state);
-    if (it3 != seedMap.end())
-      seedMap.erase(it3);
+    seedMap.erase(&state);
     addedStates.erase(it);
     executionTree->remove(state.executionTreeNode);
     delete &state;
@@ -3918,7 +4194,7 @@ void Executor::terminateStateOnError(ExecutionState &state,
     if (!ii.file.empty()) {
       msg << "File: " << ii.file << '\n'
           << "Line: " << ii.line << '\n'
-          << "assembly.ll line: " << ii.assemblyLine << '\n'
+          << "assembly.ll line: " << ii.getAssemblyLine() << '\n'
           << "State: " << state.getID() << '\n';
     }
     msg << "Stack: \n";
@@ -4414,10 +4690,40 @@ void Executor::executeMemoryOperation(ExecutionState &state,
                                       ref<Expr> address,
                                       ref<Expr> value /* undef if read */,
                                       KInstruction *target /* undef if write */) {
-  Expr::Width type = (isWrite ? value->getWidth() : 
-                     getWidthForLLVMType(target->inst->getType()));
+  Expr::Width type = (isWrite ? value->getWidth() : target->width);
   unsigned bytes = Expr::getMinBytesForWidth(type);
 
+  // Fast path: a concrete address inside a single object needs neither the
+  // solver nor bounds check expressions.
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(address)) {
+    ObjectPair op;
+    if (state.addressSpace.resolveOne(CE->getZExtValue(), op)) {
+      const MemoryObject *mo = op.first;
+      uint64_t offset = CE->getZExtValue() - mo->address;
+      if (bytes <= mo->size && offset <= mo->size - bytes) {
+        const ObjectState *os = op.second;
+        if (isWrite) {
+          if (os->readOnly) {
+            terminateStateOnProgramError(state,
+                                         "memory error: object read only",
+                                         StateTerminationType::ReadOnly);
+          } else {
+            ObjectState *wos = state.addressSpace.getWriteable(mo, os);
+            wos->write(offset, value);
+          }
+        } else {
+          ref<Expr> result = os->read(offset, type);
+
+          if (interpreterOpts.MakeConcreteSymbolic)
+            result = replaceReadWithSymbolic(state, result);
+
+          bindLocal(target, state, result);
+        }
+        return;
+      }
+    }
+  }
+
   if (SimplifySymIndices) {
     if (!isa<ConstantExpr>(address))
       address = ConstraintManager::simplifyExpr(state.constraints, address);
@@ -4492,7 +4798,8 @@ void Executor::executeMemoryOperation(ExecutionState &state,
         const ObjectState *os = op.second;
         if (isWrite) {
           if (os->readOnly) {
-            terminateStateOnProgramError(state, "memory error: object read only",
+            terminateStateOnProgramError(state,
+                                         "memory error: object read only",
                                          StateTerminationType::ReadOnly);
           } else {
             ObjectState *wos = state.addressSpace.getWriteable(mo, os);
@@ -4690,7 +4997,7 @@ void Executor::runFunctionAsMain(Function *f,
   for (envc=0; envp[envc]; ++envc) ;
 
   unsigned NumPtrBytes = Context::get().getPointerWidth() / 8;
-  KFunction *kf = kmodule->functionMap[f];
+  KFunction *kf = getKFunction(f);
   assert(kf);
   Function::arg_iterator ai = f->arg_begin(), ae = f->arg_end();
   if (ai!=ae) {
@@ -4718,7 +5025,7 @@ void Executor::runFunctionAsMain(Function *f,
   }
 
   ExecutionState *state =
-      new ExecutionState(kmodule->functionMap[f], memory.get());
+      new ExecutionState(getKFunction(f), memory.get());
 
   if (pathWriter) 
     state->pathOS = pathWriter->open();
@@ -4872,7 +5179,11 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
 
 void Executor::getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res) {
-  res = state.coveredLines;
+  res.clear();
+  state.coveredInstructions.forEach([&](unsigned id) {
+    const InstructionInfo &ii = kmodule->infos->getInfo(id);
+    res[&ii.file].insert(ii.line);
+  });
 }
 
 void Executor::doImpliedValueConcretization(ExecutionState &state,
@@ -4986,6 +5297,10 @@ void Executor::prepareForEarlyExit() {
     // Make sure stats get flushed out
     statsTracker->done();
   }
+
+  // Make sure all execution tree nodes are in the database
+  if (executionTree)
+    executionTree->flush();
 }
 
 /// Returns the errno location in memory
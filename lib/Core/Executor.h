@@ -16,6 +16,7 @@
 #define KLEE_EXECUTOR_H
 
 #include "ExecutionState.h"
+#include "SeedMap.h"
 #include "UserSearcher.h"
 
 #include "klee/ADT/RNG.h"
@@ -60,6 +61,7 @@ namespace llvm {
 namespace klee {
 class Array;
 struct Cell;
+class ConcreteJIT;
 class ExecutionState;
 class ExternalDispatcher;
 class Expr;
@@ -67,6 +69,7 @@ class InstructionInfoTable;
 class KCallable;
 struct KFunction;
 struct KInstruction;
+struct KBranchInstruction;
 class KInstIterator;
 class KModule;
 class MemoryManager;
@@ -74,6 +77,7 @@ class MemoryObject;
 class ObjectState;
 class ExecutionTree;
 class Searcher;
+class SearchLog;
 class SeedInfo;
 class SpecialFunctionHandler;
 struct StackFrame;
@@ -89,6 +93,7 @@ template <class T> class ref;
 /// removedStates, and haltExecution, among others.
 
 class Executor : public Interpreter {
+  friend class ConcreteJIT;
   friend class OwningSearcher;
   friend class WeightedRandomSearcher;
   friend class SpecialFunctionHandler;
@@ -105,6 +110,34 @@ public:
 
 private:
   std::unique_ptr<KModule> kmodule;
+  /// Whether the constant table has been initialized by run().
+  bool constantsBound = false;
+
+  /// Fills in the contents of a global variable from its initializer the
+  /// first time the variable is accessed (--lazy-global-init). The contents
+  /// of read-only globals are kept in one shared image, whose pages are only
+  /// backed by memory once a global on them is initialized.
+  class GlobalInitializer : public LazyInitializer {
+    Executor &executor;
+    /// Anonymous mapping holding the contents of the read-only globals
+    std::uint8_t *image = nullptr;
+    std::size_t imageSize = 0;
+    /// Offset of each read-only global in the image
+    std::unordered_map<const MemoryObject *, std::size_t> imageOffsets;
+    /// Globals whose address is only ever used to load from or store to
+    /// them, which external code therefore cannot reach
+    std::set<const MemoryObject *> unreachable;
+    bool prepared = false;
+
+  public:
+    explicit GlobalInitializer(Executor &executor) : executor(executor) {}
+    ~GlobalInitializer() override;
+    /// Lays out the image and finds the unreachable globals of the module
+    void prepare();
+    void initialize(ObjectState &os) const override;
+    std::uint8_t *getReadOnlyStore(const ObjectState &os) const override;
+    bool isReachableExternally(const MemoryObject *mo) const override;
+  } globalInitializer{*this};
   InterpreterHandler *interpreterHandler;
   Searcher *searcher;
 
@@ -115,6 +148,7 @@ private:
   StatsTracker *statsTracker;
   TreeStreamWriter *pathWriter, *symPathWriter;
   SpecialFunctionHandler *specialFunctionHandler;
+  std::unique_ptr<ConcreteJIT> concreteJIT;
   TimerGroup timers;
   std::unique_ptr<ExecutionTree> executionTree;
 
@@ -130,13 +164,13 @@ private:
   std::vector<ExecutionState *> removedStates;
 
   /// When non-empty the Executor is running in "seed" mode. The
-  /// states in this map will be executed in an arbitrary order
+  /// states in this map will be executed in round-robin order
   /// (outside the normal search interface) until they terminate. When
   /// the states reach a symbolic branch then either direction that
   /// satisfies one or more seeds will be added to this map. What
   /// happens with other states (that don't satisfy the seeds) depends
   /// on as-yet-to-be-determined flags.
-  std::map<ExecutionState*, std::vector<SeedInfo> > seedMap;
+  SeedMap seedMap;
 
   /// Map of globals to their representative memory object.
   std::map<const llvm::GlobalValue*, MemoryObject*> globalObjects;
@@ -192,6 +226,9 @@ private:
   /// File to print executed instructions to
   std::unique_ptr<llvm::raw_ostream> debugInstFile;
 
+  /// Log of searcher decisions and fork outcomes being recorded or replayed
+  std::unique_ptr<SearchLog> searchLog;
+
   // @brief Buffer used by logBuffer
   std::string debugBufferString;
 
@@ -215,6 +252,62 @@ private:
   
   void executeInstruction(ExecutionState &state, KInstruction *ki);
 
+  /// Executes an instruction of the opcode it is registered for.
+  typedef void (Executor::*InstructionHandler)(ExecutionState &state,
+                                               KInstruction *ki);
+
+  /// The handler of each opcode, indexed by KInstruction::opcode.
+  static const std::vector<InstructionHandler> instructionHandlers;
+  static std::vector<InstructionHandler> makeInstructionHandlers();
+
+  // Instruction handlers. The integer arithmetic, comparison and cast
+  // handlers compute results whose operands are all concrete and at most 64
+  // bits wide with native arithmetic, unless --concrete-fast-path=false.
+  void executeRetInst(ExecutionState &state, KInstruction *ki);
+  void executeBrInst(ExecutionState &state, KInstruction *ki);
+  void executeIndirectBrInst(ExecutionState &state, KInstruction *ki);
+  void executeSwitchInst(ExecutionState &state, KInstruction *ki);
+  void executeUnreachableInst(ExecutionState &state, KInstruction *ki);
+  void executeCallInst(ExecutionState &state, KInstruction *ki);
+  void executePHIInst(ExecutionState &state, KInstruction *ki);
+  void executeSelectInst(ExecutionState &state, KInstruction *ki);
+  void executeVAArgInst(ExecutionState &state, KInstruction *ki);
+  template <unsigned Opcode>
+  void executeBinaryInst(ExecutionState &state, KInstruction *ki);
+  void executeICmpInst(ExecutionState &state, KInstruction *ki);
+  void executeAllocaInst(ExecutionState &state, KInstruction *ki);
+  void executeLoadInst(ExecutionState &state, KInstruction *ki);
+  void executeStoreInst(ExecutionState &state, KInstruction *ki);
+  void executeGetElementPtrInst(ExecutionState &state, KInstruction *ki);
+  template <unsigned Opcode>
+  void executeIntCastInst(ExecutionState &state, KInstruction *ki);
+  void executePtrIntCastInst(ExecutionState &state, KInstruction *ki);
+  void executeBitCastInst(ExecutionState &state, KInstruction *ki);
+  void executeFNegInst(ExecutionState &state, KInstruction *ki);
+  void executeFAddInst(ExecutionState &state, KInstruction *ki);
+  void executeFSubInst(ExecutionState &state, KInstruction *ki);
+  void executeFMulInst(ExecutionState &state, KInstruction *ki);
+  void executeFDivInst(ExecutionState &state, KInstruction *ki);
+  void executeFRemInst(ExecutionState &state, KInstruction *ki);
+  void executeFPTruncInst(ExecutionState &state, KInstruction *ki);
+  void executeFPExtInst(ExecutionState &state, KInstruction *ki);
+  void executeFPToUIInst(ExecutionState &state, KInstruction *ki);
+  void executeFPToSIInst(ExecutionState &state, KInstruction *ki);
+  void executeUIToFPInst(ExecutionState &state, KInstruction *ki);
+  void executeSIToFPInst(ExecutionState &state, KInstruction *ki);
+  void executeFCmpInst(ExecutionState &state, KInstruction *ki);
+  void executeInsertValueInst(ExecutionState &state, KInstruction *ki);
+  void executeExtractValueInst(ExecutionState &state, KInstruction *ki);
+  void executeFenceInst(ExecutionState &state, KInstruction *ki);
+  void executeInsertElementInst(ExecutionState &state, KInstruction *ki);
+  void executeExtractElementInst(ExecutionState &state, KInstruction *ki);
+  void executeShuffleVectorInst(ExecutionState &state, KInstruction *ki);
+  void executeResumeInst(ExecutionState &state, KInstruction *ki);
+  void executeLandingPadInst(ExecutionState &state, KInstruction *ki);
+  void executeAtomicRMWInst(ExecutionState &state, KInstruction *ki);
+  void executeAtomicCmpXchgInst(ExecutionState &state, KInstruction *ki);
+  void executeIllegalInst(ExecutionState &state, KInstruction *ki);
+
   void run(ExecutionState &initialState);
 
   // Given a concrete object in our [klee's] address space, add it to 
@@ -223,9 +316,8 @@ private:
                                   unsigned size, bool isReadOnly);
 
   void initializeGlobalAlias(const llvm::Constant *c);
-  void initializeGlobalObject(ExecutionState &state, ObjectState *os, 
-			      const llvm::Constant *c,
-			      unsigned offset);
+  void initializeGlobalObject(ObjectState *os, const llvm::Constant *c,
+                              unsigned offset);
   void initializeGlobals(ExecutionState &state);
   void allocateGlobalObjects(ExecutionState &state);
   void initializeGlobalAliases();
@@ -236,6 +328,10 @@ private:
   void transferToBasicBlock(llvm::BasicBlock *dst, 
 			    llvm::BasicBlock *src,
 			    ExecutionState &state);
+  /// Transfer state to the successor with the given index of kbi, as
+  /// decoded by KModule.
+  void transferToSuccessor(const KBranchInstruction *kbi, unsigned index,
+                           ExecutionState &state);
 
   void callExternalFunction(ExecutionState &state,
                             KInstruction *target,
@@ -322,6 +418,26 @@ private:
   void executeMakeSymbolic(ExecutionState &state, const MemoryObject *mo,
                            const std::string &name);
 
+  /// Open an automatic merge of the states just forked at the branch ki,
+  /// if ki has a merge point (see --auto-merge). branches may include NULL
+  /// pointers.
+  void openAutoMerge(KInstruction *ki,
+                     const std::vector<ExecutionState *> &branches);
+
+  /// Pause state, or merge it into a paused state, if it reached the close
+  /// point of its innermost automatic merge. Returns true if it did.
+  bool closeAutoMerge(ExecutionState &state);
+
+  /// Return the value of e under each of the given seeds of state, asking
+  /// the solver only for values the seeds do not determine.
+  std::vector<ref<ConstantExpr>>
+  getSeedValues(ExecutionState &state, const std::vector<SeedInfo> &seeds,
+                ref<Expr> e);
+
+  /// Returns a random number in [0, bound) for a choice made while forking,
+  /// taken from the search log when replaying one.
+  unsigned getForkChoice(unsigned bound);
+
   /// Create a new state where each input condition has been added as
   /// a constraint and return the results. The input state is included
   /// as one of the results. Note that the output vector may include
@@ -355,12 +471,12 @@ private:
   Cell& getArgumentCell(ExecutionState &state,
                         KFunction *kf,
                         unsigned index) {
-    return state.stack.back().locals[kf->getArgRegister(index)];
+    return state.stack.back().getWritableLocal(kf->getArgRegister(index));
   }
 
   Cell& getDestCell(ExecutionState &state,
                     KInstruction *target) {
-    return state.stack.back().locals[target->dest];
+    return state.stack.back().getWritableLocal(target->dest);
   }
 
   void bindLocal(KInstruction *target, 
@@ -476,9 +592,13 @@ private:
                                  const llvm::Twine &message,
                                  bool writeErr = true);
 
-  /// bindModuleConstants - Initialize the module constant table.
+  /// bindModuleConstants - Initialize the module constant table, or extend
+  /// it with the constants of KFunctions built since.
   void bindModuleConstants();
 
+  /// Return the KFunction for f, building and binding it on first use.
+  KFunction *getKFunction(llvm::Function *f);
+
   template <typename TypeIt>
   void computeOffsetsSeqTy(KGEPInstruction *kgepi,
                            ref<ConstantExpr> &constantOffset, uint64_t index,
@@ -86,6 +86,8 @@ ObjectState::ObjectState(const MemoryObject *mo)
     knownSymbolics(nullptr),
     unflushedMask(nullptr),
     updates(nullptr, nullptr),
+    lazyInit(nullptr),
+    ownsConcreteStore(true),
     size(mo->size),
     readOnly(false) {
   if (!UseConstantArrays) {
@@ -106,37 +108,83 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
     knownSymbolics(nullptr),
     unflushedMask(nullptr),
     updates(array, nullptr),
+    lazyInit(nullptr),
+    ownsConcreteStore(true),
     size(mo->size),
     readOnly(false) {
   makeSymbolic();
   memset(concreteStore, 0, size);
 }
 
+ObjectState::ObjectState(const MemoryObject *mo, const LazyInitializer *init)
+  : copyOnWriteOwner(0),
+    object(mo),
+    concreteStore(nullptr),
+    concreteMask(nullptr),
+    knownSymbolics(nullptr),
+    unflushedMask(nullptr),
+    updates(nullptr, nullptr),
+    lazyInit(init),
+    ownsConcreteStore(true),
+    size(mo->size),
+    readOnly(false) {
+  if (!UseConstantArrays) {
+    static unsigned id = 0;
+    const Array *array =
+        getArrayCache()->CreateArray("tmp_arr" + llvm::utostr(++id), size);
+    updates = UpdateList(array, 0);
+  }
+}
+
 ObjectState::ObjectState(const ObjectState &os) 
   : copyOnWriteOwner(0),
     object(os.object),
     concreteStore(new uint8_t[os.size]),
     concreteMask(os.concreteMask ? new BitArray(*os.concreteMask, os.size) : nullptr),
-    knownSymbolics(nullptr),
+    knownSymbolics(os.knownSymbolics && !os.knownSymbolics->empty()
+                       ? new AdaptiveArray<ref<Expr>>(*os.knownSymbolics)
+                       : nullptr),
     unflushedMask(os.unflushedMask ? new BitArray(*os.unflushedMask, os.size) : nullptr),
     updates(os.updates),
+    lazyInit(nullptr),
+    ownsConcreteStore(true),
     size(os.size),
     readOnly(false) {
   assert(!os.readOnly && "no need to copy read only object?");
-  if (os.knownSymbolics) {
-    knownSymbolics = new ref<Expr>[size];
-    for (unsigned i=0; i<size; i++)
-      knownSymbolics[i] = os.knownSymbolics[i];
-  }
-
+  os.materialize();
   memcpy(concreteStore, os.concreteStore, size*sizeof(*concreteStore));
 }
 
 ObjectState::~ObjectState() {
   delete concreteMask;
   delete unflushedMask;
-  delete[] knownSymbolics;
-  delete[] concreteStore;
+  delete knownSymbolics;
+  if (ownsConcreteStore)
+    delete[] concreteStore;
+}
+
+void ObjectState::runLazyInit() const {
+  // Producing the contents does not change the value of the object, so
+  // this may happen on a const object shared between states.
+  auto self = const_cast<ObjectState *>(this);
+  const LazyInitializer *init = lazyInit;
+  self->lazyInit = nullptr;
+
+  uint8_t *store = readOnly ? init->getReadOnlyStore(*this) : nullptr;
+  if (store) {
+    // provided memory is zeroed already
+    self->concreteStore = store;
+    self->ownsConcreteStore = false;
+  } else {
+    self->concreteStore = new uint8_t[size];
+    memset(concreteStore, 0, size);
+  }
+  init->initialize(*self);
+
+  // initialise constant memory that may be used with external calls; the
+  // private copy is kept to detect external writes to it
+  if (readOnly && size)
+    memcpy(reinterpret_cast<void *>(object->address), concreteStore, size);
 }
 
 ArrayCache *ObjectState::getArrayCache() const {
@@ -199,6 +247,7 @@ const UpdateList &ObjectState::getUpdates() const {
 
 void ObjectState::flushToConcreteStore(Executor &executor,
                                        ExecutionState &state, bool concretize) {
+  materialize();
   for (unsigned i = 0; i < size; i++) {
     if (isByteConcrete(i))
       continue;
@@ -213,7 +262,7 @@ void ObjectState::flushToConcreteStore(Executor &executor,
 void ObjectState::makeConcrete() {
   delete concreteMask;
   delete unflushedMask;
-  delete[] knownSymbolics;
+  delete knownSymbolics;
   concreteMask = nullptr;
   unflushedMask = nullptr;
   knownSymbolics = nullptr;
@@ -232,11 +281,13 @@ void ObjectState::makeSymbolic() {
 }
 
 void ObjectState::initializeToZero() {
+  materialize();
   makeConcrete();
   memset(concreteStore, 0, size);
 }
 
 void ObjectState::initializeToRandom() {  
+  materialize();
   makeConcrete();
   for (unsigned i=0; i<size; i++) {
     // randomly selected by 256 sided die
@@ -270,10 +321,9 @@ void ObjectState::flushRangeForRead(unsigned rangeBase,
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
                        ConstantExpr::create(concreteStore[offset], Expr::Int8));
       } else {
-        assert(isByteKnownSymbolic(offset) &&
-               "invalid bit set in unflushedMask");
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
+        const ref<Expr> *value = getKnownSymbolic(offset);
+        assert(value && "invalid bit set in unflushedMask");
+        updates.extend(ConstantExpr::create(offset, Expr::Int32), *value);
       }
 
       unflushedMask->unset(offset);
@@ -292,24 +342,24 @@ void ObjectState::flushRangeForWrite(unsigned rangeBase, unsigned rangeSize) {
                        ConstantExpr::create(concreteStore[offset], Expr::Int8));
         markByteSymbolic(offset);
       } else {
-        assert(isByteKnownSymbolic(offset) &&
-               "invalid bit set in unflushedMask");
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
-        setKnownSymbolic(offset, 0);
+        const ref<Expr> *value = getKnownSymbolic(offset);
+        assert(value && "invalid bit set in unflushedMask");
+        updates.extend(ConstantExpr::create(offset, Expr::Int32), *value);
       }
 
       unflushedMask->unset(offset);
-    } else {
+    } else if (isByteConcrete(offset)) {
       // flushed bytes that are written over still need
       // to be marked out
-      if (isByteConcrete(offset)) {
-        markByteSymbolic(offset);
-      } else if (isByteKnownSymbolic(offset)) {
-        setKnownSymbolic(offset, 0);
-      }
+      markByteSymbolic(offset);
     }
   }
+
+  // All known symbolic values in the range are in the update list now; drop
+  // them in one go rather than byte by byte, which is quadratic for the
+  // sparse representation.
+  if (knownSymbolics)
+    knownSymbolics->eraseRange(rangeBase, rangeBase + rangeSize);
 }
 
 bool ObjectState::isByteConcrete(unsigned offset) const {
@@ -321,7 +371,11 @@ bool ObjectState::isByteUnflushed(unsigned offset) const {
 }
 
 bool ObjectState::isByteKnownSymbolic(unsigned offset) const {
-  return knownSymbolics && knownSymbolics[offset].get();
+  return getKnownSymbolic(offset) != nullptr;
+}
+
+const ref<Expr> *ObjectState::getKnownSymbolic(unsigned offset) const {
+  return knownSymbolics ? knownSymbolics->lookup(offset) : nullptr;
 }
 
 void ObjectState::markByteConcrete(unsigned offset) {
@@ -351,11 +405,11 @@ void ObjectState::markByteFlushed(unsigned offset) {
 void ObjectState::setKnownSymbolic(unsigned offset, 
                                    Expr *value /* can be null */) {
   if (knownSymbolics) {
-    knownSymbolics[offset] = value;
+    knownSymbolics->set(offset, value);
   } else {
     if (value) {
-      knownSymbolics = new ref<Expr>[size];
-      knownSymbolics[offset] = value;
+      knownSymbolics = new AdaptiveArray<ref<Expr>>(size);
+      knownSymbolics->set(offset, value);
     }
   }
 }
@@ -363,10 +417,11 @@ void ObjectState::setKnownSymbolic(unsigned offset,
 /***/
 
 ref<Expr> ObjectState::read8(unsigned offset) const {
+  materialize();
   if (isByteConcrete(offset)) {
     return ConstantExpr::create(concreteStore[offset], Expr::Int8);
-  } else if (isByteKnownSymbolic(offset)) {
-    return knownSymbolics[offset];
+  } else if (const ref<Expr> *value = getKnownSymbolic(offset)) {
+    return *value;
   } else {
     assert(!isByteUnflushed(offset) && "unflushed byte without cache value");
     
@@ -375,7 +430,19 @@ ref<Expr> ObjectState::read8(unsigned offset) const {
   }    
 }
 
+bool ObjectState::readConcrete(unsigned offset, unsigned bytes,
+                               uint8_t *buf) const {
+  materialize();
+  for (unsigned i = 0; i < bytes; ++i) {
+    if (!isByteConcrete(offset + i))
+      return false;
+    buf[i] = concreteStore[offset + i];
+  }
+  return true;
+}
+
 ref<Expr> ObjectState::read8(ref<Expr> offset) const {
+  materialize();
   assert(!isa<ConstantExpr>(offset) &&
          "constant offset passed to symbolic read8");
   unsigned base, size;
@@ -397,6 +464,7 @@ ref<Expr> ObjectState::read8(ref<Expr> offset) const {
 }
 
 void ObjectState::write8(unsigned offset, uint8_t value) {
+  materialize();
   //assert(read_only == false && "writing to read-only object!");
   concreteStore[offset] = value;
   setKnownSymbolic(offset, 0);
@@ -406,6 +474,7 @@ void ObjectState::write8(unsigned offset, uint8_t value) {
 }
 
 void ObjectState::write8(unsigned offset, ref<Expr> value) {
+  materialize();
   // can happen when ExtractExpr special cases
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
     write8(offset, (uint8_t) CE->getZExtValue(8));
@@ -418,6 +487,7 @@ void ObjectState::write8(unsigned offset, ref<Expr> value) {
 }
 
 void ObjectState::write8(ref<Expr> offset, ref<Expr> value) {
+  materialize();
   assert(!isa<ConstantExpr>(offset) &&
          "constant offset passed to symbolic write8");
   unsigned base, size;
@@ -441,6 +511,7 @@ void ObjectState::write8(ref<Expr> offset, ref<Expr> value) {
 /***/
 
 ref<Expr> ObjectState::read(ref<Expr> offset, Expr::Width width) const {
+  materialize();
   // Truncate offset to 32-bits.
   offset = ZExtExpr::create(offset, Expr::Int32);
 
@@ -472,9 +543,24 @@ ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
   if (width == Expr::Bool)
     return ExtractExpr::create(read8(offset), 0, Expr::Bool);
 
-  // Otherwise, follow the slow general case.
   unsigned NumBytes = width / 8;
   assert(width == NumBytes * 8 && "Invalid width for read size!");
+
+  // Concrete bytes can be combined directly, without building a
+  // concatenation of byte constants.
+  if (width <= 64) {
+    uint8_t buf[8];
+    if (readConcrete(offset, NumBytes, buf)) {
+      uint64_t value = 0;
+      for (unsigned i = 0; i != NumBytes; ++i) {
+        unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+        value |= (uint64_t) buf[idx] << (8 * i);
+      }
+      return ConstantExpr::create(value, width);
+    }
+  }
+
+  // Otherwise, follow the slow general case.
   ref<Expr> Res(0);
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
@@ -486,6 +572,7 @@ ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
 }
 
 void ObjectState::write(ref<Expr> offset, ref<Expr> value) {
+  materialize();
   // Truncate offset to 32-bits.
   offset = ZExtExpr::create(offset, Expr::Int32);
 
@@ -570,6 +657,7 @@ void ObjectState::write64(unsigned offset, uint64_t value) {
 }
 
 void ObjectState::print() const {
+  materialize();
   llvm::errs() << "-- ObjectState --\n";
   llvm::errs() << "\tMemoryObject ID: " << object->id << "\n";
   llvm::errs() << "\tRoot Object: " << updates.root << "\n";
@@ -13,6 +13,7 @@
 #include "Context.h"
 #include "TimingSolver.h"
 
+#include "klee/ADT/AdaptiveArray.h"
 #include "klee/Expr/Expr.h"
 
 #include "llvm/ADT/StringExtras.h"
@@ -31,8 +32,35 @@ class BitArray;
 class ExecutionState;
 class Executor;
 class MemoryManager;
+class MemoryObject;
+class ObjectState;
 class Solver;
 
+/// Produces the initial contents of an object state the first time it is
+/// accessed (see ObjectState::ObjectState(const MemoryObject *, const
+/// LazyInitializer *)).
+class LazyInitializer {
+public:
+  virtual ~LazyInitializer() = default;
+
+  /// Write the initial contents to os, which is concrete and zeroed.
+  virtual void initialize(ObjectState &os) const = 0;
+
+  /// Returns zeroed memory to hold the contents of os if it is read-only,
+  /// which os does not own and which must outlive it, or null to allocate
+  /// it.
+  virtual uint8_t *getReadOnlyStore(const ObjectState &os) const {
+    return nullptr;
+  }
+
+  /// Whether code outside of KLEE may access the object of mo (e.g. because
+  /// its address is taken), so that external calls must see its contents
+  /// even if it has not been initialized.
+  virtual bool isReachableExternally(const MemoryObject *mo) const {
+    return true;
+  }
+};
+
 class MemoryObject {
   friend class STPBuilder;
   friend class ObjectState;
@@ -182,9 +210,9 @@ private:
   /// @brief concreteMask[byte] is set if byte is known to be concrete
   BitArray *concreteMask;
 
-  /// knownSymbolics[byte] holds the symbolic expression for byte,
-  /// if byte is known to be symbolic
-  ref<Expr> *knownSymbolics;
+  /// knownSymbolics holds the symbolic expression for byte, if byte is known
+  /// to be symbolic. Stored sparsely while only few bytes are symbolic.
+  AdaptiveArray<ref<Expr>> *knownSymbolics;
 
   /// unflushedMask[byte] is set if byte is unflushed
   /// mutable because may need flushed during read of const
@@ -193,6 +221,12 @@ private:
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
 
+  /// Initializer whose contents have not been produced yet, or null.
+  const LazyInitializer *lazyInit;
+
+  /// False if concreteStore is provided by the lazy initializer.
+  bool ownsConcreteStore;
+
 public:
   unsigned size;
 
@@ -208,6 +242,16 @@ public:
   /// contents.
   ObjectState(const MemoryObject *mo, const Array *array);
 
+  /// Create a new object state for the given memory object whose concrete
+  /// contents are produced by init the first time the object is read,
+  /// written or copied. Initialization must give the same contents no
+  /// matter when it happens, as all states sharing the object see it.
+  ///
+  /// If the object is read-only by then, its contents are also copied out
+  /// to the object's memory at its address, for external calls, and may be
+  /// kept in memory provided by init.
+  ObjectState(const MemoryObject *mo, const LazyInitializer *init);
+
   ObjectState(const ObjectState &os);
   ~ObjectState();
 
@@ -225,6 +269,10 @@ public:
   ref<Expr> read(unsigned offset, Expr::Width width) const;
   ref<Expr> read8(unsigned offset) const;
 
+  /// Copy bytes [offset, offset + bytes) to buf if they are all concrete.
+  /// \return false if one of them is not concrete.
+  bool readConcrete(unsigned offset, unsigned bytes, uint8_t *buf) const;
+
   void write(unsigned offset, ref<Expr> value);
   void write(ref<Expr> offset, ref<Expr> value);
 
@@ -245,6 +293,19 @@ public:
                             bool concretize);
 
 private:
+  /// Produce the contents of a lazily initialized object.
+  void materialize() const {
+    if (lazyInit)
+      runLazyInit();
+  }
+  void runLazyInit() const;
+
+  /// Whether the object has not been initialized yet and cannot be reached
+  /// by external calls, which may then ignore it.
+  bool isHiddenFromExternalCalls() const {
+    return lazyInit && !lazyInit->isReachableExternally(object.get());
+  }
+
   const UpdateList &getUpdates() const;
 
   void makeConcrete();
@@ -269,6 +330,9 @@ private:
   /// isByteUnflushed(i) => (isByteConcrete(i) || isByteKnownSymbolic(i))
   bool isByteUnflushed(unsigned offset) const;
 
+  /// Returns the known symbolic value of the byte, or null if there is none.
+  const ref<Expr> *getKnownSymbolic(unsigned offset) const;
+
   void markByteConcrete(unsigned offset);
   void markByteSymbolic(unsigned offset);
   void markByteFlushed(unsigned offset);
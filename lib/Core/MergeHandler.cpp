@@ -12,8 +12,12 @@
 #include "CoreStats.h"
 #include "ExecutionState.h"
 #include "Executor.h"
+#include "Memory.h"
 #include "Searcher.h"
 
+#include "klee/Module/KInstruction.h"
+#include "klee/Module/KModule.h"
+
 namespace klee {
 
 /*** Test generation options ***/
@@ -37,6 +41,33 @@ llvm::cl::opt<bool> UseIncompleteMerge(
     llvm::cl::desc("Heuristic-based path merging (default=false)"),
     llvm::cl::cat(klee::MergeCat));
 
+llvm::cl::opt<bool> AutoMerge(
+    "auto-merge", llvm::cl::init(false),
+    llvm::cl::desc("Merge the states forked at a branch when they reach the "
+                   "branch's immediate post-dominator, without klee_open_merge "
+                   "annotations (default=false)"),
+    llvm::cl::cat(klee::MergeCat));
+
+llvm::cl::opt<unsigned> AutoMergeMaxWait(
+    "auto-merge-max-wait", llvm::cl::init(10000),
+    llvm::cl::desc("Number of instructions after which states waiting at an "
+                   "automatic merge point continue without the states that "
+                   "have not arrived yet (default=10000)"),
+    llvm::cl::cat(klee::MergeCat));
+
+llvm::cl::opt<unsigned> AutoMergeMaxQueries(
+    "auto-merge-max-queries", llvm::cl::init(8),
+    llvm::cl::desc("Do not merge states automatically if the values that "
+                   "differ between them are estimated to feed more than this "
+                   "many solver queries (default=8)"),
+    llvm::cl::cat(klee::MergeCat));
+
+llvm::cl::opt<unsigned> AutoMergeMaxItes(
+    "auto-merge-max-ites", llvm::cl::init(256),
+    llvm::cl::desc("Do not merge states automatically if this would create "
+                   "more than this many ite-expressions (default=256)"),
+    llvm::cl::cat(klee::MergeCat));
+
 llvm::cl::opt<bool> DebugLogIncompleteMerge(
     "debug-log-incomplete-merge", llvm::cl::init(false),
     llvm::cl::desc("Debug information for incomplete path merging (default=false)"),
@@ -67,6 +98,65 @@ ExecutionState *MergeHandler::getPrioritizeState(){
 }
 
 
+bool MergeHandler::reachedClosePoint(const ExecutionState &es) const {
+  return closesAt(es.pc, es.stack.size());
+}
+
+bool MergeHandler::isWorthMerging(const ExecutionState &a,
+                                  const ExecutionState &b) const {
+  // Every value that differs between the states becomes an ite-expression
+  // in the merged state, and each solver query over it has to consider both
+  // alternatives. Estimate the number of such queries: a PHI of the close
+  // point's block costs the number of queries it statically feeds; an object
+  // whose differing bytes include a symbolic one costs one query per access.
+  unsigned ites = 0, queries = 0;
+
+  const StackFrame &af = a.stack.back();
+  const StackFrame &bf = b.stack.back();
+  if (af.kf != bf.kf)
+    return false;
+  KFunction *kf = af.kf;
+  for (unsigned i = kf->basicBlockEntry[autoClosePoint->inst->getParent()];
+       kf->instructions[i] != autoClosePoint; ++i) {
+    unsigned reg = kf->instructions[i]->dest;
+    const ref<Expr> &av = af.getLocal(reg).value;
+    const ref<Expr> &bv = bf.getLocal(reg).value;
+    if (av && bv && av != bv) {
+      ++ites;
+      if (!isa<ConstantExpr>(av) || !isa<ConstantExpr>(bv))
+        queries += kf->registerQueryUses[reg];
+    }
+  }
+
+  auto ai = a.addressSpace.objects.begin(), ae = a.addressSpace.objects.end();
+  auto bi = b.addressSpace.objects.begin(), be = b.addressSpace.objects.end();
+  for (; ai != ae && bi != be; ++ai, ++bi) {
+    if (ai->first != bi->first)
+      return false;
+    const ObjectState *aos = ai->second.get(), *bos = bi->second.get();
+    if (aos == bos)
+      continue;
+    bool symbolic = false;
+    for (unsigned i = 0; i < ai->first->size; ++i) {
+      ref<Expr> av = aos->read8(i), bv = bos->read8(i);
+      if (av != bv) {
+        ++ites;
+        symbolic |= !isa<ConstantExpr>(av) || !isa<ConstantExpr>(bv);
+      }
+    }
+    queries += symbolic;
+    if (ites > AutoMergeMaxItes)
+      break;
+  }
+
+  bool worth = ites <= AutoMergeMaxItes && queries <= AutoMergeMaxQueries;
+  if (DebugLogMerge)
+    llvm::errs() << "auto merge of " << &a << " and " << &b << ": " << ites
+                 << " ites, " << queries << " queries"
+                 << (worth ? "" : ", skipped") << "\n";
+  return worth;
+}
+
 void MergeHandler::addOpenState(ExecutionState *es){
   openStates.push_back(es);
 }
@@ -96,6 +186,10 @@ void MergeHandler::addClosedState(ExecutionState *es,
   // If no other state has yet encountered this klee_close_merge instruction,
   // add a new element to the map
   if (closePoint == reachedCloseMerge.end()) {
+    if (isAutomatic() && reachedCloseMerge.empty()) {
+      releaseDeadline = stats::instructions + AutoMergeMaxWait;
+      executor->mergingSearcher->scheduleRelease(releaseDeadline);
+    }
     reachedCloseMerge[mp].push_back(es);
     executor->mergingSearcher->pauseState(*es);
   } else {
@@ -105,7 +199,11 @@ void MergeHandler::addClosedState(ExecutionState *es,
     bool mergedSuccessful = false;
 
     for (auto& mState: cpv) {
-      if (mState->merge(*es)) {
+      if ((!isAutomatic() || isWorthMerging(*mState, *es)) &&
+          mState->merge(*es)) {
+        ++stats::mergedStates;
+        mState->mergedPaths += es->mergedPaths;
+        es->mergedPaths = 1;
         executor->terminateStateEarlyAlgorithm(*es, "merged state.", StateTerminationType::Merge);
         executor->mergingSearcher->inCloseMerge.erase(es);
         mergedSuccessful = true;
@@ -135,11 +233,20 @@ bool MergeHandler::hasMergedStates() {
 
 MergeHandler::MergeHandler(Executor *_executor, ExecutionState *es)
     : executor(_executor), openInstruction(es->steppedInstructions),
-      closedMean(0), closedStateCount(0) {
+      closedMean(0), closedStateCount(0), autoClosePoint(nullptr),
+      closeStackDepth(0), releaseDeadline(0) {
     executor->mergingSearcher->mergeGroups.push_back(this);
   addOpenState(es);
 }
 
+MergeHandler::MergeHandler(Executor *_executor, const ExecutionState &es,
+                           KInstruction *closePoint)
+    : executor(_executor), openInstruction(es.steppedInstructions),
+      closedMean(0), closedStateCount(0), autoClosePoint(closePoint),
+      closeStackDepth(es.stack.size()), releaseDeadline(0) {
+  executor->mergingSearcher->mergeGroups.push_back(this);
+}
+
 MergeHandler::~MergeHandler() {
   auto it = std::find(executor->mergingSearcher->mergeGroups.begin(),
                       executor->mergingSearcher->mergeGroups.end(), this);
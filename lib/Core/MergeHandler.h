@@ -64,6 +64,23 @@
  * possible) will be continued without waiting for the remaining states. When a
  * remaining state now enters a close-merge point, it will again wait for the
  * other states, or until the 'timeout' is reached.
+ *
+ * # Automatic State Merging
+ *
+ * With `--auto-merge`, no annotations are needed: when a state forks at a
+ * conditional branch or switch, the Executor opens a MergeHandler whose close
+ * point is the first non-PHI instruction of the branch's immediate
+ * post-dominator (see KFunction::mergePoints), at the current stack depth.
+ * States arriving there are paused and merged exactly as at a
+ * klee_close_merge(), except that
+ *
+ * - two states are only merged if the merge is estimated to be cheap: the
+ *   values that differ between them (and would become ite-expressions) must
+ *   not feed more than `--auto-merge-max-queries` later solver queries, and
+ *   there must be at most `--auto-merge-max-ites` of them;
+ *
+ * - paused states are released after `--auto-merge-max-wait` instructions
+ *   even if some state of the group has not arrived yet.
 */
 
 #ifndef KLEE_MERGEHANDLER_H
@@ -77,6 +94,7 @@ DISABLE_WARNING_DEPRECATED_DECLARATIONS
 #include "llvm/Support/CommandLine.h"
 DISABLE_WARNING_POP
 
+#include <cstddef>
 #include <map>
 #include <stdint.h>
 #include <vector>
@@ -88,12 +106,15 @@ class Instruction;
 namespace klee {
 extern llvm::cl::opt<bool> UseMerge;
 
+extern llvm::cl::opt<bool> AutoMerge;
+
 extern llvm::cl::opt<bool> DebugLogMerge;
 
 extern llvm::cl::opt<bool> DebugLogIncompleteMerge;
 
 class Executor;
 class ExecutionState;
+struct KInstruction;
 
 /// @brief Represents one `klee_open_merge()` call. 
 /// Handles merging of states that branched from it
@@ -124,6 +145,21 @@ private:
   std::map<llvm::Instruction *, std::vector<ExecutionState *> >
       reachedCloseMerge;
 
+  /// @brief For automatic merging, the instruction at which states are
+  /// merged; nullptr for a klee_open_merge() region
+  KInstruction *autoClosePoint;
+
+  /// @brief For automatic merging, the stack depth of the close point
+  std::size_t closeStackDepth;
+
+  /// @brief For automatic merging, the instruction count after which the
+  /// states waiting at the close point are released
+  uint64_t releaseDeadline;
+
+  /// @brief For automatic merging, whether merging the two states (waiting
+  /// at the close point) is estimated to keep solver queries cheap
+  bool isWorthMerging(const ExecutionState &a, const ExecutionState &b) const;
+
 public:
 
   /// @brief Called when a state runs into a 'klee_close_merge()' call
@@ -150,10 +186,33 @@ public:
   // klee_close_merge
   double getMean();
 
+  /// @brief True, if this handler was opened automatically at a branch
+  bool isAutomatic() const { return autoClosePoint != nullptr; }
+
+  /// @brief True, if this handler was opened automatically and closes at ki
+  /// in the stack frame at the given depth
+  bool closesAt(const KInstruction *ki, std::size_t stackDepth) const {
+    return isAutomatic() && autoClosePoint == ki &&
+           closeStackDepth == stackDepth;
+  }
+
+  /// @brief True, if this handler was opened automatically and the state is
+  /// at its close point
+  bool reachedClosePoint(const ExecutionState &es) const;
+
+  /// @brief The instruction count after which automatically merged states
+  /// waiting at the close point should be released
+  uint64_t getReleaseDeadline() const { return releaseDeadline; }
+
   /// @brief Required by klee::ref-managed objects
   class ReferenceCounter _refCount;
 
   MergeHandler(Executor *_executor, ExecutionState *es);
+  /// @brief Opens an automatic merge of the states forked at a branch, which
+  /// closes at closePoint in the stack frame of es. The states have to be
+  /// added with addOpenState().
+  MergeHandler(Executor *_executor, const ExecutionState &es,
+               KInstruction *closePoint);
   ~MergeHandler();
 };
 }
@@ -0,0 +1,234 @@
+//===-- SearchLog.cpp -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SearchLog.h"
+
+#include "klee/Config/config.h"
+#include "klee/Support/ErrorHandling.h"
+#include "klee/Support/FileHandling.h"
+#ifdef HAVE_ZLIB_H
+#include "klee/Support/CompressionStream.h"
+#endif
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdio>
+#include <fstream>
+
+using namespace klee;
+
+class SearchLog::Reader {
+#ifdef HAVE_ZLIB_H
+  compressed_fd_istream is;
+#else
+  std::ifstream is;
+#endif
+
+public:
+#ifdef HAVE_ZLIB_H
+  Reader(const std::string &path, std::string &error) : is(path, error) {}
+#else
+  Reader(const std::string &path, std::string &error) : is(path) {
+    if (!is)
+      error = "cannot open file";
+  }
+#endif
+
+  bool getline(std::string &line) {
+#ifdef HAVE_ZLIB_H
+    return is.getline(line);
+#else
+    return static_cast<bool>(std::getline(is, line));
+#endif
+  }
+};
+
+SearchLog::~SearchLog() {
+  if (writer)
+    writeRun();
+}
+
+std::unique_ptr<SearchLog> SearchLog::record(const std::string &path) {
+  std::unique_ptr<SearchLog> log(new SearchLog());
+  log->path = path;
+  std::string error;
+#ifdef HAVE_ZLIB_H
+  log->writer = klee_open_compressed_output_file(path, error);
+#else
+  log->writer = klee_open_output_file(path, error);
+#endif
+  if (!log->writer)
+    klee_error("Could not open search log %s: %s", path.c_str(), error.c_str());
+  return log;
+}
+
+std::unique_ptr<SearchLog> SearchLog::replay(const std::string &path) {
+  std::unique_ptr<SearchLog> log(new SearchLog());
+  log->path = path;
+  std::string error;
+  log->reader = std::make_unique<Reader>(path, error);
+  if (!error.empty())
+    klee_error("Could not open search log %s: %s", path.c_str(), error.c_str());
+  return log;
+}
+
+static const char *describeKind(char kind) {
+  switch (kind) {
+  case 's':
+    return "state selection";
+  case 'c':
+    return "random choice";
+  default:
+    return "fork";
+  }
+}
+
+bool SearchLog::next(char kind, std::uint32_t &a, char &b, std::uint64_t &c) {
+  std::string line;
+  if (!reader->getline(line))
+    return false;
+  char k = line.empty() ? 0 : line[0];
+  unsigned long long count = 0;
+  unsigned newID = 0;
+  b = 0;
+  bool valid = false;
+  if (k == 's') {
+    // "s <id> <count>"; logs written before selections were counted omit
+    // the count
+    int fields = std::sscanf(line.c_str(), "s %u %llu", &a, &count);
+    valid = fields >= 1 && (fields == 1 || count > 0);
+    c = fields == 2 ? count : 1;
+  } else if (k == 'c') {
+    // "c <value>"
+    valid = std::sscanf(line.c_str(), "c %u", &a) == 1;
+    c = 0;
+  } else if (k == 'f') {
+    // "f <id> <outcome> [<new id>]"
+    int fields = std::sscanf(line.c_str(), "f %u %c %u", &a, &b, &newID);
+    valid = fields >= 2;
+    c = newID;
+  }
+  if (!valid)
+    klee_error("Malformed entry at step %llu in search log %s: \"%s\"",
+               static_cast<unsigned long long>(step), path.c_str(),
+               line.c_str());
+  if (k != kind)
+    diverged(describeKind(k), describeKind(kind));
+  return true;
+}
+
+void SearchLog::diverged(const std::string &expected,
+                         const std::string &actual) const {
+  klee_error("Execution diverged from search log %s at step %llu: expected "
+             "%s, got %s",
+             path.c_str(), static_cast<unsigned long long>(step),
+             expected.c_str(), actual.c_str());
+}
+
+void SearchLog::writeRun() {
+  if (runLength)
+    *writer << "s " << runID << ' ' << runLength << '\n';
+  runLength = 0;
+}
+
+std::uint32_t SearchLog::select(std::uint32_t id) {
+  ++step;
+  if (writer) {
+    if (runLength && id != runID)
+      writeRun();
+    runID = id;
+    ++runLength;
+    return id;
+  }
+
+  if (!runLength) {
+    char none;
+    if (!next('s', runID, none, runLength))
+      diverged("end of log", "state selection");
+  }
+  --runLength;
+  return runID;
+}
+
+void SearchLog::fork(std::uint32_t id, ForkOutcome outcome,
+                     std::uint32_t newID) {
+  char o = static_cast<char>(outcome);
+  ++step;
+  if (writer) {
+    // a fork ends the run of selections of the forking state
+    writeRun();
+    *writer << "f " << id << ' ' << o;
+    if (outcome == ForkOutcome::Both)
+      *writer << ' ' << newID;
+    *writer << '\n';
+    return;
+  }
+
+  auto describe = [](std::uint32_t id, char o, std::uint32_t newID) {
+    std::string s = "fork of state " + std::to_string(id) + " with outcome " +
+                    std::string(1, o);
+    if (o == static_cast<char>(ForkOutcome::Both))
+      s += " creating state " + std::to_string(newID);
+    return s;
+  };
+
+  // the recording ended the run of selections before this fork
+  if (runLength)
+    diverged("state selection", describe(id, o, newID));
+
+  std::uint32_t loggedID;
+  std::uint64_t loggedNewID;
+  char loggedOutcome;
+  if (!next('f', loggedID, loggedOutcome, loggedNewID))
+    diverged("end of log", describe(id, o, newID));
+  if (loggedID != id || loggedOutcome != o ||
+      (outcome == ForkOutcome::Both && loggedNewID != newID))
+    diverged(describe(loggedID, loggedOutcome,
+                      static_cast<std::uint32_t>(loggedNewID)),
+             describe(id, o, newID));
+}
+
+unsigned SearchLog::choose(unsigned value, unsigned bound) {
+  ++step;
+  if (writer) {
+    // a choice ends the run of selections of the forking state
+    writeRun();
+    *writer << "c " << value << '\n';
+    return value;
+  }
+
+  std::string actual = "random choice of " + std::to_string(value) +
+                       " out of " + std::to_string(bound);
+  if (runLength)
+    diverged("state selection", actual);
+
+  std::uint32_t logged;
+  char none;
+  std::uint64_t unused;
+  if (!next('c', logged, none, unused))
+    diverged("end of log", actual);
+  if (logged >= bound)
+    diverged("random choice of " + std::to_string(logged), actual);
+  return logged;
+}
+
+void SearchLog::missingState(std::uint32_t id) const {
+  klee_error("Execution diverged from search log %s at step %llu: state %u "
+             "selected by the log does not exist",
+             path.c_str(), static_cast<unsigned long long>(step), id);
+}
+
+void SearchLog::finish() {
+  if (!reader)
+    return;
+  std::string line;
+  if (runLength || reader->getline(line))
+    klee_warning("Execution ended at step %llu before the end of search log %s",
+                 static_cast<unsigned long long>(step), path.c_str());
+}
@@ -0,0 +1,98 @@
+//===-- SearchLog.h ---------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SEARCHLOG_H
+#define KLEE_SEARCHLOG_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace klee {
+
+/// SearchLog records the states chosen by the searcher and the outcome of
+/// every fork of a run (including the multi-way branches of switch,
+/// indirectbr and symbolic pointer resolution), and replays them in a later
+/// run: the state selected by the searcher is replaced by the logged one,
+/// and each fork outcome is checked against the log. Random choices made
+/// while forking (which state a multi-way branch forks from, or which side
+/// an inhibited fork follows) are logged as well and taken from the log,
+/// as searchers draw from the same random number generator. Two runs
+/// replaying the same log thus explore the same paths in the same order,
+/// whatever their searchers, and the first step at which a run cannot
+/// follow the log is reported as an error.
+///
+/// The log is a line-based text stream (gzip-compressed when zlib is
+/// available), which is read back one entry at a time. Consecutive
+/// selections of the same state are stored as a single entry with a count.
+class SearchLog {
+public:
+  enum class ForkOutcome : char {
+    True = 't',
+    False = 'f',
+    Both = 'b',
+    /// The solver failed, and the state was terminated
+    Failed = 'x'
+  };
+
+private:
+  class Reader;
+
+  std::unique_ptr<llvm::raw_ostream> writer;
+  std::unique_ptr<Reader> reader;
+  std::string path;
+  /// Number of selections and forks written or read so far
+  std::uint64_t step = 0;
+  /// The state selected last and the number of its consecutive selections
+  /// that are not written yet (recording) or not replayed yet (replaying)
+  std::uint32_t runID = 0;
+  std::uint64_t runLength = 0;
+
+  SearchLog() = default;
+  /// Reads the next entry, which must be of the given kind, into the
+  /// fields. Returns false at the end of the log.
+  bool next(char kind, std::uint32_t &a, char &b, std::uint64_t &c);
+  /// Writes the pending run of selections.
+  void writeRun();
+  [[noreturn]] void diverged(const std::string &expected,
+                             const std::string &actual) const;
+
+public:
+  ~SearchLog();
+
+  /// Opens a log at path for recording; exits with an error on failure.
+  static std::unique_ptr<SearchLog> record(const std::string &path);
+  /// Opens the log at path for replaying; exits with an error on failure.
+  static std::unique_ptr<SearchLog> replay(const std::string &path);
+
+  bool isReplaying() const { return reader != nullptr; }
+
+  /// Logs the selection of state id. When replaying, returns the id of the
+  /// state the log selected at this step instead. Called once per executed
+  /// instruction, so repeated selections only bump a counter.
+  std::uint32_t select(std::uint32_t id);
+  /// Logs the outcome of a fork of state id; newID is the id of the state
+  /// created by a fork with outcome Both.
+  void fork(std::uint32_t id, ForkOutcome outcome, std::uint32_t newID = 0);
+  /// Logs a random choice of value in [0, bound) made while forking. When
+  /// replaying, returns the value chosen at this step of the log instead.
+  unsigned choose(unsigned value, unsigned bound);
+  /// Reports that the state selected by the log does not exist.
+  [[noreturn]] void missingState(std::uint32_t id) const;
+  /// Warns if a replay ends before the log does.
+  void finish();
+};
+
+} // namespace klee
+
+#endif /* KLEE_SEARCHLOG_H */
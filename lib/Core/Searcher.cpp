@@ -17,6 +17,7 @@
 #include "StatsTracker.h"
 
 #include "klee/ADT/DiscretePDF.h"
+#include "klee/ADT/FenwickPDF.h"
 #include "klee/ADT/RNG.h"
 #include "klee/Statistics/Statistics.h"
 #include "klee/Module/InstructionInfoTable.h"
@@ -151,11 +152,18 @@ void RandomSearcher::printName(llvm::raw_ostream &os) {
 
 ///
 
-WeightedRandomSearcher::WeightedRandomSearcher(WeightType type, RNG &rng)
-  : states(std::make_unique<DiscretePDF<ExecutionState*, ExecutionStateIDCompare>>()),
-    theRNG{rng},
+WeightedRandomSearcher::WeightedRandomSearcher(WeightType type, RNG &rng,
+                                               SamplerType sampler)
+  : theRNG{rng},
     type(type) {
 
+  if (sampler == Fenwick)
+    fenwickStates = std::make_unique<
+        FenwickPDF<ExecutionState *, std::hash<ExecutionState *>>>();
+  else
+    treeStates = std::make_unique<
+        DiscretePDF<ExecutionState *, ExecutionStateIDCompare>>();
+
   switch(type) {
   case Depth:
   case RP:
@@ -173,8 +181,15 @@ WeightedRandomSearcher::WeightedRandomSearcher(WeightType type, RNG &rng)
   }
 }
 
+WeightedRandomSearcher::~WeightedRandomSearcher() = default;
+
 ExecutionState &WeightedRandomSearcher::selectState() {
-  return *states->choose(theRNG.getDoubleL());
+  if (staleState) {
+    refreshWeight(staleState);
+    staleState = nullptr;
+  }
+  double p = theRNG.getDoubleL();
+  return fenwickStates ? *fenwickStates->choose(p) : *treeStates->choose(p);
 }
 
 double WeightedRandomSearcher::getWeight(ExecutionState *es) {
@@ -218,26 +233,55 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
   }
 }
 
+void WeightedRandomSearcher::insertState(ExecutionState *es, double weight) {
+  if (fenwickStates)
+    fenwickStates->insert(es, weight);
+  else
+    treeStates->insert(es, weight);
+}
+
+void WeightedRandomSearcher::removeState(ExecutionState *es) {
+  if (fenwickStates)
+    fenwickStates->remove(es);
+  else
+    treeStates->remove(es);
+}
+
+void WeightedRandomSearcher::refreshWeight(ExecutionState *es) {
+  double weight = getWeight(es);
+  if (fenwickStates) {
+    fenwickStates->update(es, weight);
+  } else if (treeStates->getWeight(es) != weight) {
+    treeStates->update(es, weight);
+  }
+}
+
 void WeightedRandomSearcher::update(ExecutionState *current,
                                     const std::vector<ExecutionState *> &addedStates,
                                     const std::vector<ExecutionState *> &removedStates) {
 
-  // update current
+  // mark current as stale; its weight is recomputed before the next selection
   if (current && updateWeights &&
-      std::find(removedStates.begin(), removedStates.end(), current) == removedStates.end())
-    states->update(current, getWeight(current));
+      std::find(removedStates.begin(), removedStates.end(), current) == removedStates.end()) {
+    if (staleState && staleState != current)
+      refreshWeight(staleState);
+    staleState = current;
+  }
 
   // insert states
   for (const auto state : addedStates)
-    states->insert(state, getWeight(state));
+    insertState(state, getWeight(state));
 
   // remove states
-  for (const auto state : removedStates)
-    states->remove(state);
+  for (const auto state : removedStates) {
+    if (state == staleState)
+      staleState = nullptr;
+    removeState(state);
+  }
 }
 
 bool WeightedRandomSearcher::empty() {
-  return states->empty();
+  return fenwickStates ? fenwickStates->empty() : treeStates->empty();
 }
 
 void WeightedRandomSearcher::printName(llvm::raw_ostream &os) {
@@ -257,37 +301,33 @@ void WeightedRandomSearcher::printName(llvm::raw_ostream &os) {
 
 ///
 
-// Check if n is a valid pointer and a node belonging to us
-#define IS_OUR_NODE_VALID(n)                                                   \
-  (((n).getPointer() != nullptr) && (((n).getInt() & idBitMask) != 0))
-
 RandomPathSearcher::RandomPathSearcher(InMemoryExecutionTree *executionTree, RNG &rng)
     : executionTree{executionTree}, theRNG{rng},
-      idBitMask{static_cast<uint8_t>(executionTree ? executionTree->getNextId() : 0)} {
+      idBitMask{executionTree ? executionTree->getNextId() : 0} {
   assert(executionTree);
 };
 
 ExecutionState &RandomPathSearcher::selectState() {
   unsigned flips=0, bits=0;
-  assert(executionTree->root.getInt() & idBitMask &&
+  assert(executionTree->getRootOwners() & idBitMask &&
          "Root should belong to the searcher");
-  ExecutionTreeNode *n = executionTree->root.getPointer();
+  ExecutionTreeNode *n = executionTree->root;
   while (!n->state) {
-    if (!IS_OUR_NODE_VALID(n->left)) {
-      assert(IS_OUR_NODE_VALID(n->right) && "Both left and right nodes invalid");
-      assert(n != n->right.getPointer());
-      n = n->right.getPointer();
-    } else if (!IS_OUR_NODE_VALID(n->right)) {
-      assert(IS_OUR_NODE_VALID(n->left) && "Both right and left nodes invalid");
-      assert(n != n->left.getPointer());
-      n = n->left.getPointer();
+    bool ownLeft = n->leftOwners & idBitMask;
+    bool ownRight = n->rightOwners & idBitMask;
+    if (!ownLeft) {
+      assert(ownRight && n->right && "Both left and right nodes invalid");
+      n = n->right;
+    } else if (!ownRight) {
+      assert(n->left && "Both right and left nodes invalid");
+      n = n->left;
     } else {
       if (bits==0) {
         flips = theRNG.getInt32();
         bits = 32;
       }
       --bits;
-      n = ((flips & (1U << bits)) ? n->left : n->right).getPointer();
+      n = (flips & (1U << bits)) ? n->left : n->right;
     }
   }
 
@@ -299,47 +339,28 @@ void RandomPathSearcher::update(ExecutionState *current,
                                 const std::vector<ExecutionState *> &removedStates) {
   // insert states
   for (auto es : addedStates) {
-    ExecutionTreeNode *etnode = es->executionTreeNode, *parent = etnode->parent;
-    ExecutionTreeNodePtr *childPtr;
-
-    childPtr = parent ? ((parent->left.getPointer() == etnode) ? &parent->left
-                                                               : &parent->right)
-                      : &executionTree->root;
-    while (etnode && !IS_OUR_NODE_VALID(*childPtr)) {
-      childPtr->setInt(childPtr->getInt() | idBitMask);
-      etnode = parent;
-      if (etnode)
-        parent = etnode->parent;
-
-      childPtr = parent
-                     ? ((parent->left.getPointer() == etnode) ? &parent->left
-                                                              : &parent->right)
-                     : &executionTree->root;
+    ExecutionTreeNode *etnode = es->executionTreeNode;
+    while (etnode && !(executionTree->owners(etnode) & idBitMask)) {
+      executionTree->owners(etnode) |= idBitMask;
+      etnode = etnode->parent;
     }
   }
 
   // remove states
   for (auto es : removedStates) {
-    ExecutionTreeNode *etnode = es->executionTreeNode, *parent = etnode->parent;
-
-    while (etnode && !IS_OUR_NODE_VALID(etnode->left) &&
-           !IS_OUR_NODE_VALID(etnode->right)) {
-      auto childPtr =
-          parent ? ((parent->left.getPointer() == etnode) ? &parent->left
-                                                          : &parent->right)
-                 : &executionTree->root;
-      assert(IS_OUR_NODE_VALID(*childPtr) &&
+    ExecutionTreeNode *etnode = es->executionTreeNode;
+    while (etnode && !(etnode->leftOwners & idBitMask) &&
+           !(etnode->rightOwners & idBitMask)) {
+      assert(executionTree->owners(etnode) & idBitMask &&
              "Removing executionTree child not ours");
-      childPtr->setInt(childPtr->getInt() & ~idBitMask);
-      etnode = parent;
-      if (etnode)
-        parent = etnode->parent;
+      executionTree->owners(etnode) &= ~idBitMask;
+      etnode = etnode->parent;
     }
   }
 }
 
 bool RandomPathSearcher::empty() {
-  return !IS_OUR_NODE_VALID(executionTree->root);
+  return !(executionTree->getRootOwners() & idBitMask);
 }
 
 void RandomPathSearcher::printName(llvm::raw_ostream &os) {
@@ -365,7 +386,31 @@ void MergingSearcher::continueState(ExecutionState &state) {
   baseSearcher->update(nullptr, {&state}, {});
 }
 
+void MergingSearcher::scheduleRelease(std::uint64_t deadline) {
+  nextReleaseDeadline = std::min(nextReleaseDeadline, deadline);
+}
+
+void MergingSearcher::releaseExpiredGroups() {
+  std::uint64_t now = stats::instructions;
+  nextReleaseDeadline = UINT64_MAX;
+  for (auto cur_mergehandler : mergeGroups) {
+    if (!cur_mergehandler->isAutomatic() ||
+        !cur_mergehandler->hasMergedStates())
+      continue;
+    if (cur_mergehandler->getReleaseDeadline() <= now) {
+      if (DebugLogMerge)
+        llvm::errs() << "Releasing states waiting at automatic merge point\n";
+      cur_mergehandler->releaseStates();
+    } else {
+      scheduleRelease(cur_mergehandler->getReleaseDeadline());
+    }
+  }
+}
+
 ExecutionState& MergingSearcher::selectState() {
+  if (stats::instructions >= nextReleaseDeadline)
+    releaseExpiredGroups();
+
   assert(!baseSearcher->empty() && "base searcher is empty");
 
   if (!UseIncompleteMerge)
@@ -484,6 +529,105 @@ void BatchingSearcher::printName(llvm::raw_ostream &os) {
 }
 
 
+///
+
+/// Maximum number of states kept as locality candidates per burst.
+static const std::size_t maxLocalityCandidates = 64;
+/// Instructions after which a burst whose state has not terminated ends.
+static const std::uint64_t localityBurstInstructions = 10000;
+
+/// Length of the longest common prefix of two constraint sets.
+static std::size_t commonPrefixLength(const ConstraintSet &a,
+                                      const ConstraintSet &b) {
+  std::size_t n = 0;
+  for (auto ia = a.begin(), ib = b.begin(); ia != a.end() && ib != b.end();
+       ++ia, ++ib, ++n) {
+    if (*ia != *ib)
+      break;
+  }
+  return n;
+}
+
+LocalitySearcher::LocalitySearcher(Searcher *baseSearcher, unsigned burstLength)
+    : baseSearcher{baseSearcher}, burstLength{burstLength} {}
+
+ExecutionState &LocalitySearcher::selectState() {
+  if (burstLength == 0)
+    return baseSearcher->selectState();
+
+  bool withinBudget =
+      stats::instructions - burstStartInstructions <= localityBurstInstructions;
+
+  if (burstState && withinBudget)
+    return *burstState;
+
+  if (!burstState && withinBudget && burstRemaining > 0 &&
+      !candidates.empty()) {
+    // continue with the candidate closest to the terminated state; on ties
+    // prefer the most recently forked one
+    auto best = candidates.rbegin();
+    std::size_t bestLength = 0;
+    for (auto it = candidates.rbegin(); it != candidates.rend(); ++it) {
+      std::size_t length =
+          commonPrefixLength(lastConstraints, (*it)->constraints);
+      if (length > bestLength) {
+        best = it;
+        bestLength = length;
+      }
+    }
+    burstState = *best;
+    candidates.erase(std::next(best).base());
+    --burstRemaining;
+    ++stats::localitySelections;
+    return *burstState;
+  }
+
+  // start a new burst from the underlying searcher's choice
+  burstState = &baseSearcher->selectState();
+  burstRemaining = burstLength;
+  burstStartInstructions = stats::instructions;
+  candidates.clear();
+  return *burstState;
+}
+
+void LocalitySearcher::update(ExecutionState *current,
+                              const std::vector<ExecutionState *> &addedStates,
+                              const std::vector<ExecutionState *> &removedStates) {
+  baseSearcher->update(current, addedStates, removedStates);
+  if (burstLength == 0)
+    return;
+
+  // collect states forked off by the burst state
+  if (current && current == burstState) {
+    candidates.insert(candidates.end(), addedStates.begin(), addedStates.end());
+    if (candidates.size() > maxLocalityCandidates)
+      candidates.erase(candidates.begin(),
+                       candidates.end() - maxLocalityCandidates);
+  }
+
+  for (const auto state : removedStates) {
+    if (state == burstState) {
+      lastConstraints = state->constraints;
+      burstState = nullptr;
+    }
+    auto it = std::find(candidates.begin(), candidates.end(), state);
+    if (it != candidates.end())
+      candidates.erase(it);
+  }
+}
+
+bool LocalitySearcher::empty() {
+  return baseSearcher->empty();
+}
+
+void LocalitySearcher::printName(llvm::raw_ostream &os) {
+  os << "<LocalitySearcher> burstLength: " << burstLength
+     << ", baseSearcher:\n";
+  baseSearcher->printName(os);
+  os << "</LocalitySearcher>\n";
+}
+
+
 ///
 
 IterativeDeepeningTimeSearcher::IterativeDeepeningTimeSearcher(Searcher *baseSearcher)
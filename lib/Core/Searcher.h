@@ -18,6 +18,8 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <cstdint>
+#include <functional>
 #include <map>
 #include <queue>
 #include <set>
@@ -32,6 +34,7 @@ namespace llvm {
 
 namespace klee {
   template<class T, class Comparator> class DiscretePDF;
+  template<class T, class Hash> class FenwickPDF;
   class ExecutionState;
   class Executor;
 
@@ -135,19 +138,38 @@ namespace klee {
       CoveringNew
     };
 
+    /// The data structure states are sampled from.
+    enum SamplerType : std::uint8_t {
+      /// Balanced tree of heap-allocated nodes (DiscretePDF).
+      Tree,
+      /// Fenwick tree over a flat array of state slots (FenwickPDF).
+      Fenwick
+    };
+
   private:
-    std::unique_ptr<DiscretePDF<ExecutionState*, ExecutionStateIDCompare>> states;
+    std::unique_ptr<DiscretePDF<ExecutionState*, ExecutionStateIDCompare>> treeStates;
+    std::unique_ptr<FenwickPDF<ExecutionState*, std::hash<ExecutionState*>>> fenwickStates;
     RNG &theRNG;
     WeightType type;
     bool updateWeights;
+    /// State whose weight may have changed since it was last computed. Its
+    /// weight is refreshed lazily, before the next selection, so that
+    /// consecutive updates of the same state cost a single recomputation.
+    ExecutionState *staleState = nullptr;
     
     double getWeight(ExecutionState*);
+    void insertState(ExecutionState *es, double weight);
+    void removeState(ExecutionState *es);
+    /// Recomputes the weight of es and updates it if it changed.
+    void refreshWeight(ExecutionState *es);
 
   public:
     /// \param type The WeightType that determines the underlying heuristic.
     /// \param RNG A random number generator.
-    WeightedRandomSearcher(WeightType type, RNG &rng);
-    ~WeightedRandomSearcher() override = default;
+    /// \param sampler The data structure states are sampled from.
+    WeightedRandomSearcher(WeightType type, RNG &rng,
+                           SamplerType sampler = Tree);
+    ~WeightedRandomSearcher() override;
 
     ExecutionState &selectState() override;
     void update(ExecutionState *current,
@@ -164,15 +186,9 @@ namespace klee {
   ///
   /// To support this, RandomPathSearcher has a subgraph view of ExecutionTree,
   /// in that it only walks the ExecutionTreeNodes that it "owns". Ownership is
-  /// stored in the getInt method of the ExecutionTreeNodePtr class (which hides
-  /// it in the pointer itself).
-  ///
-  /// The current implementation of ExecutionTreeNodePtr supports only 3
-  /// instances of the RandomPathSearcher. This is because the current
-  /// ExecutionTreeNodePtr implementation conforms to C++ and only steals the
-  /// last 3 alignment bits. This restriction could be relaxed slightly by an
-  /// architecture-specific implementation of ExecutionTreeNodePtr that also
-  /// steals the top bits of the pointer.
+  /// stored in each ExecutionTreeNode as one bit per searcher for each of its
+  /// children. Up to MaxExecutionTreeOwners
+  /// instances of the RandomPathSearcher can share an ExecutionTree.
   ///
   /// The ownership bits are maintained in the update method.
   class RandomPathSearcher final : public Searcher {
@@ -180,7 +196,7 @@ namespace klee {
     RNG &theRNG;
 
     // Unique bitmask of this searcher
-    const uint8_t idBitMask;
+    const ExecutionTreeOwnerMask idBitMask;
 
   public:
     /// \param executionTree The execution tree.
@@ -209,6 +225,13 @@ namespace klee {
     /// States that have been paused by the 'pauseState' function
     std::vector<ExecutionState*> pausedStates;
 
+    /// Instruction count at which the next automatic merge group waiting at
+    /// its close point has to be released
+    std::uint64_t nextReleaseDeadline = UINT64_MAX;
+
+    /// Release the automatic merge groups whose deadline has passed
+    void releaseExpiredGroups();
+
     public:
     /// \param baseSearcher The underlying searcher (takes ownership).
     explicit MergingSearcher(Searcher *baseSearcher);
@@ -233,6 +256,10 @@ namespace klee {
     /// Continue a paused state
     void continueState(ExecutionState &state);
 
+    /// Make sure releaseExpiredGroups() runs once the instruction count
+    /// reaches deadline
+    void scheduleRelease(std::uint64_t deadline);
+
     ExecutionState &selectState() override;
     void update(ExecutionState *current,
                 const std::vector<ExecutionState *> &addedStates,
@@ -274,6 +301,44 @@ namespace klee {
     void printName(llvm::raw_ostream &os) override;
   };
 
+  /// LocalitySearcher keeps the solver caches warm by running related states
+  /// back to back. The underlying searcher picks a state, which starts a
+  /// burst: the state keeps running until it terminates, and the states it
+  /// forked off are collected. When it terminates, the collected state whose
+  /// constraints share the longest prefix with those of the terminated state
+  /// runs next, so that consecutive queries mostly differ in their last few
+  /// constraints. The burst ends, and the underlying searcher picks again,
+  /// after a given number of such locality decisions or once the burst has
+  /// run for a fixed number of instructions without terminating.
+  class LocalitySearcher final : public Searcher {
+    std::unique_ptr<Searcher> baseSearcher;
+    unsigned burstLength;
+
+    /// State being run in the current burst, if it has not terminated.
+    ExecutionState *burstState {nullptr};
+    /// Locality decisions left in the current burst.
+    unsigned burstRemaining {0};
+    std::uint64_t burstStartInstructions {0};
+    /// States forked off during the current burst, oldest first.
+    std::vector<ExecutionState *> candidates;
+    /// Constraints of the last burst state that terminated.
+    ConstraintSet lastConstraints;
+
+  public:
+    /// \param baseSearcher The underlying searcher (takes ownership).
+    /// \param burstLength Number of locality decisions before the underlying
+    /// searcher picks again; 0 delegates every selection.
+    LocalitySearcher(Searcher *baseSearcher, unsigned burstLength);
+    ~LocalitySearcher() override = default;
+
+    ExecutionState &selectState() override;
+    void update(ExecutionState *current,
+                const std::vector<ExecutionState *> &addedStates,
+                const std::vector<ExecutionState *> &removedStates) override;
+    bool empty() override;
+    void printName(llvm::raw_ostream &os) override;
+  };
+
   /// IterativeDeepeningTimeSearcher implements time-based deepening. States
   /// are selected from an underlying searcher. When a state reaches its time
   /// limit it is paused (removed from underlying searcher). When the underlying
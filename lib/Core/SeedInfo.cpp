@@ -19,6 +19,10 @@
 #include "klee/ADT/KTest.h"
 #include "klee/Support/ErrorHandling.h"
 
+#include <algorithm>
+#include <climits>
+#include <map>
+
 using namespace klee;
 
 KTestObject *SeedInfo::getNextInput(const MemoryObject *mo,
@@ -163,3 +167,67 @@ void SeedInfo::patchSeed(const ExecutionState &state,
   }
 #endif
 }
+
+std::vector<ref<Expr>> klee::evaluateSeeds(const std::vector<SeedInfo> &seeds,
+                                           const ref<Expr> &e) {
+  std::vector<ref<Expr>> results;
+  results.reserve(seeds.size());
+  if (isa<ConstantExpr>(e)) {
+    results.assign(seeds.size(), e);
+    return results;
+  }
+  if (seeds.size() == 1) {
+    results.push_back(seeds.front().assignment.evaluate(e));
+    return results;
+  }
+
+  // The input bytes e depends on: (array, index) for reads at a constant
+  // index, and whole arrays for reads at a symbolic one.
+  std::vector<ref<ReadExpr>> reads;
+  findReads(e, /*visitUpdates=*/true, reads);
+  std::vector<std::pair<const Array *, unsigned>> bytes;
+  std::vector<const Array *> arrays;
+  for (const auto &re : reads) {
+    const Array *array = re->updates.root;
+    if (array->isConstantArray())
+      continue;
+    if (const auto *index = dyn_cast<ConstantExpr>(re->index))
+      bytes.emplace_back(array, index->getZExtValue(32));
+    else
+      arrays.push_back(array);
+  }
+  std::sort(bytes.begin(), bytes.end());
+  bytes.erase(std::unique(bytes.begin(), bytes.end()), bytes.end());
+  std::sort(arrays.begin(), arrays.end());
+  arrays.erase(std::unique(arrays.begin(), arrays.end()), arrays.end());
+
+  // Unbound bytes are keyed as 256, which no bound byte can equal; whole
+  // arrays as their size followed by their bytes, or UINT_MAX if unbound.
+  std::map<std::vector<unsigned>, ref<Expr>> cache;
+  std::vector<unsigned> key;
+  for (const SeedInfo &seed : seeds) {
+    const Assignment::bindings_ty &bindings = seed.assignment.bindings;
+    key.clear();
+    for (const auto &byte : bytes) {
+      auto it = bindings.find(byte.first);
+      key.push_back(it != bindings.end() && byte.second < it->second.size()
+                        ? it->second[byte.second]
+                        : 256u);
+    }
+    for (const Array *array : arrays) {
+      auto it = bindings.find(array);
+      if (it == bindings.end()) {
+        key.push_back(UINT_MAX);
+        continue;
+      }
+      key.push_back(it->second.size());
+      key.insert(key.end(), it->second.begin(), it->second.end());
+    }
+
+    auto cached = cache.find(key);
+    if (cached == cache.end())
+      cached = cache.emplace(key, seed.assignment.evaluate(e)).first;
+    results.push_back(cached->second);
+  }
+  return results;
+}
@@ -12,6 +12,8 @@
 
 #include "klee/Expr/Assignment.h"
 
+#include <vector>
+
 extern "C" {
   struct KTest;
   struct KTestObject;
@@ -44,6 +46,12 @@ namespace klee {
                    ref<Expr> condition,
                    TimingSolver *solver);
   };
+
+  /// Evaluate e under the assignment of each seed, in order. Seeds that
+  /// agree on every input byte read by e share a single evaluation, so the
+  /// cost grows with the number of distinct inputs rather than of seeds.
+  std::vector<ref<Expr>> evaluateSeeds(const std::vector<SeedInfo> &seeds,
+                                       const ref<Expr> &e);
 }
 
 #endif /* KLEE_SEEDINFO_H */
@@ -0,0 +1,97 @@
+//===-- SeedMap.h -----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SEEDMAP_H
+#define KLEE_SEEDMAP_H
+
+#include "ExecutionState.h"
+#include "SeedInfo.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+/// The seeds followed by each state during seeding.
+///
+/// States are ordered by id, so the seeding loop visits them in a
+/// deterministic round-robin order, and the total number of seeds is kept
+/// up to date as seeds are added and removed. A state is only present while
+/// it has at least one seed. The seed vectors may be modified in place, but
+/// seeds must only be added and removed through SeedMap.
+class SeedMap {
+  /// Orders states by id, and allows looking them up by id alone
+  struct IDCompare {
+    using is_transparent = void;
+    bool operator()(const ExecutionState *a, const ExecutionState *b) const {
+      return a->getID() < b->getID();
+    }
+    bool operator()(const ExecutionState *a, std::uint32_t b) const {
+      return a->getID() < b;
+    }
+    bool operator()(std::uint32_t a, const ExecutionState *b) const {
+      return a < b->getID();
+    }
+  };
+
+public:
+  using map_type =
+      std::map<ExecutionState *, std::vector<SeedInfo>, IDCompare>;
+  using iterator = map_type::iterator;
+
+private:
+  map_type seeds;
+  std::size_t numSeeds = 0;
+
+public:
+  iterator begin() { return seeds.begin(); }
+  iterator end() { return seeds.end(); }
+  iterator find(ExecutionState *es) { return seeds.find(es); }
+  /// The first state with an id greater than id. Unlike a state pointer,
+  /// the id of a state remains valid after the state is terminated.
+  iterator upper_bound(std::uint32_t id) { return seeds.upper_bound(id); }
+
+  bool empty() const { return seeds.empty(); }
+  std::size_t count(ExecutionState *es) const { return seeds.count(es); }
+  /// Number of states with seeds
+  std::size_t numStates() const { return seeds.size(); }
+  /// Number of seeds over all states
+  std::size_t totalSeeds() const { return numSeeds; }
+
+  void add(ExecutionState *es, SeedInfo seed) {
+    seeds[es].push_back(std::move(seed));
+    ++numSeeds;
+  }
+
+  /// Remove the state at it and return its seeds.
+  std::vector<SeedInfo> take(iterator it) {
+    std::vector<SeedInfo> result = std::move(it->second);
+    numSeeds -= result.size();
+    seeds.erase(it);
+    return result;
+  }
+
+  void erase(iterator it) {
+    numSeeds -= it->second.size();
+    seeds.erase(it);
+  }
+
+  void erase(ExecutionState *es) {
+    auto it = seeds.find(es);
+    if (it != seeds.end())
+      erase(it);
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_SEEDMAP_H */
@@ -19,6 +19,7 @@
 #include "klee/Solver/SolverStats.h"
 #include "klee/Statistics/Statistics.h"
 #include "klee/Support/ErrorHandling.h"
+#include "klee/Support/MetricsServer.h"
 #include "klee/Support/ModuleUtil.h"
 #include "klee/System/MemoryUsage.h"
 
@@ -31,11 +32,13 @@
 #include "klee/Support/CompilerWarning.h"
 DISABLE_WARNING_PUSH
 DISABLE_WARNING_DEPRECATED_DECLARATIONS
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallBitVector.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
@@ -46,7 +49,11 @@ DISABLE_WARNING_DEPRECATED_DECLARATIONS
 #include "llvm/Support/Process.h"
 DISABLE_WARNING_POP
 
+#include <cctype>
 #include <fstream>
+#include <functional>
+#include <queue>
+#include <sstream>
 #include <unistd.h>
 
 using namespace klee;
@@ -116,6 +123,24 @@ cl::opt<bool> UseCallPaths("use-call-paths", cl::init(true),
                                     "level statistics (default=true)"),
                            cl::cat(StatsCat));
 
+cl::opt<bool> StatsWriterThread(
+    "stats-writer-thread", cl::init(true),
+    cl::desc("Write run.stats and run.istats from a background thread "
+             "(default=true)"),
+    cl::cat(StatsCat));
+
+cl::opt<std::string> MetricsSocket(
+    "metrics-socket",
+    cl::desc("Serve the current statistics in the Prometheus text format on "
+             "a Unix domain socket at this path (default=off)"),
+    cl::cat(StatsCat));
+
+cl::opt<std::string> MetricsInterval(
+    "metrics-interval", cl::init("1s"),
+    cl::desc("Approximate time between updates of the statistics served on "
+             "--metrics-socket (default=1s)"),
+    cl::cat(StatsCat));
+
 } // namespace klee
 
 ///
@@ -128,18 +153,22 @@ bool StatsTracker::useIStats() {
   return OutputIStats;
 }
 
+bool StatsTracker::useMetrics() {
+  return !MetricsSocket.empty();
+}
+
 /// Check for special cases where we statically know an instruction is
 /// uncoverable. Currently the case is an unreachable instruction
 /// following a noreturn call; the instruction is really only there to
 /// satisfy LLVM's termination requirement.
-static bool instructionIsCoverable(Instruction *i) {
+static bool instructionIsCoverable(const Instruction *i) {
   if (i->getOpcode() == Instruction::Unreachable) {
-    BasicBlock *bb = i->getParent();
-    BasicBlock::iterator it(i);
+    const BasicBlock *bb = i->getParent();
+    BasicBlock::const_iterator it(i);
     if (it==bb->begin()) {
       return true;
     } else {
-      Instruction *prev = &*(--it);
+      const Instruction *prev = &*(--it);
       if (isa<CallInst>(prev) || isa<InvokeInst>(prev)) {
         Function *target = getDirectCallTarget(cast<CallBase>(*prev),
                                                /*moduleIsFullyLinked=*/true);
@@ -199,35 +228,34 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     }
   }
 
-  if (useStatistics() || userSearcherRequiresMD2U())
-    theStatisticManager->useIndexedStats(km->infos->getMaxID());
-
-  for (auto &kfp : km->functions) {
-    KFunction *kf = kfp.get();
-    kf->trackCoverage = 1;
-
-    for (unsigned i=0; i<kf->numInstructions; ++i) {
-      KInstruction *ki = kf->instructions[i];
-
-      if (OutputIStats) {
-        unsigned id = ki->info->id;
-        theStatisticManager->setIndex(id);
-        if (kf->trackCoverage && instructionIsCoverable(ki->inst))
+  // Coverable instructions and branches are counted over the whole module,
+  // which only walks the IR: instruction ids, and with them the indexed
+  // statistics, are only handed out to a function once it is populated in
+  // the instruction info table (see functionPopulated()).
+  for (auto &fn : *km->module) {
+    for (auto &bb : fn) {
+      for (auto &inst : bb) {
+        if (OutputIStats && instructionIsCoverable(&inst))
           ++stats::uncoveredInstructions;
-      }
-      
-      if (kf->trackCoverage) {
-        if (BranchInst *bi = dyn_cast<BranchInst>(ki->inst))
+
+        if (BranchInst *bi = dyn_cast<BranchInst>(&inst))
           if (!bi->isUnconditional())
             numBranches++;
       }
     }
   }
 
-  if (OutputStats) {
-    sqlite3_config(SQLITE_CONFIG_SINGLETHREAD);
+  if (useStatistics() || userSearcherRequiresMD2U()) {
+    theStatisticManager->useIndexedStats(km->infos->getPopulatedMaxID());
+    km->infos->setPopulateListener(
+        [this](const Function &f, const FunctionInfo &info) {
+          functionPopulated(f, info);
+        });
+  }
 
-    // open database
+  if (OutputStats) {
+    // open database; rows are written from the writer thread, if any,
+    // which SQLite's default serialized threading mode allows
     auto db_filename = executor.interpreterHandler->getOutputFilename("run.stats");
     if (sqlite3_open(db_filename.c_str(), &statsFile) != SQLITE_OK) {
       std::ostringstream errorstream;
@@ -266,6 +294,9 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     }
     sqlite3_reset(transactionBeginStmt);
 
+    if (StatsWriterThread)
+      writer = std::make_unique<WorkerThread>();
+
     writeStatsLine();
 
     if (statsWriteInterval)
@@ -282,9 +313,26 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     }));
   }
 
+  if (!MetricsSocket.empty()) {
+    const time::Span metricsInterval(MetricsInterval);
+    if (!metricsInterval)
+      klee_error("--metrics-interval must be positive.");
+
+    std::string error;
+    metricsServer = MetricsServer::create(MetricsSocket, error);
+    if (!metricsServer)
+      klee_error("Cannot serve metrics: %s", error.c_str());
+    publishMetrics();
+    executor.timers.add(std::make_unique<Timer>(metricsInterval, [&]{
+      publishMetrics();
+    }));
+  }
+
   if (OutputIStats) {
     istatsFile = executor.interpreterHandler->openOutputFile("run.istats");
     if (istatsFile) {
+      if (StatsWriterThread && !writer)
+        writer = std::make_unique<WorkerThread>();
       if (iStatsWriteInterval)
         executor.timers.add(std::make_unique<Timer>(iStatsWriteInterval, [&]{
           writeIStats();
@@ -295,7 +343,12 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
   }
 }
 
-StatsTracker::~StatsTracker() {  
+StatsTracker::~StatsTracker() {
+  executor.kmodule->infos->setPopulateListener(nullptr);
+
+  // run outstanding writes before closing the files
+  writer.reset();
+
   if (statsFile) {
     auto rc = sqlite3_step(transactionEndStmt);
     if (rc != SQLITE_DONE) {
@@ -313,12 +366,23 @@ void StatsTracker::done() {
   if (statsFile)
     writeStatsLine();
 
+  if (metricsServer)
+    publishMetrics();
+
   if (OutputIStats) {
     if (updateMinDistToUncovered)
       computeReachableUncovered();
-    if (istatsFile)
+    if (istatsFile) {
+      // the final snapshot must not be skipped
+      if (writer)
+        writer->drain();
       writeIStats();
+    }
   }
+
+  if (writer)
+    writer->drain();
+  checkWriteError();
 }
 
 void StatsTracker::stepInstruction(ExecutionState &es) {
@@ -358,7 +422,9 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
         //
         // FIXME: This trick no longer works, we should fix this in the line
         // number propogation.
-          es.coveredLines[&ii.file].insert(ii.line);
+        es.coveredInstructions.insert(ii.id);
+        if (updateMinDistToUncovered)
+          newlyCoveredInstructions.push_back(ii.id);
 	es.coveredNew = true;
         es.instsSinceCovNew = 1;
 	++stats::coveredInstructions;
@@ -469,7 +535,8 @@ void StatsTracker::writeStatsHeader() {
          << "States INTEGER,"
          BRANCH_TYPES
          TERMINATION_CLASSES
-         << "ArrayHashTime INTEGER"
+         << "ArrayHashTime INTEGER,"
+         << "FastPathInstructions INTEGER"
          << ')';
   char *zErrMsg = nullptr;
   if(sqlite3_exec(statsFile, create.str().c_str(), nullptr, nullptr, &zErrMsg)) {
@@ -515,7 +582,8 @@ void StatsTracker::writeStatsHeader() {
          << "States,"
          BRANCH_TYPES
          TERMINATION_CLASSES
-         << "ArrayHashTime"
+         << "ArrayHashTime,"
+         << "FastPathInstructions"
          << ')';
   #undef BTYPE
   #define BTYPE(Name, I) << "?,"
@@ -550,6 +618,7 @@ void StatsTracker::writeStatsHeader() {
          << "?,"
          BRANCH_TYPES
          TERMINATION_CLASSES
+         << "?,"
          << "? "
          << ')';
 
@@ -562,56 +631,164 @@ time::Span StatsTracker::elapsed() {
   return time::getWallTime() - startWallTime;
 }
 
+void StatsTracker::checkWriteError() {
+  if (!writeFailed.load(std::memory_order_acquire))
+    return;
+  // let the writer finish its outstanding jobs before exiting
+  writer.reset();
+  klee_error("%s", writeError.c_str());
+}
+
 void StatsTracker::writeStatsLine() {
+  checkWriteError();
+
   #undef BTYPE
-  #define BTYPE(Name,I) sqlite3_bind_int64(insertStmt, arg++, stats::branches ## Name);
+  #define BTYPE(Name,I) row.push_back(stats::branches ## Name);
   #undef TCLASS
-  #define TCLASS(Name,I) sqlite3_bind_int64(insertStmt, arg++, stats::termination ## Name);
-  int arg = 1;
-  sqlite3_bind_int64(insertStmt, arg++, stats::instructions);
-  sqlite3_bind_int64(insertStmt, arg++, fullBranches);
-  sqlite3_bind_int64(insertStmt, arg++, partialBranches);
-  sqlite3_bind_int64(insertStmt, arg++, numBranches);
-  sqlite3_bind_int64(insertStmt, arg++, time::getUserTime().toMicroseconds());
-  sqlite3_bind_int64(insertStmt, arg++, executor.states.size());
-  sqlite3_bind_int64(insertStmt, arg++, util::GetTotalMallocUsage() + executor.memory->getUsedDeterministicSize());
-  sqlite3_bind_int64(insertStmt, arg++, stats::queries);
-  sqlite3_bind_int64(insertStmt, arg++, stats::solverQueries);
-  sqlite3_bind_int64(insertStmt, arg++, stats::queryConstructs);
-  sqlite3_bind_int64(insertStmt, arg++, elapsed().toMicroseconds());
-  sqlite3_bind_int64(insertStmt, arg++, stats::coveredInstructions);
-  sqlite3_bind_int64(insertStmt, arg++, stats::uncoveredInstructions);
-  sqlite3_bind_int64(insertStmt, arg++, stats::queryTime);
-  sqlite3_bind_int64(insertStmt, arg++, stats::solverTime);
-  sqlite3_bind_int64(insertStmt, arg++, stats::cexCacheTime);
-  sqlite3_bind_int64(insertStmt, arg++, stats::forkTime);
-  sqlite3_bind_int64(insertStmt, arg++, stats::resolveTime);
-  sqlite3_bind_int64(insertStmt, arg++, stats::queryCacheMisses);
-  sqlite3_bind_int64(insertStmt, arg++, stats::queryCacheHits);
-  sqlite3_bind_int64(insertStmt, arg++, stats::queryCexCacheMisses);
-  sqlite3_bind_int64(insertStmt, arg++, stats::queryCexCacheHits);
-  sqlite3_bind_int64(insertStmt, arg++, stats::inhibitedForks);
-  sqlite3_bind_int64(insertStmt, arg++, stats::externalCalls);
-  sqlite3_bind_int64(insertStmt, arg++, stats::allocations);
-  sqlite3_bind_int64(insertStmt, arg++, ExecutionState::getLastID());
+  #define TCLASS(Name,I) row.push_back(stats::termination ## Name);
+  std::vector<std::int64_t> row;
+  row.push_back(stats::instructions);
+  row.push_back(fullBranches);
+  row.push_back(partialBranches);
+  row.push_back(numBranches);
+  row.push_back(time::getUserTime().toMicroseconds());
+  row.push_back(executor.states.size());
+  row.push_back(util::GetTotalMallocUsage() + executor.memory->getUsedDeterministicSize());
+  row.push_back(stats::queries);
+  row.push_back(stats::solverQueries);
+  row.push_back(stats::queryConstructs);
+  row.push_back(elapsed().toMicroseconds());
+  row.push_back(stats::coveredInstructions);
+  row.push_back(stats::uncoveredInstructions);
+  row.push_back(stats::queryTime);
+  row.push_back(stats::solverTime);
+  row.push_back(stats::cexCacheTime);
+  row.push_back(stats::forkTime);
+  row.push_back(stats::resolveTime);
+  row.push_back(stats::queryCacheMisses);
+  row.push_back(stats::queryCacheHits);
+  row.push_back(stats::queryCexCacheMisses);
+  row.push_back(stats::queryCexCacheHits);
+  row.push_back(stats::inhibitedForks);
+  row.push_back(stats::externalCalls);
+  row.push_back(stats::allocations);
+  row.push_back(ExecutionState::getLastID());
   BRANCH_TYPES
   TERMINATION_CLASSES
 #ifdef KLEE_ARRAY_DEBUG
-  sqlite3_bind_int64(insertStmt, arg++, stats::arrayHashTime);
+  row.push_back(stats::arrayHashTime);
 #else
-  sqlite3_bind_int64(insertStmt, arg++, -1LL);
+  row.push_back(-1LL);
 #endif
+  row.push_back(stats::concreteFastPathInstructions);
+
+  if (writer) {
+    writer->submit([this, row = std::move(row)] { insertStatsRow(row); });
+  } else {
+    insertStatsRow(row);
+    checkWriteError();
+  }
+}
+
+namespace {
+/// Turns a statistic name like "QueryCexCacheHits" into a Prometheus metric
+/// name like "klee_query_cex_cache_hits".
+std::string metricName(const std::string &name) {
+  std::string result = "klee_";
+  for (std::size_t i = 0; i < name.size(); ++i) {
+    const unsigned char c = name[i];
+    if (std::isupper(c)) {
+      if (i && (std::islower(name[i - 1]) || std::isdigit(name[i - 1])))
+        result += '_';
+      result += static_cast<char>(std::tolower(c));
+    } else {
+      result += std::isalnum(c) ? static_cast<char>(c) : '_';
+    }
+  }
+  return result;
+}
+
+void writeMetric(std::ostringstream &out, const std::string &name,
+                 const char *type, const std::string &help, double value) {
+  out << "# HELP " << name << ' ' << help << '\n'
+      << "# TYPE " << name << ' ' << type << '\n'
+      << name << ' ' << value << '\n';
+}
+} // namespace
+
+void StatsTracker::publishMetrics() {
+  std::ostringstream out;
+  out.precision(15);
+
+  writeMetric(out, "klee_live_states", "gauge", "Number of live states",
+              executor.states.size());
+  writeMetric(out, "klee_memory_usage_bytes", "gauge",
+              "Memory used by KLEE and the program under test",
+              util::GetTotalMallocUsage() +
+                  executor.memory->getUsedDeterministicSize());
+  writeMetric(out, "klee_wall_time_seconds", "gauge",
+              "Wall time since the start of execution",
+              elapsed().toSeconds());
+  writeMetric(out, "klee_user_time_seconds", "gauge", "User CPU time",
+              time::getUserTime().toSeconds());
+  // branch coverage is only tracked for run.istats
+  if (OutputIStats) {
+    writeMetric(out, "klee_full_branches", "gauge",
+                "Branches with both sides covered", fullBranches);
+    writeMetric(out, "klee_partial_branches", "gauge",
+                "Branches with one side covered", partialBranches);
+  }
+  writeMetric(out, "klee_num_branches", "gauge", "Conditional branches",
+              numBranches);
+
+  // every registered statistic, including the solver's
+  StatisticManager &sm = *theStatisticManager;
+  for (unsigned i = 0; i < sm.getNumStatistics(); ++i) {
+    const Statistic &s = sm.getStatistic(i);
+    writeMetric(out, metricName(s.getName()), "untyped",
+                "KLEE statistic " + s.getName(), sm.getValue(s));
+  }
+
+  metricsServer->publish(out.str());
+}
+
+void StatsTracker::insertStatsRow(const std::vector<std::int64_t> &row) {
+  if (writeFailed.load(std::memory_order_acquire))
+    return;
+
+  // this may run on the writer thread, so errors are reported later by
+  // checkWriteError() on the interpreter thread
+  auto fail = [this](const char *what) {
+    writeError = std::string(what) + sqlite3_errmsg(statsFile);
+    writeFailed.store(true, std::memory_order_release);
+  };
+
+  int arg = 1;
+  for (std::int64_t value : row)
+    sqlite3_bind_int64(insertStmt, arg++, value);
   int errCode = sqlite3_step(insertStmt);
-  if(errCode != SQLITE_DONE) klee_error("Error writing stats data: %s", sqlite3_errmsg(statsFile));
+  if (errCode != SQLITE_DONE) {
+    fail("Error writing stats data: ");
+    sqlite3_reset(insertStmt);
+    return;
+  }
   sqlite3_reset(insertStmt);
 
   statsWriteCount++;
   if(statsWriteCount == statsCommitEvery) {
     errCode = sqlite3_step(transactionEndStmt);
-    if (errCode != SQLITE_DONE) klee_warning("Transaction commit error: %s", sqlite3_errmsg(statsFile));
+    if (errCode != SQLITE_DONE) {
+      fail("Transaction commit error: ");
+      sqlite3_reset(transactionEndStmt);
+      return;
+    }
     sqlite3_reset(transactionEndStmt);
     errCode = sqlite3_step(transactionBeginStmt);
-    if (errCode != SQLITE_DONE) klee_warning("Transaction begin error: %s", sqlite3_errmsg(statsFile));
+    if (errCode != SQLITE_DONE) {
+      fail("Transaction begin error: ");
+      sqlite3_reset(transactionBeginStmt);
+      return;
+    }
     sqlite3_reset(transactionBeginStmt);
 
     statsWriteCount = 0;
@@ -629,20 +806,22 @@ void StatsTracker::updateStateStatistics(uint64_t addend) {
   }
 }
 
-void StatsTracker::writeIStats() {
-  const auto m = executor.kmodule->module.get();
-  llvm::raw_fd_ostream &of = *istatsFile;
-  
-  // We assume that we didn't move the file pointer
-  unsigned istatsSize = of.tell();
-
-  of.seek(0);
+struct StatsTracker::IStatsSnapshot {
+  /// IDs of the statistics written, in column order.
+  std::vector<unsigned> columns;
+  /// Value of each column for each instruction id, row-major.
+  std::vector<uint64_t> values;
+  /// Id of the first instruction of each function populated when the
+  /// snapshot was taken.
+  std::unordered_map<const llvm::Function *, unsigned> firstInstructionIDs;
+  CallSiteSummaryTable callSiteStats;
+};
 
-  of << "version: 1\n";
-  of << "creator: klee\n";
-  of << "pid: " << getpid() << "\n";
-  of << "cmd: " << m->getModuleIdentifier() << "\n\n";
-  of << "\n";
+void StatsTracker::writeIStats() {
+  // a snapshot that is still being written will be superseded by the
+  // next one anyway
+  if (istatsWritePending)
+    return;
 
   StatisticManager &sm = *theStatisticManager;
   unsigned nStats = sm.getNumStatistics();
@@ -662,36 +841,82 @@ void StatsTracker::writeIStats() {
   istatsMask.set(sm.getStatisticID("States"));
   istatsMask.set(sm.getStatisticID("MinDistToUncovered"));
 
+  auto snapshot = std::make_shared<IStatsSnapshot>();
+  for (unsigned i = 0; i < nStats; i++)
+    if (istatsMask.test(i))
+      snapshot->columns.push_back(i);
+
+  // set state counts, decremented after we process so that we don't
+  // have to zero all records each time.
+  if (istatsMask.test(stats::states.getID()))
+    updateStateStatistics(1);
+
+  unsigned numIndices = executor.kmodule->infos->getPopulatedMaxID();
+  unsigned numColumns = snapshot->columns.size();
+  snapshot->values.resize(std::size_t(numIndices) * numColumns);
+  for (unsigned index = 0; index < numIndices; ++index)
+    for (unsigned c = 0; c < numColumns; ++c)
+      snapshot->values[std::size_t(index) * numColumns + c] =
+          sm.getIndexedValue(sm.getStatistic(snapshot->columns[c]), index);
+
+  snapshot->firstInstructionIDs = firstInstructionIDs;
+
+  if (UseCallPaths)
+    callPathManager.getSummaryStatistics(snapshot->callSiteStats);
+
+  if (istatsMask.test(stats::states.getID()))
+    updateStateStatistics((uint64_t)-1);
+
+  if (writer) {
+    istatsWritePending = true;
+    writer->submit([this, snapshot] {
+      writeIStatsSnapshot(*snapshot);
+      istatsWritePending = false;
+    });
+  } else {
+    writeIStatsSnapshot(*snapshot);
+  }
+}
+
+void StatsTracker::writeIStatsSnapshot(const IStatsSnapshot &snapshot) {
+  const auto m = executor.kmodule->module.get();
+  llvm::raw_fd_ostream &of = *istatsFile;
+  
+  // We assume that we didn't move the file pointer
+  unsigned istatsSize = of.tell();
+
+  of.seek(0);
+
+  of << "version: 1\n";
+  of << "creator: klee\n";
+  of << "pid: " << getpid() << "\n";
+  of << "cmd: " << m->getModuleIdentifier() << "\n\n";
+  of << "\n";
+
+  StatisticManager &sm = *theStatisticManager;
+  unsigned numColumns = snapshot.columns.size();
+
   of << "positions: instr line\n";
 
-  for (unsigned i=0; i<nStats; i++) {
-    if (istatsMask.test(i)) {
-      Statistic &s = sm.getStatistic(i);
-      of << "event: " << s.getShortName() << " : " 
-         << s.getName() << "\n";
-    }
+  for (unsigned id : snapshot.columns) {
+    Statistic &s = sm.getStatistic(id);
+    of << "event: " << s.getShortName() << " : " 
+       << s.getName() << "\n";
   }
 
   of << "events: ";
-  for (unsigned i=0; i<nStats; i++) {
-    if (istatsMask.test(i))
-      of << sm.getStatistic(i).getShortName() << " ";
-  }
+  for (unsigned id : snapshot.columns)
+    of << sm.getStatistic(id).getShortName() << " ";
   of << "\n";
-  
-  // set state counts, decremented after we process so that we don't
-  // have to zero all records each time.
-  if (istatsMask.test(stats::states.getID()))
-    updateStateStatistics(1);
 
   std::string sourceFile = "";
 
-  CallSiteSummaryTable callSiteStats;
-  if (UseCallPaths)
-    callPathManager.getSummaryStatistics(callSiteStats);
+  const CallSiteSummaryTable &callSiteStats = snapshot.callSiteStats;
 
   of << "ob=" << llvm::sys::path::filename(objectFilename).str() << "\n";
 
+  const AssemblyLineTable &assemblyLines =
+      executor.kmodule->infos->getAssemblyLines();
   for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
        fnIt != fn_ie; ++fnIt) {
     if (!fnIt->isDeclaration()) {
@@ -699,11 +924,18 @@ void StatsTracker::writeIStats() {
       // KCachegrind can create two entries for the function, one with an
       // unnamed file and one without.
       Function *fn = &*fnIt;
-      const FunctionInfo &ii = executor.kmodule->infos->getFunctionInfo(*fn);
-      if (ii.file != sourceFile) {
-        of << "fl=" << ii.file << "\n";
-        sourceFile = ii.file;
+      SourceLocation fnLocation = InstructionInfoTable::getSourceLocation(*fn);
+      if (fnLocation.file != sourceFile) {
+        of << "fl=" << fnLocation.file << "\n";
+        sourceFile = fnLocation.file.str();
       }
+
+      // Functions which had not been populated when the snapshot was taken
+      // have never been executed: their instructions only have the
+      // statistics set up by functionPopulated().
+      auto populated = snapshot.firstInstructionIDs.find(fn);
+      bool isPopulated = populated != snapshot.firstInstructionIDs.end();
+      unsigned index = isPopulated ? populated->second : 0;
       
       of << "fn=" << fnIt->getName().str() << "\n";
       for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
@@ -711,54 +943,66 @@ void StatsTracker::writeIStats() {
         for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
              it != ie; ++it) {
           Instruction *instr = &*it;
-          const InstructionInfo &ii = executor.kmodule->infos->getInfo(*instr);
-          unsigned index = ii.id;
-          if (ii.file!=sourceFile) {
-            of << "fl=" << ii.file << "\n";
-            sourceFile = ii.file;
+          SourceLocation location =
+              InstructionInfoTable::getSourceLocation(*instr);
+          uint64_t assemblyLine = assemblyLines.getLine(*instr);
+          if (location.file != sourceFile) {
+            of << "fl=" << location.file << "\n";
+            sourceFile = location.file.str();
+          }
+          of << assemblyLine << " ";
+          of << location.line << " ";
+          if (isPopulated) {
+            for (unsigned c = 0; c < numColumns; c++)
+              of << snapshot.values[std::size_t(index) * numColumns + c]
+                 << " ";
+            ++index;
+          } else {
+            uint64_t uncovered = instructionIsCoverable(instr);
+            for (unsigned id : snapshot.columns) {
+              if (id == stats::uncoveredInstructions.getID() ||
+                  (updateMinDistToUncovered &&
+                   id == stats::minDistToUncovered.getID()))
+                of << uncovered << " ";
+              else
+                of << "0 ";
+            }
           }
-          of << ii.assemblyLine << " ";
-          of << ii.line << " ";
-          for (unsigned i=0; i<nStats; i++)
-            if (istatsMask.test(i))
-              of << sm.getIndexedValue(sm.getStatistic(i), index) << " ";
           of << "\n";
 
           if (UseCallPaths && 
               (isa<CallInst>(instr) || isa<InvokeInst>(instr))) {
-            CallSiteSummaryTable::iterator it = callSiteStats.find(instr);
+            auto it = callSiteStats.find(instr);
             if (it!=callSiteStats.end()) {
               for (auto fit = it->second.begin(), fie = it->second.end();
                    fit != fie; ++fit) {
                 const Function *f = fit->first;
-                CallSiteInfo &csi = fit->second;
-                const FunctionInfo &fii =
-                    executor.kmodule->infos->getFunctionInfo(*f);
+                const CallSiteInfo &csi = fit->second;
+                SourceLocation calleeLocation =
+                    InstructionInfoTable::getSourceLocation(*f);
 
-                if (fii.file!="" && fii.file!=sourceFile)
-                  of << "cfl=" << fii.file << "\n";
+                if (calleeLocation.file!="" && calleeLocation.file!=sourceFile)
+                  of << "cfl=" << calleeLocation.file << "\n";
                 of << "cfn=" << f->getName().str() << "\n";
                 of << "calls=" << csi.count << " ";
-                of << fii.assemblyLine << " ";
-                of << fii.line << "\n";
-
-                of << ii.assemblyLine << " ";
-                of << ii.line << " ";
-                for (unsigned i=0; i<nStats; i++) {
-                  if (istatsMask.test(i)) {
-                    Statistic &s = sm.getStatistic(i);
-                    uint64_t value;
-
-                    // Hack, ignore things that don't make sense on
-                    // call paths.
-                    if (&s == &stats::uncoveredInstructions) {
-                      value = 0;
-                    } else {
-                      value = csi.statistics.getValue(s);
-                    }
-
-                    of << value << " ";
+                of << assemblyLines.getLine(*f) << " ";
+                of << calleeLocation.line << "\n";
+
+                of << assemblyLine << " ";
+                of << location.line << " ";
+                for (unsigned id : snapshot.columns) {
+                  Statistic &s = sm.getStatistic(id);
+                  uint64_t value;
+
+                  // Hack, ignore things that don't make sense on
+                  // call paths.
+                  if (&s == &stats::uncoveredInstructions) {
+                    value = 0;
+                  } else {
+                    value = csi.statistics.getValue(s);
                   }
+
+                  of << value << " ";
                 }
                 of << "\n";
               }
@@ -769,9 +1013,6 @@ void StatsTracker::writeIStats() {
     }
   }
 
-  if (istatsMask.test(stats::states.getID()))
-    updateStateStatistics((uint64_t)-1);
-  
   // Clear then end of the file if necessary (no truncate op?).
   unsigned pos = of.tell();
   for (unsigned i=pos; i<istatsSize; ++i)
@@ -782,24 +1023,117 @@ void StatsTracker::writeIStats() {
 
 ///
 
-typedef std::map<Instruction*, std::vector<Function*> > calltargets_ty;
+typedef std::map<const Instruction*, std::vector<Function*> > calltargets_ty;
 
 static calltargets_ty callTargets;
-static std::map<Function*, std::vector<Instruction*> > functionCallers;
-static std::map<Function*, unsigned> functionShortestPath;
+static std::map<const Function*, std::vector<const Instruction*> >
+    functionCallers;
+static std::map<const Function*, unsigned> functionShortestPath;
+
+/// Node of the instruction graph over which minDistToUncovered is
+/// computed, indexed by instruction id.
+struct UncoveredDistNode {
+  const Instruction *inst = nullptr;
+  /// Cost of stepping from this instruction to one of its successors, or 0
+  /// if execution cannot continue past it (e.g. calls that never return).
+  unsigned through = 0;
+  std::vector<unsigned> succs;
+  std::vector<unsigned> preds;
+};
+
+/// Graph of the functions populated so far, built once the shortest paths
+/// through functions are known. Instructions only have edges within their
+/// function, so functions are added as they are populated.
+static std::vector<UncoveredDistNode> uncoveredDistGraph;
+static bool uncoveredDistGraphStarted = false;
+
+/// The instructions of a function, in function order (which is the order
+/// of their ids), so that the instructions can be referred to by index.
+class FunctionInstructions {
+  std::vector<const Instruction *> insts;
+  llvm::DenseMap<const BasicBlock *, unsigned> blockStart;
+
+public:
+  explicit FunctionInstructions(const Function &f) {
+    for (auto &bb : f) {
+      blockStart[&bb] = insts.size();
+      for (auto &i : bb)
+        insts.push_back(&i);
+    }
+  }
 
-static std::vector<Instruction*> getSuccs(Instruction *i) {
-  BasicBlock *bb = i->getParent();
-  std::vector<Instruction*> res;
+  unsigned size() const { return insts.size(); }
+  const Instruction *operator[](unsigned i) const { return insts[i]; }
 
-  if (i==bb->getTerminator()) {
-    for (succ_iterator it = succ_begin(bb), ie = succ_end(bb); it != ie; ++it)
-      res.push_back(&*(it->begin()));
-  } else {
-    res.push_back(&*(++(i->getIterator())));
+  /// Returns the indices of the instructions executed right after the
+  /// instruction at index i.
+  std::vector<unsigned> getSuccs(unsigned i) const {
+    const Instruction *inst = insts[i];
+    const BasicBlock *bb = inst->getParent();
+    std::vector<unsigned> res;
+
+    if (inst == bb->getTerminator()) {
+      for (const BasicBlock *succ : successors(bb))
+        res.push_back(blockStart.find(succ)->second);
+    } else {
+      res.push_back(i + 1);
+    }
+
+    return res;
+  }
+};
+
+/// Returns the cost of stepping from an instruction to one of its
+/// successors, or 0 if execution cannot continue past it.
+static unsigned getThroughCost(const Instruction *inst) {
+  if (!isa<CallInst>(inst) && !isa<InvokeInst>(inst))
+    return 1;
+
+  unsigned best = 0;
+  for (Function *target : callTargets[inst]) {
+    uint64_t dist = functionShortestPath[target];
+    if (dist) {
+      dist = 1+dist; // count instruction itself
+      if (best==0 || dist<best)
+        best = dist;
+    }
   }
+  return best;
+}
+
+/// Computes minDistToReturn for the instructions of a function from the
+/// current shortest paths through the functions it calls, and returns the
+/// distance from its entry. 0 is unreachable.
+static uint64_t computeMinDistToReturn(const FunctionInstructions &insts,
+                                       std::vector<uint64_t> &dist) {
+  dist.assign(insts.size(), 0);
+  for (unsigned i = 0; i < insts.size(); ++i)
+    dist[i] = isa<ReturnInst>(insts[i]);
+
+  bool changed;
+  do {
+    changed = false;
+    for (unsigned i = insts.size(); i-- > 0;) {
+      unsigned bestThrough = getThroughCost(insts[i]);
+      if (!bestThrough)
+        continue;
+
+      uint64_t best = dist[i];
+      for (unsigned succ : insts.getSuccs(i)) {
+        if (dist[succ]) {
+          uint64_t val = bestThrough + dist[succ];
+          if (best==0 || val<best)
+            best = val;
+        }
+      }
+      if (best != dist[i]) {
+        dist[i] = best;
+        changed = true;
+      }
+    }
+  } while (changed);
 
-  return res;
+  return dist.empty() ? 0 : dist[0];
 }
 
 uint64_t klee::computeMinDistToUncovered(const KInstruction *ki,
@@ -824,12 +1158,171 @@ uint64_t klee::computeMinDistToUncovered(const KInstruction *ki,
   }
 }
 
+/// Adds the instructions of a function to uncoveredDistGraph, given the id
+/// of its first instruction, sets their minDistToReturn and appends their
+/// ids to added.
+static void addToUncoveredDistGraph(const Function &f, unsigned firstID,
+                                    std::vector<unsigned> &added) {
+  StatisticManager &sm = *theStatisticManager;
+  FunctionInstructions insts(f);
+  std::vector<uint64_t> distToReturn;
+  computeMinDistToReturn(insts, distToReturn);
+
+  if (uncoveredDistGraph.size() < firstID + insts.size())
+    uncoveredDistGraph.resize(firstID + insts.size());
+
+  for (unsigned i = 0; i < insts.size(); ++i) {
+    unsigned id = firstID + i;
+    sm.setIndexedValue(stats::minDistToReturn, id, distToReturn[i]);
+
+    UncoveredDistNode &node = uncoveredDistGraph[id];
+    node.inst = insts[i];
+    node.through = getThroughCost(insts[i]);
+    if (node.through) {
+      for (unsigned succ : insts.getSuccs(i)) {
+        node.succs.push_back(firstID + succ);
+        uncoveredDistGraph[firstID + succ].preds.push_back(id);
+      }
+    }
+    added.push_back(id);
+  }
+}
+
+/// Returns the instructions whose minDistToUncovered may have been realized
+/// through a newly covered instruction: the newly covered instructions
+/// themselves and, transitively, every predecessor whose distance is tight
+/// over an edge into an affected instruction. All other distances remain
+/// valid, as covering instructions can only make distances longer.
+static std::vector<unsigned>
+collectAffectedByCoverage(const std::vector<unsigned> &newlyCovered) {
+  StatisticManager &sm = *theStatisticManager;
+  std::vector<bool> isAffected(uncoveredDistGraph.size());
+  std::vector<unsigned> affected;
+
+  for (unsigned id : newlyCovered) {
+    if (!isAffected[id]) {
+      isAffected[id] = true;
+      affected.push_back(id);
+    }
+  }
+
+  for (std::size_t i = 0; i < affected.size(); ++i) {
+    uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered, affected[i]);
+    if (!dist)
+      continue;
+    for (unsigned pred : uncoveredDistGraph[affected[i]].preds) {
+      if (isAffected[pred])
+        continue;
+      uint64_t predDist = sm.getIndexedValue(stats::minDistToUncovered, pred);
+      if (predDist == uncoveredDistGraph[pred].through + dist) {
+        isAffected[pred] = true;
+        affected.push_back(pred);
+      }
+    }
+  }
+
+  return affected;
+}
+
+/// Recomputes minDistToUncovered for the given instructions, assuming the
+/// distances of all other instructions are up to date. This is Dijkstra's
+/// algorithm over the reversed instruction graph, seeded with the best
+/// distance each affected instruction reaches through unaffected ones.
+static void recomputeMinDistToUncovered(const std::vector<unsigned> &affected,
+                                        const InstructionInfoTable &infos) {
+  StatisticManager &sm = *theStatisticManager;
+
+  for (unsigned id : affected)
+    sm.setIndexedValue(stats::minDistToUncovered, id, 0);
+
+  typedef std::pair<uint64_t, unsigned> Entry;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+  for (unsigned id : affected) {
+    const UncoveredDistNode &node = uncoveredDistGraph[id];
+    uint64_t best = sm.getIndexedValue(stats::uncoveredInstructions, id);
+
+    if (isa<CallInst>(node.inst) || isa<InvokeInst>(node.inst)) {
+      for (Function *target : callTargets[node.inst]) {
+        // look the callee up without populating it
+        const FunctionInfo *calleeInfo = infos.findFunctionInfo(*target);
+        if (!target->isDeclaration() && calleeInfo) {
+          uint64_t calleeDist = sm.getIndexedValue(stats::minDistToUncovered,
+                                                   calleeInfo->id);
+          if (calleeDist) {
+            calleeDist = 1+calleeDist; // count instruction itself
+            if (best==0 || calleeDist<best)
+              best = calleeDist;
+          }
+        }
+      }
+    }
+
+    for (unsigned succ : node.succs) {
+      uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered, succ);
+      if (dist) {
+        uint64_t val = node.through + dist;
+        if (best==0 || val<best)
+          best = val;
+      }
+    }
+
+    if (best) {
+      sm.setIndexedValue(stats::minDistToUncovered, id, best);
+      queue.emplace(best, id);
+    }
+  }
+
+  while (!queue.empty()) {
+    Entry top = queue.top();
+    queue.pop();
+    if (top.first != sm.getIndexedValue(stats::minDistToUncovered, top.second))
+      continue; // superseded by a shorter distance
+
+    for (unsigned pred : uncoveredDistGraph[top.second].preds) {
+      uint64_t val = uncoveredDistGraph[pred].through + top.first;
+      uint64_t cur = sm.getIndexedValue(stats::minDistToUncovered, pred);
+      if (cur==0 || val<cur) {
+        sm.setIndexedValue(stats::minDistToUncovered, pred, val);
+        queue.emplace(val, pred);
+      }
+    }
+  }
+}
+
+void StatsTracker::functionPopulated(const Function &f,
+                                     const FunctionInfo &info) {
+  StatisticManager &sm = *theStatisticManager;
+  sm.growIndexedStats(info.id + 1);
+  if (f.isDeclaration())
+    return;
+
+  // instruction ids are handed out in function order, right before the id
+  // of the function
+  unsigned firstID = info.id - f.getInstructionCount();
+  firstInstructionIDs[&f] = firstID;
+
+  if (OutputIStats) {
+    unsigned id = firstID;
+    for (const Instruction &inst : instructions(f)) {
+      if (instructionIsCoverable(&inst))
+        sm.incrementIndexedValue(stats::uncoveredInstructions, id, 1);
+      ++id;
+    }
+  }
+
+  if (uncoveredDistGraphStarted) {
+    std::vector<unsigned> added;
+    addToUncoveredDistGraph(f, firstID, added);
+    recomputeMinDistToUncovered(added, *executor.kmodule->infos);
+  }
+}
+
 void StatsTracker::computeReachableUncovered() {
   KModule *km = executor.kmodule.get();
   const auto m = km->module.get();
   static bool init = true;
   const InstructionInfoTable &infos = *km->infos;
-  StatisticManager &sm = *theStatisticManager;
   
   if (init) {
     init = false;
@@ -871,9 +1364,11 @@ void StatsTracker::computeReachableUncovered() {
              fie = it->second.end(); fit != fie; ++fit) 
         functionCallers[*fit].push_back(it->first);
 
-    // Initialize minDistToReturn to shortest paths through
-    // functions. 0 is unreachable.
-    std::vector<Instruction *> instructions;
+    // Compute shortest paths through functions, 0 is unreachable. A
+    // function is recomputed whenever the path through one of the functions
+    // it calls has become shorter.
+    std::vector<const Function *> worklist;
+    std::set<const Function *> queued;
     for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
          fnIt != fn_ie; ++fnIt) {
       Function *fn = &*fnIt;
@@ -885,161 +1380,42 @@ void StatsTracker::computeReachableUncovered() {
         }
       } else {
         functionShortestPath[fn] = 0;
+        worklist.push_back(fn);
+        queued.insert(fn);
       }
+    }
 
-      // Not sure if I should bother to preorder here. XXX I should.
-      for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
-           bbIt != bb_ie; ++bbIt) {
-        for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
-             it != ie; ++it) {
-          Instruction *inst = &*it;
-          instructions.push_back(inst);
-          unsigned id = infos.getInfo(*inst).id;
-          sm.setIndexedValue(stats::minDistToReturn, 
-                             id, 
-                             isa<ReturnInst>(inst)
-                             );
+    std::vector<uint64_t> distToReturn;
+    while (!worklist.empty()) {
+      const Function *f = worklist.back();
+      worklist.pop_back();
+      queued.erase(f);
+
+      uint64_t best =
+          computeMinDistToReturn(FunctionInstructions(*f), distToReturn);
+      if (best != functionShortestPath[f]) {
+        functionShortestPath[f] = best;
+        for (const Instruction *caller : functionCallers[f]) {
+          const Function *cf = caller->getFunction();
+          if (queued.insert(cf).second)
+            worklist.push_back(cf);
         }
       }
     }
-  
-    std::reverse(instructions.begin(), instructions.end());
-    
-    // I'm so lazy it's not even worklisted.
-    bool changed;
-    do {
-      changed = false;
-      for (auto it = instructions.begin(), ie = instructions.end(); it != ie;
-           ++it) {
-        Instruction *inst = *it;
-        unsigned bestThrough = 0;
-
-        if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
-          std::vector<Function*> &targets = callTargets[inst];
-          for (std::vector<Function*>::iterator fnIt = targets.begin(),
-                 ie = targets.end(); fnIt != ie; ++fnIt) {
-            uint64_t dist = functionShortestPath[*fnIt];
-            if (dist) {
-              dist = 1+dist; // count instruction itself
-              if (bestThrough==0 || dist<bestThrough)
-                bestThrough = dist;
-            }
-          }
-        } else {
-          bestThrough = 1;
-        }
-       
-        if (bestThrough) {
-          unsigned id = infos.getInfo(*(*it)).id;
-          uint64_t best, cur = best = sm.getIndexedValue(stats::minDistToReturn, id);
-          std::vector<Instruction*> succs = getSuccs(*it);
-          for (std::vector<Instruction*>::iterator it2 = succs.begin(),
-                 ie = succs.end(); it2 != ie; ++it2) {
-            uint64_t dist = sm.getIndexedValue(stats::minDistToReturn,
-                                               infos.getInfo(*(*it2)).id);
-            if (dist) {
-              uint64_t val = bestThrough + dist;
-              if (best==0 || val<best)
-                best = val;
-            }
-          }
-          // there's a corner case here when a function only includes a single
-          // instruction (a ret). in that case, we MUST update
-          // functionShortestPath, or it will remain 0 (erroneously indicating
-          // that no return instructions are reachable)
-          Function *f = inst->getParent()->getParent();
-          if (best != cur || (inst == &*(f->begin()->begin())
-                  && functionShortestPath[f] != best)) {
-            sm.setIndexedValue(stats::minDistToReturn, id, best);
-            changed = true;
-
-            // Update shortest path if this is the entry point.
-            if (inst == &*(f->begin()->begin()))
-              functionShortestPath[f] = best;
-          }
-        }
-      }
-    } while (changed);
   }
 
   // compute minDistToUncovered, 0 is unreachable
-  std::vector<Instruction *> instructions;
-  for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
-       fnIt != fn_ie; ++fnIt) {
-    // Not sure if I should bother to preorder here.
-    for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
-         bbIt != bb_ie; ++bbIt) {
-      for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
-           it != ie; ++it) {
-        Instruction *inst = &*it;
-        unsigned id = infos.getInfo(*inst).id;
-        instructions.push_back(inst);
-        sm.setIndexedValue(stats::minDistToUncovered, 
-                           id, 
-                           sm.getIndexedValue(stats::uncoveredInstructions, id));
-      }
-    }
+  std::vector<unsigned> affected;
+  if (!uncoveredDistGraphStarted) {
+    // functions populated later are added by functionPopulated()
+    uncoveredDistGraphStarted = true;
+    for (const auto &populated : firstInstructionIDs)
+      addToUncoveredDistGraph(*populated.first, populated.second, affected);
+  } else {
+    affected = collectAffectedByCoverage(newlyCoveredInstructions);
   }
-  
-  std::reverse(instructions.begin(), instructions.end());
-  
-  // I'm so lazy it's not even worklisted.
-  bool changed;
-  do {
-    changed = false;
-    for (std::vector<Instruction*>::iterator it = instructions.begin(),
-           ie = instructions.end(); it != ie; ++it) {
-      Instruction *inst = *it;
-      uint64_t best, cur = best = sm.getIndexedValue(stats::minDistToUncovered,
-                                                     infos.getInfo(*inst).id);
-      unsigned bestThrough = 0;
-      
-      if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
-        std::vector<Function*> &targets = callTargets[inst];
-        for (std::vector<Function*>::iterator fnIt = targets.begin(),
-               ie = targets.end(); fnIt != ie; ++fnIt) {
-          uint64_t dist = functionShortestPath[*fnIt];
-          if (dist) {
-            dist = 1+dist; // count instruction itself
-            if (bestThrough==0 || dist<bestThrough)
-              bestThrough = dist;
-          }
-
-          if (!(*fnIt)->isDeclaration()) {
-            uint64_t calleeDist = sm.getIndexedValue(
-                stats::minDistToUncovered, infos.getFunctionInfo(*(*fnIt)).id);
-            if (calleeDist) {
-              calleeDist = 1+calleeDist; // count instruction itself
-              if (best==0 || calleeDist<best)
-                best = calleeDist;
-            }
-          }
-        }
-      } else {
-        bestThrough = 1;
-      }
-      
-      if (bestThrough) {
-        std::vector<Instruction*> succs = getSuccs(inst);
-        for (std::vector<Instruction*>::iterator it2 = succs.begin(),
-               ie = succs.end(); it2 != ie; ++it2) {
-          uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered,
-                                             infos.getInfo(*(*it2)).id);
-          if (dist) {
-            uint64_t val = bestThrough + dist;
-            if (best==0 || val<best)
-              best = val;
-          }
-        }
-      }
-
-      if (best != cur) {
-        sm.setIndexedValue(stats::minDistToUncovered, infos.getInfo(*inst).id,
-                           best);
-        changed = true;
-      }
-    }
-  } while (changed);
+  newlyCoveredInstructions.clear();
+  recomputeMinDistToUncovered(affected, infos);
 
   for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
          ie = executor.states.end(); it != ie; ++it) {
@@ -11,11 +11,17 @@
 #define KLEE_STATSTRACKER_H
 
 #include "CallPathManager.h"
+#include "klee/Support/WorkerThread.h"
 #include "klee/System/Time.h"
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <set>
 #include <sqlite3.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace llvm {
   class BranchInst;
@@ -27,8 +33,10 @@ namespace llvm {
 namespace klee {
   class ExecutionState;
   class Executor;
+  struct FunctionInfo;
   class InstructionInfoTable;
   class InterpreterHandler;
+  class MetricsServer;
   struct KInstruction;
   struct StackFrame;
 
@@ -54,16 +62,57 @@ namespace klee {
     CallPathManager callPathManager;
 
     bool updateMinDistToUncovered;
+    /// Instructions covered since minDistToUncovered was last updated.
+    std::vector<unsigned> newlyCoveredInstructions;
+    /// Id of the first instruction of every function populated in the
+    /// instruction info table so far.
+    std::unordered_map<const llvm::Function *, unsigned> firstInstructionIDs;
+
+    /// Snapshot of the instruction level statistics written to run.istats.
+    struct IStatsSnapshot;
+
+    /// Thread that writes run.stats rows and run.istats snapshots, so that
+    /// the interpreter loop does not wait for the I/O. Once it is started,
+    /// statsFile and istatsFile are only used from jobs on this thread
+    /// until it has been drained.
+    std::unique_ptr<WorkerThread> writer;
+    /// Whether an istats snapshot is queued or being written.
+    std::atomic<bool> istatsWritePending{false};
+    /// Set once writing or committing run.stats rows has failed; writeError
+    /// is only read after observing it.
+    std::atomic<bool> writeFailed{false};
+    std::string writeError;
+
+    /// Serves the statistics published by publishMetrics(), if
+    /// --metrics-socket is set.
+    std::unique_ptr<MetricsServer> metricsServer;
 
   public:
     static bool useStatistics();
     static bool useIStats();
+    /// Whether --metrics-socket is set. Serving metrics needs a tracker but
+    /// does not turn on per-instruction statistics.
+    static bool useMetrics();
 
   private:
+    /// Sets up the indexed statistics of a function which has just been
+    /// populated in the instruction info table.
+    void functionPopulated(const llvm::Function &f, const FunctionInfo &info);
     void updateStateStatistics(uint64_t addend);
     void writeStatsHeader();
+    /// Takes a snapshot of the current statistics and queues it as a new
+    /// run.stats row.
     void writeStatsLine();
+    void insertStatsRow(const std::vector<std::int64_t> &row);
+    /// Exits with the error recorded by insertStatsRow(), if any. Must be
+    /// called on the interpreter thread.
+    void checkWriteError();
+    /// Takes a snapshot of the instruction level statistics and queues it
+    /// for writing to run.istats, unless the previous one is still pending.
     void writeIStats();
+    void writeIStatsSnapshot(const IStatsSnapshot &snapshot);
+    /// Formats the current statistics and hands them to metricsServer.
+    void publishMetrics();
 
   public:
     StatsTracker(Executor &_executor, std::string _objectFilename,
@@ -79,12 +79,36 @@ cl::opt<std::string> BatchTime(
     cl::init("5s"),
     cl::cat(SearchCat));
 
+cl::opt<unsigned> LocalityBurst(
+    "locality-burst",
+    cl::desc("Run up to N states forked off a state selected by the search "
+             "heuristic before the heuristic selects again, each time "
+             "choosing the state whose constraints are closest to those of "
+             "the previous one, to improve solver cache reuse. Higher values "
+             "favour solver locality, lower values search diversity. Set to "
+             "0 to disable (default=0)"),
+    cl::init(0),
+    cl::cat(SearchCat));
+
+cl::opt<WeightedRandomSearcher::SamplerType> NURSSampler(
+    "nurs-sampler",
+    cl::desc("Data structure NURS searchers sample states from. The two "
+             "pick different states for the same --rng-seed (default=tree)"),
+    cl::values(clEnumValN(WeightedRandomSearcher::Tree, "tree",
+                          "balanced tree of heap-allocated nodes"),
+               clEnumValN(WeightedRandomSearcher::Fenwick, "fenwick",
+                          "Fenwick tree over a flat array of states, "
+                          "faster with many states")),
+    cl::init(WeightedRandomSearcher::Tree),
+    cl::cat(SearchCat));
+
 void initializeSearchOptions() {
   // default values
   if (CoreSearch.empty()) {
-    if (UseMerge) {
+    if (UseMerge || AutoMerge) {
       CoreSearch.push_back(Searcher::NURS_CovNew);
-      klee_warning("--use-merge enabled. Using NURS_CovNew as default searcher.");
+      klee_warning("%s enabled. Using NURS_CovNew as default searcher.",
+                   UseMerge ? "--use-merge" : "--auto-merge");
     } else {
       CoreSearch.push_back(Searcher::RandomPath);
       CoreSearch.push_back(Searcher::NURS_CovNew);
@@ -114,13 +138,13 @@ Searcher *getNewSearcher(Searcher::CoreSearchType type, RNG &rng,
     case Searcher::BFS: searcher = new BFSSearcher(); break;
     case Searcher::RandomState: searcher = new RandomSearcher(rng); break;
     case Searcher::RandomPath: searcher = new RandomPathSearcher(executionTree, rng); break;
-    case Searcher::NURS_CovNew: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CoveringNew, rng); break;
-    case Searcher::NURS_MD2U: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::MinDistToUncovered, rng); break;
-    case Searcher::NURS_Depth: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::Depth, rng); break;
-    case Searcher::NURS_RP: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::RP, rng); break;
-    case Searcher::NURS_ICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::InstCount, rng); break;
-    case Searcher::NURS_CPICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CPInstCount, rng); break;
-    case Searcher::NURS_QC: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::QueryCost, rng); break;
+    case Searcher::NURS_CovNew: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CoveringNew, rng, NURSSampler); break;
+    case Searcher::NURS_MD2U: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::MinDistToUncovered, rng, NURSSampler); break;
+    case Searcher::NURS_Depth: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::Depth, rng, NURSSampler); break;
+    case Searcher::NURS_RP: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::RP, rng, NURSSampler); break;
+    case Searcher::NURS_ICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::InstCount, rng, NURSSampler); break;
+    case Searcher::NURS_CPICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CPInstCount, rng, NURSSampler); break;
+    case Searcher::NURS_QC: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::QueryCost, rng, NURSSampler); break;
   }
 
   return searcher;
@@ -146,11 +170,15 @@ Searcher *klee::constructUserSearcher(Executor &executor) {
                                     BatchInstructions);
   }
 
+  if (LocalityBurst) {
+    searcher = new LocalitySearcher(searcher, LocalityBurst);
+  }
+
   if (UseIterativeDeepeningTimeSearch) {
     searcher = new IterativeDeepeningTimeSearcher(searcher);
   }
 
-  if (UseMerge) {
+  if (UseMerge || AutoMerge) {
     auto *ms = new MergingSearcher(searcher);
     executor.setMergingSearcher(ms);
 
@@ -9,6 +9,8 @@
 
 #include "Passes.h"
 
+#include "ModuleHelper.h"
+
 #include "klee/Support/Casting.h"
 #include "klee/Support/ErrorHandling.h"
 #include "klee/Support/OptionCategories.h"
@@ -33,6 +35,11 @@ cl::list<std::string>
 
 namespace klee {
 
+void describeFunctionAliases(llvm::raw_ostream &os) {
+  for (const auto &pair : FunctionAlias)
+    os << pair << '\0';
+}
+
 bool FunctionAliasPass::runOnModule(Module &M) {
   bool modified = false;
 
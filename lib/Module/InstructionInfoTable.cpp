@@ -30,9 +30,11 @@ DISABLE_WARNING_DEPRECATED_DECLARATIONS
 #include "llvm/Support/raw_ostream.h"
 DISABLE_WARNING_POP
 
+#include <cassert>
 #include <cstdint>
 #include <map>
 #include <string>
+#include <utility>
 
 using namespace klee;
 
@@ -85,19 +87,76 @@ buildInstructionToLineMap(const llvm::Module &m) {
   return mapping;
 }
 
+std::uint64_t AssemblyLineTable::getLine(const llvm::Value &v) const {
+  std::call_once(built, [this] { lines = buildInstructionToLineMap(module); });
+  return lines.at(reinterpret_cast<std::uintptr_t>(&v));
+}
+
+unsigned InstructionInfo::getAssemblyLine() const {
+  return assemblyLines.getLine(inst);
+}
+
+uint64_t FunctionInfo::getAssemblyLine() const {
+  return assemblyLines.getLine(function);
+}
+
+/// Looks up the debug location of an instruction, returning false if it has
+/// none.
+static bool getDebugLocation(const llvm::Instruction &Inst,
+                             SourceLocation &location) {
+  // Retrieve debug information associated with instruction
+  auto dl = Inst.getDebugLoc();
+
+  // Check if a valid debug location is assigned to the instruction.
+  if (dl.get() == nullptr)
+    return false;
+
+  location.file = dl.get()->getFilename();
+  location.line = dl.getLine();
+  location.column = dl.getCol();
+
+  // Still, if the line is unknown, take the context of the instruction to
+  // narrow it down
+  if (location.line == 0) {
+    if (auto LexicalBlock =
+            llvm::dyn_cast<llvm::DILexicalBlock>(dl.getScope())) {
+      location.line = LexicalBlock->getLine();
+      location.column = LexicalBlock->getColumn();
+    }
+  }
+  return true;
+}
+
+SourceLocation
+InstructionInfoTable::getSourceLocation(const llvm::Function &Func) {
+  if (auto dsub = Func.getSubprogram())
+    return {dsub->getFilename(), dsub->getLine(), 0};
+
+  // Fallback: Mark as unknown
+  return {"", 0, 0};
+}
+
+SourceLocation
+InstructionInfoTable::getSourceLocation(const llvm::Instruction &Inst) {
+  SourceLocation location;
+  if (getDebugLocation(Inst, location))
+    return location;
+
+  // If nothing found, use the surrounding function
+  location = getSourceLocation(*Inst.getFunction());
+  location.column = 0;
+  return location;
+}
+
 class DebugInfoExtractor {
   std::vector<std::unique_ptr<std::string>> &internedStrings;
-  std::map<uintptr_t, uint64_t> lineTable;
-
-  const llvm::Module &module;
+  const AssemblyLineTable &assemblyLines;
 
 public:
   DebugInfoExtractor(
       std::vector<std::unique_ptr<std::string>> &_internedStrings,
-      const llvm::Module &_module)
-      : internedStrings(_internedStrings), module(_module) {
-    lineTable = buildInstructionToLineMap(module);
-  }
+      const AssemblyLineTable &_assemblyLines)
+      : internedStrings(_internedStrings), assemblyLines(_assemblyLines) {}
 
   std::string &getInternedString(const std::string &s) {
     auto found = std::find_if(internedStrings.begin(), internedStrings.end(),
@@ -115,98 +174,109 @@ public:
   }
 
   std::unique_ptr<FunctionInfo> getFunctionInfo(const llvm::Function &Func) {
-    auto asmLine = lineTable.at(reinterpret_cast<std::uintptr_t>(&Func));
-    auto dsub = Func.getSubprogram();
-
-    if (dsub != nullptr) {
-      auto path = dsub->getFilename();
-      return std::make_unique<FunctionInfo>(FunctionInfo(
-          0, getInternedString(path.str()), dsub->getLine(), asmLine));
-    }
-
-    // Fallback: Mark as unknown
+    auto location = InstructionInfoTable::getSourceLocation(Func);
     return std::make_unique<FunctionInfo>(
-        FunctionInfo(0, getInternedString(""), 0, asmLine));
+        FunctionInfo(0, getInternedString(location.file.str()), location.line,
+                     Func, assemblyLines));
   }
 
   std::unique_ptr<InstructionInfo>
   getInstructionInfo(const llvm::Instruction &Inst, const FunctionInfo *f) {
-    auto asmLine = lineTable.at(reinterpret_cast<std::uintptr_t>(&Inst));
-
-    // Retrieve debug information associated with instruction
-    auto dl = Inst.getDebugLoc();
-
-    // Check if a valid debug location is assigned to the instruction.
-    if (dl.get() != nullptr) {
-      auto full_path = dl.get()->getFilename();
-      auto line = dl.getLine();
-      auto column = dl.getCol();
-
-      // Still, if the line is unknown, take the context of the instruction to
-      // narrow it down
-      if (line == 0) {
-        if (auto LexicalBlock =
-                llvm::dyn_cast<llvm::DILexicalBlock>(dl.getScope())) {
-          line = LexicalBlock->getLine();
-          column = LexicalBlock->getColumn();
-        }
-      }
+    SourceLocation location;
+    if (getDebugLocation(Inst, location))
       return std::make_unique<InstructionInfo>(InstructionInfo(
-          0, getInternedString(full_path.str()), line, column, asmLine));
-    }
+          0, getInternedString(location.file.str()), location.line,
+          location.column, Inst, assemblyLines));
 
     if (f != nullptr)
       // If nothing found, use the surrounding function
       return std::make_unique<InstructionInfo>(
-          InstructionInfo(0, f->file, f->line, 0, asmLine));
+          InstructionInfo(0, f->file, f->line, 0, Inst, assemblyLines));
     // If nothing found, use the surrounding function
     return std::make_unique<InstructionInfo>(
-        InstructionInfo(0, getInternedString(""), 0, 0, asmLine));
+        InstructionInfo(0, getInternedString(""), 0, 0, Inst, assemblyLines));
   }
 };
 
-InstructionInfoTable::InstructionInfoTable(const llvm::Module &m) {
-  // Generate all debug instruction information
-  DebugInfoExtractor DI(internedStrings, m);
-  for (const auto &Func : m) {
-    auto F = DI.getFunctionInfo(Func);
-    auto FR = F.get();
-    functionInfos.insert(std::make_pair(&Func, std::move(F)));
-
-    for (auto it = llvm::inst_begin(Func), ie = llvm::inst_end(Func); it != ie;
-         ++it) {
-      auto instr = &*it;
-      infos.insert(std::make_pair(instr, DI.getInstructionInfo(*instr, FR)));
-    }
+InstructionInfoTable::InstructionInfoTable(const llvm::Module &m)
+    : module(m), assemblyLines(m) {}
+
+const FunctionInfo &
+InstructionInfoTable::populate(const llvm::Function &f) const {
+  auto found = functionInfos.find(&f);
+  if (found != functionInfos.end())
+    return *found->second.get();
+
+  if (f.getParent() != &module)
+    llvm::report_fatal_error("invalid function, not present in "
+                             "initial module!");
+  DebugInfoExtractor DI(internedStrings, assemblyLines);
+  auto F = DI.getFunctionInfo(f);
+  auto FR = F.get();
+  functionInfos.insert(std::make_pair(&f, std::move(F)));
+
+  // Instructions of a function get consecutive IDs in function order, so
+  // that neighbouring instructions get neighbouring IDs.
+  for (auto it = llvm::inst_begin(f), ie = llvm::inst_end(f); it != ie; ++it) {
+    auto info = DI.getInstructionInfo(*it, FR);
+    info->id = infosByID.size();
+    infosByID.push_back(info.get());
+    infos.insert(std::make_pair(&*it, std::move(info)));
   }
+  FR->id = infosByID.size();
+  infosByID.push_back(nullptr);
+
+  if (populateListener)
+    populateListener(f, *FR);
 
-  // Make sure that every item has a unique ID
-  size_t idCounter = 0;
-  for (auto &item : infos)
-    item.second->id = idCounter++;
-  for (auto &item : functionInfos)
-    item.second->id = idCounter++;
+  return *FR;
 }
 
 unsigned InstructionInfoTable::getMaxID() const {
-  return infos.size() + functionInfos.size();
+  for (const auto &Func : module)
+    populate(Func);
+  return infosByID.size();
+}
+
+unsigned InstructionInfoTable::getPopulatedMaxID() const {
+  return infosByID.size();
 }
 
 const InstructionInfo &
 InstructionInfoTable::getInfo(const llvm::Instruction &inst) const {
   auto it = infos.find(&inst);
-  if (it == infos.end())
-    llvm::report_fatal_error("invalid instruction, not present in "
-                             "initial module!");
+  if (it == infos.end()) {
+    if (!inst.getParent() || !inst.getFunction())
+      llvm::report_fatal_error("invalid instruction, not present in "
+                               "initial module!");
+    populate(*inst.getFunction());
+    it = infos.find(&inst);
+  }
   return *it->second.get();
 }
 
+const InstructionInfo &InstructionInfoTable::getInfo(unsigned id) const {
+  assert(id < infosByID.size() && infosByID[id] && "invalid instruction id");
+  return *infosByID[id];
+}
+
 const FunctionInfo &
 InstructionInfoTable::getFunctionInfo(const llvm::Function &f) const {
-  auto found = functionInfos.find(&f);
-  if (found == functionInfos.end())
-    llvm::report_fatal_error("invalid instruction, not present in "
-                             "initial module!");
+  return populate(f);
+}
+
+const FunctionInfo *
+InstructionInfoTable::findFunctionInfo(const llvm::Function &f) const {
+  auto it = functionInfos.find(&f);
+  return it != functionInfos.end() ? it->second.get() : nullptr;
+}
+
+void InstructionInfoTable::setPopulateListener(PopulateListener listener) {
+  populateListener = std::move(listener);
+  if (!populateListener)
+    return;
 
-  return *found->second.get();
+  for (const auto &Func : module)
+    if (const FunctionInfo *info = findFunctionInfo(Func))
+      populateListener(Func, *info);
 }
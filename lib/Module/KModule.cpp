@@ -14,6 +14,7 @@
 #include "ModuleHelper.h"
 #include "Passes.h"
 
+#include "klee/Config/CompileTimeInfo.h"
 #include "klee/Config/Version.h"
 #include "klee/Core/Interpreter.h"
 #include "klee/Module/Cell.h"
@@ -28,8 +29,14 @@
 
 DISABLE_WARNING_PUSH
 DISABLE_WARNING_DEPRECATED_DECLARATIONS
+DISABLE_WARNING(-Wuninitialized)
+#include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
 DISABLE_WARNING_POP
 
 #include <sstream>
@@ -84,6 +91,13 @@ cl::opt<SwitchImplType> SwitchType(
                           "execute switch internally")),
     cl::init(SwitchImplType::eSwitchTypeInternal), cl::cat(ModuleCat));
 
+cl::opt<std::string> ModuleCacheDir(
+    "module-cache-dir",
+    cl::desc("Cache the linked and optimised module in this directory, keyed "
+             "by the input modules and the options that affect their "
+             "preparation, and reuse it on later runs (default=off)"),
+    cl::value_desc("directory"), cl::init(""), cl::cat(ModuleCat));
+
 } // namespace
 
 /***/
@@ -192,6 +206,97 @@ bool KModule::link(std::vector<std::unique_ptr<llvm::Module>> &modules,
   return modules.size() != numRemainingModules;
 }
 
+bool KModule::loadFromCache(std::vector<std::unique_ptr<llvm::Module>> &modules,
+                            const Interpreter::ModuleOptions &opts) {
+  if (ModuleCacheDir.empty())
+    return false;
+
+  // The key covers everything that goes into the prepared module: the KLEE
+  // and LLVM builds, the preparation options and the bitcode of each input
+  // module (including the runtime libraries, which are loaded by now).
+  std::string config;
+  llvm::raw_string_ostream cs(config);
+  cs << PACKAGE_STRING << '\0' << KLEE_BUILD_REVISION << '\0'
+     << KLEE_BUILD_MODE << '\0' << LLVM_VERSION_STRING << '\0'
+     << opts.EntryPoint << '\0' << opts.OptSuffix << '\0' << opts.Optimize
+     << opts.CheckDivZero << opts.CheckOvershift << OptimiseKLEECall
+     << static_cast<int>(SwitchType.getValue()) << '\0';
+  describeOptimizeOptions(cs);
+  describeFunctionAliases(cs);
+
+  SHA1 hasher;
+  hasher.update(cs.str());
+  for (auto &m : modules) {
+    SmallVector<char, 0> bitcode;
+    raw_svector_ostream bs(bitcode);
+    WriteBitcodeToFile(*m, bs);
+    hasher.update(std::to_string(bitcode.size()));
+    hasher.update(StringRef(bitcode.data(), bitcode.size()));
+  }
+
+  SmallString<128> path(ModuleCacheDir);
+  sys::path::append(path, toHex(hasher.final(), true) + ".bc");
+  cachePath = path.str().str();
+
+  auto buffer = MemoryBuffer::getFile(cachePath);
+  if (!buffer)
+    return false;
+  auto cached = parseBitcodeFile(buffer.get()->getMemBufferRef(),
+                                 modules[0]->getContext());
+  if (!cached) {
+    klee_warning("Ignoring unreadable cached module %s: %s", cachePath.c_str(),
+                 toString(cached.takeError()).c_str());
+    return false;
+  }
+
+  klee_message("Using cached module %s", cachePath.c_str());
+  module = std::move(cached.get());
+  module->setModuleIdentifier(modules.front()->getModuleIdentifier());
+  modules.clear();
+  targetData = std::unique_ptr<llvm::DataLayout>(new DataLayout(module.get()));
+  if (opts.CheckDivZero)
+    addInternalFunction("klee_div_zero_check");
+  if (opts.CheckOvershift)
+    addInternalFunction("klee_overshift_check");
+  cachePath.clear();
+  return true;
+}
+
+void KModule::storeInCache() {
+  if (cachePath.empty())
+    return;
+
+  // Write to a temporary file and rename it into place, so that concurrent
+  // runs never read a partially written module.
+  std::error_code ec = sys::fs::create_directories(ModuleCacheDir);
+  int fd;
+  SmallString<128> tmpPath;
+  if (!ec)
+    ec = sys::fs::createUniqueFile(cachePath + "-%%%%%%.tmp", fd, tmpPath);
+  if (ec) {
+    klee_warning("Unable to cache module in %s: %s", ModuleCacheDir.c_str(),
+                 ec.message().c_str());
+    return;
+  }
+
+  {
+    raw_fd_ostream os(fd, /*shouldClose=*/true);
+    WriteBitcodeToFile(*module, os);
+    os.close();
+    if (os.has_error()) {
+      ec = os.error();
+      os.clear_error();
+    }
+  }
+  if (!ec)
+    ec = sys::fs::rename(tmpPath, cachePath);
+  if (ec) {
+    klee_warning("Unable to cache module in %s: %s", cachePath.c_str(),
+                 ec.message().c_str());
+    sys::fs::remove(tmpPath);
+  }
+}
+
 void KModule::instrument(const Interpreter::ModuleOptions &opts) {
   klee::instrument(opts.CheckDivZero, opts.CheckOvershift, module.get());
 }
@@ -224,37 +329,16 @@ void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput) {
 
   /* Build shadow structures */
 
+  // KFunctions and instruction infos are built on demand by getKFunction(),
+  // so that code which is linked in but never executed costs nothing.
   infos = std::unique_ptr<InstructionInfoTable>(
       new InstructionInfoTable(*module.get()));
 
-  std::vector<Function *> declarations;
-
-  for (auto &Function : *module) {
-    if (Function.isDeclaration()) {
-      declarations.push_back(&Function);
-    }
-
-    auto kf = std::unique_ptr<KFunction>(new KFunction(&Function, this));
-
-    for (unsigned i=0; i<kf->numInstructions; ++i) {
-      KInstruction *ki = kf->instructions[i];
-      ki->info = &infos->getInfo(*ki->inst);
-    }
-
-    functionMap.insert(std::make_pair(&Function, kf.get()));
-    functions.push_back(std::move(kf));
-  }
-
   /* Compute various interesting properties */
 
-  for (auto &kf : functions) {
-    if (functionEscapes(kf->function))
-      escapingFunctions.insert(kf->function);
-  }
-
-  for (auto &declaration : declarations) {
-    if (functionEscapes(declaration))
-      escapingFunctions.insert(declaration);
+  for (auto &Function : *module) {
+    if (functionEscapes(&Function))
+      escapingFunctions.insert(&Function);
   }
 
   if (DebugPrintEscapingFunctions && !escapingFunctions.empty()) {
@@ -268,6 +352,23 @@ void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput) {
   }
 }
 
+KFunction *KModule::getKFunction(llvm::Function *f) {
+  auto it = functionMap.find(f);
+  if (it != functionMap.end())
+    return it->second;
+
+  auto kf = std::unique_ptr<KFunction>(new KFunction(f, this));
+  for (unsigned i=0; i<kf->numInstructions; ++i) {
+    KInstruction *ki = kf->instructions[i];
+    ki->info = &infos->getInfo(*ki->inst);
+  }
+
+  KFunction *result = kf.get();
+  functionMap.insert(std::make_pair(f, result));
+  functions.push_back(std::move(kf));
+  return result;
+}
+
 void KModule::checkModule() { klee::checkModule(DontVerify, module.get()); }
 
 KConstant* KModule::getKConstant(const Constant *c) {
@@ -355,6 +456,9 @@ KFunction::KFunction(llvm::Function *_function,
       case Instruction::InsertValue:
       case Instruction::ExtractValue:
         ki = new KGEPInstruction(); break;
+      case Instruction::Br:
+      case Instruction::Switch:
+        ki = new KBranchInstruction(); break;
       default:
         ki = new KInstruction(); break;
       }
@@ -362,6 +466,27 @@ KFunction::KFunction(llvm::Function *_function,
       Instruction *inst = &*it;
       ki->inst = inst;
       ki->dest = registerMap[inst];
+      ki->opcode = inst->getOpcode();
+      Type *ty = inst->getType();
+      ki->width = ty->isSized() ? km->targetData->getTypeSizeInBits(ty) : 0;
+      if (const CmpInst *ci = dyn_cast<CmpInst>(inst))
+        ki->predicate = ci->getPredicate();
+      else
+        ki->predicate = 0;
+
+      if (ki->opcode == Instruction::Br || ki->opcode == Instruction::Switch) {
+        // Resolve the successors here so that branching does not have to
+        // look up the target block and its PHI incoming index every time.
+        KBranchInstruction *kbi = static_cast<KBranchInstruction *>(ki);
+        for (unsigned j = 0, e = inst->getNumSuccessors(); j != e; ++j) {
+          BasicBlock *succ = inst->getSuccessor(j);
+          unsigned incoming = 0;
+          if (const PHINode *phi = dyn_cast<PHINode>(&succ->front()))
+            incoming = phi->getBasicBlockIndex(&*bbit);
+          kbi->successors.push_back(
+              std::make_pair(basicBlockEntry[succ], incoming));
+        }
+      }
 
       if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
         const CallBase &cb = cast<CallBase>(*inst);
@@ -0,0 +1,100 @@
+//===-- MergePoints.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Computes where states forked at a branch can be merged again, and how many
+// solver queries a merged value is likely to cause, for automatic state
+// merging (--auto-merge).
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Module/KInstruction.h"
+#include "klee/Module/KModule.h"
+
+#include "klee/Support/CompilerWarning.h"
+DISABLE_WARNING_PUSH
+DISABLE_WARNING_DEPRECATED_DECLARATIONS
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+DISABLE_WARNING_POP
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+
+using namespace llvm;
+using namespace klee;
+
+void KFunction::computeMergePoints() {
+  DominatorTree dt(*function);
+  PostDominatorTree pdt(*function);
+  LoopInfo loops(dt);
+
+  std::map<const Value *, unsigned> registerOf;
+  for (unsigned i = 0; i < numInstructions; ++i)
+    registerOf[instructions[i]->inst] = instructions[i]->dest;
+
+  // Count the queries each register feeds directly, then propagate the
+  // counts from users to operands in a single backward pass. Values flowing
+  // around a loop through PHI nodes are counted once per iteration at most.
+  const unsigned maxQueryUses = 1u << 16;
+  registerQueryUses.assign(numRegisters, 0);
+  auto addUses = [&](const Value *v, unsigned n) {
+    auto it = registerOf.find(v);
+    if (it != registerOf.end()) {
+      unsigned &uses = registerQueryUses[it->second];
+      uses = std::min(uses + n, maxQueryUses);
+    } else if (const Argument *a = dyn_cast<Argument>(v)) {
+      unsigned &uses = registerQueryUses[getArgRegister(a->getArgNo())];
+      uses = std::min(uses + n, maxQueryUses);
+    }
+  };
+  for (unsigned i = numInstructions; i-- > 0;) {
+    const Instruction *inst = instructions[i]->inst;
+    if (const BranchInst *bi = dyn_cast<BranchInst>(inst)) {
+      if (bi->isConditional())
+        addUses(bi->getCondition(), 1);
+    } else if (const SwitchInst *si = dyn_cast<SwitchInst>(inst)) {
+      addUses(si->getCondition(), 1);
+    } else if (const LoadInst *li = dyn_cast<LoadInst>(inst)) {
+      addUses(li->getPointerOperand(), 1);
+    } else if (const StoreInst *st = dyn_cast<StoreInst>(inst)) {
+      addUses(st->getPointerOperand(), 1);
+    }
+    if (unsigned uses = registerQueryUses[instructions[i]->dest]) {
+      for (const Use &op : inst->operands())
+        addUses(op.get(), uses);
+    }
+  }
+
+  for (unsigned i = 0; i < numInstructions; ++i) {
+    KInstruction *ki = instructions[i];
+    const Instruction *inst = ki->inst;
+    if (!isa<SwitchInst>(inst) &&
+        !(isa<BranchInst>(inst) && cast<BranchInst>(inst)->isConditional()))
+      continue;
+
+    // Branches whose post-dominator lies outside their loop decide whether
+    // to leave the loop; states forked there only meet again after running
+    // the remaining iterations, so they are not held back.
+    BasicBlock *bb = ki->inst->getParent();
+    DomTreeNode *node = pdt.getNode(bb);
+    if (!node || !node->getIDom())
+      continue;
+    BasicBlock *ipdom = node->getIDom()->getBlock();
+    if (!ipdom || loops.getLoopFor(bb) != loops.getLoopFor(ipdom))
+      continue;
+
+    unsigned phis = std::distance(ipdom->begin(),
+                                  ipdom->getFirstNonPHI()->getIterator());
+    mergePoints[ki] = instructions[basicBlockEntry[ipdom] + phis];
+  }
+}
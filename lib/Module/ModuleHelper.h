@@ -12,6 +12,7 @@
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
 
 namespace klee {
 enum class SwitchImplType {
@@ -32,6 +33,13 @@ void injectStaticConstructorsAndDestructors(llvm::Module *m,
 
 void optimizeModule(llvm::Module *M,
                     llvm::ArrayRef<const char *> preservedFunctions);
+
+/// Print the options that change how optimizeModule() transforms a module,
+/// for use in module cache keys.
+void describeOptimizeOptions(llvm::raw_ostream &os);
+
+/// Print the --function-alias replacements, for use in module cache keys.
+void describeFunctionAliases(llvm::raw_ostream &os);
 } // namespace klee
 
 #endif // KLEE_MODULEHELPER_H
@@ -26,3 +26,5 @@ void klee::optimiseAndPrepare(bool OptimiseKLEECall, bool Optimize,
                               llvm::Module *module) {
   assert(0);
 }
+
+void klee::describeOptimizeOptions(llvm::raw_ostream &os) {}
@@ -142,6 +142,11 @@ static void AddStandardCompilePasses(legacy::PassManager &PM) {
   addPass(PM, createConstantMergePass());        // Merge dup global constants
 }
 
+void klee::describeOptimizeOptions(llvm::raw_ostream &os) {
+  os << DisableInline << DisableInternalize << VerifyEach << Strip
+     << StripDebug << '\0';
+}
+
 /// Optimize - Perform link time optimizations. This will run the scalar
 /// optimizations, any loaded plugin-optimization modules, and then the
 /// inter-procedural optimizations if applicable.
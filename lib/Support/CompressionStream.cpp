@@ -15,6 +15,7 @@
 
 #include <fcntl.h>
 #include <errno.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -112,5 +113,32 @@ void compressed_fd_ostream::write_file(const char *Ptr, size_t Size) {
     Size -= ret;
   } while (Size > 0);
 }
+
+compressed_fd_istream::compressed_fd_istream(const std::string &Filename,
+                                             std::string &ErrorInfo) {
+  ErrorInfo = "";
+  file = gzopen(Filename.c_str(), "rb");
+  if (!file)
+    ErrorInfo = errno ? strerror(errno) : "gzopen failed";
+}
+
+compressed_fd_istream::~compressed_fd_istream() {
+  if (file)
+    gzclose(file);
+}
+
+bool compressed_fd_istream::getline(std::string &Line) {
+  Line.clear();
+  if (!file)
+    return false;
+  while (gzgets(file, buffer, BUFSIZE)) {
+    Line += buffer;
+    if (!Line.empty() && Line.back() == '\n') {
+      Line.pop_back();
+      return true;
+    }
+  }
+  return !Line.empty();
+}
 }
 #endif
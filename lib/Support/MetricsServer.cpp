@@ -0,0 +1,147 @@
+//===-- MetricsServer.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Support/MetricsServer.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+/// How long to wait for a client to send its request before answering
+const int requestTimeoutMs = 100;
+
+/// Sends all of `size` bytes, giving up if the client goes away.
+void sendAll(int fd, const char *data, std::size_t size) {
+  while (size) {
+    ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return;
+    data += n;
+    size -= n;
+  }
+}
+} // namespace
+
+std::unique_ptr<MetricsServer> MetricsServer::create(const std::string &path,
+                                                     std::string &error) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+    error = "socket path is empty or too long: " + path;
+    return nullptr;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+  // Remove a socket left behind by an earlier run, but nothing else.
+  struct stat st;
+  if (::lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+    ::unlink(path.c_str());
+
+  std::unique_ptr<MetricsServer> server(new MetricsServer());
+  server->path = path;
+  server->snapshot = std::make_shared<const std::string>();
+  server->listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (server->listenFd < 0 ||
+      ::bind(server->listenFd, reinterpret_cast<sockaddr *>(&address),
+             sizeof(address)) != 0) {
+    error = std::string("cannot listen on ") + path + ": " + strerror(errno);
+    return nullptr;
+  }
+  server->bound = true;
+  if (::listen(server->listenFd, 16) != 0 ||
+      ::pipe2(server->wakeFds, O_CLOEXEC) != 0) {
+    error = std::string("cannot listen on ") + path + ": " + strerror(errno);
+    return nullptr;
+  }
+
+  server->thread = std::thread([s = server.get()] { s->loop(); });
+  return server;
+}
+
+MetricsServer::~MetricsServer() {
+  if (thread.joinable()) {
+    char c = 0;
+    while (::write(wakeFds[1], &c, 1) < 0 && errno == EINTR)
+      ;
+    thread.join();
+  }
+  for (int fd : {listenFd, wakeFds[0], wakeFds[1]})
+    if (fd >= 0)
+      ::close(fd);
+  if (bound)
+    ::unlink(path.c_str());
+}
+
+void MetricsServer::publish(std::string text) {
+  std::atomic_store(&snapshot,
+                    std::make_shared<const std::string>(std::move(text)));
+}
+
+void MetricsServer::loop() {
+  for (;;) {
+    pollfd fds[2] = {{listenFd, POLLIN, 0}, {wakeFds[0], POLLIN, 0}};
+    if (::poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    if (fds[1].revents)
+      return;
+    if (!(fds[0].revents & POLLIN))
+      continue;
+
+    int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+      continue;
+    // do not let a client that stops reading block the server
+    timeval timeout = {1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    serve(fd);
+    ::close(fd);
+  }
+}
+
+void MetricsServer::serve(int fd) {
+  // Read whatever the client sends first; an HTTP client sends a request
+  // line, a plain client usually nothing.
+  char request[1024];
+  std::size_t received = 0;
+  pollfd pfd = {fd, POLLIN, 0};
+  while (received < sizeof(request) &&
+         ::poll(&pfd, 1, requestTimeoutMs) > 0) {
+    ssize_t n = ::recv(fd, request + received, sizeof(request) - received, 0);
+    if (n <= 0)
+      break;
+    received += n;
+    // the end of the HTTP request headers
+    if (std::string(request, received).find("\r\n\r\n") != std::string::npos)
+      break;
+  }
+
+  const std::shared_ptr<const std::string> text = std::atomic_load(&snapshot);
+  if (received >= 4 && std::memcmp(request, "GET ", 4) == 0) {
+    std::string header = "HTTP/1.0 200 OK\r\n"
+                         "Content-Type: text/plain; version=0.0.4\r\n"
+                         "Content-Length: " +
+                         std::to_string(text->size()) + "\r\n\r\n";
+    sendAll(fd, header.data(), header.size());
+  }
+  sendAll(fd, text->data(), text->size());
+}
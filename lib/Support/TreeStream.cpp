@@ -7,39 +7,156 @@
 //
 //===----------------------------------------------------------------------===//
 
-#define DEBUG_TYPE "TreeStreamWriter"
 #include "klee/ADT/TreeStream.h"
 
-#include "klee/Support/Debug.h"
-
+#include <algorithm>
 #include <cassert>
-#include <iomanip>
 #include <fstream>
 #include <iterator>
-#include <map>
 
-#include "llvm/Support/raw_ostream.h"
+#include <fcntl.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace klee;
 
+namespace {
+const char magic[8] = {'K', 'L', 'E', 'E', 'T', 'S', '2', '\0'};
+
+enum RecordKind : unsigned char { ForkRecord, BytesRecord, BitsRecord };
+
+const std::size_t recordHeaderSize = 9;
+
+std::size_t payloadSize(unsigned count, bool bits) {
+  return bits ? (count + 7) / 8 : count;
+}
+
+unsigned readU32(const unsigned char *p) {
+  unsigned value;
+  memcpy(&value, p, 4);
+  return value;
+}
+} // namespace
+
+///
+
+void TreeStreamIndex::addStream(TreeStreamID id, TreeStreamID parent) {
+  assert(id == streams.size() && parent < id && "stream IDs out of order");
+  Stream s;
+  s.parent = parent;
+  s.forkPoint = streams[parent].length;
+  streams.push_back(std::move(s));
+}
+
+void TreeStreamIndex::addChunk(TreeStreamID id, std::uint64_t offset,
+                               unsigned count, bool bits) {
+  assert(id < streams.size() && "unknown stream");
+  Stream &s = streams[id];
+  s.chunks.push_back({offset, s.length, count, bits});
+  s.length += count;
+}
+
+bool TreeStreamIndex::read(TreeStreamID id, const unsigned char *data,
+                           std::size_t size,
+                           std::vector<unsigned char> &out) const {
+  if (id >= streams.size())
+    return false;
+
+  // The chain of streams from `id` up to the root, with the number of
+  // items each one contributes.
+  std::vector<std::pair<TreeStreamID, unsigned>> chain;
+  std::size_t total = 0;
+  for (unsigned limit = streams[id].length; id; id = streams[id].parent) {
+    chain.emplace_back(id, limit);
+    total += limit;
+    limit = streams[id].forkPoint;
+  }
+  out.reserve(out.size() + total);
+
+  for (auto it = chain.rbegin(), ie = chain.rend(); it != ie; ++it) {
+    unsigned limit = it->second;
+    for (const Chunk &c : streams[it->first].chunks) {
+      if (c.start >= limit)
+        break;
+      unsigned n = std::min(c.count, limit - c.start);
+      if (c.offset + payloadSize(n, c.bits) > size)
+        return false;
+      const unsigned char *p = data + c.offset;
+      if (c.bits) {
+        for (unsigned i = 0; i < n; ++i)
+          out.push_back((p[i / 8] >> (i % 8)) & 1 ? '1' : '0');
+      } else {
+        out.insert(out.end(), p, p + n);
+      }
+    }
+  }
+  return true;
+}
+
+///
+
+MappedFile::~MappedFile() {
+  if (base)
+    munmap(base, mapped);
+  if (fd >= 0)
+    close(fd);
+}
+
+const unsigned char *MappedFile::map(std::size_t size) {
+  if (size && size <= available)
+    return static_cast<const unsigned char *>(base);
+
+  if (fd < 0 && (fd = ::open(path.c_str(), O_RDONLY)) < 0)
+    return nullptr;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || static_cast<std::size_t>(st.st_size) < size)
+    return nullptr;
+
+  std::size_t fileSize = st.st_size;
+  if (fileSize > mapped) {
+    if (base)
+      munmap(base, mapped);
+    // Pages past the end of the file are never touched; they become
+    // readable as the file grows.
+    std::size_t length = std::max<std::size_t>(2 * fileSize, 1 << 16);
+    base = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+      base = nullptr;
+      mapped = available = 0;
+      return nullptr;
+    }
+    mapped = length;
+  }
+  available = fileSize;
+  return static_cast<const unsigned char *>(base);
+}
+
 ///
 
 TreeStreamWriter::TreeStreamWriter(const std::string &_path) 
   : lastID(0),
     bufferCount(0),
+    bufferBits(false),
     path(_path),
     output(new std::ofstream(path.c_str(), 
                              std::ios::out | std::ios::binary)),
-    ids(1) {
+    fileSize(0),
+    ids(1),
+    mapping(_path) {
   if (!output->good()) {
     delete output;
     output = 0;
+    return;
   }
+  output->write(magic, sizeof(magic));
+  fileSize = sizeof(magic);
 }
 
 TreeStreamWriter::~TreeStreamWriter() {
-  flush();
+  if (output)
+    flush();
   delete output;
 }
 
@@ -55,35 +172,64 @@ TreeOStream TreeStreamWriter::open(const TreeOStream &os) {
   assert(output && os.writer==this);
   flushBuffer();
   unsigned id = ids++;
-  output->write(reinterpret_cast<const char*>(&os.id), 4);
-  unsigned tag = id | (1<<31);
-  output->write(reinterpret_cast<const char*>(&tag), 4);
+  char payload[8];
+  memcpy(payload, &os.id, 4);
+  memcpy(payload + 4, &id, 4);
+  output->put(ForkRecord);
+  output->write(payload, sizeof(payload));
+  fileSize += 1 + sizeof(payload);
+  index.addStream(id, os.id);
   return TreeOStream(*this, id);
 }
 
+void TreeStreamWriter::writeRecord(unsigned char kind, unsigned id,
+                                   unsigned count, const char *payload,
+                                   std::size_t payloadSize) {
+  output->put(kind);
+  output->write(reinterpret_cast<const char*>(&id), 4);
+  output->write(reinterpret_cast<const char*>(&count), 4);
+  output->write(payload, payloadSize);
+  index.addChunk(id, fileSize + recordHeaderSize, count, kind == BitsRecord);
+  fileSize += recordHeaderSize + payloadSize;
+}
+
 void TreeStreamWriter::write(TreeOStream &os, const char *s, unsigned size) {
   if (bufferCount && 
-      (os.id!=lastID || size+bufferCount>bufferSize))
+      (os.id!=lastID || bufferBits || size+bufferCount>bufferSize))
     flushBuffer();
   if (bufferCount) { // (os.id==lastID && size+bufferCount<=bufferSize)
     memcpy(&buffer[bufferCount], s, size);
     bufferCount += size;
   } else if (size<bufferSize) {
     lastID = os.id;
+    bufferBits = false;
     memcpy(buffer, s, size);
     bufferCount = size;
   } else {
-    output->write(reinterpret_cast<const char*>(&os.id), 4);
-    output->write(reinterpret_cast<const char*>(&size), 4);
-    output->write(s, size);
+    writeRecord(BytesRecord, os.id, size, s, size);
   }
 }
 
+void TreeStreamWriter::writeBranch(TreeOStream &os, bool taken) {
+  if (bufferCount &&
+      (os.id!=lastID || !bufferBits || bufferCount==8*bufferSize))
+    flushBuffer();
+  if (!bufferCount) {
+    lastID = os.id;
+    bufferBits = true;
+  }
+  unsigned char &byte = reinterpret_cast<unsigned char&>(buffer[bufferCount/8]);
+  if (bufferCount % 8 == 0)
+    byte = 0;
+  if (taken)
+    byte |= 1 << (bufferCount % 8);
+  ++bufferCount;
+}
+
 void TreeStreamWriter::flushBuffer() {
   if (bufferCount) {    
-    output->write(reinterpret_cast<const char*>(&lastID), 4);
-    output->write(reinterpret_cast<const char*>(&bufferCount), 4);
-    output->write(buffer, bufferCount);
+    writeRecord(bufferBits ? BitsRecord : BytesRecord, lastID, bufferCount,
+                buffer, payloadSize(bufferCount, bufferBits));
     bufferCount = 0;
   }
 }
@@ -97,67 +243,114 @@ void TreeStreamWriter::readStream(TreeStreamID streamID,
                                   std::vector<unsigned char> &out) {
   assert(streamID>0 && streamID<ids);
   flush();
-  
-  std::ifstream is(path.c_str(),
-                   std::ios::in | std::ios::binary);
-  assert(is.good());
-  KLEE_DEBUG(llvm::errs() << "finding chain for: " << streamID << "\n");
-
-  std::map<unsigned,unsigned> parents;
-  std::vector<unsigned> roots;
-  for (;;) {
-    assert(is.good());
-    unsigned id;
-    unsigned tag;
-    is.read(reinterpret_cast<char*>(&id), 4);
-    is.read(reinterpret_cast<char*>(&tag), 4);
-    if (tag&(1<<31)) { // fork
-      unsigned child = tag ^ (1<<31);
-
-      if (child==streamID) {
-        roots.push_back(child);
-        while (id) {
-          roots.push_back(id);
-          std::map<unsigned, unsigned>::iterator it = parents.find(id);
-          assert(it!=parents.end());
-          id = it->second;
-        } 
-        break;
-      } else {
-        parents.insert(std::make_pair(child,id));
-      }
+
+  const unsigned char *data = mapping.map(fileSize);
+  assert(data && "unable to map tree stream");
+  bool success = index.read(streamID, data, fileSize, out);
+  assert(success && "corrupt tree stream");
+  (void)success;
+}
+
+///
+
+TreeStreamReader::TreeStreamReader(const std::string &path)
+    : mapping(path), data(nullptr), size(0), valid(false) {
+  data = mapping.map(0);
+  if (!data)
+    return;
+  size = mapping.size();
+  if (size < sizeof(magic) || memcmp(data, magic, sizeof(magic)))
+    return;
+
+  for (std::size_t pos = sizeof(magic); pos < size;) {
+    if (size - pos < recordHeaderSize)
+      return;
+    unsigned char kind = data[pos];
+    unsigned a = readU32(data + pos + 1), b = readU32(data + pos + 5);
+    pos += recordHeaderSize;
+    if (kind == ForkRecord) {
+      if (b != index.size() || a >= b)
+        return;
+      index.addStream(b, a);
+    } else if (kind == BytesRecord || kind == BitsRecord) {
+      std::size_t n = payloadSize(b, kind == BitsRecord);
+      if (a == 0 || a >= index.size() || size - pos < n)
+        return;
+      index.addChunk(a, pos, b, kind == BitsRecord);
+      pos += n;
     } else {
-      unsigned size = tag;
-      while (size--) is.get();
+      return;
     }
   }
-  KLEE_DEBUG({
-      llvm::errs() << "roots: ";
-      for (size_t i = 0, e = roots.size(); i < e; ++i) {
-        llvm::errs() << roots[i] << " ";
+  valid = true;
+}
+
+bool TreeStreamReader::readStream(TreeStreamID id,
+                                  std::vector<unsigned char> &out) const {
+  return valid && id > 0 && index.read(id, data, size, out);
+}
+
+///
+
+bool klee::convertLegacyTreeStream(const std::string &oldPath,
+                                   const std::string &newPath,
+                                   std::string &error) {
+  std::ifstream is(oldPath.c_str(), std::ios::in | std::ios::binary);
+  if (!is.good()) {
+    error = "unable to open " + oldPath;
+    return false;
+  }
+  std::vector<char> old((std::istreambuf_iterator<char>(is)),
+                        std::istreambuf_iterator<char>());
+  if (old.size() >= sizeof(magic) && !memcmp(old.data(), magic, sizeof(magic))) {
+    error = oldPath + " is already in the current format";
+    return false;
+  }
+
+  TreeStreamWriter writer(newPath);
+  if (!writer.good()) {
+    error = "unable to create " + newPath;
+    return false;
+  }
+
+  // Old records are (stream, tag) pairs: a tag with the top bit set opens
+  // the child stream (tag ^ 1<<31), otherwise `tag` bytes of data follow.
+  std::vector<TreeOStream> streams(1);
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(old.data());
+  for (std::size_t pos = 0, size = old.size(); pos < size;) {
+    if (size - pos < 8) {
+      error = "truncated record in " + oldPath;
+      return false;
+    }
+    unsigned id = readU32(p + pos), tag = readU32(p + pos + 4);
+    pos += 8;
+    if (id >= streams.size() || (id == 0 && !(tag & (1u << 31)))) {
+      error = "unknown stream in " + oldPath;
+      return false;
+    }
+    if (tag & (1u << 31)) {
+      TreeOStream child = id ? writer.open(streams[id]) : writer.open();
+      if (child.getID() != (tag ^ (1u << 31))) {
+        error = "stream IDs out of order in " + oldPath;
+        return false;
       }
-      llvm::errs() << "\n";
-    });
-  is.seekg(0, std::ios::beg);
-  for (;;) {
-    unsigned id;
-    unsigned tag;
-    is.read(reinterpret_cast<char*>(&id), 4);
-    is.read(reinterpret_cast<char*>(&tag), 4);
-    if (!is.good()) break;
-    if (tag&(1<<31)) { // fork
-      unsigned child = tag ^ (1<<31);
-      if (id==roots.back() && roots.size()>1 && child==roots[roots.size()-2])
-        roots.pop_back();
+      streams.push_back(child);
     } else {
-      unsigned size = tag;
-      if (id==roots.back()) {
-        while (size--) out.push_back(is.get());
-      } else {
-        while (size--) is.get();
+      if (size - pos < tag) {
+        error = "truncated record in " + oldPath;
+        return false;
+      }
+      for (unsigned i = 0; i < tag; ++i) {
+        char c = p[pos + i];
+        if (c == '0' || c == '1')
+          streams[id].writeBranch(c == '1');
+        else
+          streams[id].write(&c, 1);
       }
+      pos += tag;
     }
-  }  
+  }
+  return true;
 }
 
 ///
@@ -185,6 +378,11 @@ void TreeOStream::write(const char *buffer, unsigned size) {
   writer->write(*this, buffer, size);
 }
 
+void TreeOStream::writeBranch(bool taken) {
+  assert(writer);
+  writer->writeBranch(*this, taken);
+}
+
 TreeOStream &TreeOStream::operator<<(const std::string &s) {
   assert(writer);
   write(s.c_str(), s.size());
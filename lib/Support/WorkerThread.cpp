@@ -0,0 +1,65 @@
+//===-- WorkerThread.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Support/WorkerThread.h"
+
+#include <utility>
+
+using namespace klee;
+
+WorkerThread::WorkerThread() : thread([this] { loop(); }) {}
+
+WorkerThread::~WorkerThread() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  jobAvailable.notify_one();
+  thread.join();
+}
+
+void WorkerThread::loop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+    if (jobs.empty())
+      return; // stopping, and every job has run
+
+    Job job = std::move(jobs.front());
+    jobs.pop_front();
+    running = true;
+    lock.unlock();
+    job();
+    lock.lock();
+    running = false;
+    jobDone.notify_all();
+  }
+}
+
+void WorkerThread::submit(Job job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(std::move(job));
+  }
+  jobAvailable.notify_one();
+}
+
+void WorkerThread::drain() { waitForPending(0); }
+
+void WorkerThread::waitForPending(std::size_t maxPending) {
+  std::unique_lock<std::mutex> lock(mutex);
+  jobDone.wait(lock, [this, maxPending] {
+    return jobs.size() + (running ? 1 : 0) <= maxPending;
+  });
+}
+
+std::size_t WorkerThread::pending() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return jobs.size() + (running ? 1 : 0);
+}
@@ -0,0 +1,79 @@
+; RUN: %llvmas %s -o %t1.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --optimize=false %t1.bc | FileCheck %s
+; RUN: FileCheck --check-prefix=CHECK-INFO --input-file=%t.klee-out/info %s
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --optimize=false --concrete-fast-path=false %t1.bc | FileCheck %s
+; RUN: FileCheck --check-prefix=CHECK-OFF --input-file=%t.klee-out/info %s
+
+; Checks the native evaluation of concrete integer instructions against the
+; semantics of the expression builder, in particular for narrow widths.
+
+; CHECK: PASS
+; CHECK-INFO: KLEE: done: fast-path instructions = {{[1-9][0-9]*}}
+; CHECK-OFF: KLEE: done: fast-path instructions = 0
+
+declare i32 @puts(i8*)
+
+@.passstr = private constant [5 x i8] c"PASS\00", align 1
+@.failstr = private constant [5 x i8] c"FAIL\00", align 1
+
+define i32 @main() {
+bb0:
+  %v0 = sdiv i8 -7, 2
+  %c0 = icmp eq i8 %v0, -3
+  br i1 %c0, label %bb1, label %bbfalse
+bb1:
+  %v1 = srem i8 -7, 2
+  %c1 = icmp eq i8 %v1, -1
+  br i1 %c1, label %bb2, label %bbfalse
+bb2:
+  %v2 = ashr i8 -128, 3
+  %c2 = icmp eq i8 %v2, -16
+  br i1 %c2, label %bb3, label %bbfalse
+bb3:
+  %v3 = lshr i8 -128, 3
+  %c3 = icmp eq i8 %v3, 16
+  br i1 %c3, label %bb4, label %bbfalse
+bb4:
+  %v4 = shl i8 3, 7
+  %c4 = icmp eq i8 %v4, -128
+  br i1 %c4, label %bb5, label %bbfalse
+bb5:
+  %v5 = sext i4 -1 to i64
+  %c5 = icmp eq i64 %v5, -1
+  br i1 %c5, label %bb6, label %bbfalse
+bb6:
+  %v6 = trunc i64 511 to i8
+  %c6 = icmp eq i8 %v6, -1
+  br i1 %c6, label %bb7, label %bbfalse
+bb7:
+  %c7 = icmp slt i8 -1, 1
+  br i1 %c7, label %bb8, label %bbfalse
+bb8:
+  %c8 = icmp ult i8 -1, 1
+  br i1 %c8, label %bbfalse, label %bb9
+bb9:
+  %v9 = mul i16 300, 300
+  %c9 = icmp eq i16 %v9, 24464
+  br i1 %c9, label %bb10, label %bbfalse
+bb10:
+  %v10 = add i1 true, true
+  %c10 = icmp eq i1 %v10, false
+  br i1 %c10, label %bb11, label %bbfalse
+bb11:
+  %v11 = sub i64 0, 1
+  %v11z = zext i8 -1 to i64
+  %v11u = udiv i64 %v11, %v11z
+  %c11 = icmp eq i64 %v11u, 72340172838076673
+  br i1 %c11, label %bb12, label %bbfalse
+bb12:
+  %c12 = icmp sge i32 -2147483648, 0
+  br i1 %c12, label %bbfalse, label %bbtrue
+bbtrue:
+  %0 = call i32 @puts(i8* getelementptr inbounds ([5 x i8], [5 x i8]* @.passstr, i64 0, i64 0)) nounwind
+  ret i32 0
+bbfalse:
+  %1 = call i32 @puts(i8* getelementptr inbounds ([5 x i8], [5 x i8]* @.failstr, i64 0, i64 0)) nounwind
+  ret i32 0
+}
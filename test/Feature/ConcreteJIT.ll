@@ -0,0 +1,107 @@
+; RUN: %llvmas %s -o %t1.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --optimize=false --concrete-fast-path=false --concrete-jit --concrete-jit-threshold=2 %t1.bc 2>&1 | FileCheck %s
+; RUN: FileCheck --check-prefix=CHECK-INFO --input-file=%t.klee-out/info %s
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --optimize=false --concrete-fast-path=false %t1.bc 2>&1 | FileCheck %s
+; RUN: FileCheck --check-prefix=CHECK-OFF --input-file=%t.klee-out/info %s
+
+; Checks that calls compiled by --concrete-jit give the same results as the
+; interpreter, and that they are interpreted when they read symbolic memory
+; (undoing their writes), reach uncovered code or fail.
+
+; CHECK: acc:41
+; CHECK: read:(ZExt w32 (Read w8 2 x))
+; CHECK: rare:37035
+; CHECK: fact:3628800
+; CHECK: memory error: out of bound pointer
+; CHECK-INFO: KLEE: done: fast-path instructions = {{[1-9][0-9]*}}
+; CHECK-OFF: KLEE: done: fast-path instructions = 0
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
+declare void @klee_print_expr(i8*, ...)
+
+@.x = private constant [2 x i8] c"x\00"
+@.acc = private constant [4 x i8] c"acc\00"
+@.read = private constant [5 x i8] c"read\00"
+@.rare = private constant [5 x i8] c"rare\00"
+@.fact = private constant [5 x i8] c"fact\00"
+@acc = global i64 0
+@arr = global [4 x i32] zeroinitializer
+@buf = global [4 x i8] zeroinitializer
+@sym = global [4 x i8] zeroinitializer
+
+; Increments @acc before reading p[i]
+define i32 @incr(i8* %p, i64 %i) {
+entry:
+  %a = load i64, i64* @acc
+  %a1 = add i64 %a, 1
+  store i64 %a1, i64* @acc
+  %q = getelementptr i8, i8* %p, i64 %i
+  %v = load i8, i8* %q
+  %z = zext i8 %v to i32
+  ret i32 %z
+}
+
+; Only takes the rare block for 12345
+define i32 @select(i32 %a) {
+entry:
+  %c = icmp eq i32 %a, 12345
+  br i1 %c, label %rare, label %common
+rare:
+  %m = mul i32 %a, 3
+  ret i32 %m
+common:
+  %d = udiv i32 %a, 3
+  ret i32 %d
+}
+
+define i32 @get(i64 %i) {
+entry:
+  %p = getelementptr [4 x i32], [4 x i32]* @arr, i64 0, i64 %i
+  %v = load i32, i32* %p
+  ret i32 %v
+}
+
+define i64 @fact(i64 %n) {
+entry:
+  %c = icmp ule i64 %n, 1
+  br i1 %c, label %base, label %rec
+base:
+  ret i64 1
+rec:
+  %n1 = sub i64 %n, 1
+  %r = call i64 @fact(i64 %n1)
+  %m = mul i64 %r, %n
+  ret i64 %m
+}
+
+define i32 @main() {
+entry:
+  %s = getelementptr [4 x i8], [4 x i8]* @sym, i64 0, i64 0
+  call void @klee_make_symbolic(i8* %s, i64 4, i8* getelementptr ([2 x i8], [2 x i8]* @.x, i64 0, i64 0))
+  %b = getelementptr [4 x i8], [4 x i8]* @buf, i64 0, i64 0
+  br label %loop
+loop:
+  %k = phi i32 [ 0, %entry ], [ %kn, %loop ]
+  %k64 = zext i32 %k to i64
+  %i = and i64 %k64, 3
+  %r = call i32 @incr(i8* %b, i64 %i)
+  %d = call i32 @select(i32 %k)
+  %f = call i64 @fact(i64 %i)
+  %g = call i32 @get(i64 %i)
+  %kn = add i32 %k, 1
+  %c = icmp ult i32 %kn, 40
+  br i1 %c, label %loop, label %after
+after:
+  %r2 = call i32 @incr(i8* %s, i64 2)
+  %a = load i64, i64* @acc
+  call void (i8*, ...) @klee_print_expr(i8* getelementptr ([4 x i8], [4 x i8]* @.acc, i64 0, i64 0), i64 %a)
+  call void (i8*, ...) @klee_print_expr(i8* getelementptr ([5 x i8], [5 x i8]* @.read, i64 0, i64 0), i32 %r2)
+  %d2 = call i32 @select(i32 12345)
+  call void (i8*, ...) @klee_print_expr(i8* getelementptr ([5 x i8], [5 x i8]* @.rare, i64 0, i64 0), i32 %d2)
+  %f2 = call i64 @fact(i64 10)
+  call void (i8*, ...) @klee_print_expr(i8* getelementptr ([5 x i8], [5 x i8]* @.fact, i64 0, i64 0), i64 %f2)
+  %o = call i32 @get(i64 6)
+  ret i32 %o
+}
@@ -0,0 +1,20 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --lazy-global-init %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --lazy-global-init=false %t.bc 2>&1 | FileCheck %s
+// CHECK: external modified read-only object
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 0
+
+#include <assert.h>
+#include <string.h>
+
+static const char message[] = "hello";
+
+int main() {
+  // strcpy is an external call, which must not change the constant
+  strcpy((char *)message, "X");
+  assert(message[0] == 'h');
+  return 0;
+}
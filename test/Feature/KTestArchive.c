@@ -0,0 +1,32 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.unpacked
+// RUN: %klee --output-dir=%t.klee-out --ktest-archive --compress-ktest-archive %t.bc 2>&1 | FileCheck --check-prefix=CHECK-RUN %s
+// CHECK-RUN: KLEE: done: generated tests = 3
+// RUN: not ls %t.klee-out/test000001.ktest
+// RUN: %ktest-tool %t.klee-out/tests.ktar | FileCheck --check-prefix=CHECK-TOOL %s
+// CHECK-TOOL: ktest file : '{{.*}}tests.ktar:test000001.ktest'
+// CHECK-TOOL: ktest file : '{{.*}}tests.ktar:test000002.ktest'
+// CHECK-TOOL: ktest file : '{{.*}}tests.ktar:test000003.ktest'
+
+// Individual tests can be unpacked again
+// RUN: %ktest-tool --unpack %t.unpacked %t.klee-out/tests.ktar
+// RUN: %ktest-tool %t.unpacked/test000002.ktest | FileCheck --check-prefix=CHECK-FILE %s
+// CHECK-FILE: name: 'x'
+
+// The archive can be used for seeding
+// RUN: rm -rf %t.seed-out
+// RUN: %klee --output-dir=%t.seed-out --seed-dir=%t.klee-out --only-seed %t.bc 2>&1 | FileCheck --check-prefix=CHECK-SEED %s
+// CHECK-SEED: using 3 seeds
+// CHECK-SEED: KLEE: done: generated tests = 3
+
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x < 0)
+    return 0;
+  if (x > 100)
+    return 1;
+  return 2;
+}
@@ -0,0 +1,31 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --lazy-global-init %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --lazy-global-init=false %t.bc 2>&1 | FileCheck %s
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 2
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <string.h>
+
+static const char message[] = "hello lazy";
+static const char *const words[] = {message, message + 6};
+static const short table[4] = {1, 2, 3, 4};
+static int counter = 41;
+static char unused[1 << 16] = {1};
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x < 10)
+    ++counter;
+  assert(counter == 41 || counter == 42);
+  assert(table[2] == 3);
+  // strlen is an external call, which copies the constant string out
+  assert(strlen(words[1]) == 4);
+  assert(words[0][0] == 'h');
+  return 0;
+}
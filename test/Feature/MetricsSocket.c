@@ -0,0 +1,21 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// Socket paths are limited in length, so use a relative one.
+// RUN: rm -rf %t.dir && mkdir -p %t.dir && cd %t.dir
+// RUN: %klee --output-dir=klee-out --metrics-socket=metrics.sock %t.bc 2>&1 | FileCheck %s
+// The socket is removed again at the end of the run
+// RUN: test ! -e metrics.sock
+// RUN: rm -rf klee-out
+// RUN: not %klee --output-dir=klee-out --metrics-socket=nonexistent/metrics.sock %t.bc 2>&1 | FileCheck --check-prefix=CHECK-ERROR %s
+
+// CHECK: KLEE: done: completed paths = 2
+// CHECK-ERROR: Cannot serve metrics: cannot listen on
+
+#include "klee/klee.h"
+
+int main(void) {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x > 0)
+    return 1;
+  return 0;
+}
@@ -0,0 +1,29 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.cache
+// RUN: %klee --output-dir=%t.klee-out --module-cache-dir=%t.cache %t.bc 2>&1 | FileCheck --check-prefix=CHECK-MISS %s
+// CHECK-MISS-NOT: Using cached module
+// CHECK-MISS: KLEE: done: completed paths = 2
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --module-cache-dir=%t.cache %t.bc 2>&1 | FileCheck --check-prefix=CHECK-HIT %s
+// CHECK-HIT: Using cached module
+// CHECK-HIT: KLEE: done: completed paths = 2
+
+// Options that change the prepared module select a different entry.
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --module-cache-dir=%t.cache --switch-type=simple %t.bc 2>&1 | FileCheck --check-prefix=CHECK-MISS %s
+// RUN: ls %t.cache | FileCheck --check-prefix=CHECK-ENTRIES %s
+// CHECK-ENTRIES: {{^[0-9a-f]{40}\.bc$}}
+// CHECK-ENTRIES-NEXT: {{^[0-9a-f]{40}\.bc$}}
+
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  switch (x) {
+  case 1:
+    return 1;
+  default:
+    return 0;
+  }
+}
@@ -0,0 +1,53 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.log
+// RUN: %klee --output-dir=%t.klee-out --search=random-path --record-search-log=%t.log %t.bc > %t.recorded
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --search=dfs --replay-search-log=%t.log %t.bc > %t.replayed
+// RUN: diff %t.recorded %t.replayed
+
+// A log cannot be replayed against a different program.
+// RUN: %clang %s -emit-llvm %O0opt -DEXTRA_BRANCH -c -o %t2.bc
+// RUN: rm -rf %t.klee-out
+// RUN: not %klee --output-dir=%t.klee-out --replay-search-log=%t.log %t2.bc 2>&1 | FileCheck %s
+// CHECK: Execution diverged from search log
+
+#include "klee/klee.h"
+#include <stdio.h>
+
+int main() {
+  int x, y;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&y, sizeof(y), "y");
+
+#ifdef EXTRA_BRANCH
+  if (x == 42)
+    return 0;
+#endif
+
+  if (x > 10)
+    printf("x > 10\n");
+  else
+    printf("x <= 10\n");
+
+  if (y & 1)
+    printf("odd\n");
+  else
+    printf("even\n");
+
+  if (x + y == 7)
+    printf("sum\n");
+
+  // forks in Executor::branch() are logged as well
+  switch (y & 6) {
+  case 0:
+    printf("case 0\n");
+    break;
+  case 2:
+    printf("case 2\n");
+    break;
+  default:
+    printf("default\n");
+  }
+
+  return 0;
+}
@@ -8,6 +8,16 @@
 // RUN: %klee-exec-tree tree-dot %t.klee-out | FileCheck --check-prefix=CHECK-DOT %s
 // RUN: %klee-exec-tree tree-info %t.klee-out | FileCheck --check-prefix=CHECK-TINFO %s
 // RUN: not %klee-exec-tree dot %t.klee-out/exec-tree-doesnotexist.db
+// RUN: %klee-exec-tree --streaming branches %t.klee-out | FileCheck --check-prefix=CHECK-BRANCH %s
+// RUN: %klee-exec-tree --streaming --jobs=4 depths %t.klee-out | FileCheck --check-prefix=CHECK-DEPTH %s
+// RUN: %klee-exec-tree --in-memory --jobs=4 instructions %t.klee-out | FileCheck --check-prefix=CHECK-INSTR %s
+// RUN: %klee-exec-tree --streaming --jobs=2 terminations %t.klee-out | FileCheck --check-prefix=CHECK-TERM %s
+// RUN: %klee-exec-tree --streaming tree-dot %t.klee-out | FileCheck --check-prefix=CHECK-DOT %s
+// RUN: %klee-exec-tree --streaming --jobs=3 tree-info %t.klee-out | FileCheck --check-prefix=CHECK-TINFO %s
+// RUN: not %klee-exec-tree --root=1000 tree-info %t.klee-out 2>&1 | FileCheck --check-prefix=CHECK-ROOT %s
+// RUN: rm -rf %t.klee-out-sync
+// RUN: %klee -write-exec-tree --exec-tree-writer-thread=false --exec-tree-batch-size=3 --output-dir=%t.klee-out-sync %t.bc
+// RUN: %klee-exec-tree tree-info %t.klee-out-sync | FileCheck --check-prefix=CHECK-TINFO %s
 
 #include "klee/klee.h"
 
@@ -72,6 +82,8 @@ int main(void) {
 // CHECK-DOT-DAG: N{{[0-9]+}}->{N{{[0-9]+}} N{{[0-9]+}}};
 // CHECK-DOT-DAG: }
 
+// CHECK-ROOT: ExecutionTree DB does not contain node 1000
+
 // CHECK-TINFO: nodes: 15
 // CHECK-TINFO: leaf nodes: 8
 // CHECK-TINFO: max. depth: 5
@@ -0,0 +1,31 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --auto-merge --search=bfs %t.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=CHECK-STATS %s < %t.klee-out/info
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --auto-merge --search=dfs %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --auto-merge --auto-merge-max-ites=0 %t.bc 2>&1 | FileCheck --check-prefix=CHECK-NOMERGE %s
+
+// Each of the 8 branches forks, and the two states are merged again where
+// the branch's then-block joins the control flow.
+// CHECK: generated tests = 1{{$}}
+// CHECK-STATS: merged states = 8{{$}}
+// CHECK-STATS: estimated paths saved by merging = 255{{$}}
+// CHECK-NOMERGE: generated tests = 256{{$}}
+
+#include "klee/klee.h"
+
+int main() {
+  unsigned char x;
+  int count = 0;
+
+  klee_make_symbolic(&x, sizeof(x), "x");
+
+  for (int i = 0; i < 8; ++i) {
+    if (x & (1 << i))
+      ++count;
+  }
+
+  return count;
+}
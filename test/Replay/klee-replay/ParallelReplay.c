@@ -0,0 +1,36 @@
+// RUN: rm -rf %t.out
+// RUN: mkdir -p %t.out
+// RUN: %ktest-gen --bout-file %t.out/test1.ktest normal
+// RUN: %ktest-gen --bout-file %t.out/test2.ktest crash
+// RUN: %ktest-gen --bout-file %t.out/test3.ktest normal
+// RUN: %ktest-gen --bout-file %t.out/test4.ktest exit
+// RUN: %ktest-gen --bout-file %t.out/test5.ktest crash
+// RUN: %cc %s -O0 -o %t
+// RUN: %klee-replay --jobs=3 %t %t.out/test1.ktest %t.out/test2.ktest %t.out/test3.ktest %t.out/test4.ktest %t.out/test5.ktest 2> %t.out/out.txt
+// RUN: FileCheck --input-file=%t.out/out.txt %s
+
+// CHECK-DAG: RESULT: {{.*}}test1.ktest: NORMAL
+// CHECK-DAG: RESULT: {{.*}}test2.ktest: CRASHED signal 6
+// CHECK-DAG: RESULT: {{.*}}test4.ktest: ABNORMAL 3
+// CHECK: SUMMARY: 5 tests: 2 normal, 1 abnormal, 2 crashed, 0 timed out, 0 errors
+// CHECK-NEXT: SUMMARY: CRASHED signal 6: 2 tests
+// CHECK-NEXT: SUMMARY: ABNORMAL 3: 1 tests
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+  // Fails if another test shares the replay directory
+  int fd = open("output", O_CREAT | O_EXCL | O_WRONLY, 0644);
+  if (fd < 0)
+    return 1;
+  close(fd);
+
+  if (!strcmp(argv[1], "crash"))
+    abort();
+  if (!strcmp(argv[1], "exit"))
+    return 3;
+  return 0;
+}
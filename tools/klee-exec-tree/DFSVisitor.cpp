@@ -9,27 +9,35 @@
 
 #include "DFSVisitor.h"
 
+#include <deque>
+#include <tuple>
 #include <utility>
 
 DFSVisitor::DFSVisitor(const Tree &tree, callbackT cb_intermediate,
                        callbackT cb_leaf) noexcept
-    : tree{tree},
-      cb_intermediate{std::move(cb_intermediate)}, cb_leaf{std::move(cb_leaf)} {
+    : DFSVisitor(tree, std::move(cb_intermediate), std::move(cb_leaf),
+                 tree.getRoot(), 1) {}
+
+DFSVisitor::DFSVisitor(const Tree &tree, callbackT cb_intermediate,
+                       callbackT cb_leaf, std::uint32_t root,
+                       std::uint32_t rootDepth) noexcept
+    : tree{tree}, cb_intermediate{std::move(cb_intermediate)},
+      cb_leaf{std::move(cb_leaf)}, root{root}, rootDepth{rootDepth} {
   run();
 }
 
 void DFSVisitor::run() const noexcept {
   // empty tree
-  if (tree.nodes.size() <= 1)
+  if (tree.empty())
     return;
 
   std::vector<std::tuple<std::uint32_t, std::uint32_t>> stack{
-      {1, 1}}; // (id, depth)
+      {root, rootDepth}}; // (id, depth)
   while (!stack.empty()) {
     std::uint32_t id, depth;
     std::tie(id, depth) = stack.back();
     stack.pop_back();
-    const auto &node = tree.nodes[id];
+    const auto node = tree.getNode(id);
 
     if (node.left || node.right) {
       if (cb_intermediate)
@@ -44,3 +52,33 @@ void DFSVisitor::run() const noexcept {
     }
   }
 }
+
+std::vector<std::pair<std::uint32_t, std::uint32_t>>
+splitTree(const Tree &tree, std::size_t count,
+          const std::function<void(std::uint32_t, Node, std::uint32_t)>
+              &cb_intermediate,
+          const std::function<void(std::uint32_t, Node, std::uint32_t)>
+              &cb_leaf) {
+  if (tree.empty())
+    return {};
+
+  std::deque<std::pair<std::uint32_t, std::uint32_t>> queue{
+      {tree.getRoot(), 1}}; // (id, depth)
+  while (!queue.empty() && queue.size() < count) {
+    const auto [id, depth] = queue.front();
+    queue.pop_front();
+    const auto node = tree.getNode(id);
+
+    if (node.left || node.right) {
+      cb_intermediate(id, node, depth);
+      if (node.left)
+        queue.emplace_back(node.left, depth + 1);
+      if (node.right)
+        queue.emplace_back(node.right, depth + 1);
+    } else {
+      cb_leaf(id, node, depth);
+    }
+  }
+
+  return {queue.begin(), queue.end()};
+}
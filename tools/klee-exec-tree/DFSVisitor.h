@@ -11,7 +11,16 @@
 
 #include "Tree.h"
 
+#include <atomic>
+#include <cstddef>
 #include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// Number of threads used by visitParallel()
+inline unsigned numJobs{1};
 
 /// @brief Traverses an execution tree and calls registered callbacks for
 /// intermediate and leaf nodes (not the classical Visitor pattern).
@@ -22,10 +31,70 @@ class DFSVisitor {
   const Tree &tree;
   callbackT cb_intermediate;
   callbackT cb_leaf;
+  std::uint32_t root;
+  std::uint32_t rootDepth;
   void run() const noexcept;
 
 public:
   DFSVisitor(const Tree &tree, callbackT cb_intermediate,
              callbackT cb_leaf) noexcept;
+  /// Traverses the subtree below `root`, which is at depth `rootDepth`
+  DFSVisitor(const Tree &tree, callbackT cb_intermediate, callbackT cb_leaf,
+             std::uint32_t root, std::uint32_t rootDepth) noexcept;
   ~DFSVisitor() = default;
 };
+
+/// Visits the top of the tree breadth-first, until at least `count` subtrees
+/// are left or the tree is exhausted, and returns the (root, depth) pairs of
+/// the remaining subtrees.
+std::vector<std::pair<std::uint32_t, std::uint32_t>>
+splitTree(const Tree &tree, std::size_t count,
+          const std::function<void(std::uint32_t, Node, std::uint32_t)>
+              &cb_intermediate,
+          const std::function<void(std::uint32_t, Node, std::uint32_t)>
+              &cb_leaf);
+
+/// Visits every node with numJobs threads, for statistics that do not depend
+/// on the order of the nodes. Each thread accumulates into its own Result with
+/// intermediate(result, id, node, depth) and leaf(result, id, node, depth),
+/// reading from its own clone of the tree; the partial results are combined
+/// with merge(result, partial).
+template <typename Result, typename IntermediateFn, typename LeafFn,
+          typename MergeFn>
+Result visitParallel(const Tree &tree, IntermediateFn intermediate, LeafFn leaf,
+                     MergeFn merge) {
+  Result result{};
+  auto bind = [](auto &fn, Result &r) {
+    return [&fn, &r](std::uint32_t id, Node node, std::uint32_t depth) {
+      fn(r, id, node, depth);
+    };
+  };
+
+  if (numJobs <= 1) {
+    DFSVisitor visitor(tree, bind(intermediate, result), bind(leaf, result));
+    return result;
+  }
+
+  const auto subtrees = splitTree(tree, 8 * numJobs, bind(intermediate, result),
+                                  bind(leaf, result));
+  std::atomic<std::size_t> next{0};
+  std::mutex mutex;
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < numJobs; ++i) {
+    threads.emplace_back([&] {
+      const auto view = tree.clone();
+      Result partial{};
+      for (std::size_t j; (j = next++) < subtrees.size();) {
+        DFSVisitor visitor(*view, bind(intermediate, partial),
+                           bind(leaf, partial), subtrees[j].first,
+                           subtrees[j].second);
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      merge(result, partial);
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+
+  return result;
+}
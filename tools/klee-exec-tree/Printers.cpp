@@ -25,19 +25,22 @@
 // branches
 
 void printBranches(const Tree &tree) {
-  if (tree.nodes.size() <= 1) {
+  if (tree.empty()) {
     std::cout << "Empty tree.\n";
     return;
   }
 
-  std::unordered_map<BranchType, std::uint32_t> branchTypes;
+  using BranchCounts = std::unordered_map<BranchType, std::uint32_t>;
 
-  DFSVisitor visitor(
+  const auto branchTypes = visitParallel<BranchCounts>(
       tree,
-      [&branchTypes](std::uint32_t id, Node node, std::uint32_t depth) {
-        branchTypes[std::get<BranchType>(node.kind)]++;
-      },
-      nullptr);
+      [](BranchCounts &counts, std::uint32_t id, Node node,
+         std::uint32_t depth) { counts[std::get<BranchType>(node.kind)]++; },
+      [](BranchCounts &, std::uint32_t, Node, std::uint32_t) {},
+      [](BranchCounts &counts, const BranchCounts &partial) {
+        for (const auto &[branchType, count] : partial)
+          counts[branchType] += count;
+      });
 
   // sort output
   std::vector<std::pair<BranchType, std::uint32_t>> sortedBranchTypes(
@@ -63,12 +66,12 @@ struct DepthInfo {
 };
 
 DepthInfo getDepthInfo(const Tree &tree) {
-  DepthInfo I;
-
-  DFSVisitor visitor(
+  return visitParallel<DepthInfo>(
       tree,
-      [&](std::uint32_t id, Node node, std::uint32_t depth) { ++I.noNodes; },
-      [&I](std::uint32_t id, Node node, std::uint32_t depth) {
+      [](DepthInfo &I, std::uint32_t id, Node node, std::uint32_t depth) {
+        ++I.noNodes;
+      },
+      [](DepthInfo &I, std::uint32_t id, Node node, std::uint32_t depth) {
         ++I.noLeaves;
         ++I.noNodes;
         if (depth > I.maxDepth)
@@ -76,13 +79,20 @@ DepthInfo getDepthInfo(const Tree &tree) {
         if (depth >= I.depths.size())
           I.depths.resize(depth + 1, 0);
         ++I.depths[depth];
+      },
+      [](DepthInfo &I, const DepthInfo &partial) {
+        I.noLeaves += partial.noLeaves;
+        I.noNodes += partial.noNodes;
+        I.maxDepth = std::max(I.maxDepth, partial.maxDepth);
+        if (partial.depths.size() > I.depths.size())
+          I.depths.resize(partial.depths.size(), 0);
+        for (size_t depth = 0; depth < partial.depths.size(); ++depth)
+          I.depths[depth] += partial.depths[depth];
       });
-
-  return I;
 }
 
 void printDepths(const Tree &tree) {
-  if (tree.nodes.size() <= 1) {
+  if (tree.empty()) {
     std::cout << "Empty tree.\n";
     return;
   }
@@ -188,17 +198,27 @@ struct Info {
 };
 
 void printInstructions(const Tree &tree) {
-  std::map<std::uint32_t, Info> asmInfo;
+  using AsmInfo = std::map<std::uint32_t, Info>;
 
-  DFSVisitor visitor(
+  const auto asmInfo = visitParallel<AsmInfo>(
       tree,
-      [&asmInfo](std::uint32_t id, Node node, std::uint32_t depth) {
+      [](AsmInfo &asmInfo, std::uint32_t id, Node node, std::uint32_t depth) {
         asmInfo[node.asmLine].noBranches++;
       },
-      [&asmInfo](std::uint32_t id, Node node, std::uint32_t depth) {
+      [](AsmInfo &asmInfo, std::uint32_t id, Node node, std::uint32_t depth) {
         auto &info = asmInfo[node.asmLine];
         info.noTerminations++;
         info.terminationTypes[std::get<StateTerminationType>(node.kind)]++;
+      },
+      [](AsmInfo &asmInfo, const AsmInfo &partial) {
+        for (const auto &[asmLine, partialInfo] : partial) {
+          auto &info = asmInfo[asmLine];
+          info.noBranches += partialInfo.noBranches;
+          info.noTerminations += partialInfo.noTerminations;
+          for (const auto &[terminationType, count] :
+               partialInfo.terminationTypes)
+            info.terminationTypes[terminationType] += count;
+        }
       });
 
   std::cout << "asm line,branches,terminations,termination types\n";
@@ -218,17 +238,22 @@ void printInstructions(const Tree &tree) {
 // terminations
 
 void printTerminations(const Tree &tree) {
-  if (tree.nodes.size() <= 1) {
+  if (tree.empty()) {
     std::cout << "Empty tree.\n";
     return;
   }
 
-  std::map<StateTerminationType, std::uint32_t> terminations;
+  using TerminationCounts = std::map<StateTerminationType, std::uint32_t>;
 
-  DFSVisitor visitor(
-      tree, nullptr,
-      [&terminations](std::uint32_t id, Node node, std::uint32_t depth) {
-        terminations[std::get<StateTerminationType>(node.kind)]++;
+  const auto terminations = visitParallel<TerminationCounts>(
+      tree, [](TerminationCounts &, std::uint32_t, Node, std::uint32_t) {},
+      [](TerminationCounts &counts, std::uint32_t id, Node node,
+         std::uint32_t depth) {
+        counts[std::get<StateTerminationType>(node.kind)]++;
+      },
+      [](TerminationCounts &counts, const TerminationCounts &partial) {
+        for (const auto &[terminationType, count] : partial)
+          counts[terminationType] += count;
       });
 
   std::cout << "termination type,count\n";
@@ -239,7 +264,7 @@ void printTerminations(const Tree &tree) {
 // tree info
 
 void printTreeInfo(const Tree &tree) {
-  if (tree.nodes.size() <= 1) {
+  if (tree.empty()) {
     std::cout << "Empty tree.\n";
     return;
   }
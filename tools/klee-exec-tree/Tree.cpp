@@ -14,51 +14,151 @@
 #include <cassert>
 #include <cstdlib>
 #include <iostream>
+#include <string_view>
 
-Tree::Tree(const std::filesystem::path &path) {
-  // open db
+namespace {
+const char *lookupQuery{"SELECT stateID, leftID, rightID, asmLine, kind FROM "
+                        "nodes WHERE ID = ?;"};
+
+/// Trees with more nodes are streamed by Backend::Auto
+constexpr std::uint32_t maxInMemoryNodes{1u << 24};
+
+::sqlite3 *openDatabase(const std::filesystem::path &path) {
   ::sqlite3 *db;
-  if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) !=
-      SQLITE_OK) {
+  if (sqlite3_open_v2(path.c_str(), &db,
+                      SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX,
+                      nullptr) != SQLITE_OK) {
     std::cerr << "Cannot open execution tree database: " << sqlite3_errmsg(db)
               << std::endl;
     exit(EXIT_FAILURE);
   }
+  return db;
+}
 
-  // initialise prepared statement
-  ::sqlite3_stmt *readStmt;
-  std::string query{
-      "SELECT ID, stateID, leftID, rightID, asmLine, kind FROM nodes;"};
-  if (sqlite3_prepare_v3(db, query.c_str(), -1, SQLITE_PREPARE_PERSISTENT,
-                         &readStmt, nullptr) != SQLITE_OK) {
-    std::cerr << "Cannot prepare read statement: " << sqlite3_errmsg(db)
-              << std::endl;
-    exit(EXIT_FAILURE);
-  }
-
-  ::sqlite3_stmt *maxStmt;
-  query = "SELECT MAX(ID) FROM nodes;";
+::sqlite3_stmt *prepare(::sqlite3 *db, const std::string &query,
+                        const char *name) {
+  ::sqlite3_stmt *stmt;
   if (sqlite3_prepare_v3(db, query.c_str(), -1, SQLITE_PREPARE_PERSISTENT,
-                         &maxStmt, nullptr) != SQLITE_OK) {
-    std::cerr << "Cannot prepare max statement: " << sqlite3_errmsg(db)
-              << std::endl;
+                         &stmt, nullptr) != SQLITE_OK) {
+    std::cerr << "Cannot prepare " << name
+              << " statement: " << sqlite3_errmsg(db) << std::endl;
     exit(EXIT_FAILURE);
   }
+  return stmt;
+}
 
-  // read max id
-  int rc;
-  std::uint64_t maxID;
-  if ((rc = sqlite3_step(maxStmt)) == SQLITE_ROW) {
+std::uint32_t readMaxID(::sqlite3 *db) {
+  ::sqlite3_stmt *maxStmt = prepare(db, "SELECT MAX(ID) FROM nodes;", "max");
+  std::uint32_t maxID;
+  if (sqlite3_step(maxStmt) == SQLITE_ROW) {
     maxID = static_cast<std::uint32_t>(sqlite3_column_int(maxStmt, 0));
   } else {
     std::cerr << "Cannot read maximum ID: " << sqlite3_errmsg(db) << std::endl;
     exit(EXIT_FAILURE);
   }
+  sqlite3_finalize(maxStmt);
+  return maxID;
+}
+
+/// Whether nodes can be looked up by ID without scanning the whole table
+bool hasIDIndex(::sqlite3 *db) {
+  ::sqlite3_stmt *planStmt =
+      prepare(db, std::string("EXPLAIN QUERY PLAN ") + lookupQuery, "read");
+  bool indexed = false;
+  while (sqlite3_step(planStmt) == SQLITE_ROW) {
+    const auto *detail =
+        reinterpret_cast<const char *>(sqlite3_column_text(planStmt, 3));
+    if (detail && std::string_view(detail).substr(0, 6) == "SEARCH")
+      indexed = true;
+  }
+  sqlite3_finalize(planStmt);
+  return indexed;
+}
+
+/// Determines whether a node is a branch or a leaf node
+decltype(Node::kind) nodeKind(std::uint32_t left, std::uint32_t right,
+                              std::uint8_t kind) {
+  if (left == 0 && right == 0)
+    return static_cast<StateTerminationType>(kind);
+  return static_cast<BranchType>(kind);
+}
+} // namespace
+
+// Tree
+
+std::unique_ptr<Tree> Tree::open(const std::filesystem::path &path,
+                                 Backend backend, std::uint32_t root) {
+  initialiseValidTypes();
+  initialiseTypeNames();
+
+  ::sqlite3 *db = openDatabase(path);
+  std::unique_ptr<Tree> tree;
+  if (backend == Backend::InMemory) {
+    tree = std::make_unique<InMemoryTree>(db, root);
+  } else {
+    const bool indexed = hasIDIndex(db);
+    const auto maxID = readMaxID(db);
+    if (backend == Backend::Auto)
+      backend = indexed && maxID > maxInMemoryNodes ? Backend::Streaming
+                                                    : Backend::InMemory;
+
+    if (backend == Backend::Streaming) {
+      if (!indexed)
+        std::cerr << "Warning: ExecutionTree DB has no index on node IDs, "
+                     "every lookup scans the whole table"
+                  << std::endl;
+      tree = std::make_unique<StreamingTree>(path, root, maxID);
+    } else {
+      tree = std::make_unique<InMemoryTree>(db, root);
+    }
+  }
+  sqlite3_close(db);
+
+  return tree;
+}
+
+void Tree::checkType(std::uint32_t id, const Node &node) {
+  if (node.left || node.right) {
+    // valid branch types
+    assert(std::holds_alternative<BranchType>(node.kind));
+    const auto branchType = std::get<BranchType>(node.kind);
+    if (validBranchTypes.count(branchType) == 0) {
+      std::cerr << "ExecutionTree DB contains unknown branch type ("
+                << (unsigned)static_cast<std::uint8_t>(branchType)
+                << ") in node " << id << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  } else {
+    // valid termination types
+    assert(std::holds_alternative<StateTerminationType>(node.kind));
+    const auto terminationType = std::get<StateTerminationType>(node.kind);
+    if (validTerminationTypes.count(terminationType) == 0 ||
+        terminationType == StateTerminationType::RUNNING) {
+      std::cerr << "ExecutionTree DB contains unknown termination type ("
+                << (unsigned)static_cast<std::uint8_t>(terminationType)
+                << ") in node " << id << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+// InMemoryTree
+
+InMemoryTree::InMemoryTree(::sqlite3 *db, std::uint32_t root)
+    : Tree(root, 0) {
+  // initialise prepared statement
+  ::sqlite3_stmt *readStmt = prepare(
+      db, "SELECT ID, stateID, leftID, rightID, asmLine, kind FROM nodes;",
+      "read");
+
+  // read max id
+  maxID = readMaxID(db);
 
   // reserve space
-  nodes.resize(maxID + 1, {});
+  auto nodes = std::make_shared<std::vector<Node>>(maxID + 1, Node{});
 
   // read rows into vector
+  int rc;
   while ((rc = sqlite3_step(readStmt)) == SQLITE_ROW) {
     const auto ID = static_cast<std::uint32_t>(sqlite3_column_int(readStmt, 0));
     const auto stateID =
@@ -91,20 +191,12 @@ Tree::Tree(const std::filesystem::path &path) {
                 << ID << std::endl;
     }
 
-    // determine node kind (branch or leaf node)
-    decltype(Node::kind) kind;
-    if (left == 0 && right == 0) {
-      kind = static_cast<StateTerminationType>(tmpKind);
-    } else {
-      kind = static_cast<BranchType>(tmpKind);
-    }
-
     // store children
-    nodes[ID] = {.left = left,
-                 .right = right,
-                 .stateID = stateID,
-                 .asmLine = asmLine,
-                 .kind = kind};
+    (*nodes)[ID] = {.left = left,
+                    .right = right,
+                    .stateID = stateID,
+                    .asmLine = asmLine,
+                    .kind = nodeKind(left, right, tmpKind)};
   }
 
   if (rc != SQLITE_DONE) {
@@ -113,62 +205,42 @@ Tree::Tree(const std::filesystem::path &path) {
     exit(EXIT_FAILURE);
   }
 
-  // close db
-  sqlite3_finalize(maxStmt);
   sqlite3_finalize(readStmt);
-  sqlite3_close(db);
+  this->nodes = std::move(nodes);
 
-  // initialise global sets/maps and sanity check
-  initialiseValidTypes();
-  sanityCheck();
-  initialiseTypeNames();
-}
-
-void Tree::initialiseTypeNames() {
-// branch types
-#undef BTYPE
-#define BTYPE(Name, I) branchTypeNames[BranchType::Name] = #Name;
-  BRANCH_TYPES
+  if (!empty() && (root == 0 || root > maxID)) {
+    std::cerr << "ExecutionTree DB does not contain node " << root
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
 
-// termination types
-#undef TTYPE
-#define TTYPE(Name, I, S)                                                      \
-  terminationTypeNames[StateTerminationType::Name] = #Name;
-  TERMINATION_TYPES
+  sanityCheck();
 }
 
-void Tree::initialiseValidTypes() {
-// branch types
-#undef BTYPE
-#define BTYPE(Name, I) validBranchTypes.insert(BranchType::Name);
-  BRANCH_TYPES
-
-// termination types
-#undef TTYPE
-#define TTYPE(Name, I, S)                                                      \
-  validTerminationTypes.insert(StateTerminationType::Name);
-  TERMINATION_TYPES
+std::unique_ptr<Tree> InMemoryTree::clone() const {
+  return std::unique_ptr<Tree>(new InMemoryTree(nodes, root, maxID));
 }
 
-void Tree::sanityCheck() {
-  if (nodes.size() <= 1) // [0] is unused
+void InMemoryTree::sanityCheck() const {
+  if (empty())
     return;
 
-  std::vector<std::uint32_t> stack{1}; // root ID
-  std::unordered_set<std::uint32_t> visited;
+  std::vector<std::uint32_t> stack{root};
+  std::vector<bool> visited(maxID + 1, false);
   while (!stack.empty()) {
     const auto id = stack.back();
     stack.pop_back();
 
-    if (!visited.insert(id).second) {
+    if (visited[id]) {
       std::cerr
           << "ExecutionTree DB contains duplicate child reference or circular "
              "structure. Affected node: "
           << id << std::endl;
       exit(EXIT_FAILURE);
     }
+    visited[id] = true;
 
-    const auto &node = nodes[id];
+    const auto &node = (*nodes)[id];
 
     // default constructed "gap" in vector
     if (!node.left && !node.right &&
@@ -179,31 +251,120 @@ void Tree::sanityCheck() {
       exit(EXIT_FAILURE);
     }
 
-    if (node.left || node.right) {
-      if (node.right)
-        stack.push_back(node.right);
-      if (node.left)
-        stack.push_back(node.left);
-      // valid branch types
-      assert(std::holds_alternative<BranchType>(node.kind));
-      const auto branchType = std::get<BranchType>(node.kind);
-      if (validBranchTypes.count(branchType) == 0) {
-        std::cerr << "ExecutionTree DB contains unknown branch type ("
-                  << (unsigned)static_cast<std::uint8_t>(branchType)
-                  << ") in node " << id << std::endl;
-        exit(EXIT_FAILURE);
-      }
-    } else {
-      // valid termination types
-      assert(std::holds_alternative<StateTerminationType>(node.kind));
-      const auto terminationType = std::get<StateTerminationType>(node.kind);
-      if (validTerminationTypes.count(terminationType) == 0 ||
-          terminationType == StateTerminationType::RUNNING) {
-        std::cerr << "ExecutionTree DB contains unknown termination type ("
-                  << (unsigned)static_cast<std::uint8_t>(terminationType)
-                  << ") in node " << id << std::endl;
-        exit(EXIT_FAILURE);
-      }
+    if (node.right)
+      stack.push_back(node.right);
+    if (node.left)
+      stack.push_back(node.left);
+    checkType(id, node);
+  }
+}
+
+// StreamingTree
+
+StreamingTree::StreamingTree(const std::filesystem::path &path,
+                             std::uint32_t root, std::uint32_t maxID)
+    : Tree(root, maxID), path{path}, db{openDatabase(path)},
+      lookupStmt{prepare(db, lookupQuery, "read")} {
+  if (!empty() && (root == 0 || root > maxID)) {
+    std::cerr << "ExecutionTree DB does not contain node " << root
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+StreamingTree::~StreamingTree() {
+  sqlite3_finalize(lookupStmt);
+  sqlite3_close(db);
+}
+
+std::unique_ptr<Tree> StreamingTree::clone() const {
+  return std::make_unique<StreamingTree>(path, root, maxID);
+}
+
+Node StreamingTree::getNode(std::uint32_t id) const {
+  int rc;
+  if ((rc = sqlite3_bind_int64(lookupStmt, 1, id)) == SQLITE_OK)
+    rc = sqlite3_step(lookupStmt);
+  if (rc == SQLITE_DONE) {
+    std::cerr << "ExecutionTree DB references undefined node. Affected node: "
+              << id << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (rc != SQLITE_ROW) {
+    std::cerr << "Error while reading database: " << sqlite3_errmsg(db)
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  const auto stateID =
+      static_cast<std::uint32_t>(sqlite3_column_int(lookupStmt, 0));
+  const auto left =
+      static_cast<std::uint32_t>(sqlite3_column_int(lookupStmt, 1));
+  const auto right =
+      static_cast<std::uint32_t>(sqlite3_column_int(lookupStmt, 2));
+  const auto asmLine =
+      static_cast<std::uint32_t>(sqlite3_column_int(lookupStmt, 3));
+  const auto tmpKind =
+      static_cast<std::uint8_t>(sqlite3_column_int(lookupStmt, 4));
+  sqlite3_reset(lookupStmt);
+
+  // sanity checks: valid indices
+  if (left > maxID || right > maxID) {
+    std::cerr << "ExecutionTree DB contains references to non-existing nodes "
+                 "(> max. ID) in node "
+              << id << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // children are created after their parents; this rules out cycles but,
+  // unlike the in-memory backend, not two parents sharing a child
+  for (const auto child : {left, right}) {
+    if (child && child <= id) {
+      std::cerr
+          << "ExecutionTree DB contains duplicate child reference or circular "
+             "structure. Affected node: "
+          << child << std::endl;
+      exit(EXIT_FAILURE);
     }
   }
+
+  if ((left == 0 && right != 0) || (left != 0 && right == 0)) {
+    std::cerr << "Warning: ExecutionTree DB contains ambiguous node "
+                 "(0 vs. non-0 children): "
+              << id << std::endl;
+  }
+
+  Node node{.left = left,
+            .right = right,
+            .stateID = stateID,
+            .asmLine = asmLine,
+            .kind = nodeKind(left, right, tmpKind)};
+  checkType(id, node);
+  return node;
+}
+
+void Tree::initialiseTypeNames() {
+// branch types
+#undef BTYPE
+#define BTYPE(Name, I) branchTypeNames[BranchType::Name] = #Name;
+  BRANCH_TYPES
+
+// termination types
+#undef TTYPE
+#define TTYPE(Name, I, S)                                                      \
+  terminationTypeNames[StateTerminationType::Name] = #Name;
+  TERMINATION_TYPES
+}
+
+void Tree::initialiseValidTypes() {
+// branch types
+#undef BTYPE
+#define BTYPE(Name, I) validBranchTypes.insert(BranchType::Name);
+  BRANCH_TYPES
+
+// termination types
+#undef TTYPE
+#define TTYPE(Name, I, S)                                                      \
+  validTerminationTypes.insert(StateTerminationType::Name);
+  TERMINATION_TYPES
 }
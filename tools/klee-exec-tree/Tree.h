@@ -12,7 +12,11 @@
 #include "klee/Core/BranchTypes.h"
 #include "klee/Core/TerminationTypes.h"
 
+#include <sqlite3.h>
+
+#include <cstdint>
 #include <filesystem>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -34,20 +38,89 @@ struct Node final {
   std::variant<BranchType, StateTerminationType> kind{BranchType::NONE};
 };
 
-///@brief An in-memory representation of a complete execution tree
-class Tree final {
+///@brief Read access to the nodes of an execution tree database
+class Tree {
+public:
+  enum class Backend {
+    /// InMemory for trees with up to 2^24 nodes, Streaming for larger ones
+    Auto,
+    /// Reads the whole database into memory
+    InMemory,
+    /// Reads nodes from the database when they are visited
+    Streaming
+  };
+
+  /// Opens exec_tree.db at `path`, considering only the subtree below node
+  /// `root`. Exits with an error message if the database is malformed.
+  static std::unique_ptr<Tree> open(const std::filesystem::path &path,
+                                    Backend backend, std::uint32_t root = 1);
+
+  virtual ~Tree() = default;
+
+  /// Root of the (sub)tree
+  [[nodiscard]] std::uint32_t getRoot() const { return root; }
+  [[nodiscard]] bool empty() const { return maxID == 0; }
+  /// Returns node `id`, which must be reachable from the root
+  [[nodiscard]] virtual Node getNode(std::uint32_t id) const = 0;
+  /// Returns an independent view of the same tree for use on another thread
+  [[nodiscard]] virtual std::unique_ptr<Tree> clone() const = 0;
+
+protected:
+  std::uint32_t root{1};
+  /// Largest node ID, 0 for an empty tree
+  std::uint32_t maxID{0};
+
+  Tree(std::uint32_t root, std::uint32_t maxID) : root{root}, maxID{maxID} {}
+
   /// Creates branchTypeNames and terminationTypeNames maps
   static void initialiseTypeNames();
   /// Creates validBranchTypes and validTerminationTypes sets
   static void initialiseValidTypes();
+  /// Checks the type of node `id` and exits if it is invalid
+  static void checkType(std::uint32_t id, const Node &node);
+};
+
+///@brief An in-memory representation of a complete execution tree
+class InMemoryTree final : public Tree {
+  /// sorted vector of Nodes default initialised with BranchType::NONE,
+  /// shared by all clones
+  std::shared_ptr<const std::vector<Node>> nodes; // node IDs start with 1!
+
+  InMemoryTree(std::shared_ptr<const std::vector<Node>> nodes,
+               std::uint32_t root, std::uint32_t maxID)
+      : Tree(root, maxID), nodes{std::move(nodes)} {}
+
   /// Checks tree properties (e.g. valid branch/termination types)
-  void sanityCheck();
+  void sanityCheck() const;
 
 public:
-  /// sorted vector of Nodes default initialised with BranchType::NONE
-  std::vector<Node> nodes; // ExecutionTree node IDs start with 1!
-
   /// Reads complete exec-tree.db into memory
-  explicit Tree(const std::filesystem::path &path);
-  ~Tree() = default;
+  InMemoryTree(::sqlite3 *db, std::uint32_t root);
+  ~InMemoryTree() override = default;
+
+  [[nodiscard]] Node getNode(std::uint32_t id) const override {
+    return (*nodes)[id];
+  }
+  [[nodiscard]] std::unique_ptr<Tree> clone() const override;
+};
+
+///@brief An execution tree whose nodes are looked up in the database by ID
+/// as they are visited.
+///
+/// Memory use does not depend on the size of the tree. Instead of tracking
+/// visited nodes, the structure is checked by requiring child IDs to be
+/// larger than the IDs of their parents, as they are in every tree written
+/// by KLEE.
+class StreamingTree final : public Tree {
+  std::filesystem::path path;
+  ::sqlite3 *db{nullptr};
+  ::sqlite3_stmt *lookupStmt{nullptr};
+
+public:
+  StreamingTree(const std::filesystem::path &path, std::uint32_t root,
+                std::uint32_t maxID);
+  ~StreamingTree() override;
+
+  [[nodiscard]] Node getNode(std::uint32_t id) const override;
+  [[nodiscard]] std::unique_ptr<Tree> clone() const override;
 };
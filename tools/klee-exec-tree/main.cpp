@@ -7,35 +7,85 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <charconv>
+#include <cstdint>
 #include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <string_view>
 
+#include "DFSVisitor.h"
 #include "Printers.h"
 
 namespace fs = std::filesystem;
 
 void print_usage() {
-  std::cout << "Usage: klee-exec-tree <option> /path[/exec_tree.db]\n\n"
+  std::cout << "Usage: klee-exec-tree [flags] <option> /path[/exec_tree.db]\n\n"
                "Options:\n"
                "\tbranches     -  print branch statistics in csv format\n"
                "\tdepths       -  print depths statistics in csv format\n"
                "\tinstructions -  print asm line summary in csv format\n"
                "\tterminations -  print termination statistics in csv format\n"
                "\ttree-dot     -  print tree in dot format\n"
-               "\ttree-info    -  print tree statistics"
+               "\ttree-info    -  print tree statistics\n\n"
+               "Flags:\n"
+               "\t--jobs=N     -  compute statistics with N threads\n"
+               "\t--root=ID    -  only consider the subtree below node ID\n"
+               "\t--in-memory  -  load the whole tree into memory\n"
+               "\t--streaming  -  read nodes from the database as they are\n"
+               "\t                visited, in constant memory (default for\n"
+               "\t                trees with more than 2^24 nodes); does\n"
+               "\t                not detect nodes shared by two parents,\n"
+               "\t                which are then counted twice"
                "\n";
 }
 
+/// Parses the number after `prefix` in `arg`, or returns false
+bool parseFlag(std::string_view arg, std::string_view prefix,
+               std::uint32_t &value) {
+  if (arg.substr(0, prefix.size()) != prefix)
+    return false;
+  const auto number = arg.substr(prefix.size());
+  const auto [end, ec] =
+      std::from_chars(number.data(), number.data() + number.size(), value);
+  if (number.empty() || ec != std::errc() ||
+      end != number.data() + number.size()) {
+    std::cerr << "Invalid value in " << arg << '\n';
+    exit(EXIT_FAILURE);
+  }
+  return true;
+}
+
 int main(int argc, char *argv[]) {
-  if (argc != 3) {
+  // parse flags
+  auto backend = Tree::Backend::Auto;
+  std::uint32_t root = 1;
+  int argi = 1;
+  for (; argi < argc && argv[argi][0] == '-'; ++argi) {
+    std::string_view arg(argv[argi]);
+    std::uint32_t jobs;
+    if (parseFlag(arg, "--jobs=", jobs)) {
+      numJobs = jobs ? jobs : 1;
+    } else if (parseFlag(arg, "--root=", root)) {
+      continue;
+    } else if (arg == "--in-memory") {
+      backend = Tree::Backend::InMemory;
+    } else if (arg == "--streaming") {
+      backend = Tree::Backend::Streaming;
+    } else {
+      print_usage();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (argc - argi != 2) {
     print_usage();
     exit(EXIT_FAILURE);
   }
 
   // parse options
   void (*action)(const Tree &);
-  std::string option(argv[1]);
+  std::string option(argv[argi]);
   if (option == "branches") {
     action = printBranches;
   } else if (option == "instructions") {
@@ -54,15 +104,15 @@ int main(int argc, char *argv[]) {
   }
 
   // create tree
-  fs::path path{argv[2]};
+  fs::path path{argv[argi + 1]};
   if (fs::is_directory(path))
     path /= "exec_tree.db";
   if (!fs::exists(path)) {
     std::cerr << "Cannot open " << path << '\n';
     exit(EXIT_FAILURE);
   }
-  Tree tree(path);
+  const auto tree = Tree::open(path, backend, root);
 
   // print results
-  action(tree);
+  action(*tree);
 }
@@ -13,6 +13,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -56,9 +57,28 @@ static struct option long_options[] = {
   {"chroot-to-dir", required_argument, 0, 'r'},
   {"help", no_argument, 0, 'h'},
   {"keep-replay-dir", no_argument, 0, 'k'},
+  {"jobs", required_argument, 0, 'j'},
+  {"timeout", required_argument, 0, 't'},
   {0, 0, 0, 0},
 };
 
+/* Number of tests replayed concurrently */
+static unsigned num_jobs = 1;
+/* Per-test timeout in seconds, overrides KLEE_REPLAY_TIMEOUT if set */
+static unsigned replay_timeout = 0;
+
+/* Outcome of replaying one test, sent by the monitoring process to the
+   driver of a parallel replay. */
+struct replay_result {
+  int status;    /* wait status of the monitored process */
+  int timed_out; /* whether it was killed because of the timeout */
+  int elapsed;   /* in seconds */
+};
+
+/* Write end of the pipe the result is reported on, or -1 */
+static int result_fd = -1;
+static volatile sig_atomic_t timed_out = 0;
+
 static void stop_monitored(int process) {
   fputs("KLEE-REPLAY: NOTE: TIMEOUT: ATTEMPTING GDB EXIT\n", stderr);
   int pid = fork();
@@ -120,6 +140,7 @@ static void int_handler(int signal) {
 }
 
 static void timeout_handler(int signal) {
+  timed_out = 1;
   fprintf(stderr, "KLEE-REPLAY: NOTE: EXIT STATUS: TIMED OUT (%d seconds)\n",
           monitored_timeout);
   if (monitored_pid) {
@@ -166,14 +187,18 @@ static inline char *strip_root_dir(char *executable, char *rootdir) {
 
 static void run_monitored(char *executable, int argc, char **argv) {
   int pid;
-  const char *t = getenv("KLEE_REPLAY_TIMEOUT");
-  if (!t)
-    t = "10000000";
-  monitored_timeout = atoi(t);
-
-  if (monitored_timeout==0) {
-    fprintf(stderr, "KLEE-REPLAY: ERROR: invalid timeout (%s)\n", t);
-    _exit(1);
+  if (replay_timeout) {
+    monitored_timeout = replay_timeout;
+  } else {
+    const char *t = getenv("KLEE_REPLAY_TIMEOUT");
+    if (!t)
+      t = "10000000";
+    monitored_timeout = atoi(t);
+
+    if (monitored_timeout==0) {
+      fprintf(stderr, "KLEE-REPLAY: ERROR: invalid timeout (%s)\n", t);
+      _exit(1);
+    }
   }
 
   /* Kill monitored process(es) on SIGINT and SIGTERM */
@@ -243,6 +268,15 @@ static void run_monitored(char *executable, int argc, char **argv) {
     /* Just in case, kill the process group of pid.  Since we called setpgrp()
        for pid, this will not kill us, or any of our ancestors */
     kill(-pid, SIGKILL);
+
+    if (result_fd >= 0) {
+      struct replay_result result;
+      result.status = status;
+      result.timed_out = timed_out;
+      result.elapsed = (int) (time(0) - start);
+      if (write(result_fd, &result, sizeof(result)) != sizeof(result))
+        perror("KLEE-REPLAY: ERROR: reporting result");
+    }
     process_status(status, time(0) - start, 0);
   }
 }
@@ -271,11 +305,22 @@ static void usage(void) {
     "Usage: %s [option]... <executable> <ktest-file>...\n"
     "   or: %s --create-files-only <ktest-file>\n"
     "\n"
+    "A <ktest-file> may also be a .ktar archive, whose tests are replayed\n"
+    "in turn.\n"
+    "\n"
     "-r, --chroot-to-dir=DIR  use chroot jail, requires CAP_SYS_CHROOT\n"
     "-k, --keep-replay-dir    do not delete replay directory\n"
+    "-j, --jobs=N             replay up to N tests at a time and print a\n"
+    "                         summary of their exit statuses at the end\n"
+    "-t, --timeout=SECONDS    time limit for each test\n"
     "-h, --help               display this help and exit\n"
     "\n"
-    "Use KLEE_REPLAY_TIMEOUT environment variable to set a timeout (in seconds).\n",
+    "Use KLEE_REPLAY_TIMEOUT environment variable to set a timeout (in seconds).\n"
+    "\n"
+    "Every test runs in its own replay directory, so tests that create files\n"
+    "do not interfere with each other when replayed in parallel. Executables\n"
+    "built with --coverage accumulate the counters of all tests in their\n"
+    ".gcda files (libgcov merges them under a file lock).\n",
     progname, progname);
   exit(1);
 }
@@ -283,6 +328,237 @@ static void usage(void) {
 
 int keep_temps = 0;
 
+/* Replays the test in `input`, which is freed afterwards. */
+static void replay_input(char *executable, const char *program,
+                         const char *input_fname) {
+  static unsigned num_replayed = 0;
+  int prg_argc;
+  char ** prg_argv;
+  unsigned i;
+
+  obj_index = 0;
+  prg_argc = input->numArgs;
+  prg_argv = input->args;
+  free(prg_argv[0]);
+  prg_argv[0] = strdup(program);
+
+  klee_init_env(&prg_argc, &prg_argv);
+
+  if (num_replayed++)
+    fputc('\n', stderr);
+  fprintf(stderr, "KLEE-REPLAY: NOTE: Test file: %s\n"
+                  "KLEE-REPLAY: NOTE: Arguments: ", input_fname);
+  for (i=0; i != (unsigned) prg_argc; ++i) {
+    char *s = prg_argv[i];
+    if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
+    fprintf(stderr, "\"%s\" ", prg_argv[i]);
+  }
+  fputc('\n', stderr);
+
+  /* Create the input files, pipes, etc. */
+  replay_create_files(&__exe_fs);
+
+  /* Run the test case machinery in a subprocess, eventually this parent
+     process should be a script or something which shells out to the actual
+     execution tool. */
+
+  int pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    _exit(66);
+  } else if (pid == 0) {
+    /* Run the executable */
+    run_monitored(executable, prg_argc, prg_argv);
+    _exit(0);
+  } else {
+    /* Wait for the executable to finish. */
+    int res, status;
+
+    do {
+      res = waitpid(pid, &status, 0);
+    } while (res < 0 && errno == EINTR);
+
+    // Delete all files in the replay directory
+    replay_delete_files();
+
+    if (res < 0) {
+      perror("waitpid");
+      _exit(66);
+    }
+
+    free(prg_argv);
+    kTest_free(input);
+  }
+}
+
+/* Parallel replay: every test is replayed by a worker process, which runs
+   replay_input() and reports the outcome on a pipe. The driver keeps up to
+   num_jobs workers running and aggregates their results as they finish. */
+
+struct replay_job {
+  pid_t pid; /* 0 if the slot is free */
+  int fd;    /* read end of the result pipe */
+  char *name;
+};
+
+static struct replay_job *jobs;
+static unsigned num_running = 0;
+
+/* Results are counted per exit code and per signal, remembering the first
+   test that produced each one. */
+static struct {
+  unsigned total, normal, abnormal, crashed, timed_out, errors;
+  unsigned exit_codes[256];
+  char *first_exit[256];
+  unsigned signals[NSIG];
+  char *first_signal[NSIG];
+} summary;
+
+static void record_result(char *name, const struct replay_result *result,
+                          int worker_status) {
+  char msg[64];
+  int elapsed = 0;
+
+  ++summary.total;
+  if (!result) {
+    ++summary.errors;
+    snprintf(msg, sizeof(msg), "ERROR (worker status %d)", worker_status);
+  } else {
+    elapsed = result->elapsed;
+    if (result->timed_out) {
+      ++summary.timed_out;
+      strcpy(msg, "TIMED OUT");
+    } else if (WIFSIGNALED(result->status)) {
+      int sig = WTERMSIG(result->status);
+      ++summary.crashed;
+      if (sig > 0 && sig < NSIG && !summary.signals[sig]++)
+        summary.first_signal[sig] = strdup(name);
+      snprintf(msg, sizeof(msg), "CRASHED signal %d", sig);
+    } else if (WIFEXITED(result->status) && WEXITSTATUS(result->status)) {
+      int rc = WEXITSTATUS(result->status);
+      ++summary.abnormal;
+      if (!summary.exit_codes[rc]++)
+        summary.first_exit[rc] = strdup(name);
+      snprintf(msg, sizeof(msg), "ABNORMAL %d", rc);
+    } else {
+      ++summary.normal;
+      strcpy(msg, "NORMAL");
+    }
+  }
+
+  fprintf(stderr, "KLEE-REPLAY: NOTE: RESULT: %s: %s (%d seconds)\n", name, msg,
+          elapsed);
+}
+
+static void print_summary(void) {
+  unsigned i;
+
+  fprintf(stderr,
+          "KLEE-REPLAY: SUMMARY: %u tests: %u normal, %u abnormal, "
+          "%u crashed, %u timed out, %u errors\n",
+          summary.total, summary.normal, summary.abnormal, summary.crashed,
+          summary.timed_out, summary.errors);
+  for (i = 0; i != NSIG; ++i) {
+    if (!summary.signals[i])
+      continue;
+    fprintf(stderr, "KLEE-REPLAY: SUMMARY: CRASHED signal %u: %u tests (first: %s)\n",
+            i, summary.signals[i], summary.first_signal[i]);
+    free(summary.first_signal[i]);
+  }
+  for (i = 0; i != 256; ++i) {
+    if (!summary.exit_codes[i])
+      continue;
+    fprintf(stderr, "KLEE-REPLAY: SUMMARY: ABNORMAL %u: %u tests (first: %s)\n",
+            i, summary.exit_codes[i], summary.first_exit[i]);
+    free(summary.first_exit[i]);
+  }
+}
+
+/* Waits for one worker to finish and records its result. */
+static void wait_for_job(void) {
+  int status;
+  pid_t pid;
+  unsigned i;
+
+  do {
+    pid = waitpid(-1, &status, 0);
+  } while (pid < 0 && errno == EINTR);
+
+  if (pid < 0) {
+    perror("waitpid");
+    exit(1);
+  }
+
+  for (i = 0; i != num_jobs; ++i) {
+    struct replay_job *job = &jobs[i];
+    if (job->pid != pid)
+      continue;
+
+    struct replay_result result;
+    ssize_t n;
+    do {
+      n = read(job->fd, &result, sizeof(result));
+    } while (n < 0 && errno == EINTR);
+    record_result(job->name, n == sizeof(result) ? &result : NULL, status);
+
+    close(job->fd);
+    free(job->name);
+    job->pid = 0;
+    --num_running;
+    return;
+  }
+}
+
+/* Replays the test in `input` in a new worker, waiting for a free slot
+   first. `input` is freed. */
+static void start_job(char *executable, const char *program,
+                      const char *input_fname) {
+  unsigned i;
+  int fds[2];
+
+  if (num_running == num_jobs)
+    wait_for_job();
+
+  /* The target program must not inherit the write end, or a process it
+     leaves behind could keep the pipe open. */
+  if (pipe(fds) < 0 || fcntl(fds[0], F_SETFD, FD_CLOEXEC) < 0 ||
+      fcntl(fds[1], F_SETFD, FD_CLOEXEC) < 0 ||
+      fcntl(fds[0], F_SETFL, O_NONBLOCK) < 0) {
+    perror("pipe");
+    exit(1);
+  }
+
+  for (i = 0; jobs[i].pid; ++i)
+    ;
+
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    exit(1);
+  } else if (pid == 0) {
+    close(fds[0]);
+    result_fd = fds[1];
+    replay_input(executable, program, input_fname);
+    _exit(0);
+  }
+
+  close(fds[1]);
+  kTest_free(input);
+  jobs[i].pid = pid;
+  jobs[i].fd = fds[0];
+  jobs[i].name = strdup(input_fname);
+  ++num_running;
+}
+
+static void replay_test(char *executable, const char *program,
+                        const char *input_fname) {
+  if (jobs)
+    start_job(executable, program, input_fname);
+  else
+    replay_input(executable, program, input_fname);
+}
+
 int main(int argc, char** argv) {
   int prg_argc;
   char ** prg_argv;
@@ -293,7 +569,7 @@ int main(int argc, char** argv) {
     usage();
 
   int c, opt_index;
-  while ((c = getopt_long(argc, argv, "f:r:k", long_options, &opt_index)) != -1) {
+  while ((c = getopt_long(argc, argv, "f:r:kj:t:", long_options, &opt_index)) != -1) {
     switch (c) {
     case 'f': {
       /* Special case hack for only creating files and not actually executing
@@ -327,9 +603,31 @@ int main(int argc, char** argv) {
     case 'k':
       keep_temps = 1;
       break;
+
+    case 'j':
+    case 't': {
+      char *end;
+      unsigned long n = strtoul(optarg, &end, 10);
+      if (!*optarg || *end || n == 0 || n > 100000) {
+        fprintf(stderr, "KLEE-REPLAY: ERROR: invalid %s (%s)\n",
+                c == 'j' ? "number of jobs" : "timeout", optarg);
+        exit(1);
+      }
+      if (c == 'j')
+        num_jobs = n;
+      else
+        replay_timeout = n;
+      break;
+    }
+
+    default:
+      usage();
     }
   }
 
+  if (optind >= argc)
+    usage();
+
   // Executable needs to be converted to an absolute path, as klee-replay calls
   // chdir just before executing it
   char executable[PATH_MAX];
@@ -353,71 +651,53 @@ int main(int argc, char** argv) {
     exit(1);
   }
 
+  if (num_jobs > 1)
+    jobs = calloc(num_jobs, sizeof(*jobs));
+
   int idx = 0;
   for (idx = optind + 1; idx != argc; ++idx) {
     char* input_fname = argv[idx];
-    unsigned i;
 
-    input = kTest_fromFile(input_fname);
-    if (!input) {
+    if (!kTestArchive_isArchive(input_fname)) {
+      input = kTest_fromFile(input_fname);
+      if (!input) {
+        fprintf(stderr, "KLEE-REPLAY: ERROR: input file %s not valid.\n",
+                input_fname);
+        exit(1);
+      }
+      replay_test(executable, argv[optind], input_fname);
+      continue;
+    }
+
+    /* Replay every test in an archive, naming each "archive:test" */
+    KTestArchive *archive = kTestArchive_open(input_fname);
+    if (!archive) {
       fprintf(stderr, "KLEE-REPLAY: ERROR: input file %s not valid.\n",
               input_fname);
       exit(1);
     }
-
-    obj_index = 0;
-    prg_argc = input->numArgs;
-    prg_argv = input->args;
-    free(prg_argv[0]);
-    prg_argv[0] = strdup(argv[optind]);
-
-    klee_init_env(&prg_argc, &prg_argv);
-
-    if (idx > 2)
-      fputc('\n', stderr);
-    fprintf(stderr, "KLEE-REPLAY: NOTE: Test file: %s\n"
-                    "KLEE-REPLAY: NOTE: Arguments: ", input_fname);
-    for (i=0; i != (unsigned) prg_argc; ++i) {
-      char *s = prg_argv[i];
-      if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
-      fprintf(stderr, "\"%s\" ", prg_argv[i]);
-    }
-    fputc('\n', stderr);
-
-    /* Create the input files, pipes, etc. */
-    replay_create_files(&__exe_fs);
-
-    /* Run the test case machinery in a subprocess, eventually this parent
-       process should be a script or something which shells out to the actual
-       execution tool. */
-
-    int pid = fork();
-    if (pid < 0) {
-      perror("fork");
-      _exit(66);
-    } else if (pid == 0) {
-      /* Run the executable */
-      run_monitored(executable, prg_argc, prg_argv);
-      _exit(0);
-    } else {
-      /* Wait for the executable to finish. */
-      int res, status;
-
-      do {
-        res = waitpid(pid, &status, 0);
-      } while (res < 0 && errno == EINTR);
-
-      // Delete all files in the replay directory
-      replay_delete_files();
-
-      if (res < 0) {
-        perror("waitpid");
-        _exit(66);
+    unsigned i;
+    for (i = 0; i != kTestArchive_numTests(archive); ++i) {
+      const char *test_name = kTestArchive_getName(archive, i);
+      char *name = malloc(strlen(input_fname) + strlen(test_name) + 2);
+      sprintf(name, "%s:%s", input_fname, test_name);
+      input = kTestArchive_getTest(archive, i);
+      if (!input) {
+        fprintf(stderr, "KLEE-REPLAY: ERROR: input file %s not valid.\n",
+                name);
+        exit(1);
       }
-
-      free(prg_argv);
-      kTest_free(input);
+      replay_test(executable, argv[optind], name);
+      free(name);
     }
+    kTestArchive_close(archive);
+  }
+
+  if (jobs) {
+    while (num_running)
+      wait_for_job();
+    print_summary();
+    free(jobs);
   }
 
   return 0;
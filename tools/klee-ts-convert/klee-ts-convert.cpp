@@ -0,0 +1,40 @@
+//===-- klee-ts-convert.cpp -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Converts path stream files (paths.ts, symPaths.ts) written by older
+// versions of KLEE into the current indexed format.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/ADT/TreeStream.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <old.ts> <new.ts>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::string error;
+  if (!klee::convertLegacyTreeStream(argv[1], argv[2], error)) {
+    fprintf(stderr, "%s: error: %s\n", argv[0], error.c_str());
+    return EXIT_FAILURE;
+  }
+
+  klee::TreeStreamReader reader(argv[2]);
+  if (!reader.good()) {
+    fprintf(stderr, "%s: error: unable to read back %s\n", argv[0], argv[2]);
+    return EXIT_FAILURE;
+  }
+  printf("%s: converted %zu streams\n", argv[2], reader.getNumStreams() - 1);
+  return EXIT_SUCCESS;
+}
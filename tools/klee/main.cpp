@@ -22,6 +22,7 @@
 #include "klee/Support/ModuleUtil.h"
 #include "klee/Support/OptionCategories.h"
 #include "klee/Support/PrintVersion.h"
+#include "klee/Support/WorkerThread.h"
 #include "klee/System/Time.h"
 
 #include "klee/Support/CompilerWarning.h"
@@ -59,6 +60,7 @@ DISABLE_WARNING_POP
 #include <fstream>
 #include <iomanip>
 #include <iterator>
+#include <mutex>
 #include <sstream>
 
 using namespace llvm;
@@ -119,6 +121,33 @@ namespace {
                 cl::desc("Write .sym.path files for each test case (default=false)"),
                 cl::cat(TestCaseCat));
 
+  cl::opt<bool>
+  UseKTestArchive("ktest-archive",
+                  cl::init(false),
+                  cl::desc("Write test inputs into a single tests.ktar archive instead "
+                           "of separate .ktest files (default=false)"),
+                  cl::cat(TestCaseCat));
+
+  cl::opt<bool>
+  CompressKTestArchive("compress-ktest-archive",
+                       cl::init(false),
+                       cl::desc("Compress the tests in the .ktar archive with zlib "
+                                "(default=false)"),
+                       cl::cat(TestCaseCat));
+
+  cl::opt<bool>
+  TestWriterThread("test-writer-thread",
+                   cl::init(true),
+                   cl::desc("Write test case files from a background thread (default=true)"),
+                   cl::cat(TestCaseCat));
+
+  cl::opt<unsigned>
+  MaxPendingTests("max-pending-tests",
+                  cl::init(64),
+                  cl::desc("Maximum number of test cases waiting to be written "
+                           "before the interpreter blocks (default=64)"),
+                  cl::cat(TestCaseCat));
+
 
   /*** Startup options ***/
 
@@ -233,7 +262,7 @@ namespace {
   
   cl::list<std::string>
   ReplayKTestFile("replay-ktest-file",
-                  cl::desc("Specify a .ktest file to use for replay"),
+                  cl::desc("Specify a .ktest file (or .ktar archive) to use for replay"),
                   cl::value_desc(".ktest file"),
                   cl::cat(ReplayCat));
 
@@ -253,12 +282,12 @@ namespace {
 
   cl::list<std::string>
   SeedOutFile("seed-file",
-              cl::desc(".ktest file to be used as seed"),
+              cl::desc(".ktest file (or .ktar archive of them) to be used as seed"),
               cl::cat(SeedingCat));
 
   cl::list<std::string>
   SeedOutDir("seed-dir",
-             cl::desc("Directory with .ktest files to be used as seeds"),
+             cl::desc("Directory with .ktest files (or .ktar archives) to be used as seeds"),
              cl::cat(SeedingCat));
 
   cl::opt<unsigned>
@@ -312,6 +341,41 @@ private:
   int m_argc;
   char **m_argv;
 
+  /// Everything needed to write out one test case, extracted from the
+  /// terminated state on the interpreter thread.
+  struct TestCase {
+    unsigned id;
+    bool hasSolution;
+    std::vector<std::pair<std::string, std::vector<unsigned char>>> objects;
+    /// (suffix, contents) of the remaining files (.err, .kquery, ...)
+    std::vector<std::pair<std::string, std::string>> files;
+    /// Time spent on the test case before it was handed off for writing
+    time::Span preparationTime;
+  };
+
+  /// Writes test case files when --test-writer-thread is set
+  std::unique_ptr<WorkerThread> m_testWriter;
+  /// Receives the .ktest files when --ktest-archive is set
+  KTestArchive *m_ktestArchive;
+
+  /// Failures recorded by writeTestCase(), which may run on the writer
+  /// thread; reported by reportWriteErrors() on the interpreter thread.
+  std::mutex m_writeErrorMutex;
+  std::vector<std::string> m_writeWarnings;
+  unsigned m_lostTests = 0;
+
+  void writeTestCase(const TestCase &test);
+  /// Opens a test case file from writeTestCase(); failures are recorded.
+  std::unique_ptr<llvm::raw_fd_ostream>
+  openTestFileForWriting(const std::string &suffix, unsigned id);
+  void recordWriteWarning(std::string warning, bool lostTest = false);
+  /// Emits the recorded warnings and stops counting lost test cases.
+  void reportWriteErrors();
+
+  /// Handler whose test cases are finished when the process exits
+  static KleeHandler *s_exitHandler;
+  static void finishTestCasesAtExit();
+
 public:
   KleeHandler(int argc, char **argv);
   ~KleeHandler();
@@ -330,6 +394,12 @@ public:
   void processTestCase(const ExecutionState  &state,
                        const char *errorMessage,
                        const char *errorSuffix);
+  /// Blocks until all test cases handed to the writer thread are written.
+  void flushTestCases();
+  /// Writes all outstanding test cases, stops the writer thread and closes
+  /// tests.ktar. Also runs from an atexit hook, so that tests are not lost
+  /// when KLEE exits through klee_error().
+  void finishTestCases();
 
   std::string getOutputFilename(const std::string &filename);
   std::unique_ptr<llvm::raw_fd_ostream> openOutputFile(const std::string &filename);
@@ -342,6 +412,8 @@ public:
 
   static void getKTestFilesInDir(std::string directoryPath,
                                  std::vector<std::string> &results);
+  /// Loads a .ktest file, or every test in a .ktar archive
+  static bool loadKTests(const std::string &path, std::vector<KTest *> &tests);
 
   static std::string getRunTimeLibraryPath(const char *argv0);
 };
@@ -349,7 +421,8 @@ public:
 KleeHandler::KleeHandler(int argc, char **argv)
     : m_interpreter(0), m_pathWriter(0), m_symPathWriter(0),
       m_outputDirectory(), m_numTotalTests(0), m_numGeneratedTests(0),
-      m_pathsCompleted(0), m_pathsExplored(0), m_argc(argc), m_argv(argv) {
+      m_pathsCompleted(0), m_pathsExplored(0), m_argc(argc), m_argv(argv),
+      m_ktestArchive(0) {
 
   // create output directory (OutputDir or "klee-out-<i>")
   bool dir_given = OutputDir != "";
@@ -423,6 +496,9 @@ KleeHandler::KleeHandler(int argc, char **argv)
 }
 
 KleeHandler::~KleeHandler() {
+  finishTestCases();
+  if (s_exitHandler == this)
+    s_exitHandler = nullptr;
   delete m_pathWriter;
   delete m_symPathWriter;
   fclose(klee_warning_file);
@@ -443,6 +519,63 @@ void KleeHandler::setInterpreter(Interpreter *i) {
     assert(m_symPathWriter->good());
     m_interpreter->setSymbolicPathWriter(m_symPathWriter);
   }
+
+  if (UseKTestArchive && !WriteNone) {
+    std::string path = getOutputFilename("tests.ktar");
+    m_ktestArchive = kTestArchive_create(path.c_str(), CompressKTestArchive);
+    if (!m_ktestArchive)
+      klee_error("cannot create \"%s\": %s", path.c_str(), strerror(errno));
+  }
+
+  if (TestWriterThread && !WriteNone)
+    m_testWriter = std::make_unique<WorkerThread>();
+
+  if ((m_testWriter || m_ktestArchive) && !s_exitHandler) {
+    s_exitHandler = this;
+    atexit(finishTestCasesAtExit);
+  }
+}
+
+void KleeHandler::flushTestCases() {
+  if (m_testWriter)
+    m_testWriter->drain();
+  reportWriteErrors();
+}
+
+void KleeHandler::finishTestCases() {
+  m_testWriter.reset();
+  reportWriteErrors();
+  if (m_ktestArchive && !kTestArchive_close(m_ktestArchive))
+    klee_warning("unable to finish writing tests.ktar");
+  m_ktestArchive = nullptr;
+}
+
+void KleeHandler::recordWriteWarning(std::string warning, bool lostTest) {
+  std::lock_guard<std::mutex> lock(m_writeErrorMutex);
+  m_writeWarnings.push_back(std::move(warning));
+  if (lostTest)
+    ++m_lostTests;
+}
+
+void KleeHandler::reportWriteErrors() {
+  std::vector<std::string> warnings;
+  unsigned lostTests;
+  {
+    std::lock_guard<std::mutex> lock(m_writeErrorMutex);
+    warnings.swap(m_writeWarnings);
+    lostTests = m_lostTests;
+    m_lostTests = 0;
+  }
+  for (const auto &warning : warnings)
+    klee_warning("%s", warning.c_str());
+  m_numGeneratedTests -= lostTests;
+}
+
+KleeHandler *KleeHandler::s_exitHandler = nullptr;
+
+void KleeHandler::finishTestCasesAtExit() {
+  if (s_exitHandler)
+    s_exitHandler->finishTestCases();
 }
 
 std::string KleeHandler::getOutputFilename(const std::string &filename) {
@@ -477,75 +610,61 @@ KleeHandler::openTestFile(const std::string &suffix, unsigned id) {
   return openOutputFile(getTestFilename(suffix, id));
 }
 
+std::unique_ptr<llvm::raw_fd_ostream>
+KleeHandler::openTestFileForWriting(const std::string &suffix, unsigned id) {
+  std::string Error;
+  std::string path = getOutputFilename(getTestFilename(suffix, id));
+  auto f = klee_open_output_file(path, Error);
+  if (!f)
+    recordWriteWarning("error opening file \"" + path +
+                       "\".  KLEE may have run out of file descriptors: try "
+                       "to increase the maximum number of open file "
+                       "descriptors by using ulimit (" +
+                       Error + ").");
+  return f;
+}
+
 
 /* Outputs all files (.ktest, .kquery, .cov etc.) describing a test case */
 void KleeHandler::processTestCase(const ExecutionState &state,
                                   const char *errorMessage,
                                   const char *errorSuffix) {
+  // report failures of test cases written so far
+  reportWriteErrors();
+
   if (!WriteNone) {
-    std::vector< std::pair<std::string, std::vector<unsigned char> > > out;
-    bool success = m_interpreter->getSymbolicSolution(state, out);
+    // Solving and printing constraints use expressions that the interpreter
+    // keeps sharing, so they stay on this thread; only the file output is
+    // handed to the writer thread.
+    TestCase test;
+    test.hasSolution = m_interpreter->getSymbolicSolution(state, test.objects);
 
-    if (!success)
+    if (!test.hasSolution)
       klee_warning("unable to get symbolic solution, losing test case");
 
     const auto start_time = time::getWallTime();
 
-    unsigned id = ++m_numTotalTests;
-
-    if (success) {
-      KTest b;
-      b.numArgs = m_argc;
-      b.args = m_argv;
-      b.symArgvs = 0;
-      b.symArgvLen = 0;
-      b.numObjects = out.size();
-      b.objects = new KTestObject[b.numObjects];
-      assert(b.objects);
-      for (unsigned i=0; i<b.numObjects; i++) {
-        KTestObject *o = &b.objects[i];
-        o->name = const_cast<char*>(out[i].first.c_str());
-        o->numBytes = out[i].second.size();
-        o->bytes = new unsigned char[o->numBytes];
-        assert(o->bytes);
-        std::copy(out[i].second.begin(), out[i].second.end(), o->bytes);
-      }
-
-      if (!kTest_toFile(&b, getOutputFilename(getTestFilename("ktest", id)).c_str())) {
-        klee_warning("unable to write output test case, losing it");
-      } else {
-        ++m_numGeneratedTests;
-      }
-
-      for (unsigned i=0; i<b.numObjects; i++)
-        delete[] b.objects[i].bytes;
-      delete[] b.objects;
-    }
+    test.id = ++m_numTotalTests;
 
-    if (errorMessage) {
-      auto f = openTestFile(errorSuffix, id);
-      if (f)
-        *f << errorMessage;
-    }
+    if (errorMessage)
+      test.files.emplace_back(errorSuffix, errorMessage);
 
     if (m_pathWriter) {
       std::vector<unsigned char> concreteBranches;
       m_pathWriter->readStream(m_interpreter->getPathStreamID(state),
                                concreteBranches);
-      auto f = openTestFile("path", id);
-      if (f) {
-        for (const auto &branch : concreteBranches) {
-          *f << branch << '\n';
-        }
+      std::string path;
+      llvm::raw_string_ostream f(path);
+      for (const auto &branch : concreteBranches) {
+        f << branch << '\n';
       }
+      test.files.emplace_back("path", f.str());
     }
 
     if (errorMessage || WriteKQueries) {
       std::string constraints;
       m_interpreter->getConstraintLog(state, constraints,Interpreter::KQUERY);
-      auto f = openTestFile("kquery", id);
-      if (f)
-        *f << constraints;
+      test.files.emplace_back("kquery", std::move(constraints));
     }
 
     if (WriteCVCs) {
@@ -553,61 +672,116 @@ void KleeHandler::processTestCase(const ExecutionState &state,
       // SMT-LIBv2 not CVC which is a bit confusing
       std::string constraints;
       m_interpreter->getConstraintLog(state, constraints, Interpreter::STP);
-      auto f = openTestFile("cvc", id);
-      if (f)
-        *f << constraints;
+      test.files.emplace_back("cvc", std::move(constraints));
     }
 
     if (WriteSMT2s) {
       std::string constraints;
-        m_interpreter->getConstraintLog(state, constraints, Interpreter::SMTLIB2);
-        auto f = openTestFile("smt2", id);
-        if (f)
-          *f << constraints;
+      m_interpreter->getConstraintLog(state, constraints, Interpreter::SMTLIB2);
+      test.files.emplace_back("smt2", std::move(constraints));
     }
 
     if (m_symPathWriter) {
       std::vector<unsigned char> symbolicBranches;
       m_symPathWriter->readStream(m_interpreter->getSymbolicPathStreamID(state),
                                   symbolicBranches);
-      auto f = openTestFile("sym.path", id);
-      if (f) {
-        for (const auto &branch : symbolicBranches) {
-          *f << branch << '\n';
-        }
+      std::string path;
+      llvm::raw_string_ostream f(path);
+      for (const auto &branch : symbolicBranches) {
+        f << branch << '\n';
       }
+      test.files.emplace_back("sym.path", f.str());
     }
 
     if (WriteCov) {
       std::map<const std::string*, std::set<unsigned> > cov;
       m_interpreter->getCoveredLines(state, cov);
-      auto f = openTestFile("cov", id);
-      if (f) {
-        for (const auto &entry : cov) {
-          for (const auto &line : entry.second) {
-            *f << *entry.first << ':' << line << '\n';
-          }
+      std::string lines;
+      llvm::raw_string_ostream f(lines);
+      for (const auto &entry : cov) {
+        for (const auto &line : entry.second) {
+          f << *entry.first << ':' << line << '\n';
         }
       }
+      test.files.emplace_back("cov", f.str());
     }
 
-    if (m_numGeneratedTests == MaxTests)
-      m_interpreter->setHaltExecution(true);
+    // Count the test when it is handed off; reportWriteErrors() takes it back
+    // if the .ktest cannot be written.
+    bool reachedMaxTests =
+        test.hasSolution && ++m_numGeneratedTests == MaxTests;
+
+    test.preparationTime = time::getWallTime() - start_time;
+    if (m_testWriter) {
+      m_testWriter->waitForPending(MaxPendingTests);
+      m_testWriter->submit(
+          [this, test = std::move(test)] { writeTestCase(test); });
+    } else {
+      writeTestCase(test);
+    }
 
-    if (WriteTestInfo) {
-      time::Span elapsed_time(time::getWallTime() - start_time);
-      auto f = openTestFile("info", id);
-      if (f)
-        *f << "Time to generate test case: " << elapsed_time << '\n';
+    // Only stop at --max-tests once all outstanding tests, including this
+    // one, are known to be written.
+    if (reachedMaxTests) {
+      flushTestCases();
+      if (m_numGeneratedTests == MaxTests)
+        m_interpreter->setHaltExecution(true);
     }
   } // if (!WriteNone)
 
   if (errorMessage && OptExitOnError) {
+    flushTestCases();
     m_interpreter->prepareForEarlyExit();
     klee_error("EXITING ON ERROR:\n%s\n", errorMessage);
   }
 }
 
+void KleeHandler::writeTestCase(const TestCase &test) {
+  const auto start_time = time::getWallTime();
+
+  if (test.hasSolution) {
+    KTest b;
+    b.numArgs = m_argc;
+    b.args = m_argv;
+    b.symArgvs = 0;
+    b.symArgvLen = 0;
+    b.numObjects = test.objects.size();
+    b.objects = new KTestObject[b.numObjects];
+    assert(b.objects);
+    for (unsigned i=0; i<b.numObjects; i++) {
+      KTestObject *o = &b.objects[i];
+      o->name = const_cast<char*>(test.objects[i].first.c_str());
+      o->numBytes = test.objects[i].second.size();
+      o->bytes = const_cast<unsigned char*>(test.objects[i].second.data());
+    }
+
+    std::string name = getTestFilename("ktest", test.id);
+    bool written =
+        m_ktestArchive
+            ? kTestArchive_addTest(m_ktestArchive, name.c_str(), &b)
+            : kTest_toFile(&b, getOutputFilename(name).c_str());
+    if (!written)
+      recordWriteWarning("unable to write output test case, losing it",
+                         /*lostTest=*/true);
+
+    delete[] b.objects;
+  }
+
+  for (const auto &file : test.files) {
+    auto f = openTestFileForWriting(file.first, test.id);
+    if (f)
+      *f << file.second;
+  }
+
+  if (WriteTestInfo) {
+    time::Span elapsed_time(test.preparationTime +
+                            (time::getWallTime() - start_time));
+    auto f = openTestFileForWriting("info", test.id);
+    if (f)
+      *f << "Time to generate test case: " << elapsed_time << '\n';
+  }
+}
+
   // load a .path file
 void KleeHandler::loadPathFile(std::string name,
                                      std::vector<bool> &buffer) {
@@ -631,7 +805,8 @@ void KleeHandler::getKTestFilesInDir(std::string directoryPath,
   llvm::sys::fs::directory_iterator i(directoryPath, ec), e;
   for (; i != e && !ec; i.increment(ec)) {
     auto f = i->path();
-    if (f.size() >= 6 && f.substr(f.size()-6,f.size()) == ".ktest") {
+    if ((f.size() >= 6 && f.substr(f.size()-6,f.size()) == ".ktest") ||
+        (f.size() >= 5 && f.substr(f.size()-5,f.size()) == ".ktar")) {
       results.push_back(f);
     }
   }
@@ -643,6 +818,31 @@ void KleeHandler::getKTestFilesInDir(std::string directoryPath,
   }
 }
 
+bool KleeHandler::loadKTests(const std::string &path,
+                             std::vector<KTest *> &tests) {
+  if (!kTestArchive_isArchive(path.c_str())) {
+    KTest *out = kTest_fromFile(path.c_str());
+    if (out)
+      tests.push_back(out);
+    return out;
+  }
+
+  KTestArchive *archive = kTestArchive_open(path.c_str());
+  if (!archive)
+    return false;
+  bool success = true;
+  for (unsigned i = 0, e = kTestArchive_numTests(archive); i != e; ++i) {
+    KTest *out = kTestArchive_getTest(archive, i);
+    if (!out) {
+      success = false;
+      break;
+    }
+    tests.push_back(out);
+  }
+  kTestArchive_close(archive);
+  return success;
+}
+
 std::string KleeHandler::getRunTimeLibraryPath(const char *argv0) {
   // allow specifying the path to the runtime library
   const char *env = getenv("KLEE_RUNTIME_LIBRARY_PATH");
@@ -1443,12 +1643,8 @@ int main(int argc, char **argv, char **envp) {
     for (std::vector<std::string>::iterator
            it = kTestFiles.begin(), ie = kTestFiles.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (out) {
-        kTests.push_back(out);
-      } else {
+      if (!KleeHandler::loadKTests(*it, kTests))
         klee_warning("unable to open: %s\n", (*it).c_str());
-      }
     }
 
     if (RunInDir != "") {
@@ -1467,7 +1663,7 @@ int main(int argc, char **argv, char **envp) {
       interpreter->setReplayKTest(out);
       llvm::errs() << "KLEE: replaying: " << *it << " (" << kTest_numBytes(out)
                    << " bytes)"
-                   << " (" << ++i << "/" << kTestFiles.size() << ")\n";
+                   << " (" << ++i << "/" << kTests.size() << ")\n";
       // XXX should put envp in .ktest ?
       interpreter->runFunctionAsMain(entryFn, out->numArgs, out->args, pEnvp);
       if (interrupted) break;
@@ -1482,11 +1678,9 @@ int main(int argc, char **argv, char **envp) {
     for (std::vector<std::string>::iterator
            it = SeedOutFile.begin(), ie = SeedOutFile.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (!out) {
+      if (!KleeHandler::loadKTests(*it, seeds)) {
         klee_error("unable to open: %s\n", (*it).c_str());
       }
-      seeds.push_back(out);
     }
     for (std::vector<std::string>::iterator
            it = SeedOutDir.begin(), ie = SeedOutDir.end();
@@ -1496,11 +1690,9 @@ int main(int argc, char **argv, char **envp) {
       for (std::vector<std::string>::iterator
              it2 = kTestFiles.begin(), ie = kTestFiles.end();
            it2 != ie; ++it2) {
-        KTest *out = kTest_fromFile(it2->c_str());
-        if (!out) {
+        if (!KleeHandler::loadKTests(*it2, seeds)) {
           klee_error("unable to open: %s\n", (*it2).c_str());
         }
-        seeds.push_back(out);
       }
       if (kTestFiles.empty()) {
         klee_error("seeds directory is empty: %s\n", (*it).c_str());
@@ -1527,6 +1719,8 @@ int main(int argc, char **argv, char **envp) {
     }
   }
 
+  handler->flushTestCases();
+
   auto endTime = std::time(nullptr);
   { // output end and elapsed time
     std::uint32_t h;
@@ -1567,6 +1761,22 @@ int main(int argc, char **argv, char **envp) {
     *theStatisticManager->getStatisticByName("Instructions");
   uint64_t forks =
     *theStatisticManager->getStatisticByName("Forks");
+  uint64_t fastPathInstructions =
+    *theStatisticManager->getStatisticByName("FastPathInstructions");
+  uint64_t queryCacheHits =
+    *theStatisticManager->getStatisticByName("QueryCacheHits");
+  uint64_t queryCacheMisses =
+    *theStatisticManager->getStatisticByName("QueryCacheMisses");
+  uint64_t queryCexCacheHits =
+    *theStatisticManager->getStatisticByName("QueryCexCacheHits");
+  uint64_t queryCexCacheMisses =
+    *theStatisticManager->getStatisticByName("QueryCexCacheMisses");
+  uint64_t localitySelections =
+    *theStatisticManager->getStatisticByName("LocalitySelections");
+  uint64_t mergedStates =
+    *theStatisticManager->getStatisticByName("MergedStates");
+  uint64_t mergedPathsSaved =
+    *theStatisticManager->getStatisticByName("MergedPathsSaved");
 
   handler->getInfoStream()
     << "KLEE: done: explored paths = " << 1 + forks << "\n";
@@ -1581,7 +1791,17 @@ int main(int argc, char **argv, char **envp) {
     << "KLEE: done: total queries = " << queries << "\n"
     << "KLEE: done: valid queries = " << queriesValid << "\n"
     << "KLEE: done: invalid queries = " << queriesInvalid << "\n"
-    << "KLEE: done: query cex = " << queryCounterexamples << "\n";
+    << "KLEE: done: query cex = " << queryCounterexamples << "\n"
+    << "KLEE: done: fast-path instructions = " << fastPathInstructions
+    << "\n"
+    << "KLEE: done: query cache hits = " << queryCacheHits << " / "
+    << queryCacheHits + queryCacheMisses << "\n"
+    << "KLEE: done: query cex cache hits = " << queryCexCacheHits << " / "
+    << queryCexCacheHits + queryCexCacheMisses << "\n"
+    << "KLEE: done: locality selections = " << localitySelections << "\n"
+    << "KLEE: done: merged states = " << mergedStates << "\n"
+    << "KLEE: done: estimated paths saved by merging = " << mergedPathsSaved
+    << "\n";
 
   std::stringstream stats;
   stats << '\n'
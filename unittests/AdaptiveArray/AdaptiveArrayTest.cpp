@@ -0,0 +1,101 @@
+#include "klee/ADT/AdaptiveArray.h"
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+typedef std::shared_ptr<int> Value;
+
+Value val(int i) { return std::make_shared<int>(i); }
+
+std::vector<unsigned> indices(const AdaptiveArray<Value> &a, unsigned begin,
+                              unsigned end) {
+  std::vector<unsigned> result;
+  a.forEach(begin, end,
+            [&](unsigned idx, const Value &) { result.push_back(idx); });
+  return result;
+}
+} // namespace
+
+TEST(AdaptiveArrayTest, SparseSetAndLookup) {
+  AdaptiveArray<Value> a(1024);
+  ASSERT_TRUE(a.empty());
+
+  a.set(700, val(7));
+  a.set(3, val(3));
+  a.set(42, val(42));
+
+  ASSERT_FALSE(a.isDense());
+  ASSERT_EQ(3u, a.getCount());
+  ASSERT_EQ(42, **a.lookup(42));
+  ASSERT_EQ(nullptr, a.lookup(41));
+  ASSERT_EQ(std::vector<unsigned>({3, 42, 700}), indices(a, 0, 1024));
+  ASSERT_EQ(std::vector<unsigned>({42}), indices(a, 4, 700));
+
+  // overwriting keeps the count, setting an absent value erases
+  a.set(42, val(43));
+  ASSERT_EQ(3u, a.getCount());
+  ASSERT_EQ(43, **a.lookup(42));
+  a.set(42, Value());
+  ASSERT_FALSE(a.contains(42));
+  ASSERT_EQ(2u, a.getCount());
+}
+
+TEST(AdaptiveArrayTest, SwitchesToDense) {
+  AdaptiveArray<Value> a(64);
+  for (unsigned i = 0; i < 16; ++i)
+    a.set(i * 4, val(i));
+  ASSERT_FALSE(a.isDense());
+
+  a.set(1, val(100));
+  ASSERT_TRUE(a.isDense());
+  ASSERT_EQ(17u, a.getCount());
+  for (unsigned i = 0; i < 16; ++i)
+    ASSERT_EQ((int)i, **a.lookup(i * 4));
+  ASSERT_EQ(100, **a.lookup(1));
+  ASSERT_EQ(std::vector<unsigned>({0, 1, 4}), indices(a, 0, 5));
+}
+
+TEST(AdaptiveArrayTest, EraseRange) {
+  AdaptiveArray<Value> sparse(1000);
+  AdaptiveArray<Value> dense(8);
+  for (unsigned i = 0; i < 8; ++i) {
+    sparse.set(i * 100, val(i));
+    dense.set(i, val(i));
+  }
+  ASSERT_FALSE(sparse.isDense());
+  ASSERT_TRUE(dense.isDense());
+
+  sparse.eraseRange(100, 400);
+  dense.eraseRange(1, 4);
+  ASSERT_EQ(std::vector<unsigned>({0, 400, 500, 600, 700}),
+            indices(sparse, 0, 1000));
+  ASSERT_EQ(std::vector<unsigned>({0, 4, 5, 6, 7}), indices(dense, 0, 8));
+  ASSERT_EQ(5u, sparse.getCount());
+  ASSERT_EQ(5u, dense.getCount());
+}
+
+TEST(AdaptiveArrayTest, CopyCompacts) {
+  AdaptiveArray<Value> a(256);
+  for (unsigned i = 0; i < 128; ++i)
+    a.set(i, val(i));
+  ASSERT_TRUE(a.isDense());
+
+  AdaptiveArray<Value> denseCopy(a);
+  ASSERT_TRUE(denseCopy.isDense());
+  ASSERT_EQ(128u, denseCopy.getCount());
+
+  a.eraseRange(2, 128);
+  ASSERT_TRUE(a.isDense());
+  AdaptiveArray<Value> sparseCopy(a);
+  ASSERT_FALSE(sparseCopy.isDense());
+  ASSERT_EQ(2u, sparseCopy.getCount());
+  ASSERT_EQ(1, **sparseCopy.lookup(1));
+
+  // copies are independent
+  sparseCopy.set(0, val(99));
+  ASSERT_EQ(0, **a.lookup(0));
+}
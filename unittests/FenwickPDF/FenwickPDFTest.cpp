@@ -0,0 +1,122 @@
+#include "klee/ADT/DiscretePDF.h"
+#include "klee/ADT/FenwickPDF.h"
+#include "klee/ADT/RNG.h"
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <vector>
+
+using namespace klee;
+
+TEST(FenwickPDFTest, InsertUpdateRemove) {
+  FenwickPDF<int> pdf;
+  ASSERT_TRUE(pdf.empty());
+
+  for (int i = 0; i < 4; ++i)
+    pdf.insert(i, 1.0);
+  ASSERT_EQ(4u, pdf.size());
+  ASSERT_TRUE(pdf.inTree(2));
+
+  // Weights 1,1,1,1: each item covers a quarter of [0,1).
+  ASSERT_EQ(0, pdf.choose(0.1));
+  ASSERT_EQ(1, pdf.choose(0.3));
+  ASSERT_EQ(3, pdf.choose(0.99));
+
+  pdf.update(1, 0.0);
+  ASSERT_EQ(0.0, pdf.getWeight(1));
+  ASSERT_EQ(2, pdf.choose(0.5));
+
+  // Removing an item moves the last one into its slot.
+  pdf.remove(0);
+  ASSERT_FALSE(pdf.inTree(0));
+  ASSERT_EQ(3u, pdf.size());
+  ASSERT_EQ(1.0, pdf.getWeight(3));
+  ASSERT_EQ(3, pdf.choose(0.1));
+  ASSERT_EQ(2, pdf.choose(0.9));
+
+  pdf.remove(3);
+  pdf.remove(2);
+  ASSERT_EQ(1, pdf.choose(0.5));
+  pdf.remove(1);
+  ASSERT_TRUE(pdf.empty());
+}
+
+TEST(FenwickPDFTest, MatchesModel) {
+  FenwickPDF<int> pdf;
+  std::map<int, double> model;
+  std::vector<int> order; // slot order of the items, as kept by FenwickPDF
+  RNG rng;
+
+  for (int step = 0; step < 20000; ++step) {
+    unsigned op = rng.getInt32() % 4;
+    if (op == 0 || order.empty()) {
+      int item = step;
+      double weight = (rng.getInt32() % 100) / 10.0;
+      pdf.insert(item, weight);
+      model[item] = weight;
+      order.push_back(item);
+    } else if (op == 1) {
+      unsigned idx = rng.getInt32() % order.size();
+      pdf.remove(order[idx]);
+      model.erase(order[idx]);
+      order[idx] = order.back();
+      order.pop_back();
+    } else {
+      int item = order[rng.getInt32() % order.size()];
+      double weight = (rng.getInt32() % 100) / 10.0;
+      pdf.update(item, weight);
+      model[item] = weight;
+    }
+
+    if (order.empty())
+      continue;
+    double total = 0;
+    for (int item : order)
+      total += model[item];
+    if (total == 0)
+      continue;
+    // Pick the middle of a random item's interval.
+    unsigned idx = rng.getInt32() % order.size();
+    if (model[order[idx]] == 0)
+      continue;
+    double before = 0;
+    for (unsigned i = 0; i < idx; ++i)
+      before += model[order[i]];
+    double p = (before + model[order[idx]] / 2) / total;
+    ASSERT_EQ(order[idx], pdf.choose(p));
+  }
+}
+
+namespace {
+template <class PDF>
+double runPDFBenchmark(PDF &pdf, unsigned n, unsigned operations) {
+  RNG rng;
+  for (unsigned i = 0; i < n; ++i)
+    pdf.insert(i, 1.0 + rng.getDoubleL());
+  auto start = std::chrono::steady_clock::now();
+  unsigned item = 0;
+  for (unsigned i = 0; i < operations; ++i) {
+    item = pdf.choose(rng.getDoubleL());
+    pdf.update(item, 1.0 + rng.getDoubleL());
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+} // namespace
+
+// Run with --gtest_also_run_disabled_tests to compare the samplers.
+TEST(FenwickPDFTest, DISABLED_Benchmark) {
+  const unsigned operations = 1000000;
+  for (unsigned n = 1000; n <= 1000000; n *= 10) {
+    DiscretePDF<unsigned> tree;
+    FenwickPDF<unsigned> fenwick;
+    double treeTime = runPDFBenchmark(tree, n, operations);
+    double fenwickTime = runPDFBenchmark(fenwick, n, operations);
+    std::cout << n << " items, " << operations
+              << " choose+update: DiscretePDF " << treeTime
+              << "s, FenwickPDF " << fenwickTime << "s\n";
+  }
+}
@@ -0,0 +1,89 @@
+//===-- InstructionInfoTableTest.cpp ----------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Module/InstructionInfoTable.h"
+
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+using namespace klee;
+
+namespace {
+
+const char *const moduleText = R"(
+define i32 @first(i32 %a) {
+  %b = add i32 %a, 1
+  ret i32 %b
+}
+
+define i32 @second(i32 %a) {
+  %b = mul i32 %a, 2
+  %c = add i32 %b, 1
+  ret i32 %c
+}
+)";
+
+std::unique_ptr<llvm::Module> parse(llvm::LLVMContext &ctx) {
+  llvm::SMDiagnostic error;
+  auto m = llvm::parseAssemblyString(moduleText, error, ctx);
+  EXPECT_TRUE(m) << error.getMessage().str();
+  return m;
+}
+
+TEST(InstructionInfoTableTest, PopulatesFunctionsOnDemand) {
+  llvm::LLVMContext ctx;
+  auto m = parse(ctx);
+  InstructionInfoTable infos(*m);
+
+  // The first function looked up is numbered first, whatever its position.
+  const llvm::Function &second = *m->getFunction("second");
+  const InstructionInfo &secondEntry = infos.getInfo(*second.begin()->begin());
+  EXPECT_EQ(0u, secondEntry.id);
+  EXPECT_EQ(3u, infos.getFunctionInfo(second).id);
+  EXPECT_EQ(&secondEntry, &infos.getInfo(0));
+
+  // getMaxID() covers the whole module, and does not renumber.
+  EXPECT_EQ(7u, infos.getMaxID());
+  const llvm::Function &first = *m->getFunction("first");
+  EXPECT_EQ(4u, infos.getInfo(*first.begin()->begin()).id);
+  EXPECT_EQ(0u, infos.getInfo(*second.begin()->begin()).id);
+}
+
+TEST(InstructionInfoTableTest, AssemblyLines) {
+  llvm::LLVMContext ctx;
+  auto m = parse(ctx);
+  InstructionInfoTable infos(*m);
+
+  // Lines refer to the module as written to assembly.ll.
+  std::string text;
+  llvm::raw_string_ostream os(text);
+  m->print(os, nullptr);
+  os.flush();
+  auto lineOf = [&text](const std::string &needle) {
+    auto pos = text.find(needle);
+    EXPECT_NE(std::string::npos, pos) << needle;
+    return 1 + std::count(text.begin(), text.begin() + pos, '\n');
+  };
+
+  const llvm::Function &second = *m->getFunction("second");
+  const llvm::Instruction &mul = *second.begin()->begin();
+  EXPECT_EQ(lineOf("%b = mul"), infos.getInfo(mul).getAssemblyLine());
+  EXPECT_EQ(lineOf("define i32 @second"),
+            infos.getFunctionInfo(second).getAssemblyLine());
+}
+
+} // namespace
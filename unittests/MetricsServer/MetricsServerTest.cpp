@@ -0,0 +1,79 @@
+#include "klee/Support/MetricsServer.h"
+#include "gtest/gtest.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+std::string socketPath() {
+  char dir[] = "/tmp/klee-metrics-XXXXXX";
+  EXPECT_NE(nullptr, mkdtemp(dir));
+  return std::string(dir) + "/metrics.sock";
+}
+
+/// Connects to `path`, sends `request` and returns everything received.
+std::string query(const std::string &path, const std::string &request) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  EXPECT_GE(fd, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, path.c_str());
+  EXPECT_EQ(0, connect(fd, reinterpret_cast<sockaddr *>(&address),
+                       sizeof(address)));
+  if (!request.empty()) {
+    EXPECT_EQ((ssize_t)request.size(),
+              write(fd, request.data(), request.size()));
+  }
+
+  std::string response;
+  char buffer[256];
+  ssize_t n;
+  while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+    response.append(buffer, n);
+  close(fd);
+  return response;
+}
+} // namespace
+
+TEST(MetricsServerTest, ServesLatestSnapshot) {
+  const std::string path = socketPath();
+  std::string error;
+  {
+    auto server = MetricsServer::create(path, error);
+    ASSERT_NE(nullptr, server) << error;
+
+    ASSERT_EQ("", query(path, ""));
+    server->publish("klee_instructions 1\n");
+    ASSERT_EQ("klee_instructions 1\n", query(path, ""));
+    server->publish("klee_instructions 2\n");
+    ASSERT_EQ("klee_instructions 2\n", query(path, ""));
+
+    const std::string response =
+        query(path, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    ASSERT_EQ(0u, response.find("HTTP/1.0 200 OK\r\n"));
+    ASSERT_NE(std::string::npos, response.find("Content-Length: 20\r\n"));
+    ASSERT_EQ("\r\n\r\nklee_instructions 2\n",
+              response.substr(response.size() - 24));
+  }
+
+  // The socket is removed when the server stops.
+  ASSERT_NE(0, access(path.c_str(), F_OK));
+  rmdir(path.substr(0, path.rfind('/')).c_str());
+}
+
+TEST(MetricsServerTest, ReportsErrors) {
+  std::string error;
+  ASSERT_EQ(nullptr, MetricsServer::create(std::string(200, 'x'), error));
+  ASSERT_FALSE(error.empty());
+
+  error.clear();
+  ASSERT_EQ(nullptr,
+            MetricsServer::create("/nonexistent-dir/metrics.sock", error));
+  ASSERT_FALSE(error.empty());
+}
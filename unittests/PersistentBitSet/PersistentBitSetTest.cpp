@@ -0,0 +1,62 @@
+#include "klee/ADT/PersistentBitSet.h"
+#include "gtest/gtest.h"
+
+#include <set>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+std::vector<unsigned> elements(const PersistentBitSet &s) {
+  std::vector<unsigned> result;
+  s.forEach([&](unsigned i) { result.push_back(i); });
+  return result;
+}
+} // namespace
+
+TEST(PersistentBitSetTest, InsertAndContains) {
+  PersistentBitSet s;
+  ASSERT_TRUE(s.empty());
+
+  ASSERT_TRUE(s.insert(1000));
+  ASSERT_TRUE(s.insert(0));
+  ASSERT_TRUE(s.insert(63));
+  ASSERT_TRUE(s.insert(64));
+  ASSERT_FALSE(s.insert(63));
+
+  ASSERT_EQ(4u, s.size());
+  ASSERT_TRUE(s.contains(64));
+  ASSERT_FALSE(s.contains(65));
+  ASSERT_FALSE(s.contains(100000));
+  ASSERT_EQ(std::vector<unsigned>({0, 63, 64, 1000}), elements(s));
+
+  s.clear();
+  ASSERT_TRUE(s.empty());
+  ASSERT_FALSE(s.contains(0));
+}
+
+TEST(PersistentBitSetTest, CopiesAreIndependent) {
+  PersistentBitSet a;
+  for (unsigned i = 0; i < 5000; i += 7)
+    a.insert(i);
+
+  PersistentBitSet b(a);
+  b.insert(1);
+  b.insert(70000);
+  a.insert(2);
+
+  ASSERT_TRUE(b.contains(1));
+  ASSERT_FALSE(a.contains(1));
+  ASSERT_TRUE(a.contains(2));
+  ASSERT_FALSE(b.contains(2));
+  ASSERT_FALSE(a.contains(70000));
+  ASSERT_EQ(a.size() + 1, b.size());
+
+  std::set<unsigned> expected;
+  for (unsigned i = 0; i < 5000; i += 7)
+    expected.insert(i);
+  expected.insert(1);
+  expected.insert(70000);
+  ASSERT_EQ(std::vector<unsigned>(expected.begin(), expected.end()),
+            elements(b));
+}
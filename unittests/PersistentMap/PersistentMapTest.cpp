@@ -0,0 +1,207 @@
+#include "klee/ADT/ImmutableMap.h"
+#include "klee/ADT/PersistentMap.h"
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+typedef PersistentMap<std::uint64_t, int> Map;
+
+void expectEqual(const std::map<std::uint64_t, int> &expected,
+                 const Map &map) {
+  ASSERT_EQ(expected.size(), map.size());
+  ASSERT_EQ(expected.empty(), map.empty());
+  auto it = map.begin();
+  std::size_t i = 0;
+  for (const auto &p : expected) {
+    ASSERT_TRUE(it != map.end());
+    ASSERT_EQ(p.first, it->first);
+    ASSERT_EQ(p.second, it->second);
+    ASSERT_EQ(p.first, map.select(i).first);
+    ASSERT_EQ(i, map.rank(p.first));
+    ++it;
+    ++i;
+  }
+  ASSERT_TRUE(it == map.end());
+
+  // and backwards from the end
+  for (auto rit = expected.rbegin(); rit != expected.rend(); ++rit) {
+    --it;
+    ASSERT_EQ(rit->first, it->first);
+  }
+}
+} // namespace
+
+TEST(PersistentMapTest, Basic) {
+  Map empty;
+  ASSERT_TRUE(empty.empty());
+  ASSERT_TRUE(empty.begin() == empty.end());
+  ASSERT_EQ(nullptr, empty.lookup(1));
+  ASSERT_EQ(nullptr, empty.lookup_previous(1));
+
+  Map m = empty.insert({10, 1}).insert({20, 2}).insert({30, 3});
+  ASSERT_TRUE(empty.empty());
+  ASSERT_EQ(3u, m.size());
+  ASSERT_EQ(2, m.lookup(20)->second);
+  ASSERT_EQ(nullptr, m.lookup(25));
+  ASSERT_EQ(nullptr, m.lookup_previous(9));
+  ASSERT_EQ(20u, m.lookup_previous(29)->first);
+  ASSERT_EQ(30u, m.lookup_previous(1000)->first);
+  ASSERT_EQ(10u, m.min().first);
+  ASSERT_EQ(30u, m.max().first);
+  ASSERT_EQ(20u, m.select(1).first);
+  ASSERT_EQ(0u, m.rank(5));
+  ASSERT_EQ(1u, m.rank(20));
+  ASSERT_EQ(2u, m.rank(25));
+  ASSERT_EQ(3u, m.rank(1000));
+  ASSERT_EQ(0u, empty.rank(1));
+
+  // insert does not overwrite, replace does
+  ASSERT_EQ(2, m.insert({20, 5}).lookup(20)->second);
+  Map r = m.replace({20, 5});
+  ASSERT_EQ(5, r.lookup(20)->second);
+  ASSERT_EQ(2, m.lookup(20)->second);
+
+  ASSERT_EQ(20u, m.lower_bound(11)->first);
+  ASSERT_EQ(20u, m.lower_bound(20)->first);
+  ASSERT_EQ(30u, m.upper_bound(20)->first);
+  ASSERT_TRUE(m.upper_bound(30) == m.end());
+  ASSERT_TRUE(m.find(15) == m.end());
+  ASSERT_EQ(3, m.find(30)->second);
+
+  std::pair<std::uint64_t, int> v;
+  Map rest = m.popMin(v);
+  ASSERT_EQ(10u, v.first);
+  ASSERT_EQ(2u, rest.size());
+  rest = rest.popMax(v);
+  ASSERT_EQ(30u, v.first);
+  ASSERT_EQ(1u, rest.size());
+  ASSERT_EQ(3u, m.size());
+}
+
+TEST(PersistentMapTest, RandomizedAgainstStdMap) {
+  std::mt19937_64 rng(42);
+  std::map<std::uint64_t, int> expected;
+  Map map;
+
+  // snapshots must stay unchanged while later versions are modified
+  std::vector<std::pair<std::map<std::uint64_t, int>, Map>> snapshots;
+
+  for (int i = 0; i < 20000; ++i) {
+    std::uint64_t key = rng() % 4096;
+    switch (rng() % 4) {
+    case 0:
+    case 1:
+      expected.insert({key, i});
+      map = map.insert({key, i});
+      break;
+    case 2:
+      expected[key] = i;
+      map = map.replace({key, i});
+      break;
+    default:
+      expected.erase(key);
+      map = map.remove(key);
+      break;
+    }
+
+    if (i % 2000 == 0)
+      snapshots.emplace_back(expected, map);
+
+    std::uint64_t probe = rng() % 4200;
+    auto ub = expected.upper_bound(probe);
+    auto mub = map.upper_bound(probe);
+    if (ub == expected.end()) {
+      ASSERT_TRUE(mub == map.end());
+    } else {
+      ASSERT_EQ(ub->first, mub->first);
+    }
+    auto prev = map.lookup_previous(probe);
+    if (ub == expected.begin()) {
+      ASSERT_EQ(nullptr, prev);
+    } else {
+      ASSERT_NE(nullptr, prev);
+      ASSERT_EQ(std::prev(ub)->first, prev->first);
+    }
+    ASSERT_EQ(expected.count(probe), map.count(probe));
+    ASSERT_EQ(std::size_t(std::distance(expected.begin(),
+                                        expected.lower_bound(probe))),
+              map.rank(probe));
+  }
+
+  expectEqual(expected, map);
+  for (const auto &s : snapshots)
+    expectEqual(s.first, s.second);
+
+  // drain the map completely
+  while (!expected.empty()) {
+    auto it = expected.begin();
+    std::advance(it, rng() % expected.size());
+    map = map.remove(it->first);
+    expected.erase(it);
+  }
+  expectEqual(expected, map);
+}
+
+namespace {
+/// Times lookup, copy-on-write update and iteration of a map with n
+/// elements, as done by AddressSpace on its MemoryMap.
+template <class M> void benchmark(const char *name, std::uint64_t n) {
+  typedef std::chrono::steady_clock Clock;
+  std::mt19937_64 rng(1);
+  std::vector<std::uint64_t> keys;
+  keys.reserve(n);
+  M m;
+  for (std::uint64_t i = 0; i < n; ++i) {
+    keys.push_back(i * 64);
+    m = m.insert({i * 64, (int)i});
+  }
+
+  const std::uint64_t ops = 1000000;
+  auto seconds = [](Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  };
+
+  auto start = Clock::now();
+  std::uint64_t sum = 0;
+  for (std::uint64_t i = 0; i < ops; ++i)
+    sum += m.lookup_previous(keys[rng() % n] + 3)->second;
+  double lookup = seconds(start);
+
+  start = Clock::now();
+  for (std::uint64_t i = 0; i < ops / 10; ++i) {
+    // a fork that updates one object
+    std::uint64_t key = keys[rng() % n];
+    const M copy = m.replace({key, (int)i});
+    sum += copy.lookup(key)->second;
+  }
+  double update = seconds(start);
+
+  start = Clock::now();
+  for (int r = 0; r < 10; ++r)
+    for (const auto &p : m)
+      sum += p.second;
+  double iterate = seconds(start);
+
+  std::cout << name << " n=" << n << ": "
+            << ops / lookup / 1e6 << " M lookups/s, "
+            << ops / 10 / update / 1e6 << " M COW updates/s, "
+            << 10 * n / iterate / 1e6 << " M iterated/s (" << sum % 2
+            << ")" << std::endl;
+}
+} // namespace
+
+// Run with --gtest_also_run_disabled_tests
+TEST(PersistentMapTest, DISABLED_Benchmark) {
+  for (std::uint64_t n : {10000, 100000, 1000000}) {
+    benchmark<ImmutableMap<std::uint64_t, int>>("ImmutableMap ", n);
+    benchmark<PersistentMap<std::uint64_t, int>>("PersistentMap", n);
+  }
+}
@@ -14,9 +14,13 @@
 #include "Core/ExecutionTree.h"
 #include "Core/Searcher.h"
 #include "klee/ADT/RNG.h"
+#include "klee/Expr/Expr.h"
 
 #include "llvm/Support/raw_ostream.h"
 
+#include <chrono>
+#include <memory>
+
 using namespace klee;
 
 namespace {
@@ -156,12 +160,12 @@ TEST(SearcherTest, TwoRandomPathDot) {
       << "\tnode [style=\"filled\",width=.1,height=.1,fontname=\"Terminus\"]\n"
       << "\tedge [arrowsize=.3]\n"
       << "\tn" << rootExecutionTreeNode << " [shape=diamond];\n"
-      << "\tn" << rootExecutionTreeNode << " -> n" << esParentExecutionTreeNode << " [label=0b011];\n"
-      << "\tn" << rootExecutionTreeNode << " -> n" << rightLeafExecutionTreeNode << " [label=0b000];\n"
+      << "\tn" << rootExecutionTreeNode << " -> n" << esParentExecutionTreeNode << " [label=0b11];\n"
+      << "\tn" << rootExecutionTreeNode << " -> n" << rightLeafExecutionTreeNode << " [label=0b00];\n"
       << "\tn" << rightLeafExecutionTreeNode << " [shape=diamond,fillcolor=green];\n"
       << "\tn" << esParentExecutionTreeNode << " [shape=diamond];\n"
-      << "\tn" << esParentExecutionTreeNode << " -> n" << es1LeafExecutionTreeNode << " [label=0b010];\n"
-      << "\tn" << esParentExecutionTreeNode << " -> n" << esLeafExecutionTreeNode << " [label=0b001];\n"
+      << "\tn" << esParentExecutionTreeNode << " -> n" << es1LeafExecutionTreeNode << " [label=0b10];\n"
+      << "\tn" << esParentExecutionTreeNode << " -> n" << esLeafExecutionTreeNode << " [label=0b01];\n"
       << "\tn" << esLeafExecutionTreeNode << " [shape=diamond,fillcolor=green];\n"
       << "\tn" << es1LeafExecutionTreeNode << " [shape=diamond,fillcolor=green];\n"
       << "}\n";
@@ -186,11 +190,11 @@ TEST(SearcherTest, TwoRandomPathDot) {
       << "\tnode [style=\"filled\",width=.1,height=.1,fontname=\"Terminus\"]\n"
       << "\tedge [arrowsize=.3]\n"
       << "\tn" << rootExecutionTreeNode << " [shape=diamond];\n"
-      << "\tn" << rootExecutionTreeNode << " -> n" << esParentExecutionTreeNode << " [label=0b001];\n"
-      << "\tn" << rootExecutionTreeNode << " -> n" << rightLeafExecutionTreeNode << " [label=0b000];\n"
+      << "\tn" << rootExecutionTreeNode << " -> n" << esParentExecutionTreeNode << " [label=0b01];\n"
+      << "\tn" << rootExecutionTreeNode << " -> n" << rightLeafExecutionTreeNode << " [label=0b00];\n"
       << "\tn" << rightLeafExecutionTreeNode << " [shape=diamond,fillcolor=green];\n"
       << "\tn" << esParentExecutionTreeNode << " [shape=diamond];\n"
-      << "\tn" << esParentExecutionTreeNode << " -> n" << es1LeafExecutionTreeNode << " [label=0b001];\n"
+      << "\tn" << esParentExecutionTreeNode << " -> n" << es1LeafExecutionTreeNode << " [label=0b01];\n"
       << "\tn" << es1LeafExecutionTreeNode << " [shape=diamond,fillcolor=green];\n"
       << "}\n";
 
@@ -201,6 +205,135 @@ TEST(SearcherTest, TwoRandomPathDot) {
   executionTree.remove(root.executionTreeNode);
 }
 
+TEST(SearcherTest, ManyRandomPaths) {
+  ExecutionState root;
+  InMemoryExecutionTree executionTree(root);
+
+  std::vector<std::unique_ptr<ExecutionState>> states;
+  for (unsigned i = 0; i < MaxExecutionTreeOwners; ++i) {
+    states.emplace_back(new ExecutionState(root));
+    executionTree.attach(root.executionTreeNode, states.back().get(), &root,
+                         BranchType::Conditional);
+  }
+
+  RNG rng;
+  std::vector<std::unique_ptr<RandomPathSearcher>> searchers;
+  for (unsigned i = 0; i < MaxExecutionTreeOwners; ++i) {
+    searchers.emplace_back(new RandomPathSearcher(&executionTree, rng));
+    searchers[i]->update(nullptr, {states[i].get()}, {});
+  }
+
+  // every searcher only walks to its own state
+  for (unsigned i = 0; i < MaxExecutionTreeOwners; ++i) {
+    for (int j = 0; j < 10; j++)
+      EXPECT_EQ(&searchers[i]->selectState(), states[i].get());
+  }
+
+  // the last searcher also owns the root state
+  searchers.back()->update(nullptr, {&root}, {});
+  bool selectedRoot = false, selectedOwn = false;
+  for (int j = 0; j < 100; j++) {
+    ExecutionState *es = &searchers.back()->selectState();
+    selectedRoot |= es == &root;
+    selectedOwn |= es == states.back().get();
+  }
+  EXPECT_TRUE(selectedRoot && selectedOwn);
+
+  for (unsigned i = 0; i < MaxExecutionTreeOwners; ++i) {
+    searchers[i]->update(nullptr, {}, {states[i].get()});
+    EXPECT_EQ(i + 1 == MaxExecutionTreeOwners, !searchers[i]->empty());
+    executionTree.remove(states[i]->executionTreeNode);
+  }
+  searchers.back()->update(nullptr, {}, {&root});
+  EXPECT_TRUE(searchers.back()->empty());
+  executionTree.remove(root.executionTreeNode);
+}
+
+TEST(SearcherTest, Locality) {
+  auto c = [](unsigned i) { return ConstantExpr::create(i, Expr::Int32); };
+  ExecutionState root;
+  root.constraints.push_back(c(1));
+  root.constraints.push_back(c(2));
+  root.constraints.push_back(c(3));
+  ExecutionState far;
+  far.constraints.push_back(c(1));
+  far.constraints.push_back(c(4));
+  ExecutionState near;
+  near.constraints.push_back(c(1));
+  near.constraints.push_back(c(2));
+  near.constraints.push_back(c(5));
+
+  LocalitySearcher ls(new BFSSearcher(), 1);
+  ls.update(nullptr, {&root}, {});
+  EXPECT_EQ(&ls.selectState(), &root);
+
+  // the burst state keeps running after forking
+  ls.update(&root, {&far, &near}, {});
+  EXPECT_EQ(&ls.selectState(), &root);
+
+  // once it terminates, the closest forked state runs next, although the
+  // underlying BFS searcher would pick the other one
+  ls.update(&root, {}, {&root});
+  EXPECT_EQ(&ls.selectState(), &near);
+
+  // the burst is exhausted, so BFS picks again
+  ls.update(&near, {}, {&near});
+  EXPECT_EQ(&ls.selectState(), &far);
+  ls.update(&far, {}, {&far});
+  EXPECT_TRUE(ls.empty());
+}
+
+// Run with --gtest_also_run_disabled_tests to compare the NURS samplers.
+// nurs:depth never changes weights; nurs:qc re-weighs the selected state
+// before the next selection, like the other coverage and cost heuristics.
+TEST(SearcherTest, DISABLED_WeightedRandomBenchmark) {
+  const unsigned selections = 1000000;
+  for (unsigned n = 1000; n <= 1000000; n *= 10) {
+    std::vector<std::unique_ptr<ExecutionState>> states;
+    std::vector<ExecutionState *> added;
+    for (unsigned i = 0; i < n; ++i) {
+      states.emplace_back(new ExecutionState());
+      states.back()->setID();
+      states.back()->depth = i % 64 + 1;
+      states.back()->queryMetaData.queryCost = time::milliseconds(i % 500);
+      added.push_back(states.back().get());
+    }
+
+    for (auto type :
+         {WeightedRandomSearcher::Depth, WeightedRandomSearcher::QueryCost}) {
+      for (auto sampler :
+           {WeightedRandomSearcher::Tree, WeightedRandomSearcher::Fenwick}) {
+        RNG rng;
+        WeightedRandomSearcher searcher(type, rng, sampler);
+        auto start = std::chrono::steady_clock::now();
+        searcher.update(nullptr, added, {});
+        for (unsigned i = 0; i < selections; ++i) {
+          ExecutionState &es = searcher.selectState();
+          if (type == WeightedRandomSearcher::Depth) {
+            // re-insert the selected state, as a terminating fork would
+            searcher.update(&es, {}, {&es});
+            searcher.update(nullptr, {&es}, {});
+          } else {
+            // the selected state ran a query of a new cost
+            es.queryMetaData.queryCost = time::milliseconds(i % 500);
+            searcher.update(&es, {}, {});
+          }
+        }
+        searcher.update(nullptr, {}, added);
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        llvm::outs() << n << " states, "
+                     << (type == WeightedRandomSearcher::Depth ? "nurs:depth"
+                                                               : "nurs:qc")
+                     << ", "
+                     << (sampler == WeightedRandomSearcher::Tree ? "tree"
+                                                                 : "fenwick")
+                     << ": " << elapsed.count() << "s\n";
+      }
+    }
+  }
+}
+
 TEST(SearcherDeathTest, TooManyRandomPaths) {
   // First state
   ExecutionState es;
@@ -208,9 +341,9 @@ TEST(SearcherDeathTest, TooManyRandomPaths) {
   executionTree.remove(es.executionTreeNode); // Need to remove to avoid leaks
 
   RNG rng;
-  RandomPathSearcher rp(&executionTree, rng);
-  RandomPathSearcher rp1(&executionTree, rng);
-  RandomPathSearcher rp2(&executionTree, rng);
-  ASSERT_DEATH({ RandomPathSearcher rp3(&executionTree, rng); }, "");
+  std::vector<std::unique_ptr<RandomPathSearcher>> searchers;
+  for (unsigned i = 0; i < MaxExecutionTreeOwners; ++i)
+    searchers.emplace_back(new RandomPathSearcher(&executionTree, rng));
+  ASSERT_DEATH({ RandomPathSearcher rp(&executionTree, rng); }, "");
 }
 }
@@ -0,0 +1,107 @@
+//===-- SeedsTest.cpp -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+#define KLEE_UNITTEST
+
+#include "gtest/gtest.h"
+
+#include "Core/ExecutionState.h"
+#include "Core/SeedInfo.h"
+#include "Core/SeedMap.h"
+#include "klee/ADT/RNG.h"
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Expr.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+SeedInfo makeSeed(const Array *a, std::vector<unsigned char> aValues,
+                  const Array *b, std::vector<unsigned char> bValues) {
+  SeedInfo seed(nullptr);
+  seed.assignment.bindings[a] = std::move(aValues);
+  if (!bValues.empty())
+    seed.assignment.bindings[b] = std::move(bValues);
+  return seed;
+}
+
+TEST(SeedsTest, EvaluateMatchesAssignment) {
+  ArrayCache cache;
+  const Array *a = cache.CreateArray("a", 4);
+  const Array *b = cache.CreateArray("b", 4);
+
+  // a[1] + b[a[0] & 3] == a[2], read at constant and symbolic indices
+  ref<Expr> index = AndExpr::create(Expr::createTempRead(a, Expr::Int8),
+                                    ConstantExpr::create(3, Expr::Int8));
+  ref<Expr> readB = ReadExpr::create(
+      UpdateList(b, nullptr), ZExtExpr::create(index, Expr::Int32));
+  ref<Expr> readA1 = ReadExpr::create(UpdateList(a, nullptr),
+                                      ConstantExpr::create(1, Expr::Int32));
+  ref<Expr> readA2 = ReadExpr::create(UpdateList(a, nullptr),
+                                      ConstantExpr::create(2, Expr::Int32));
+  ref<Expr> e = EqExpr::create(AddExpr::create(readA1, readB), readA2);
+
+  RNG rng;
+  std::vector<SeedInfo> seeds;
+  for (unsigned i = 0; i < 500; ++i) {
+    std::vector<unsigned char> aValues(4), bValues;
+    for (auto &v : aValues)
+      v = rng.getInt32() % 4;
+    // Some seeds leave b unbound, so e stays symbolic under them.
+    if (i % 7) {
+      bValues.resize(4);
+      for (auto &v : bValues)
+        v = rng.getInt32() % 4;
+    }
+    seeds.push_back(makeSeed(a, aValues, b, bValues));
+  }
+
+  std::vector<ref<Expr>> values = evaluateSeeds(seeds, e);
+  ASSERT_EQ(values.size(), seeds.size());
+  for (std::size_t i = 0; i < seeds.size(); ++i)
+    EXPECT_EQ(values[i], seeds[i].assignment.evaluate(e)) << "seed " << i;
+
+  std::vector<ref<Expr>> constant =
+      evaluateSeeds(seeds, ConstantExpr::create(1, Expr::Bool));
+  for (const auto &value : constant)
+    EXPECT_TRUE(value->isTrue());
+}
+
+TEST(SeedsTest, SeedMapCountsSeeds) {
+  ExecutionState first, second;
+  first.setID();
+  second.setID();
+
+  SeedMap map;
+  EXPECT_TRUE(map.empty());
+  for (unsigned i = 0; i < 3; ++i)
+    map.add(&second, SeedInfo(nullptr));
+  map.add(&first, SeedInfo(nullptr));
+  EXPECT_EQ(map.numStates(), 2u);
+  EXPECT_EQ(map.totalSeeds(), 4u);
+
+  // States are visited in id order, and the order survives terminated
+  // states.
+  EXPECT_EQ(map.begin()->first, &first);
+  EXPECT_EQ(map.upper_bound(first.getID())->first, &second);
+  EXPECT_EQ(map.upper_bound(second.getID()), map.end());
+
+  std::vector<SeedInfo> taken = map.take(map.find(&second));
+  EXPECT_EQ(taken.size(), 3u);
+  EXPECT_EQ(map.totalSeeds(), 1u);
+  EXPECT_EQ(map.upper_bound(first.getID()), map.end());
+
+  map.erase(&second);
+  map.erase(&first);
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.totalSeeds(), 0u);
+}
+
+} // namespace
@@ -1,15 +1,41 @@
 #include "klee/ADT/TreeStream.h"
 #include <vector>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
+#include <string>
 
 #include "gtest/gtest.h"
 
+#include <unistd.h>
+
 using namespace klee;
 
+namespace {
+/// A unique file name in the temporary directory, removed again when the
+/// test is done with it.
+class TempFile {
+  std::string path;
+
+public:
+  TempFile() {
+    char name[] = "/tmp/klee-treestream-XXXXXX";
+    int fd = mkstemp(name);
+    EXPECT_NE(-1, fd);
+    if (fd != -1)
+      close(fd);
+    path = name;
+  }
+  ~TempFile() { std::remove(path.c_str()); }
+  const char *c_str() const { return path.c_str(); }
+};
+} // namespace
+
 /* Basic test, checking that after writing "abc" and then "defg", we
    get a {'a', 'b', 'c', 'c', 'd', 'e', 'f', 'g' } back.  */
 TEST(TreeStreamTest, Basic) {
-  TreeStreamWriter tsw("tsw1.out");
+  TempFile file;
+  TreeStreamWriter tsw(file.c_str());
   ASSERT_TRUE(tsw.good());
   
   TreeOStream tos = tsw.open();
@@ -30,7 +56,8 @@ TEST(TreeStreamTest, Basic) {
    the buffer size, which is a constant set to 4*4096.  This test fails 
    without #704 */
 TEST(TreeStreamTest, WriteLargerThanBufferSize) {
-  TreeStreamWriter tsw("tsw2.out");
+  TempFile file;
+  TreeStreamWriter tsw(file.c_str());
   ASSERT_TRUE(tsw.good());
   
   TreeOStream tos = tsw.open();
@@ -46,3 +73,114 @@ TEST(TreeStreamTest, WriteLargerThanBufferSize) {
   for (unsigned i=0; i<out.size(); i++)
     ASSERT_EQ('A', out[i]);
 }
+
+/* Forks streams at random points and interleaves writes to them, then
+   checks every stream against a model, both through the writer and
+   through a TreeStreamReader on the finished file. */
+TEST(TreeStreamTest, ForkedStreams) {
+  std::vector<std::vector<unsigned char>> model;
+  std::vector<TreeOStream> streams;
+  unsigned seed = 1;
+  auto next = [&seed]() { return (seed = seed * 1103515245 + 12345) >> 16; };
+  TempFile file;
+
+  {
+    TreeStreamWriter tsw(file.c_str());
+    ASSERT_TRUE(tsw.good());
+    streams.push_back(tsw.open());
+    model.emplace_back();
+
+    for (unsigned step = 0; step < 20000; ++step) {
+      unsigned i = next() % streams.size();
+      switch (next() % 8) {
+      case 0:
+        if (streams.size() < 500) {
+          streams.push_back(tsw.open(streams[i]));
+          model.push_back(model[i]);
+        }
+        break;
+      case 1: {
+        char c = 'a' + next() % 26;
+        streams[i].write(&c, 1);
+        model[i].push_back(c);
+        break;
+      }
+      default: {
+        bool taken = next() % 2;
+        streams[i].writeBranch(taken);
+        model[i].push_back(taken ? '1' : '0');
+      }
+      }
+    }
+
+    for (unsigned i = 0; i < streams.size(); i += 7) {
+      std::vector<unsigned char> out;
+      tsw.readStream(streams[i].getID(), out);
+      ASSERT_EQ(model[i], out);
+    }
+  }
+
+  TreeStreamReader reader(file.c_str());
+  ASSERT_TRUE(reader.good());
+  ASSERT_EQ(streams.size() + 1, reader.getNumStreams());
+  for (unsigned i = 0; i < streams.size(); ++i) {
+    std::vector<unsigned char> out;
+    ASSERT_TRUE(reader.readStream(streams[i].getID(), out));
+    ASSERT_EQ(model[i], out);
+  }
+}
+
+/* Branch outcomes take one bit each in the file. */
+TEST(TreeStreamTest, PackedBranches) {
+  TempFile file;
+  {
+    TreeStreamWriter tsw(file.c_str());
+    TreeOStream tos = tsw.open();
+    for (unsigned i = 0; i < 8000; ++i)
+      tos.writeBranch(i % 3 == 0);
+  }
+  std::ifstream is(file.c_str(), std::ios::binary | std::ios::ate);
+  ASSERT_LT(is.tellg(), 1100);
+
+  TreeStreamReader reader(file.c_str());
+  std::vector<unsigned char> out;
+  ASSERT_TRUE(reader.readStream(1, out));
+  ASSERT_EQ(8000u, out.size());
+  for (unsigned i = 0; i < out.size(); ++i)
+    ASSERT_EQ(i % 3 == 0 ? '1' : '0', out[i]);
+}
+
+/* Converts a file in the old, unindexed format. */
+TEST(TreeStreamTest, ConvertLegacy) {
+  TempFile oldFile, newFile, otherFile;
+  {
+    std::ofstream os(oldFile.c_str(), std::ios::binary);
+    auto put = [&os](unsigned id, unsigned tag, const char *data) {
+      os.write(reinterpret_cast<const char *>(&id), 4);
+      os.write(reinterpret_cast<const char *>(&tag), 4);
+      if (data)
+        os.write(data, tag);
+    };
+    put(0, 1 | (1u << 31), nullptr); // open stream 1
+    put(1, 3, "1x0");
+    put(1, 2 | (1u << 31), nullptr); // fork stream 2 off 1
+    put(1, 1, "1");
+    put(2, 2, "0y");
+    put(2, 3 | (1u << 31), nullptr); // fork stream 3 off 2
+    put(3, 1, "1");
+  }
+
+  std::string error;
+  ASSERT_TRUE(convertLegacyTreeStream(oldFile.c_str(), newFile.c_str(), error)) << error;
+  // Converting twice is refused.
+  ASSERT_FALSE(convertLegacyTreeStream(newFile.c_str(), otherFile.c_str(), error));
+
+  TreeStreamReader reader(newFile.c_str());
+  ASSERT_TRUE(reader.good());
+  const char *expected[] = {"1x01", "1x00y", "1x00y1"};
+  for (unsigned id = 1; id <= 3; ++id) {
+    std::vector<unsigned char> out;
+    ASSERT_TRUE(reader.readStream(id, out));
+    ASSERT_EQ(std::string(expected[id - 1]), std::string(out.begin(), out.end()));
+  }
+}
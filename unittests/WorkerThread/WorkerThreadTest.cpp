@@ -0,0 +1,63 @@
+#include "klee/Support/WorkerThread.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+using namespace klee;
+
+TEST(WorkerThreadTest, RunsJobsInOrder) {
+  std::vector<int> order;
+  {
+    WorkerThread worker;
+    for (int i = 0; i < 100; ++i)
+      worker.submit([&order, i] { order.push_back(i); });
+    worker.drain();
+    ASSERT_EQ(0u, worker.pending());
+    ASSERT_EQ(100u, order.size());
+    for (int i = 0; i < 100; ++i)
+      ASSERT_EQ(i, order[i]);
+
+    // Jobs still queued when the worker is destroyed are run.
+    for (int i = 100; i < 110; ++i)
+      worker.submit([&order, i] { order.push_back(i); });
+  }
+  ASSERT_EQ(110u, order.size());
+  ASSERT_EQ(109, order.back());
+}
+
+TEST(WorkerThreadTest, WaitForPending) {
+  std::mutex mutex;
+  std::condition_variable released;
+  bool release = false;
+  std::atomic<unsigned> done{0};
+
+  WorkerThread worker;
+  // The first job blocks the worker until it is released.
+  worker.submit([&] {
+    std::unique_lock<std::mutex> lock(mutex);
+    released.wait(lock, [&] { return release; });
+    ++done;
+  });
+  for (int i = 0; i < 4; ++i)
+    worker.submit([&done] { ++done; });
+  ASSERT_EQ(5u, worker.pending());
+
+  // Does not block while the bound is already met.
+  worker.waitForPending(5);
+  ASSERT_EQ(0u, done.load());
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    release = true;
+  }
+  released.notify_one();
+  worker.waitForPending(2);
+  ASSERT_LE(worker.pending(), 2u);
+  ASSERT_GE(done.load(), 3u);
+
+  worker.drain();
+  ASSERT_EQ(5u, done.load());
+}